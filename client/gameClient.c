@@ -155,7 +155,7 @@ void postObjects(const Client *c, const RequestData *request) {
 	clientFreeResponse(&res);
 }
 
-void getObjects(const Client *c, ObjectList *scene, MaterialLib *matLib, idRegister *reg) {
+void getObjects(const Client *c, ObjectList *scene, MaterialLib *matLib, idRegister *reg, AssetLoader *assets) {
 	ClientResponse res = clientGet(c, "get objects", strlen("get objects") + 1);
 	// printf("[client] GET response (%u bytes)\n", res.size);
 	if (!res.data || res.size < sizeof(uint32)) {
@@ -198,19 +198,12 @@ void getObjects(const Client *c, ObjectList *scene, MaterialLib *matLib, idRegis
 				}
 			}
 		} else {
-			// new object — load model and add to scene and registry
+			// new object — a proxy now, the model from the asset loader once it is ready
 			printf("New object detected with Id=%u, loading model...\n", obj->Id);
 			const char *path = modelTypeToPath(idModel(obj->Id));
-			if (path) {
-				uint32 sceneIndex = (uint32)scene->count;
-				Object *newObj = ObjectList_Add(scene); // may realloc scene->objects
-				LoadObj(path, newObj, matLib);
-				CreateObjectBVH(newObj, &newObj->bvh);
-				Object_UpdateWorldBounds(newObj);
-				newObj->position = obj->Position;
-				newObj->rotation = obj->Rotation;
-				newObj->scale = obj->Scale;
-				idRegister_Add(reg, obj->Id, sceneIndex);
+			int sceneIndex = path ? AssetLoader_Request(assets, path, scene, matLib, obj->Position, obj->Rotation, obj->Scale) : -1;
+			if (sceneIndex >= 0) {
+				idRegister_Add(reg, obj->Id, (uint32)sceneIndex);
 				seen = realloc(seen, reg->count * sizeof(bool));
 				seen[reg->count - 1] = true;
 			}
@@ -240,6 +233,9 @@ int main(void) {
 	idRegister objectRegistry;
 	idRegister_Init(&objectRegistry, 16);
 
+	AssetLoader assets;
+	AssetLoader_Init(&assets);
+
 	Client c = {.host = "127.0.0.1", .port = 8080};
 
 	uint32 f16SceneIndex = (uint32)scene.count;
@@ -266,7 +262,7 @@ int main(void) {
 	clientFreeResponse(&res);
 
 	sleep(1);
-	getObjects(&c, &scene, &matLib, &objectRegistry);
+	getObjects(&c, &scene, &matLib, &objectRegistry, &assets);
 
 	// simulate a second client posting a new R27 object
 	Client c2 = {.host = "127.0.0.1", .port = 8080};
@@ -293,7 +289,8 @@ int main(void) {
 	idRegister_Free(&c2Registry);
 
 	sleep(1);
-	getObjects(&c, &scene, &matLib, &objectRegistry);
+	getObjects(&c, &scene, &matLib, &objectRegistry, &assets);
+	AssetLoader_Flush(&assets, &scene, &matLib);
 	printf("[client] Scene objects count: %u\n", scene.count);
 	for (uint32 i = 0; i < scene.count; i++) {
 		Object *o = &scene.objects[i];
@@ -320,7 +317,7 @@ int main(void) {
 	int iterations = 0;
 	while (totalTime < 30.0f) {
 		clock_t start = clock();
-		getObjects(&c, &scene, &matLib, &objectRegistry);
+		getObjects(&c, &scene, &matLib, &objectRegistry, &assets);
 		RequestData_Reset(&request);
 		for (uint32 i = 0; i < scene.count; i++) {
 			addObjectToRequestData(&request, &scene.objects[i], objectRegistry.Ids[i]);
@@ -334,9 +331,10 @@ int main(void) {
 	printf("[client] Completed %d GET/POST iterations average iteration time: %.2fms\n", iterations, (totalTime / iterations) * 1000.0f);
 
 	sleep(15);
-	getObjects(&c, &scene, &matLib, &objectRegistry);
+	getObjects(&c, &scene, &matLib, &objectRegistry, &assets);
 	printf("[client] Scene objects count: %u\n", scene.count);
 
+	AssetLoader_Destroy(&assets);
 	RequestData_Free(&request);
 	idRegister_Free(&objectRegistry);
 }
@@ -4,6 +4,7 @@
 #include "client.h"
 #include "../object/scene.h"
 #include "../object/material/material.h"
+#include "../load/assetLoader.h"
 
 typedef enum {
 	MODEL_F16 = 1,
@@ -49,6 +50,8 @@ void addFromRegistry(RequestData *request, const idRegister *reg, const ObjectLi
 void addAllFromRegistry(RequestData *request, const idRegister *reg, const ObjectList *scene);
 
 void postObjects(const Client *c, const RequestData *request);
-void getObjects(const Client *c, ObjectList *scene, MaterialLib *matLib, idRegister *reg);
+// Unseen Ids get a proxy in the scene and a request on assets; call AssetLoader_Apply between
+// frames to swap the loaded models in.
+void getObjects(const Client *c, ObjectList *scene, MaterialLib *matLib, idRegister *reg, AssetLoader *assets);
 
 #endif // GAME_CLIENT_H
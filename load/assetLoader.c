@@ -0,0 +1,216 @@
+#include "assetLoader.h"
+#include "loadObj.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Loader thread side: everything that touches the file or walks the whole mesh.
+static void LoadJob(AssetJob *job) {
+	MaterialLib_Init(&job->materials, 16);
+	LoadObj(job->path, &job->object, &job->materials);
+	job->loaded = job->object.v1 != NULL && job->object.triangleCount > 0;
+	if (job->loaded) CreateObjectBVH(&job->object, &job->object.bvh);
+}
+
+static void FreeJob(AssetJob *job) {
+	Object_Destroy(&job->object);
+	MaterialLib_Destroy(&job->materials);
+	free(job);
+}
+
+static void *LoaderThread(void *arg) {
+	AssetLoader *loader = arg;
+	pthread_mutex_lock(&loader->lock);
+	for (;;) {
+		while (!loader->stop && loader->requestCount == 0)
+			pthread_cond_wait(&loader->wake, &loader->lock);
+		if (loader->stop) break;
+		AssetJob *job = loader->requests[loader->requestHead];
+		loader->requestHead = (loader->requestHead + 1) % ASSET_QUEUE_SIZE;
+		loader->requestCount--;
+		pthread_mutex_unlock(&loader->lock);
+
+		LoadJob(job);
+
+		pthread_mutex_lock(&loader->lock);
+		loader->done[loader->doneCount++] = job;
+		pthread_cond_broadcast(&loader->finished);
+	}
+	pthread_mutex_unlock(&loader->lock);
+	return NULL;
+}
+
+void AssetLoader_Init(AssetLoader *loader) {
+	if (!loader) return;
+	memset(loader, 0, sizeof(AssetLoader));
+	pthread_mutex_init(&loader->lock, NULL);
+	pthread_cond_init(&loader->wake, NULL);
+	pthread_cond_init(&loader->finished, NULL);
+	loader->running = pthread_create(&loader->thread, NULL, LoaderThread, loader) == 0;
+	if (!loader->running) fprintf(stderr, "Asset loader: no thread, models load inline\n");
+}
+
+void AssetLoader_Destroy(AssetLoader *loader) {
+	if (!loader) return;
+	if (loader->running) {
+		pthread_mutex_lock(&loader->lock);
+		loader->stop = 1;
+		pthread_cond_broadcast(&loader->wake);
+		pthread_mutex_unlock(&loader->lock);
+		pthread_join(loader->thread, NULL);
+	}
+	for (int i = 0; i < loader->requestCount; i++)
+		FreeJob(loader->requests[(loader->requestHead + i) % ASSET_QUEUE_SIZE]);
+	for (int i = 0; i < loader->doneCount; i++)
+		FreeJob(loader->done[i]);
+	if (loader->hasProxyTemplate) Object_Destroy(&loader->proxyTemplate);
+	pthread_mutex_destroy(&loader->lock);
+	pthread_cond_destroy(&loader->wake);
+	pthread_cond_destroy(&loader->finished);
+	memset(loader, 0, sizeof(AssetLoader));
+}
+
+static const AssetBounds *FindBounds(const AssetLoader *loader, const char *path) {
+	for (int i = 0; i < loader->boundsCount; i++)
+		if (strcmp(loader->bounds[i].path, path) == 0) return &loader->bounds[i];
+	return NULL;
+}
+
+static void RememberBounds(AssetLoader *loader, const char *path, float3 BBmin, float3 BBmax) {
+	if (FindBounds(loader, path) || loader->boundsCount >= ASSET_MODEL_CACHE) return;
+	loader->bounds[loader->boundsCount++] = (AssetBounds){path, BBmin, BBmax};
+}
+
+// A box over the model's bounds (remembered from an earlier load) sharing the template
+// cube's material, so spawning proxies never grows the material lib.
+static void BuildProxy(AssetLoader *loader, Object *proxy, MaterialLib *lib, const char *path) {
+	if (!loader->hasProxyTemplate) {
+		CreateCube(&loader->proxyTemplate, (float3){0.0f, 0.0f, 0.0f}, (float3){0.0f, 0.0f, 0.0f}, (float3){1.0f, 1.0f, 1.0f},
+				   (float3){0.5f, 0.5f, 0.5f}, lib, 0.0f, 1.0f, 0.0f);
+		loader->hasProxyTemplate = loader->proxyTemplate.v1 != NULL;
+		if (!loader->hasProxyTemplate) return;
+	}
+	const Object *cube = &loader->proxyTemplate;
+	const AssetBounds *known = FindBounds(loader, path);
+	float3 BBmin = known ? known->BBmin : (float3){-ASSET_PROXY_EXTENT, -ASSET_PROXY_EXTENT, -ASSET_PROXY_EXTENT};
+	float3 BBmax = known ? known->BBmax : (float3){ASSET_PROXY_EXTENT, ASSET_PROXY_EXTENT, ASSET_PROXY_EXTENT};
+	float3 center = {(BBmin.x + BBmax.x) * 0.5f, (BBmin.y + BBmax.y) * 0.5f, (BBmin.z + BBmax.z) * 0.5f};
+	float3 size = {BBmax.x - BBmin.x, BBmax.y - BBmin.y, BBmax.z - BBmin.z};
+
+	int n = cube->triangleCount;
+	proxy->v1 = (float3 *)malloc(n * sizeof(float3));
+	proxy->v2 = (float3 *)malloc(n * sizeof(float3));
+	proxy->v3 = (float3 *)malloc(n * sizeof(float3));
+	proxy->normals = (float3 *)malloc(n * sizeof(float3));
+	proxy->materialIds = (int *)malloc(n * sizeof(int));
+	if (!proxy->v1 || !proxy->v2 || !proxy->v3 || !proxy->normals || !proxy->materialIds) {
+		Object_Destroy(proxy);
+		return;
+	}
+	// template vertices span [-0.5, 0.5]
+	for (int i = 0; i < n; i++) {
+		const float3 *src[3] = {&cube->v1[i], &cube->v2[i], &cube->v3[i]};
+		float3 *dst[3] = {&proxy->v1[i], &proxy->v2[i], &proxy->v3[i]};
+		for (int k = 0; k < 3; k++)
+			*dst[k] = (float3){center.x + src[k]->x * size.x, center.y + src[k]->y * size.y, center.z + src[k]->z * size.z};
+	}
+	memcpy(proxy->normals, cube->normals, n * sizeof(float3));
+	memcpy(proxy->materialIds, cube->materialIds, n * sizeof(int));
+	proxy->triangleCount = n;
+	proxy->_temp = cube->_temp;
+	proxy->BBmin = BBmin;
+	proxy->BBmax = BBmax;
+	Object_BuildMaterialFlags(proxy, lib);
+	CreateObjectBVH(proxy, &proxy->bvh);
+}
+
+int AssetLoader_Request(AssetLoader *loader, const char *path, ObjectList *scene, MaterialLib *lib,
+						float3 position, float3 rotation, float3 scale) {
+	if (!loader || !path || !scene || loader->inFlight >= ASSET_QUEUE_SIZE) return -1;
+	AssetJob *job = (AssetJob *)calloc(1, sizeof(AssetJob));
+	if (!job) return -1;
+	job->path = path;
+	job->sceneIndex = (uint32)scene->count;
+
+	Object *proxy = ObjectList_Add(scene); // may realloc scene->objects
+	BuildProxy(loader, proxy, lib, path);
+	proxy->position = proxy->prevPostion = position;
+	proxy->rotation = proxy->prevRotation = rotation;
+	proxy->scale = proxy->prevScale = scale;
+	Object_UpdateWorldBounds(proxy);
+
+	pthread_mutex_lock(&loader->lock);
+	loader->requests[(loader->requestHead + loader->requestCount) % ASSET_QUEUE_SIZE] = job;
+	loader->requestCount++;
+	pthread_cond_signal(&loader->wake);
+	pthread_mutex_unlock(&loader->lock);
+	loader->inFlight++;
+	return (int)job->sceneIndex;
+}
+
+// Moves the job's private materials into lib and the object into its proxy's slot.
+static int Install(AssetJob *job, ObjectList *scene, MaterialLib *lib) {
+	Object *obj = &job->object;
+	if (!MaterialLib_Absorb(lib, &job->materials, obj->materialIds, obj->triangleCount)) return 0;
+
+	Object *slot = &scene->objects[job->sceneIndex];
+	obj->position = slot->position;
+	obj->rotation = slot->rotation;
+	obj->scale = slot->scale;
+	obj->prevPostion = slot->prevPostion;
+	obj->prevRotation = slot->prevRotation;
+	obj->prevScale = slot->prevScale;
+	Object_Destroy(slot);
+	*slot = *obj;
+	*obj = (Object){0};
+	Object_BuildMaterialFlags(slot, lib);
+	Object_UpdateWorldBounds(slot);
+	return 1;
+}
+
+int AssetLoader_Apply(AssetLoader *loader, ObjectList *scene, MaterialLib *lib) {
+	if (!loader || !scene) return 0;
+	AssetJob *ready[ASSET_QUEUE_SIZE];
+	int count = 0;
+	pthread_mutex_lock(&loader->lock);
+	if (!loader->running) {
+		// no thread: load what was requested here
+		while (loader->requestCount > 0) {
+			AssetJob *job = loader->requests[loader->requestHead];
+			loader->requestHead = (loader->requestHead + 1) % ASSET_QUEUE_SIZE;
+			loader->requestCount--;
+			LoadJob(job);
+			loader->done[loader->doneCount++] = job;
+		}
+	}
+	count = loader->doneCount;
+	memcpy(ready, loader->done, count * sizeof(AssetJob *));
+	loader->doneCount = 0;
+	pthread_mutex_unlock(&loader->lock);
+
+	for (int i = 0; i < count; i++) {
+		AssetJob *job = ready[i];
+		loader->inFlight--;
+		if (job->loaded && job->sceneIndex < (uint32)scene->count) {
+			RememberBounds(loader, job->path, job->object.BBmin, job->object.BBmax);
+			if (!Install(job, scene, lib)) fprintf(stderr, "Asset: could not install %s, keeping its proxy\n", job->path);
+		} else {
+			fprintf(stderr, "Asset: failed to load %s, keeping its proxy\n", job->path);
+		}
+		FreeJob(job);
+	}
+	return count;
+}
+
+void AssetLoader_Flush(AssetLoader *loader, ObjectList *scene, MaterialLib *lib) {
+	if (!loader) return;
+	while (loader->inFlight > 0) {
+		if (loader->running) {
+			pthread_mutex_lock(&loader->lock);
+			while (loader->doneCount == 0)
+				pthread_cond_wait(&loader->finished, &loader->lock);
+			pthread_mutex_unlock(&loader->lock);
+		}
+		AssetLoader_Apply(loader, scene, lib);
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include "../object/format.h"
+#include "../object/scene.h"
+#include "../object/material/material.h"
+#include <pthread.h>
+
+// Loads models on a background thread so spawning never stalls a frame. The caller reserves
+// a scene slot holding a bounding-box proxy; the loader thread builds the real object
+// (geometry, BVH, materials in a private lib) and AssetLoader_Apply swaps it into that slot
+// at a frame boundary, keeping the transform the slot has meanwhile been given.
+
+#define ASSET_QUEUE_SIZE 32	  // requests in flight, further requests are refused until one completes
+#define ASSET_MODEL_CACHE 16  // model paths whose bounds are remembered for sizing proxies
+#define ASSET_PROXY_EXTENT 1.0f // half-size of a proxy for a model never loaded before
+
+typedef struct {
+	const char *path;
+	uint32 sceneIndex; // slot the proxy was placed in
+	Object object;	   // filled by the loader thread
+	MaterialLib materials;
+	int loaded;
+} AssetJob;
+
+typedef struct {
+	const char *path;
+	float3 BBmin;
+	float3 BBmax;
+} AssetBounds;
+
+typedef struct {
+	AssetJob *requests[ASSET_QUEUE_SIZE]; // ring, head first
+	AssetJob *done[ASSET_QUEUE_SIZE];
+	int requestHead, requestCount;
+	int doneCount;
+	int stop;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;	 // a request was queued or stop was set
+	pthread_cond_t finished; // a job was moved to done
+	pthread_t thread;
+	int running;
+
+	// main thread only
+	int inFlight; // requested and not yet applied
+	AssetBounds bounds[ASSET_MODEL_CACHE];
+	int boundsCount;
+	Object proxyTemplate; // unit cube, created with the first proxy
+	int hasProxyTemplate;
+} AssetLoader;
+
+// If the thread cannot start, requests are loaded inline by AssetLoader_Apply.
+void AssetLoader_Init(AssetLoader *loader);
+// Joins the thread and frees every job that was never applied.
+void AssetLoader_Destroy(AssetLoader *loader);
+// Appends a proxy for path to the scene at the given transform and queues the real load.
+// Returns the proxy's scene index, or -1 if the queue is full (retry on a later frame).
+int AssetLoader_Request(AssetLoader *loader, const char *path, ObjectList *scene, MaterialLib *lib,
+						float3 position, float3 rotation, float3 scale);
+// Main thread, between frames: replaces the proxies of every finished load. Returns how many.
+int AssetLoader_Apply(AssetLoader *loader, ObjectList *scene, MaterialLib *lib);
+// Blocks until every request has been applied.
+void AssetLoader_Flush(AssetLoader *loader, ObjectList *scene, MaterialLib *lib);
+
+#endif // ASSETLOADER_H
@@ -1,10 +1,112 @@
 #include "loadObj.h"
 #include "../object/object.h"
 #include "../object/material/material.h"
+#include <fcntl.h>
+#include <immintrin.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
-#include "../util/bbox.h"
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// byte offsets inside one triangle record
+#define RECORD_V1 0
+#define RECORD_V2 16
+#define RECORD_V3 32
+#define RECORD_NORMAL 48
+#define RECORD_MATERIAL 64 // roughness, metallic, emission, color: the bytes a material is made of
+#define RECORD_MATERIAL_BYTES 28
+#define RECORD_COLOR 76
+#define RECORD_UV 92
+
+typedef struct {
+	const uint8 *records;
+	Object *obj;
+	uint32 first;
+	uint32 count;
+	__m128 bbMin;
+	__m128 bbMax;
+} DecodeTask;
+
+// Deinterleaves a range of records into the per-attribute arrays; each float4 is one
+// unaligned load and one store, w copied as stored.
+static void *DecodeRange(void *arg) {
+	DecodeTask *task = arg;
+	Object *obj = task->obj;
+	__m128 bbMin = _mm_set1_ps(FLT_MAX), bbMax = _mm_set1_ps(-FLT_MAX);
+	for (uint32 i = task->first; i < task->first + task->count; i++) {
+		const uint8 *r = task->records + (size_t)i * LOADOBJ_RECORD_SIZE;
+		__m128 a = _mm_loadu_ps((const float *)(r + RECORD_V1));
+		__m128 b = _mm_loadu_ps((const float *)(r + RECORD_V2));
+		__m128 c = _mm_loadu_ps((const float *)(r + RECORD_V3));
+		_mm_storeu_ps(&obj->v1[i].x, a);
+		_mm_storeu_ps(&obj->v2[i].x, b);
+		_mm_storeu_ps(&obj->v3[i].x, c);
+		_mm_storeu_ps(&obj->normals[i].x, _mm_loadu_ps((const float *)(r + RECORD_NORMAL)));
+		memcpy(&obj->uvs[i], r + RECORD_UV, sizeof(UvCords));
+		// running bound second so a NaN vertex is skipped, as the scalar compare did
+		bbMin = _mm_min_ps(a, _mm_min_ps(b, _mm_min_ps(c, bbMin)));
+		bbMax = _mm_max_ps(a, _mm_max_ps(b, _mm_max_ps(c, bbMax)));
+	}
+	task->bbMin = bbMin;
+	task->bbMax = bbMax;
+	return NULL;
+}
+
+static void DecodeRecords(const uint8 *records, Object *obj, uint32 triangleCount) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int threadCount = (int)(triangleCount / LOADOBJ_TRIANGLES_PER_THREAD);
+	if (threadCount > cpus) threadCount = (int)cpus;
+	if (threadCount > LOADOBJ_MAX_THREADS) threadCount = LOADOBJ_MAX_THREADS;
+	if (threadCount < 1) threadCount = 1;
+
+	DecodeTask tasks[LOADOBJ_MAX_THREADS];
+	pthread_t threads[LOADOBJ_MAX_THREADS];
+	int started[LOADOBJ_MAX_THREADS];
+	uint32 per = triangleCount / threadCount;
+	for (int t = 0; t < threadCount; t++) {
+		uint32 first = t * per;
+		tasks[t] = (DecodeTask){records, obj, first, t == threadCount - 1 ? triangleCount - first : per};
+		// the last range runs here; a range that cannot get a thread also runs inline
+		started[t] = t < threadCount - 1 && pthread_create(&threads[t], NULL, DecodeRange, &tasks[t]) == 0;
+		if (!started[t] && t < threadCount - 1) DecodeRange(&tasks[t]);
+	}
+	DecodeRange(&tasks[threadCount - 1]);
+
+	__m128 bbMin = _mm_set1_ps(FLT_MAX), bbMax = _mm_set1_ps(-FLT_MAX);
+	for (int t = 0; t < threadCount; t++) {
+		if (started[t]) pthread_join(threads[t], NULL);
+		bbMin = _mm_min_ps(tasks[t].bbMin, bbMin);
+		bbMax = _mm_max_ps(tasks[t].bbMax, bbMax);
+	}
+	_mm_storeu_ps(&obj->BBmin.x, bbMin);
+	_mm_storeu_ps(&obj->BBmax.x, bbMax);
+	obj->BBmin.w = 0.0f;
+	obj->BBmax.w = 0.0f;
+}
+
+// Meshes are built from long runs of triangles sharing a material, so the lib is only
+// searched when the material bytes differ from the previous record.
+static void AssignMaterials(const uint8 *records, Object *obj, uint32 triangleCount, MaterialLib *lib, Textures *tex) {
+	const uint8 *prev = NULL;
+	int prevId = -1;
+	for (uint32 i = 0; i < triangleCount; i++) {
+		const uint8 *r = records + (size_t)i * LOADOBJ_RECORD_SIZE;
+		if (!prev || memcmp(r + RECORD_MATERIAL, prev + RECORD_MATERIAL, RECORD_MATERIAL_BYTES) != 0) {
+			float roughness, metallic, emission;
+			float3 color;
+			memcpy(&roughness, r + RECORD_MATERIAL, sizeof(float));
+			memcpy(&metallic, r + RECORD_MATERIAL + 4, sizeof(float));
+			memcpy(&emission, r + RECORD_MATERIAL + 8, sizeof(float));
+			memcpy(&color, r + RECORD_COLOR, sizeof(float3));
+			prevId = MaterialLib_FindOrAdd(lib, Material_Make(color, roughness, metallic, emission, tex));
+			prev = r;
+		}
+		obj->materialIds[i] = prevId;
+	}
+}
 
 void LoadObj(const char *filename, Object *obj, MaterialLib *lib) {
 	if (filename == NULL || obj == NULL) {
@@ -17,32 +119,63 @@ void LoadObj(const char *filename, Object *obj, MaterialLib *lib) {
 		return;
 	}
 
-	// read first 32 bytes
-	uint32 fileSize, triangleStructSize, triangleCountRead, hasTextures;
-	fread(&fileSize, sizeof(uint32), 1, file);
-	fread(&triangleStructSize, sizeof(uint32), 1, file);
-	fread(&triangleCountRead, sizeof(uint32), 1, file);
-	fread(&hasTextures, sizeof(uint32), 1, file);
-
-	uint32 triangleCount = triangleCountRead;
+	// fileSize, triangleStructSize, triangleCount, hasTextures
+	uint32 header[4];
+	if (fread(header, sizeof(uint32), 4, file) != 4) {
+		fprintf(stderr, "Error: Could not read header of %s\n", filename);
+		fclose(file);
+		return;
+	}
+	uint32 triangleStructSize = header[1], triangleCount = header[2], hasTextures = header[3];
+	if (triangleStructSize != LOADOBJ_RECORD_SIZE) {
+		fprintf(stderr, "Error: %s has %u-byte triangle records, expected %d\n", filename, triangleStructSize, LOADOBJ_RECORD_SIZE);
+		fclose(file);
+		return;
+	}
 
-	// load textures if present
+	// textures stream in the background from the coarsest level; without them the model
+	// still loads, untextured
 	Textures *tex = NULL;
 	if (hasTextures) {
-		obj->hasTexture = true;
 		tex = Textures_LoadFromFile(file);
 		if (!tex) {
-			fprintf(stderr, "Error: Failed to load textures from file.\n");
-			fclose(file);
-			exit(1);
+			fprintf(stderr, "Error: Failed to load textures from %s, loading untextured.\n", filename);
+			fseek(file, 16 + (long)TEXTURE_FILE_BYTES, SEEK_SET);
 		}
-	} else {
-		obj->hasTexture = false;
 	}
+	obj->hasTexture = tex != NULL;
 
-	// printf("File size: %u bytes\n", fileSize);
-	// printf("Triangle struct size: %u bytes\n", triangleStructSize);
-	// printf("Triangle count: %u\n", triangleCount);
+	size_t offset = (size_t)ftell(file);
+	size_t recordBytes = (size_t)triangleCount * LOADOBJ_RECORD_SIZE;
+	struct stat st;
+	if (fstat(fileno(file), &st) != 0 || (size_t)st.st_size < offset + recordBytes) {
+		fprintf(stderr, "Error: %s is truncated (%u triangles expected)\n", filename, triangleCount);
+		Textures_Destroy(tex);
+		fclose(file);
+		return;
+	}
+
+	// map from the page holding the first record (texture bytes were already read) and
+	// decode the records in place
+	size_t mapStart = offset & ~((size_t)sysconf(_SC_PAGESIZE) - 1);
+	size_t mapBytes = offset - mapStart + recordBytes;
+	void *map = recordBytes ? mmap(NULL, mapBytes, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fileno(file), (off_t)mapStart) : MAP_FAILED;
+	uint8 *copy = NULL;
+	const uint8 *records;
+	if (map != MAP_FAILED) {
+		records = (const uint8 *)map + (offset - mapStart);
+	} else {
+		map = NULL;
+		copy = (uint8 *)malloc(recordBytes ? recordBytes : 1);
+		if (!copy || fread(copy, 1, recordBytes, file) != recordBytes) {
+			fprintf(stderr, "Error: Could not read triangles from %s\n", filename);
+			free(copy);
+			Textures_Destroy(tex);
+			fclose(file);
+			return;
+		}
+		records = copy;
+	}
 
 	obj->v1 = (float3 *)malloc(triangleCount * sizeof(float3));
 	obj->v2 = (float3 *)malloc(triangleCount * sizeof(float3));
@@ -50,55 +183,20 @@ void LoadObj(const char *filename, Object *obj, MaterialLib *lib) {
 	obj->normals = (float3 *)malloc(triangleCount * sizeof(float3));
 	obj->materialIds = (int *)malloc(triangleCount * sizeof(int));
 	obj->uvs = (UvCords *)malloc(triangleCount * sizeof(UvCords));
+	obj->materialFlags = NULL;
 
 	if (!obj->v1 || !obj->v2 || !obj->v3 || !obj->normals || !obj->materialIds || !obj->uvs) {
 		fprintf(stderr, "Error: Could not allocate memory for triangles.\n");
 		Object_Destroy(obj);
-		fclose(file);
-		return;
+		Textures_Destroy(tex);
+	} else {
+		obj->triangleCount = triangleCount;
+		DecodeRecords(records, obj, triangleCount);
+		AssignMaterials(records, obj, triangleCount, lib, tex);
+		Object_BuildMaterialFlags(obj, lib);
 	}
-	obj->triangleCount = triangleCount;
-
-	float3 BBmin = {FLT_MAX, FLT_MAX, FLT_MAX};
-	float3 BBmax = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
-
-	for (uint32 i = 0; i < triangleCount; i++) {
-		float3 v1, v2, v3;
-		float3 normal, color;
-		float Roughness, Metallic, Emission;
-		uint16 uv1x, uv1y, uv2x, uv2y, uv3x, uv3y;
 
-		fread(&v1, sizeof(float3), 1, file);
-		fread(&v2, sizeof(float3), 1, file);
-		fread(&v3, sizeof(float3), 1, file);
-
-		UpdateBoundingBox(&BBmin, &BBmax, v1);
-		UpdateBoundingBox(&BBmin, &BBmax, v2);
-		UpdateBoundingBox(&BBmin, &BBmax, v3);
-
-		fread(&normal, sizeof(float3), 1, file);
-		fread(&Roughness, sizeof(float), 1, file);
-		fread(&Metallic, sizeof(float), 1, file);
-		fread(&Emission, sizeof(float), 1, file);
-		fread(&color, sizeof(float3), 1, file);
-
-		fread(&uv1x, sizeof(uint16), 1, file);
-		fread(&uv1y, sizeof(uint16), 1, file);
-		fread(&uv2x, sizeof(uint16), 1, file);
-		fread(&uv2y, sizeof(uint16), 1, file);
-		fread(&uv3x, sizeof(uint16), 1, file);
-		fread(&uv3y, sizeof(uint16), 1, file);
-		uint32 _uvPad;
-		fread(&_uvPad, sizeof(uint32), 1, file); // 4-byte pad after UV block
-
-		obj->v1[i] = v1;
-		obj->v2[i] = v2;
-		obj->v3[i] = v3;
-		obj->normals[i] = normal;
-		obj->uvs[i] = (UvCords){uv1x, uv1y, uv2x, uv2y, uv3x, uv3y};
-		obj->materialIds[i] = MaterialLib_FindOrAdd(lib, Material_Make(color, Roughness, Metallic, Emission, tex));
-	}
-	obj->BBmin = BBmin;
-	obj->BBmax = BBmax;
+	if (map) munmap(map, mapBytes);
+	free(copy);
 	fclose(file);
 }
@@ -3,9 +3,18 @@
 
 #include "../object/format.h"
 
+// Model file: a 16-byte header {fileSize, triangleStructSize, triangleCount, hasTextures},
+// the texture maps when hasTextures is set, then triangleCount fixed-stride records:
+// v1 v2 v3 normal (4 x float4), roughness metallic emission, color (float4), 6 x uint16 uv, pad.
+#define LOADOBJ_RECORD_SIZE 108
+#define LOADOBJ_TRIANGLES_PER_THREAD 65536 // meshes below this are decoded on the calling thread
+#define LOADOBJ_MAX_THREADS 16
+
 typedef struct Object Object;
 typedef struct MaterialLib MaterialLib;
 
+// The triangle records are mapped (read in one call if mapping fails) and decoded in bulk,
+// split over threads for large meshes. Materials are interned once per run of equal records.
 void LoadObj(const char *filename, Object *obj, MaterialLib *lib);
 
-#endif // LOADOBJ_H
\ No newline at end of file
+#endif // LOADOBJ_H
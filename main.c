@@ -1,8 +1,11 @@
+#ifndef HEADLESS
 #include <MiniFB.h>
+#endif
 #include <immintrin.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -13,14 +16,24 @@
 #include "render/cpu/font.h"
 #include "render/cpu/ray.h"
 #include "render/cpu/ssr.h"
+#include "render/cpu/bloom.h"
+#include "render/cpu/fsr.h"
+#include "render/cpu/post.h"
+#include "render/cpu/taa.h"
+#include "render/cpu/denoise.h"
 #include "render/color/color.h"
 #include "load/loadObj.h"
 #include "math/vector3.h"
 #include "skybox/skybox.h"
 #include "util/threadPool.h"
+#include "util/startup.h"
 #include "util/bench.h"
+#ifdef HEADLESS
+#include "util/saveImage.h"
+#else
 #include "keyboar/keyboar.h"
 #include "render/gpu/kernels/cloadrendering/cload.h"
+#endif
 #include "client/gameClient.h"
 #include "simulation/cSim/import.h"
 #include "simulation/cSim/simulate.h"
@@ -30,8 +43,115 @@
 
 #define ACCUMULATE_STATS 1024
 #define GRID_COLS 32
+// internal render resolution as a fraction of the window; FSR upscales to WIDTH x HEIGHT
+#define RENDER_SCALE 0.75f
+#define RENDER_WIDTH ((int)(WIDTH * RENDER_SCALE))
+#define RENDER_HEIGHT ((int)(HEIGHT * RENDER_SCALE))
 #define GRID_ROWS 32
 
+#ifdef HEADLESS
+// Headless build (make headless): no window, input, network sync or OpenCL clouds. Renders a
+// fixed number of frames along a scripted camera path and writes the presented image to disk
+// or a pipe, so runs are reproducible on render nodes without X11 or a GPU.
+#define HEADLESS_FRAMES 240 // default --frames
+#define HEADLESS_SEED 1
+#define HEADLESS_ORBIT_SPEED 0.02f // radians per frame
+#define HEADLESS_ORBIT_RADIUS 6.0f
+
+typedef enum {
+	FRAME_RAW,
+	FRAME_PPM,
+	FRAME_BMP,
+} FrameFormat;
+
+typedef struct {
+	int frames; // 0 renders until the bench duration ends, BENCH_MODE only
+	FrameFormat format;
+	const char *out; // path pattern with one %d for the frame number, "-" for stdout, "|cmd" for a pipe; NULL writes nothing
+	FILE *stream;	 // set when out is stdout or a pipe
+} HeadlessOptions;
+
+static int ParseHeadlessOptions(HeadlessOptions *opt, int argc, char **argv) {
+#ifdef BENCH_MODE
+	*opt = (HeadlessOptions){.frames = 0, .format = FRAME_BMP};
+#else
+	*opt = (HeadlessOptions){.frames = HEADLESS_FRAMES, .format = FRAME_BMP};
+#endif
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+			opt->frames = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--format") && i + 1 < argc) {
+			const char *f = argv[++i];
+			if (!strcmp(f, "raw")) opt->format = FRAME_RAW;
+			else if (!strcmp(f, "ppm")) opt->format = FRAME_PPM;
+			else if (!strcmp(f, "bmp")) opt->format = FRAME_BMP;
+			else return 0;
+		} else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+			opt->out = argv[++i];
+		} else {
+			return 0;
+		}
+	}
+#ifdef BENCH_MODE
+	return opt->frames >= 0;
+#else
+	// without a bench duration nothing would ever stop the loop
+	return opt->frames > 0;
+#endif
+}
+
+static int OpenFrameStream(HeadlessOptions *opt) {
+	if (!opt->out) return 1;
+	if (!strcmp(opt->out, "-")) {
+		// frames take over stdout; logging moves to stderr so it cannot interleave with them
+		fflush(stdout);
+		int fd = dup(STDOUT_FILENO);
+		if (fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) return 0;
+		opt->stream = fdopen(fd, "wb");
+	} else if (opt->out[0] == '|') {
+		opt->stream = popen(opt->out + 1, "w");
+	} else {
+		return 1;
+	}
+	return opt->stream != NULL;
+}
+
+static void CloseFrameStream(HeadlessOptions *opt) {
+	if (!opt->stream) return;
+	if (opt->out[0] == '|') pclose(opt->stream);
+	else fclose(opt->stream);
+	opt->stream = NULL;
+}
+
+static void WriteFrame(const HeadlessOptions *opt, const Color *pixels, int width, int height, int frame) {
+	if (!opt->out) return;
+	FILE *f = opt->stream;
+	if (!f) {
+		char path[512];
+		snprintf(path, sizeof(path), opt->out, frame);
+		f = fopen(path, "wb");
+		if (!f) {
+			fprintf(stderr, "Failed to open %s\n", path);
+			return;
+		}
+	}
+	if (opt->format == FRAME_RAW) WriteImageRaw(f, pixels, width, height);
+	else if (opt->format == FRAME_PPM) WriteImagePPM(f, pixels, width, height);
+	else WriteImageBMP(f, pixels, width, height);
+	if (f != opt->stream) fclose(f);
+}
+
+// Camera path as a function of the frame number only: a slow orbit around the start point
+// with a little yaw, so consecutive frames differ (TAA, SSR and motion vectors are exercised)
+// but every run renders the same images.
+static void HeadlessCamera(Camera *camera, float3 startPosition, float3 startForward, int frame) {
+	float t = frame * HEADLESS_ORBIT_SPEED;
+	camera->position = (float3){startPosition.x + HEADLESS_ORBIT_RADIUS * sinf(t), startPosition.y,
+								startPosition.z + HEADLESS_ORBIT_RADIUS * (1.0f - cosf(t))};
+	camera->forward = startForward;
+	CameraRotate(camera, 0.0f, 0.25f * sinf(t));
+}
+#else
 // update render object to sim object and move camera to follow the plane
 void SimObjToRenderObj(Plane *simPlane, Object *renderObj, Camera *camera, Input *input, struct mfb_window *window) {
 	float3 forward;
@@ -77,28 +197,28 @@ void SimObjToRenderObj(Plane *simPlane, Object *renderObj, Camera *camera, Input
 	else
 		planeSetRudderPct(simPlane, 50.0f);
 }
+#endif
 
-int main() {
-	srand((uint32)getpid());
-
-	Input input;
-	Camera camera;
-	initCamera(&camera, WIDTH, HEIGHT, 90.0f, (float3){0.0f, 2.0f, -7.0f}, (float3){0.0f, -0.15f, 1.0f}, (float3){0.0f, 80.0f, -60.0f});
-
-	MaterialLib matLib;
-	MaterialLib_Init(&matLib, 256);
-
-	ObjectList scene;
-	ObjectList_Init(&scene, 1);
-
-	Client c = {.host = "127.0.0.1", .port = 8081};
-
-	idRegister objectRegistry;
-	idRegister_Init(&objectRegistry, 1);
-
-	RequestData request;
-	RequestData_Init(&request, 1);
+// State filled in by the startup steps below; main runs them through Startup (util/startup.h).
+typedef struct {
+	MaterialLib *matLib;
+	ObjectList *scene;
+	idRegister *registry;
+	Object f16; // loaded with its own materials, merged into matLib by InstallF16Step
+	MaterialLib f16Materials;
+	uint32 f16SceneIndex;
+	uint32 f16Id;
+	Plane *simPlane;
+	struct Alphabet *alphabet;
+	Skybox *skybox;
+#ifndef HEADLESS
+	Volume *cloudVol;
+	CloudRenderer *cloudRenderer;
+#endif
+} SceneLoad;
 
+static void BuildSceneStep(void *arg) {
+	SceneLoad *load = arg;
 	// build checkerboard grid into a temporary list, then merge into one object
 	ObjectList grid;
 	ObjectList_Init(&grid, GRID_COLS * GRID_ROWS);
@@ -124,45 +244,189 @@ int main() {
 			float roughness = palette[pIdx].roughness;
 			float metallic = palette[pIdx].metallic;
 			float3 tileColor = palette[pIdx].color;
-			CreateCube(obj, (float3){(col - GRID_COLS / 2) * 7.0f, -0.09f, 5.0f + row * 7.0f}, (float3){0.0f, 0.0f, 0.0f}, (float3){7.0f, 0.1f, 7.0f}, tileColor, &matLib, emission, roughness, metallic);
+			CreateCube(obj, (float3){(col - GRID_COLS / 2) * 7.0f, -0.09f, 5.0f + row * 7.0f}, (float3){0.0f, 0.0f, 0.0f}, (float3){7.0f, 0.1f, 7.0f}, tileColor, load->matLib, emission, roughness, metallic);
 			Object_UpdateWorldBounds(obj);
 		}
 	}
-	ObjectList_Merge(&grid, &scene);
+	ObjectList_Merge(&grid, load->scene);
 	free(grid.objects);
 
-	Object *cube = ObjectList_Add(&scene);
-	CreateCube(cube, (float3){0.0f, 1.0f, 10.0f}, (float3){0.0f, 0.5f, 0.0f}, (float3){7.0f, 7.0f, 7.0f}, (float3){0.9f, 0.0f, 0.0f}, &matLib, 100.0f, 0.99f, 0.0f);
+	Object *cube = ObjectList_Add(load->scene);
+	CreateCube(cube, (float3){0.0f, 1.0f, 10.0f}, (float3){0.0f, 0.5f, 0.0f}, (float3){7.0f, 7.0f, 7.0f}, (float3){0.9f, 0.0f, 0.0f}, load->matLib, 100.0f, 0.99f, 0.0f);
 	Object_UpdateWorldBounds(cube);
 
-	Object *cube2 = ObjectList_Add(&scene);
-	CreateCube(cube2, (float3){-10.0f, 1.0f, 15.0f}, (float3){0.0f, 0.0f, 0.0f}, (float3){7.0f, 7.0f, 7.0f}, (float3){0.0f, 0.9f, 0.0f}, &matLib, 100.0f, 0.99f, 0.0f);
+	Object *cube2 = ObjectList_Add(load->scene);
+	CreateCube(cube2, (float3){-10.0f, 1.0f, 15.0f}, (float3){0.0f, 0.0f, 0.0f}, (float3){7.0f, 7.0f, 7.0f}, (float3){0.0f, 0.9f, 0.0f}, load->matLib, 100.0f, 0.99f, 0.0f);
 	Object_UpdateWorldBounds(cube2);
 
-	Object *cube3 = ObjectList_Add(&scene);
-	CreateCube(cube3, (float3){10.0f, 1.0f, 15.0f}, (float3){0.0f, 0.0f, 0.0f}, (float3){7.0f, 7.0f, 7.0f}, (float3){0.0f, 0.0f, 0.9f}, &matLib, 100.0f, 0.99f, 0.0f);
+	Object *cube3 = ObjectList_Add(load->scene);
+	CreateCube(cube3, (float3){10.0f, 1.0f, 15.0f}, (float3){0.0f, 0.0f, 0.0f}, (float3){7.0f, 7.0f, 7.0f}, (float3){0.0f, 0.0f, 0.9f}, load->matLib, 100.0f, 0.99f, 0.0f);
 	Object_UpdateWorldBounds(cube3);
+}
 
-	uint32 f16SceneIndex = (uint32)scene.count;
-	Object *plane = ObjectList_Add(&scene);
-	uint32 f16Id = generateId(MODEL_F16);
-	LoadObj("assets/models/f16.bin", plane, &matLib);
-	idRegister_Add(&objectRegistry, f16Id, f16SceneIndex);
+static void LoadF16Step(void *arg) {
+	SceneLoad *load = arg;
+	MaterialLib_Init(&load->f16Materials, 16);
+	LoadObj("assets/models/f16.bin", &load->f16, &load->f16Materials);
+#ifdef HEADLESS
+	// frames must not depend on how far texture streaming got
+	MaterialLib_WaitTextures(&load->f16Materials);
+#endif
+	CreateObjectBVH(&load->f16, &load->f16.bvh);
+}
+
+// After the procedural scene, so matLib and the scene are only touched by one step at a time.
+static void InstallF16Step(void *arg) {
+	SceneLoad *load = arg;
+	Object *f16 = &load->f16;
+	if (!MaterialLib_Absorb(load->matLib, &load->f16Materials, f16->materialIds, f16->triangleCount)) {
+		// its ids still point into f16Materials: fall back to the default material
+		fprintf(stderr, "Failed to merge the F-16 materials, using the default material\n");
+		free(f16->materialIds);
+		f16->materialIds = NULL;
+	}
+	MaterialLib_Destroy(&load->f16Materials);
+	load->f16SceneIndex = (uint32)load->scene->count;
+	Object *plane = ObjectList_Add(load->scene);
+	*plane = *f16;
+	*f16 = (Object){0};
+	idRegister_Add(load->registry, load->f16Id, load->f16SceneIndex);
 	plane->position = (float3){0.0f, 10.0f, 20.0f};
 	plane->rotation = (float3){0.0f, 0.0f, 0.0f};
 	plane->scale = (float3){1.0f, 1.0f, 1.0f};
-	CreateObjectBVH(plane, &plane->bvh);
+	Object_BuildMaterialFlags(plane, load->matLib);
 	Object_UpdateWorldBounds(plane);
+}
 
-	Plane simPlane;
+static void LoadFlightModelStep(void *arg) {
+	SceneLoad *load = arg;
 	// Start at 220 m/s (within trim envelope) at 1000 m altitude, half throttle.
 	// 100 m/s (previous value) is below the ~193 m/s stall speed at sea level.
-	loadPlaneBin(&simPlane, "./simulation/simModels/F-16C.bin",
+	loadPlaneBin(load->simPlane, "./simulation/simModels/F-16C.bin",
 				 (float3){0.0f, 0.0f, 1.0f},	 // forward direction
 				 (float3){0.0f, 1000.0f, 20.0f}, // position (x, altitude, z)
 				 220.0f, 0.5f);					 // speed m/s, throttle 0-1
+}
+
+static void LoadFontStep(void *arg) {
+	SceneLoad *load = arg;
+	LoadAlphabet(load->alphabet, "assets/chars");
+}
 
-	addFromRegistry(&request, &objectRegistry, &scene, f16Id);
+static void LoadSkyboxStep(void *arg) {
+	SceneLoad *load = arg;
+	LoadSkybox(load->skybox, "skybox");
+}
+
+#ifndef HEADLESS
+static void LoadCloudVolumeStep(void *arg) {
+	SceneLoad *load = arg;
+	LoadVolume(load->cloudVol, "assets/models/cloud.bin",
+			   (float3){0.0f, 70.0f, 13.0f, 0.0f},
+			   (float3){0.0f, 0.0f, 0.0f, 0.0f},
+			   (float3){180.0f, 18.0f, 180.0f, 0.0f},
+			   VOLUME_CLOUD);
+}
+
+// Creates the OpenCL context and compiles render.cl.
+static void InitCloudRendererStep(void *arg) {
+	SceneLoad *load = arg;
+	CloudRenderer_Init(load->cloudRenderer, RENDER_WIDTH, RENDER_HEIGHT,
+					   "render/gpu/kernels/cloadrendering/render.cl");
+}
+
+static void UploadCloudStep(void *arg) {
+	SceneLoad *load = arg;
+	UploadVolumeToGpu(load->cloudVol, &load->cloudRenderer->ctx);
+}
+#endif
+
+int main(int argc, char **argv) {
+#ifdef HEADLESS
+	HeadlessOptions headless;
+	if (!ParseHeadlessOptions(&headless, argc, argv)) {
+		fprintf(stderr, "usage: %s [--frames N] [--format raw|ppm|bmp] [--out frame_%%04d.bmp | - | \"|command\"]\n", argv[0]);
+		return 1;
+	}
+	if (!OpenFrameStream(&headless)) {
+		fprintf(stderr, "Failed to open frame output %s\n", headless.out);
+		return 1;
+	}
+	srand(HEADLESS_SEED);
+#else
+	(void)argc;
+	(void)argv;
+	srand((uint32)getpid());
+	Input input;
+#endif
+
+	Camera camera;
+	initCamera(&camera, RENDER_WIDTH, RENDER_HEIGHT, 90.0f, (float3){0.0f, 2.0f, -7.0f}, (float3){0.0f, -0.15f, 1.0f}, (float3){0.0f, 80.0f, -60.0f});
+
+	MaterialLib matLib;
+	MaterialLib_Init(&matLib, 256);
+	// packed copy of matLib used by the shading hot path, resynced after each load
+	MaterialTable matTable;
+	MaterialTable_Init(&matTable);
+
+	ObjectList scene;
+	ObjectList_Init(&scene, 1);
+
+	Client c = {.host = "127.0.0.1", .port = 8081};
+
+	idRegister objectRegistry;
+	idRegister_Init(&objectRegistry, 1);
+
+#ifndef HEADLESS
+	AssetLoader assets;
+	AssetLoader_Init(&assets);
+#endif
+
+	RequestData request;
+	RequestData_Init(&request, 1);
+
+	// queue must hold one task per row OR per column — column dispatch uses screenWidth
+	// tasks (WIDTH >= HEIGHT), so size the pool to WIDTH to avoid ring-buffer overflow
+	ThreadPool *threadPool = poolCreate(32, WIDTH);
+
+	// independent loads run concurrently; the F-16 is loaded with its own materials and
+	// merged into matLib once the procedural scene (which also adds materials) is built
+	Plane simPlane;
+	struct Alphabet alphabet;
+	Skybox skybox;
+	SceneLoad load = {.matLib = &matLib, .scene = &scene, .registry = &objectRegistry, .f16Id = generateId(MODEL_F16),
+					  .simPlane = &simPlane, .alphabet = &alphabet, .skybox = &skybox};
+#ifndef HEADLESS
+	Volume cloudVol;
+	CloudRenderer cloudRenderer;
+	load.cloudVol = &cloudVol;
+	load.cloudRenderer = &cloudRenderer;
+#endif
+	Startup startup;
+	Startup_Init(&startup);
+	int sceneStep = Startup_Add(&startup, "procedural scene", BuildSceneStep, &load);
+	int f16Step = Startup_Add(&startup, "f16 model", LoadF16Step, &load);
+	int installStep = Startup_Add(&startup, "f16 install", InstallF16Step, &load);
+	Startup_After(&startup, installStep, sceneStep);
+	Startup_After(&startup, installStep, f16Step);
+	Startup_Add(&startup, "flight model", LoadFlightModelStep, &load);
+	Startup_Add(&startup, "font", LoadFontStep, &load);
+	Startup_Add(&startup, "skybox", LoadSkyboxStep, &load);
+#ifndef HEADLESS
+	int volumeStep = Startup_Add(&startup, "cloud volume", LoadCloudVolumeStep, &load);
+	int openclStep = Startup_Add(&startup, "opencl clouds", InitCloudRendererStep, &load);
+	int uploadStep = Startup_Add(&startup, "cloud upload", UploadCloudStep, &load);
+	Startup_After(&startup, uploadStep, volumeStep);
+	Startup_After(&startup, uploadStep, openclStep);
+#endif
+	Startup_Run(&startup, threadPool);
+	Startup_PrintTimeline(&startup, stdout);
+	Startup_Destroy(&startup);
+	uint32 f16SceneIndex = load.f16SceneIndex;
+	Object *plane = &scene.objects[f16SceneIndex];
+
+#ifndef HEADLESS
+	addFromRegistry(&request, &objectRegistry, &scene, load.f16Id);
 	postObjects(&c, &request);
 	RequestData_Reset(&request);
 
@@ -174,57 +438,74 @@ int main() {
 		return 1;
 	}
 	mfb_set_target_fps(0);
+#endif
 
-	struct Alphabet alphabet;
-	LoadAlphabet(&alphabet, "assets/chars");
-
-	Skybox skybox;
-	LoadSkybox(&skybox, "skybox");
-
-	// queue must hold one task per row OR per column — column dispatch uses screenWidth
-	// tasks (WIDTH >= HEIGHT), so size the pool to WIDTH to avoid ring-buffer overflow
-	ThreadPool *threadPool = poolCreate(32, WIDTH);
 	RayTraceTaskQueue rayTaskQueue;
-	SSRTask *ssrTasks = malloc(sizeof(SSRTask) * ((HEIGHT + 3) / 4));
+	SSRContext ssr;
+	SSR_Init(&ssr, RENDER_WIDTH, RENDER_HEIGHT);
+	TemporalAA taa;
+	Taa_Init(&taa, RENDER_WIDTH, RENDER_HEIGHT);
+	BloomPyramid bloom;
+	Bloom_Init(&bloom, RENDER_WIDTH, RENDER_HEIGHT);
+	Denoiser denoiser;
+	Denoiser_Init(&denoiser, RENDER_WIDTH, RENDER_HEIGHT);
+	FsrUpscaler fsr;
+	Fsr_Init(&fsr, RENDER_WIDTH, RENDER_HEIGHT, WIDTH, HEIGHT);
+	// window-resolution image presented each frame
+	Color *outputFramebuffer = (Color *)aligned_alloc(64, WIDTH * HEIGHT * sizeof(Color));
+	PostParams postParams = Post_DefaultParams();
+	postParams.contrast = 1.05f;
+	postParams.saturation = 1.1f;
+	PostChain post;
+	Post_Init(&post, RENDER_WIDTH, RENDER_HEIGHT, &postParams);
 
 	printf("Demo scene loaded. Total Tris: %d\n", ObjectList_CountTriangles(&scene));
 
-	Volume cloudVol;
-	LoadVolume(&cloudVol, "assets/models/cloud.bin",
-			   (float3){0.0f, 70.0f, 13.0f, 0.0f},
-			   (float3){0.0f, 0.0f, 0.0f, 0.0f},
-			   (float3){180.0f, 18.0f, 180.0f, 0.0f},
-			   VOLUME_CLOUD);
-
-	CloudRenderer cloudRenderer;
-	CloudRenderer_Init(&cloudRenderer, WIDTH, HEIGHT,
-					   "render/gpu/kernels/cloadrendering/render.cl");
-	UploadVolumeToGpu(&cloudVol, &cloudRenderer.ctx);
+#ifdef HEADLESS
+	const float3 startPosition = camera.position, startForward = camera.forward;
+#endif
 	int frame = 0;
 	int shadowResolution = 4;
 	double frameTimes[4] = {0};
 	double accumRenderTime = 0.0;
 	double accumSetupTime = 0.0;
-	double accumShadowTime = 0.0;
+	double accumVisibilityTime = 0.0;
+	double accumDenoiseTime = 0.0;
+	double accumPostTime = 0.0;
 	double accumSSRTime = 0.0;
+	double accumCloudTime = 0.0;
 	double accumCompositeTime = 0.0;
+	double accumUpscaleTime = 0.0;
 	double accumSyncTime = 0.0;
 	double accumPresentTime = 0.0;
 	int accumFrames = 0;
 
-	struct timespec wSyncStart, wA, wB;
+	struct timespec wSyncStart, wA, wB, wDenoiseStart, wDenoiseEnd, wSSRStart, wSSREnd;
 	WNOW(wSyncStart);
 
+	// derive right / up / fovScale once so the first frame's previous-camera state (and so its
+	// motion vectors) is not read from uninitialized fields
+	RenderSetup(scene.objects, scene.count, &camera);
+
 	Bench bench;
 	benchInit(&bench);
+#ifdef HEADLESS
+	struct timespec wRunStart, wRunEnd;
+	WNOW(wRunStart);
+#endif
 
 	while (1) {
 		// Update prev postion rotation scale for motion vectors
 		ComputePrevPostionRotationScale(&scene);
 		ComputePrevCameraPos(&camera);
 
-		// get current scene state from server
-		getObjects(&c, &scene, &matLib, &objectRegistry);
+#ifndef HEADLESS
+		// swap in models that finished loading, then get current scene state from server
+		AssetLoader_Apply(&assets, &scene, &matLib);
+		getObjects(&c, &scene, &matLib, &objectRegistry, &assets);
+#endif
+		plane = &scene.objects[f16SceneIndex]; // the scene may have grown
+		MaterialTable_Sync(&matTable, &matLib);
 
 		benchFrameStart(&bench);
 		WNOW(wA);
@@ -233,11 +514,12 @@ int main() {
 		frame++;
 		WNOW(wA); // setup timer covers clear + input + RenderSetup
 		clearBuffers(&camera);
-		const float2 jitterPattern[4] = {
-			{1.5f, 1.5f}, {-1.5f, 1.5f}, {-1.5f, -1.5f}, {1.5f, -1.5f}};
-		camera.jitter = jitterPattern[frame & 3];
+		camera.jitter = Taa_Jitter(frame);
 		camera.seed = frame * (int)35527.0f << 16 | (int)11369.0f;
 
+#ifdef HEADLESS
+		HeadlessCamera(&camera, startPosition, startForward, frame);
+#else
 		Input_Poll(&input, window);
 		if (input.keysDown[KB_KEY_ESCAPE]) break;
 		if (input.keys[KB_KEY_W]) CameraMoveForward(&camera, 0.2f);
@@ -247,6 +529,7 @@ int main() {
 		if (input.keys[KB_KEY_Q]) CameraMoveUp(&camera, 0.2f);
 		if (input.keys[KB_KEY_E]) CameraMoveUp(&camera, -0.2f);
 		if (input.mouse[MOUSE_LEFT]) CameraRotate(&camera, input.mouseDY * 0.005f, -input.mouseDX * 0.005f);
+#endif
 
 		// Keep plane in front of camera, facing the same direction, offset slightly below view center
 		float3 fwd = Float3_Normalize(camera.forward);
@@ -258,10 +541,12 @@ int main() {
 
 		// SimObjToRenderObj(&simPlane, plane, &camera, &input, window);
 
+#ifndef HEADLESS
 		// post current scene
 		addAllFromRegistry(&request, &objectRegistry, &scene);
 		postObjects(&c, &request);
 		RequestData_Reset(&request);
+#endif
 
 		RenderSetup(scene.objects, scene.count, &camera);
 		WNOW(wB);
@@ -270,7 +555,20 @@ int main() {
 
 		WNOW(wA);
 
-		RayTraceScene(scene.objects, scene.count, &camera, &matLib, &rayTaskQueue, threadPool, &skybox);
+		RayTraceVisibility(scene.objects, scene.count, &camera, &rayTaskQueue, threadPool);
+		WNOW(wB);
+		accumVisibilityTime += WDIFF(wA, wB);
+		WNOW(wSSRStart);
+		SSRTraceReflections(&ssr, &camera, threadPool, frame);
+		WNOW(wSSREnd);
+		accumSSRTime += WDIFF(wSSRStart, wSSREnd);
+		RayTraceShadeSignals(scene.objects, scene.count, &camera, &matTable, &rayTaskQueue, threadPool, &skybox, frame);
+		WNOW(wDenoiseStart);
+		Denoiser_Run(&denoiser, &camera, threadPool);
+		WNOW(wDenoiseEnd);
+		accumDenoiseTime += WDIFF(wDenoiseStart, wDenoiseEnd);
+		RayTraceComposite(&camera, &rayTaskQueue, threadPool, 0);
+		SSR_StoreFrame(&ssr, &camera);
 
 		// RASTERIZE
 		// for (int i = 0; i < OBJECT_COUNT; i++) {
@@ -282,14 +580,16 @@ int main() {
 		accumRenderTime += frameRenderTime;
 
 		WNOW(wA);
+		TaaResolve(&taa, &camera, threadPool);
+		BloomPostProcess(&bloom, &camera, threadPool);
 		// ShadowPostProcess(objects, OBJECT_COUNT, &camera, shadowResolution, 64);
 		// DitherPostProcess(&camera, frame);
 		// DitherOrderedPostProcess(&camera, frame);
 		WNOW(wB);
-		accumShadowTime += WDIFF(wA, wB);
+		accumPostTime += WDIFF(wA, wB);
 
+#ifndef HEADLESS
 		WNOW(wA);
-		// SSRPostProcess(&camera, threadPool, ssrTasks, 4);
 		CloudRenderer_Render(&cloudRenderer, &cloudVol, &camera, (CloudParams){
 																	 .baseColor = {1.0f, 1.0f, 1.0f, 0.0f},
 																	 .extinctionScale = {10.5f, 11.0f, 12.5f, 0.0f}, // blue scatters more (Mie tinge)
@@ -304,25 +604,42 @@ int main() {
 																	 .blurRadius = 5,
 																 });
 		WNOW(wB);
-		accumSSRTime += WDIFF(wA, wB);
-
-		benchCaptureFrame(&bench, camera.framebuffer, WIDTH, HEIGHT);
+		accumCloudTime += WDIFF(wA, wB);
 
 		WNOW(wA);
 		CloudRenderer_Composite(&cloudRenderer, &camera);
 		WNOW(wB);
 		accumCompositeTime += WDIFF(wA, wB);
+#endif
 
-#ifndef BENCH_MODE
+		// the single tone map + grade + dither + pack of the linear working buffer
+		WNOW(wA);
+		PostProcess(&post, camera.hdrBuffer, camera.framebuffer, threadPool, frame);
+		WNOW(wB);
+		accumPostTime += WDIFF(wA, wB);
+
+		benchCaptureFrame(&bench, camera.framebuffer, camera.screenWidth, camera.screenHeight);
+
+		// FSR works on the packed, display-referred image
+		WNOW(wA);
+		FsrUpscale(&fsr, camera.framebuffer, outputFramebuffer, threadPool);
+		WNOW(wB);
+		accumUpscaleTime += WDIFF(wA, wB);
+
+#if !defined(BENCH_MODE) && !defined(HEADLESS)
 		Color c = PackColorF((float3){1.0f, 0.5f, 0.2f});
 		char text[64];
 		double avgFrameTime = (frameTimes[0] + frameTimes[1] + frameTimes[2] + frameTimes[3]) * 0.25;
 		snprintf(text, sizeof(text), "FPS: %.1f", avgFrameTime > 0.0 ? 1.0 / avgFrameTime : 0.0);
-		RenderText(camera.framebuffer, WIDTH, HEIGHT, &alphabet, text, 20, 20, 1.75f, c);
+		RenderText(outputFramebuffer, WIDTH, HEIGHT, &alphabet, text, 20, 20, 1.75f, c);
 #endif
 
 		WNOW(wA);
-		if (mfb_update(window, camera.framebuffer) != STATE_OK) break;
+#ifdef HEADLESS
+		WriteFrame(&headless, outputFramebuffer, WIDTH, HEIGHT, frame);
+#else
+		if (mfb_update(window, outputFramebuffer) != STATE_OK) break;
+#endif
 		WNOW(wB);
 		accumPresentTime += WDIFF(wA, wB);
 
@@ -332,18 +649,22 @@ int main() {
 			double avgRender = accumRenderTime / accumFrames * 1000.0;
 			double avgSetup = accumSetupTime / accumFrames * 1000.0;
 			double avgRasterize = avgRender - avgSetup;
-			double avgShadow = accumShadowTime / accumFrames * 1000.0;
+			double avgVisibility = accumVisibilityTime / accumFrames * 1000.0;
+			double avgDenoise = accumDenoiseTime / accumFrames * 1000.0;
+			double avgPost = accumPostTime / accumFrames * 1000.0;
 			double avgSSR = accumSSRTime / accumFrames * 1000.0;
+			double avgCloud = accumCloudTime / accumFrames * 1000.0;
 			double avgComposite = accumCompositeTime / accumFrames * 1000.0;
+			double avgUpscale = accumUpscaleTime / accumFrames * 1000.0;
 			double avgSync = accumSyncTime / accumFrames * 1000.0;
 			double avgPresent = accumPresentTime / accumFrames * 1000.0;
-			double avgTotal = avgRender + avgShadow + avgSSR + avgComposite + avgSync + avgPresent;
+			double avgTotal = avgRender + avgPost + avgCloud + avgComposite + avgUpscale + avgSync + avgPresent;
 			double avgFps = 1000.0 / avgTotal;
 			double targetFrameTime = 1.0 / 60.0;
 			int maxTriangles60 = (int)(ObjectList_CountTriangles(&scene) * ((targetFrameTime * 1000.0) / avgRasterize));
-			printf("Frame %d  setup: %.2f ms  raster: %.2f ms  shadow: %.2f ms  ssr: %.2f ms  composite: %.2f ms  sync: %.2f ms  present: %.2f ms  total: %.2f ms  FPS: %.1f  Est Tris@60: %d  ShadowRes: %d\n",
-				   frame, avgSetup, avgRasterize, avgShadow, avgSSR, avgComposite, avgSync, avgPresent, avgTotal, avgFps, maxTriangles60, shadowResolution);
-			accumRenderTime = accumSetupTime = accumShadowTime = accumSSRTime = accumCompositeTime = accumSyncTime = accumPresentTime = 0.0;
+			printf("Frame %d  setup: %.2f ms  raster: %.2f ms (vis: %.2f  ssr: %.2f  shade: %.2f  denoise: %.2f)  post: %.2f ms  clouds: %.2f ms  composite: %.2f ms  fsr: %.2f ms  sync: %.2f ms  present: %.2f ms  total: %.2f ms  FPS: %.1f  Est Tris@60: %d  ShadowRes: %d\n",
+				   frame, avgSetup, avgRasterize, avgVisibility, avgSSR, avgRasterize - avgVisibility - avgSSR - avgDenoise, avgDenoise, avgPost, avgCloud, avgComposite, avgUpscale, avgSync, avgPresent, avgTotal, avgFps, maxTriangles60, shadowResolution);
+			accumRenderTime = accumSetupTime = accumVisibilityTime = accumDenoiseTime = accumPostTime = accumSSRTime = accumCloudTime = accumCompositeTime = accumUpscaleTime = accumSyncTime = accumPresentTime = 0.0;
 			accumFrames = 0;
 		}
 
@@ -351,24 +672,42 @@ int main() {
 		if (benchFrameEnd(&bench)) break;
 #ifdef PGO_MAX_FRAMES
 		if (frame >= PGO_MAX_FRAMES) break;
+#endif
+#ifdef HEADLESS
+		if (headless.frames && frame >= headless.frames) break;
 #endif
 	}
 
+#ifdef HEADLESS
+	WNOW(wRunEnd);
+	double runTime = WDIFF(wRunStart, wRunEnd);
+	printf("Headless: %d frames in %.2f s, %.2f ms/frame (%.1f FPS)\n", frame, runTime, runTime / frame * 1000.0, frame / runTime);
+	CloseFrameStream(&headless);
+#else
 	mfb_close(window);
+#endif
 	benchReport(&bench);
 	benchFree(&bench);
 
-	for (int i = 0; i < 256; i++) {
-		if (alphabet.letters[i].tile.pixels) {
-			free((void *)alphabet.letters[i].tile.pixels);
-		}
-	}
+	DestroyAlphabet(&alphabet);
+#ifndef HEADLESS
+	AssetLoader_Destroy(&assets);
+#endif
 	ObjectList_Destroy(&scene);
+#ifndef HEADLESS
 	CloudRenderer_Destroy(&cloudRenderer);
-	free(cloudVol.density);
+	Volume_Destroy(&cloudVol);
+#endif
 	DestroySkybox(&skybox);
 	poolDestroy(threadPool);
-	free(ssrTasks);
+	SSR_Destroy(&ssr);
+	Taa_Destroy(&taa);
+	Bloom_Destroy(&bloom);
+	Denoiser_Destroy(&denoiser);
+	Fsr_Destroy(&fsr);
+	Post_Destroy(&post);
+	free(outputFramebuffer);
+	MaterialTable_Destroy(&matTable);
 	MaterialLib_Destroy(&matLib);
 	destroyCamera(&camera);
 	return 0;
@@ -1,4 +1,5 @@
 #include "format.h"
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -6,15 +7,57 @@
 
 #define ALIGN64(n) (((n) + 63) & ~(size_t)63)
 
+// Buffer layout, in CameraBuffer bit order. Half-resolution buffers hold one entry per
+// 2x2 block (the finest SECONDARY_RESOLUTION).
+typedef struct {
+	size_t offset; // of the pointer in Camera
+	size_t elementSize;
+	bool halfRes;
+	bool zeroed; // read before the first write
+} CameraBufferDesc;
+
+static const CameraBufferDesc cameraBuffers[] = {
+	{offsetof(Camera, framebuffer), sizeof(uint32), false, false},
+	{offsetof(Camera, hdrBuffer), sizeof(half4), false, false},
+	{offsetof(Camera, hdrTemp), sizeof(half4), false, false},
+	{offsetof(Camera, depthBuffer), sizeof(float), false, false},
+	{offsetof(Camera, normalBuffer), sizeof(uint32), false, false},
+	{offsetof(Camera, reflectBuffer), sizeof(half4), false, false},
+	{offsetof(Camera, uvBuffer), sizeof(uvMap), false, false},
+	{offsetof(Camera, motionVectorBuffer), sizeof(float2), false, false},
+	{offsetof(Camera, objectIdBuffer), sizeof(int), false, false},
+	{offsetof(Camera, triangleIdBuffer), sizeof(int), false, false},
+	{offsetof(Camera, baryBuffer), sizeof(float2), false, false},
+	{offsetof(Camera, bloomBuffer), sizeof(float3), false, false},
+	{offsetof(Camera, bloomTemp), sizeof(float3), false, false},
+	{offsetof(Camera, bloomDst), sizeof(float3), false, false},
+	{offsetof(Camera, emissionSignal), sizeof(float3), false, false},
+	{offsetof(Camera, reflectionSignal), sizeof(float3), false, false},
+	{offsetof(Camera, secondaryEmission), sizeof(float3), true, false},
+	{offsetof(Camera, secondaryReflection), sizeof(float3), true, false},
+	{offsetof(Camera, secondaryPixel), sizeof(int), true, false},
+	{offsetof(Camera, ssrReflection), sizeof(float3), true, true},
+	{offsetof(Camera, reflectCache), sizeof(Color), false, false},
+	{offsetof(Camera, tempFramebuffer), sizeof(Color), false, false},
+	{offsetof(Camera, tempBuffer_1), sizeof(float), false, false},
+	{offsetof(Camera, tempBuffer_2), sizeof(float), false, false},
+	{offsetof(Camera, shadowCache), sizeof(float), false, false},
+};
+
+#define CAMERA_BUFFER_COUNT (int)(sizeof(cameraBuffers) / sizeof(cameraBuffers[0]))
+
+static inline void **CameraBufferSlot(Camera *camera, int i) {
+	return (void **)((char *)camera + cameraBuffers[i].offset);
+}
+
 void clearBuffers(Camera *camera) {
 	if (!camera) return;
 	int size = camera->screenWidth * camera->screenHeight;
 	// framebuffer: cleared to black background each frame.
 	// memset(camera->framebuffer, 0, size * sizeof(uint32));
-	// memset(camera->accumulationBuffer, 0, size * sizeof(int4));
 	// depthBuffer: 0x7F7F7F7F ~= 3.4e38, indistinguishable from FLT_MAX for depth comparisons.
 	// memset(camera->depthBuffer, 0x7F, size * sizeof(float));
-	// normalBuffer, positionBuffer, reflectBuffer: only read at pixels where
+	// normalBuffer, reflectBuffer: only read at pixels where
 	// depthBuffer < FLT_MAX (i.e. pixels written by RenderObject), so no clear needed.
 	// tempBuffer_1: fully overwritten with 1.0f in ShadowPostProcess before any read.
 	// tempBuffer_2: written by blur horizontal pass before vertical pass reads it.
@@ -30,64 +73,56 @@ void initCamera(Camera *camera, int screenWidth, int screenHeight, float fov, fl
 	camera->position = position;
 	camera->lightDir = lightDir;
 	camera->forward = forward;
-	camera->framebuffer = (uint32 *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(uint32)));
-	camera->normalBuffer = (float3 *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(float3)));
-	camera->positionBuffer = (float3 *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(float3)));
-	camera->reflectBuffer = (float3 *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(float3)));
-	camera->bloomBuffer = (float3 *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(float3)));
-	camera->bloomTemp = (float3 *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(float3)));
-	camera->bloomDst = (float3 *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(float3)));
-	camera->accumulationBuffer = (int4 *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(int4)));
-	camera->depthBuffer = (float *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(float)));
-	camera->reflectCache = (Color *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(Color)));
-	camera->tempFramebuffer = (Color *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(Color)));
-	camera->tempBuffer_1 = (float *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(float)));
-	camera->tempBuffer_2 = (float *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(float)));
-	camera->shadowCache = (float *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(float)));
-	camera->objectIdBuffer = (int *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(int)));
-	camera->uvBuffer = (uvMap *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(uvMap)));
-	camera->triangleIdBuffer = (int *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(int)));
-	camera->motionVectorBuffer = (float2 *)aligned_alloc(64, ALIGN64(screenWidth * screenHeight * sizeof(float2)));
+	camera->jitter = (float2){0.0f, 0.0f};
+	for (int i = 0; i < CAMERA_BUFFER_COUNT; i++)
+		*CameraBufferSlot(camera, i) = NULL;
+	// everything else is allocated by the first pass that needs it
+	Camera_Require(camera, CAMERA_FRAMEBUFFER | CAMERA_DEPTH);
 	camera->frameCounter = 0;
 	clearBuffers(camera);
 }
 
 void destroyCamera(Camera *camera) {
 	if (!camera) return;
-	free(camera->framebuffer);
-	free(camera->normalBuffer);
-	free(camera->positionBuffer);
-	free(camera->reflectBuffer);
-	free(camera->depthBuffer);
-	free(camera->reflectCache);
-	free(camera->tempFramebuffer);
-	free(camera->tempBuffer_1);
-	free(camera->tempBuffer_2);
-	free(camera->shadowCache);
-	free(camera->objectIdBuffer);
-	free(camera->bloomBuffer);
-	free(camera->bloomTemp);
-	free(camera->bloomDst);
-	free(camera->uvBuffer);
-	free(camera->triangleIdBuffer);
-	free(camera->motionVectorBuffer);
-	camera->framebuffer = NULL;
-	camera->normalBuffer = NULL;
-	camera->positionBuffer = NULL;
-	camera->reflectBuffer = NULL;
-	camera->depthBuffer = NULL;
-	camera->reflectCache = NULL;
-	camera->tempFramebuffer = NULL;
-	camera->tempBuffer_1 = NULL;
-	camera->tempBuffer_2 = NULL;
-	camera->shadowCache = NULL;
-	camera->objectIdBuffer = NULL;
-	camera->bloomBuffer = NULL;
-	camera->bloomTemp = NULL;
-	camera->bloomDst = NULL;
-	camera->uvBuffer = NULL;
-	camera->triangleIdBuffer = NULL;
-	camera->motionVectorBuffer = NULL;
+	for (int i = 0; i < CAMERA_BUFFER_COUNT; i++) {
+		void **slot = CameraBufferSlot(camera, i);
+		free(*slot);
+		*slot = NULL;
+	}
+}
+
+bool Camera_Require(Camera *camera, uint32 mask) {
+	if (!camera) return false;
+	size_t fullSize = (size_t)camera->screenWidth * camera->screenHeight;
+	size_t halfSize = (size_t)((camera->screenWidth + 1) / 2) * ((camera->screenHeight + 1) / 2);
+	bool ok = true;
+	for (int i = 0; i < CAMERA_BUFFER_COUNT; i++) {
+		void **slot = CameraBufferSlot(camera, i);
+		if (!(mask & (1u << i)) || *slot) continue;
+		size_t bytes = (cameraBuffers[i].halfRes ? halfSize : fullSize) * cameraBuffers[i].elementSize;
+		*slot = aligned_alloc(64, ALIGN64(bytes));
+		if (!*slot) {
+			ok = false;
+			continue;
+		}
+		if (cameraBuffers[i].zeroed) memset(*slot, 0, bytes);
+	}
+	return ok;
+}
+
+PixelRays Camera_PixelRays(const Camera *camera) {
+	float3 fwd = Float3_Normalize(camera->forward);
+	float3 rgt = Float3_Scale(Float3_Normalize(camera->right), camera->aspect * camera->fovScale);
+	float3 up = Float3_Scale(Float3_Normalize(camera->up), camera->fovScale);
+	float w = (float)camera->screenWidth, h = (float)camera->screenHeight;
+	// ndcX = (x + 0.5 + jitter.x) / w * 2 - 1, ndcY = 1 - (y + 0.5 + jitter.y) / h * 2
+	float ndcX0 = (0.5f + camera->jitter.x) / w * 2.0f - 1.0f;
+	float ndcY0 = 1.0f - (0.5f + camera->jitter.y) / h * 2.0f;
+	return (PixelRays){
+		camera->position,
+		Float3_Add(fwd, Float3_Add(Float3_Scale(rgt, ndcX0), Float3_Scale(up, ndcY0))),
+		Float3_Scale(rgt, 2.0f / w),
+		Float3_Scale(up, -2.0f / h)};
 }
 
 void CameraMoveForward(Camera *camera, float amount) {
@@ -50,6 +50,14 @@ typedef struct float4 {
 	float w;
 } float4;
 
+// IEEE half-float RGBA, converted with F16C; w is unused padding.
+typedef struct half4 {
+	uint16 x;
+	uint16 y;
+	uint16 z;
+	uint16 w;
+} half4;
+
 typedef struct int4 {
 	int x;
 	int y;
@@ -79,7 +87,7 @@ typedef struct Camera {
 
 
 	float fov;
-	float2 jitter;
+	float2 jitter; // primary-ray sub-pixel offset in pixels, 0 = pixel centres
 	int screenWidth;
 	int screenHeight;
 	float3 lightDir;
@@ -90,16 +98,17 @@ typedef struct Camera {
 	
 	float seed;
 	
+	// Per-pixel buffers are allocated on first use by Camera_Require, see CameraBuffer.
 	uint32 *framebuffer;
-	int4 *accumulationBuffer;
-	float3 *normalBuffer;
-	float3 *positionBuffer;
-	float3 *reflectBuffer;
+	half4 *hdrBuffer; // linear working colour of the deferred path, packed to framebuffer once by PostProcess
+	half4 *hdrTemp;	  // snapshot of hdrBuffer for passes that read neighbours while writing
+	uint32 *normalBuffer; // octahedral unit normal, PackNormal / UnpackNormal; positions come from depthBuffer via PixelRays
+	half4 *reflectBuffer; // reflection direction (xyz) + gloss^2 (w)
 	float3 *bloomBuffer;
 	float3 *bloomTemp;
 	float3 *bloomDst;
 	uvMap *uvBuffer;
-	float *depthBuffer;
+	float *depthBuffer; // view-space z along forward, DEPTH_FAR where nothing was hit
 	float2 *motionVectorBuffer;
 	Color *reflectCache;
 	Color *tempFramebuffer;
@@ -108,12 +117,71 @@ typedef struct Camera {
 	float *shadowCache; 
 	int *objectIdBuffer;
 	int *triangleIdBuffer;
+	float2 *baryBuffer; // visibility buffer: barycentrics (v, w) of the primary hit
+	float3 *emissionSignal;	  // secondary-ray emission (xyz) + shadow visibility (w), before composite
+	float3 *reflectionSignal; // secondary-ray reflection color, before composite
+	// low-res secondary-ray samples, sized for half resolution (the finest SECONDARY_RESOLUTION)
+	float3 *secondaryEmission;
+	float3 *secondaryReflection;
+	int *secondaryPixel; // full-res pixel each sample was traced from, -1 = all sky
+	float3 *ssrReflection; // screen-space reflection per secondary sample: color (xyz), confidence (w), 0 when SSR is off
 	int frameCounter;
 } Camera;
 
+// One bit per Camera buffer, for Camera_Require.
+typedef enum {
+	CAMERA_FRAMEBUFFER = 1 << 0,
+	CAMERA_HDR = 1 << 1,
+	CAMERA_HDR_TEMP = 1 << 2,
+	CAMERA_DEPTH = 1 << 3,
+	CAMERA_NORMAL = 1 << 4,
+	CAMERA_REFLECT = 1 << 5,
+	CAMERA_UV = 1 << 6,
+	CAMERA_MOTION = 1 << 7,
+	CAMERA_OBJECT_ID = 1 << 8,
+	CAMERA_TRIANGLE_ID = 1 << 9,
+	CAMERA_BARY = 1 << 10,
+	CAMERA_BLOOM = 1 << 11,
+	CAMERA_BLOOM_TEMP = 1 << 12,
+	CAMERA_BLOOM_DST = 1 << 13,
+	CAMERA_EMISSION_SIGNAL = 1 << 14,
+	CAMERA_REFLECTION_SIGNAL = 1 << 15,
+	CAMERA_SECONDARY_EMISSION = 1 << 16,
+	CAMERA_SECONDARY_REFLECTION = 1 << 17,
+	CAMERA_SECONDARY_PIXEL = 1 << 18,
+	CAMERA_SSR_REFLECTION = 1 << 19,
+	CAMERA_REFLECT_CACHE = 1 << 20,
+	CAMERA_TEMP_FRAMEBUFFER = 1 << 21,
+	CAMERA_TEMP_1 = 1 << 22,
+	CAMERA_TEMP_2 = 1 << 23,
+	CAMERA_SHADOW_CACHE = 1 << 24,
+} CameraBuffer;
+
+// Primary rays of the current camera and jitter. The ray through pixel (x, y) is
+// base + stepX * x + stepY * y with a forward component of 1, so scaling it by the
+// view-space depth gives the hit point relative to origin.
+typedef struct {
+	float3 origin;
+	float3 base;
+	float3 stepX;
+	float3 stepY;
+} PixelRays;
+
+static inline float3 PixelRays_Position(const PixelRays *rays, int x, int y, float depth) {
+	return (float3){
+		rays->origin.x + (rays->base.x + rays->stepX.x * x + rays->stepY.x * y) * depth,
+		rays->origin.y + (rays->base.y + rays->stepX.y * x + rays->stepY.y * y) * depth,
+		rays->origin.z + (rays->base.z + rays->stepX.z * x + rays->stepY.z * y) * depth};
+}
+
 void clearBuffers(Camera *camera);
 void initCamera(Camera *camera, int width, int height, float fov, float3 position, float3 forward, float3 lightDir);
 void destroyCamera(Camera *camera);
+// Allocates the buffers in mask (CameraBuffer bits) that do not exist yet. Returns false if
+// any allocation failed; buffers that were allocated are kept.
+bool Camera_Require(Camera *camera, uint32 mask);
+// Needs forward / right / up from RenderSetup.
+PixelRays Camera_PixelRays(const Camera *camera);
 void CameraMoveForward(Camera *camera, float amount);
 void CameraMoveRight(Camera *camera, float amount);
 void CameraMoveUp(Camera *camera, float amount);
@@ -1,43 +1,100 @@
 #include "material.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Golden-ratio multiply-xorshift over the bits of each field.
+static uint32 MaterialHash(const Material *mat) {
+	uint32 words[6];
+	memcpy(&words[0], &mat->color, 3 * sizeof(float));
+	memcpy(&words[3], &mat->roughness, 3 * sizeof(float)); // roughness, metallic, emission
+	uint64_t tex = (uint64_t)(uintptr_t)mat->textures;
+	uint64_t h = tex ^ (tex >> 32);
+	for (int i = 0; i < 6; i++) {
+		h = (h ^ words[i]) * 0x9E3779B97F4A7C15ull;
+		h ^= h >> 29;
+	}
+	return (uint32)(h ^ (h >> 32));
+}
+
+static int MaterialEqual(const Material *a, const Material *b) {
+	return memcmp(&a->color, &b->color, 3 * sizeof(float)) == 0 &&
+		   memcmp(&a->roughness, &b->roughness, 3 * sizeof(float)) == 0 && a->textures == b->textures;
+}
+
+// The slot holding an entry equal to mat, or the empty slot it would go in. The index is
+// at most half full, so probing always ends.
+static int *IndexSlot(const MaterialLib *lib, const Material *mat) {
+	uint32 mask = (uint32)lib->indexCapacity - 1;
+	for (uint32 i = MaterialHash(mat) & mask;; i = (i + 1) & mask) {
+		int id = lib->index[i];
+		if (id < 0 || MaterialEqual(&lib->entries[id], mat)) return &lib->index[i];
+	}
+}
+
+// Rehashes every entry in order, so each slot keeps the lowest index of its material.
+static void RebuildIndex(MaterialLib *lib) {
+	if (!lib->indexCapacity) return;
+	memset(lib->index, 0xFF, (size_t)lib->indexCapacity * sizeof(int));
+	for (int i = 0; i < lib->count; i++) {
+		int *slot = IndexSlot(lib, &lib->entries[i]);
+		if (*slot < 0) *slot = i;
+	}
+}
+
+static int ResizeIndex(MaterialLib *lib, int capacity) {
+	int *index = (int *)malloc((size_t)capacity * sizeof(int));
+	if (!index) return 0;
+	free(lib->index);
+	lib->index = index;
+	lib->indexCapacity = capacity;
+	RebuildIndex(lib);
+	return 1;
+}
+
+static void Textures_Retain(Textures *tex) {
+	if (tex) atomic_fetch_add_explicit(&tex->refs, 1, memory_order_relaxed);
+}
+
+static void Textures_Release(Textures *tex) {
+	if (tex && atomic_fetch_sub_explicit(&tex->refs, 1, memory_order_acq_rel) == 1) Textures_Destroy(tex);
+}
 
 void MaterialLib_Init(MaterialLib *lib, int initialCapacity) {
 	if (initialCapacity <= 0) initialCapacity = 64;
+	memset(lib, 0, sizeof(MaterialLib));
+	int indexCapacity = 16;
+	while (indexCapacity < 2 * initialCapacity)
+		indexCapacity *= 2;
 	lib->entries = (Material *)malloc((size_t)initialCapacity * sizeof(Material));
-	if (!lib->entries) {
+	if (!lib->entries || !ResizeIndex(lib, indexCapacity)) {
 		fprintf(stderr, "Error: Could not allocate MaterialLib.\n");
-		lib->count = lib->capacity = 0;
+		free(lib->entries);
+		lib->entries = NULL;
 		return;
 	}
-	lib->count = 0;
 	lib->capacity = initialCapacity;
 }
 
 void MaterialLib_Destroy(MaterialLib *lib) {
 	if (!lib) return;
-	// Free each unique Textures pointer once.
-	for (int i = 0; i < lib->count; i++) {
-		if (!lib->entries[i].textures) continue;
-		int duplicate = 0;
-		for (int j = 0; j < i; j++) {
-			if (lib->entries[j].textures == lib->entries[i].textures) {
-				duplicate = 1;
-				break;
-			}
-		}
-		if (!duplicate) Textures_Destroy(lib->entries[i].textures);
-	}
+	for (int i = 0; i < lib->count; i++)
+		Textures_Release(lib->entries[i].textures);
 	free(lib->entries);
+	free(lib->index);
 	lib->entries = NULL;
-	lib->count = lib->capacity = 0;
+	lib->index = NULL;
+	lib->count = lib->capacity = lib->indexCapacity = 0;
 }
 
 int MaterialLib_Add(MaterialLib *lib, Material mat) {
 	if (!lib) return -1;
 	if (lib->count >= lib->capacity) {
-		int newCap = lib->capacity * 2;
+		int newCap = lib->capacity ? lib->capacity * 2 : 64;
 		Material *resized = (Material *)realloc(lib->entries, (size_t)newCap * sizeof(Material));
 		if (!resized) {
 			fprintf(stderr, "Error: Could not grow MaterialLib.\n");
@@ -46,69 +103,252 @@ int MaterialLib_Add(MaterialLib *lib, Material mat) {
 		lib->entries = resized;
 		lib->capacity = newCap;
 	}
+	if (2 * (lib->count + 1) > lib->indexCapacity && !ResizeIndex(lib, lib->indexCapacity ? lib->indexCapacity * 2 : 16)) {
+		fprintf(stderr, "Error: Could not grow MaterialLib index.\n");
+		return -1;
+	}
+	int *slot = IndexSlot(lib, &mat);
+	if (*slot < 0) *slot = lib->count;
 	lib->entries[lib->count] = mat;
+	Textures_Retain(mat.textures);
+	lib->version++;
 	return lib->count++;
 }
 
 int MaterialLib_FindOrAdd(MaterialLib *lib, Material mat) {
-	for (int i = 0; i < lib->count; i++) {
-		if (memcmp(&lib->entries[i], &mat, sizeof(Material)) == 0)
-			return i;
+	if (!lib) return -1;
+	if (lib->indexCapacity) {
+		int id = *IndexSlot(lib, &mat);
+		if (id >= 0) return id;
 	}
 	return MaterialLib_Add(lib, mat);
 }
 
+int MaterialLib_Absorb(MaterialLib *lib, MaterialLib *src, int *materialIds, int count) {
+	if (!lib || !src) return 0;
+	int *remap = (int *)malloc((size_t)(src->count ? src->count : 1) * sizeof(int));
+	if (!remap) return 0;
+	int oldCount = lib->count;
+	for (int i = 0; i < src->count; i++) {
+		remap[i] = MaterialLib_FindOrAdd(lib, src->entries[i]);
+		if (remap[i] >= 0) continue;
+		// drop what this call added; the index only shrinks, so rebuilding it cannot fail
+		for (int j = oldCount; j < lib->count; j++)
+			Textures_Release(lib->entries[j].textures);
+		lib->count = oldCount;
+		RebuildIndex(lib);
+		lib->version++;
+		free(remap);
+		return 0;
+	}
+	for (int t = 0; t < count; t++)
+		if (materialIds[t] >= 0 && materialIds[t] < src->count) materialIds[t] = remap[materialIds[t]];
+	free(remap);
+	// lib holds its own references now
+	MaterialLib_Destroy(src);
+	return 1;
+}
+
 void packMaterials(int *materialIds, int count, MaterialLib *lib) {
+	if (!lib->indexCapacity) return;
 	for (int i = 0; i < count; i++) {
 		int id = materialIds[i];
 		if (id <= 0 || id >= lib->count) continue;
-		for (int j = 0; j < id; j++) {
-			if (memcmp(&lib->entries[j], &lib->entries[id], sizeof(Material)) == 0) {
-				materialIds[i] = j;
-				break;
+		int first = *IndexSlot(lib, &lib->entries[id]);
+		if (first >= 0 && first < id) materialIds[i] = first;
+	}
+}
+
+// Fills rows [y0, y1) of level l from the mapped maps, taking the texel nearest each
+// level texel's centre.
+static void FillLevelRows(Texel *dst, const uint8 *maps, int l, int y0, int y1) {
+	int shift = TEXTURE_LEVEL_SHIFT * l, size = TEXTURE_SIZE >> shift;
+	int step = 1 << shift, half = step >> 1;
+	const uint8 *colorMap = maps;
+	const uint8 *normalMap = colorMap + (size_t)TEXTURE_SIZE * TEXTURE_SIZE * 4;
+	const uint8 *materialMap = normalMap + (size_t)TEXTURE_SIZE * TEXTURE_SIZE * 3;
+	for (int y = y0; y < y1; y++) {
+		size_t row = (size_t)(y * step + half) * TEXTURE_SIZE;
+		const uint32 *color = (const uint32 *)colorMap + row;
+		const uint8 *normal = normalMap + row * 3;
+		const uint16 *material = (const uint16 *)materialMap + row;
+		for (int x = 0; x < size; x++) {
+			int sx = x * step + half;
+			const uint8 *rgb = normal + sx * 3;
+			dst[Textures_TexelIndex(x, y, size)] = (Texel){
+				.color = color[sx],
+				// NormalMap is RGB, unpacked to RGBA with full alpha
+				.normal = 0xFF000000u | ((uint32)rgb[2] << 16) | ((uint32)rgb[1] << 8) | rgb[0],
+				.material = material[sx],
+			};
+		}
+	}
+}
+
+static Texel *AllocLevel(int l) {
+	int size = TEXTURE_SIZE >> (TEXTURE_LEVEL_SHIFT * l);
+	return (Texel *)aligned_alloc(64, (size_t)size * size * sizeof(Texel));
+}
+
+// Background side of Textures_LoadFromFile: every level finer than the resident one,
+// coarsest first. Unmaps the file when done.
+static void *StreamLevels(void *arg) {
+	Textures *tex = arg;
+	const uint8 *maps = tex->map + tex->mapOffset;
+	for (int l = atomic_load(&tex->resident) - 1; l >= 0; l--) {
+		int size = TEXTURE_SIZE >> (TEXTURE_LEVEL_SHIFT * l);
+		Texel *level = AllocLevel(l);
+		if (!level) {
+			fprintf(stderr, "Error: Could not allocate texture level %d, keeping level %d.\n", l, l + 1);
+			break;
+		}
+		for (int y = 0; y < size; y += TEXTURE_STREAM_ROWS) {
+			if (atomic_load_explicit(&tex->cancel, memory_order_relaxed)) {
+				free(level);
+				goto done;
 			}
+			FillLevelRows(level, maps, l, y, y + TEXTURE_STREAM_ROWS < size ? y + TEXTURE_STREAM_ROWS : size);
 		}
+		tex->levels[l] = level;
+		atomic_store_explicit(&tex->resident, l, memory_order_release);
 	}
+done:
+	munmap((void *)tex->map, tex->mapBytes);
+	tex->map = NULL;
+	return NULL;
+}
+
+void Textures_Wait(Textures *tex) {
+	if (!tex || !tex->streaming) return;
+	pthread_join(tex->thread, NULL);
+	tex->streaming = 0;
 }
 
 void Textures_Destroy(Textures *tex) {
+	if (!tex) return;
+	atomic_store(&tex->cancel, 1);
+	Textures_Wait(tex);
+	if (tex->map) munmap((void *)tex->map, tex->mapBytes);
+	for (int l = 0; l < TEXTURE_LEVELS; l++)
+		free(tex->levels[l]);
 	free(tex);
 }
 
+void MaterialLib_WaitTextures(MaterialLib *lib) {
+	if (!lib) return;
+	for (int i = 0; i < lib->count; i++)
+		Textures_Wait(lib->entries[i].textures);
+}
+
 Textures *Textures_LoadFromFile(FILE *file) {
-	Textures *tex = (Textures *)malloc(sizeof(Textures));
+	long offset = ftell(file);
+	struct stat st;
+	if (offset < 0 || fstat(fileno(file), &st) != 0 || (size_t)st.st_size < (size_t)offset + TEXTURE_FILE_BYTES) {
+		fprintf(stderr, "Error: Texture maps are truncated.\n");
+		return NULL;
+	}
+	Textures *tex = (Textures *)calloc(1, sizeof(Textures));
 	if (!tex) {
 		fprintf(stderr, "Error: Could not allocate Textures.\n");
 		return NULL;
 	}
 
-	// ColorMap: RGBA uint8 packed as uint32, read directly.
-	if (fread(tex->colorMap, sizeof(uint32), TEXTURE_SIZE * TEXTURE_SIZE, file) != (size_t)(TEXTURE_SIZE * TEXTURE_SIZE)) {
-		fprintf(stderr, "Error: Failed to read colorMap.\n");
+	// mappings start on a page boundary
+	size_t mapStart = (size_t)offset & ~((size_t)sysconf(_SC_PAGESIZE) - 1);
+	tex->mapOffset = (size_t)offset - mapStart;
+	tex->mapBytes = tex->mapOffset + TEXTURE_FILE_BYTES;
+	void *map = mmap(NULL, tex->mapBytes, PROT_READ, MAP_PRIVATE, fileno(file), (off_t)mapStart);
+	int last = TEXTURE_LEVELS - 1;
+	tex->levels[last] = map != MAP_FAILED ? AllocLevel(last) : NULL;
+	if (!tex->levels[last]) {
+		fprintf(stderr, "Error: Could not map texture maps.\n");
+		if (map != MAP_FAILED) munmap(map, tex->mapBytes);
 		free(tex);
 		return NULL;
 	}
+	tex->map = (const uint8 *)map;
+	// the coarsest level touches one row in 64 of each map, so it is ready within a few ms
+	FillLevelRows(tex->levels[last], tex->map + tex->mapOffset, last, 0, TEXTURE_SIZE >> (TEXTURE_LEVEL_SHIFT * last));
+	atomic_store(&tex->resident, last);
+
+	tex->streaming = pthread_create(&tex->thread, NULL, StreamLevels, tex) == 0;
+	if (!tex->streaming) StreamLevels(tex);
+	fseek(file, offset + (long)TEXTURE_FILE_BYTES, SEEK_SET);
+	return tex;
+}
+
+void MaterialTable_Init(MaterialTable *table) {
+	*table = (MaterialTable){0};
+	table->builtCount = -1;
+}
 
-	// NormalMap: stored as RGB (3 bytes/pixel), unpack to RGBA with full alpha.
-	for (int i = 0; i < TEXTURE_SIZE * TEXTURE_SIZE; i++) {
-		uint8 rgb[3];
-		if (fread(rgb, 1, 3, file) != 3) {
-			fprintf(stderr, "Error: Failed to read normalMap.\n");
-			free(tex);
-			return NULL;
+void MaterialTable_Destroy(MaterialTable *table) {
+	if (!table) return;
+	free(table->entries);
+	free(table->textureSets);
+	*table = (MaterialTable){0};
+}
+
+static int MaterialTable_TextureSet(MaterialTable *table, Textures *tex) {
+	for (int i = 0; i < table->textureSetCount; i++) {
+		if (table->textureSets[i] == tex) return i;
+	}
+	if (table->textureSetCount >= table->textureSetCapacity) {
+		int newCap = table->textureSetCapacity ? table->textureSetCapacity * 2 : 8;
+		Textures **resized = (Textures **)realloc(table->textureSets, (size_t)newCap * sizeof(Textures *));
+		if (!resized) {
+			fprintf(stderr, "Error: Could not grow MaterialTable texture sets.\n");
+			return -1;
 		}
-		((uint8 *)&tex->normalMap[i / TEXTURE_SIZE][i % TEXTURE_SIZE])[0] = rgb[0];
-		((uint8 *)&tex->normalMap[i / TEXTURE_SIZE][i % TEXTURE_SIZE])[1] = rgb[1];
-		((uint8 *)&tex->normalMap[i / TEXTURE_SIZE][i % TEXTURE_SIZE])[2] = rgb[2];
-		((uint8 *)&tex->normalMap[i / TEXTURE_SIZE][i % TEXTURE_SIZE])[3] = 0xFF;
+		table->textureSets = resized;
+		table->textureSetCapacity = newCap;
 	}
+	table->textureSets[table->textureSetCount] = tex;
+	return table->textureSetCount++;
+}
 
-	// MaterialMap: [roughness, metallic] as uint16, read directly.
-	if (fread(tex->MaterialMap, sizeof(uint16), TEXTURE_SIZE * TEXTURE_SIZE, file) != (size_t)(TEXTURE_SIZE * TEXTURE_SIZE)) {
-		fprintf(stderr, "Error: Failed to read MaterialMap.\n");
-		free(tex);
-		return NULL;
+void MaterialTable_Sync(MaterialTable *table, const MaterialLib *lib) {
+	if (!table || !lib) return;
+	if (table->builtVersion == lib->version && table->builtCount == lib->count) return;
+
+	int needed = lib->count + 1;
+	if (needed > table->capacity) {
+		PackedMaterial *resized = (PackedMaterial *)aligned_alloc(64, ((size_t)needed * sizeof(PackedMaterial) + 63) & ~(size_t)63);
+		if (!resized) {
+			fprintf(stderr, "Error: Could not grow MaterialTable.\n");
+			return;
+		}
+		free(table->entries);
+		table->entries = resized;
+		table->capacity = needed;
 	}
 
-	return tex;
+	// matches the fallback the renderer uses for untagged triangles
+	table->entries[0] = (PackedMaterial){.r = 0.8f, .g = 0.8f, .b = 0.8f, .roughness = 0.8f};
+	table->textureSetCount = 0;
+	for (int i = 0; i < lib->count; i++) {
+		const Material *mat = &lib->entries[i];
+		uint16 flags = Material_Flags(mat);
+		int set = 0;
+		if (mat->textures) {
+			set = MaterialTable_TextureSet(table, mat->textures);
+			if (set < 0) {
+				set = 0;
+				flags &= ~MATERIAL_TEXTURED;
+			}
+		}
+		table->entries[i + 1] = (PackedMaterial){
+			.r = mat->color.x,
+			.g = mat->color.y,
+			.b = mat->color.z,
+			.roughness = mat->roughness,
+			.metallic = mat->metallic,
+			.emission = mat->emission,
+			.textureSet = (uint16)set,
+			.flags = flags,
+		};
+	}
+	table->count = needed;
+	table->builtVersion = lib->version;
+	table->builtCount = lib->count;
 }
@@ -2,15 +2,75 @@
 #define MATERIAL_H
 
 #include "../format.h"
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 
 #define TEXTURE_SIZE 4096
+
+// Textures stream in as a chain: level l is TEXTURE_SIZE >> (TEXTURE_LEVEL_SHIFT * l) texels
+// per edge. The coarsest level is ready when loading returns, finer ones replace it as a
+// background thread reads them.
+#define TEXTURE_LEVELS 4 // 4096, 1024, 256, 64
+#define TEXTURE_LEVEL_SHIFT 2
+#define TEXTURE_STREAM_ROWS 64 // level rows filled between cancel checks
+// colour (RGBA), normal (RGB) and material (2 bytes) maps as stored in a model file
+#define TEXTURE_FILE_BYTES ((size_t)TEXTURE_SIZE * TEXTURE_SIZE * (4 + 3 + 2))
+
+// Texel layout: 1 = 8x8 tiles with Morton order inside each tile, 0 = plain row-major.
+#ifndef TEXTURE_TILED
+#define TEXTURE_TILED 1
+#endif
+#define TEXTURE_TILE_SHIFT 3
+#define TEXTURE_TILE_SIZE (1 << TEXTURE_TILE_SHIFT)
+
+// Colour, normal and material for one texel are interleaved so a hit reads
+// one (at most two) cache lines instead of one per map.
+typedef struct Texel {
+	Color color;	 // RGBA8
+	Color normal;	 // RGBA8
+	uint16 material; // [roughness (uint8), metallic (uint8)]
+	uint16 _pad;
+} Texel;
+
 typedef struct Textures {
-	Color colorMap[TEXTURE_SIZE][TEXTURE_SIZE];     // RGBA8
-	Color normalMap[TEXTURE_SIZE][TEXTURE_SIZE];    // RGBA8
-	uint16 MaterialMap[TEXTURE_SIZE][TEXTURE_SIZE]; // [roughness (uint8), metallic (uint8)]
+	Texel *levels[TEXTURE_LEVELS]; // addressed through Textures_TexelIndex, NULL until streamed
+	_Atomic int resident;		   // finest published level
+	_Atomic int cancel;
+	const uint8 *map; // the maps in file layout, mapped while streaming
+	size_t mapBytes;
+	size_t mapOffset; // of the colour map inside the mapping
+	pthread_t thread;
+	int streaming;	   // thread started and not yet joined
+	_Atomic int refs; // lib entries pointing here; the last one released frees the block
 } Textures;
 
+// Spreads the low 3 bits of v to even bit positions (0b abc -> 0b 0a0b0c).
+static inline uint32 Textures_Part1By1_3(uint32 v) {
+	v = (v | (v << 2)) & 0x33;
+	v = (v | (v << 1)) & 0x55;
+	return v;
+}
+
+// size is the level's edge in texels.
+static inline uint32 Textures_TexelIndex(uint32 x, uint32 y, uint32 size) {
+#if TEXTURE_TILED
+	uint32 tile = (y >> TEXTURE_TILE_SHIFT) * (size >> TEXTURE_TILE_SHIFT) + (x >> TEXTURE_TILE_SHIFT);
+	uint32 inTile = Textures_Part1By1_3(x & (TEXTURE_TILE_SIZE - 1)) |
+					(Textures_Part1By1_3(y & (TEXTURE_TILE_SIZE - 1)) << 1);
+	return (tile << (2 * TEXTURE_TILE_SHIFT)) | inTile;
+#else
+	return y * size + x;
+#endif
+}
+
+// x, y in full-resolution texels; reads the finest level resident right now.
+static inline const Texel *Textures_Fetch(const Textures *tex, uint32 x, uint32 y) {
+	int l = atomic_load_explicit(&tex->resident, memory_order_acquire);
+	uint32 shift = TEXTURE_LEVEL_SHIFT * l;
+	return &tex->levels[l][Textures_TexelIndex(x >> shift, y >> shift, TEXTURE_SIZE >> shift)];
+}
+
 typedef struct Material {
 	float3 color;
 	float roughness;
@@ -19,32 +79,97 @@ typedef struct Material {
 	Textures *textures;
 } Material;
 
-// One shared library - all objects reference entries by index.
+// One shared library - all objects reference entries by index. Entries are interned through
+// an open-addressing hash of their fields (padding never takes part), so FindOrAdd is O(1).
 typedef struct MaterialLib {
 	Material *entries;
 	int count;
 	int capacity;
+	uint32 version; // bumped on every add/edit so MaterialTable knows when to rebuild
+	int *index;		// lowest entry index per distinct material, -1 for an empty slot
+	int indexCapacity; // power of two, at least twice count
 } MaterialLib;
 
+// Per-material / per-triangle flags — let shading skip whole paths without touching the material.
+#define MATERIAL_TEXTURED (1 << 0)
+#define MATERIAL_EMISSIVE (1 << 1)
+#define MATERIAL_METALLIC (1 << 2)
+
+// Hot-path copy of a Material: no pointers, 2 per cache line.
+typedef struct PackedMaterial {
+	float r, g, b;
+	float roughness;
+	float metallic;
+	float emission;
+	uint16 textureSet; // index into MaterialTable.textureSets when MATERIAL_TEXTURED
+	uint16 flags;
+	uint32 _pad;
+} PackedMaterial; // 32 bytes
+
+// Runtime material table built from a MaterialLib. Slot 0 holds the default material,
+// lib entry i lives at slot i + 1 so a missing id (-1) needs no branch.
+typedef struct MaterialTable {
+	PackedMaterial *entries;
+	Textures **textureSets; // unique Textures blocks, referenced by PackedMaterial.textureSet
+	int count;
+	int capacity;
+	int textureSetCount;
+	int textureSetCapacity;
+	uint32 builtVersion;
+	int builtCount;
+} MaterialTable;
+
 void MaterialLib_Init(MaterialLib *lib, int initialCapacity);
 void MaterialLib_Destroy(MaterialLib *lib);
 
-// Add a material; returns its index. Returns -1 on allocation failure.
+// Add a material, even if an equal one exists; returns its index. Returns -1 on allocation
+// failure. The lib takes a reference on mat.textures.
 int MaterialLib_Add(MaterialLib *lib, Material mat);
 
 // Returns the index of a matching material if one already exists, otherwise adds it.
+// Materials match when colour, roughness, metallic, emission and textures are bit-equal.
+// Entries must not be edited in place once added: the index is hashed from their fields and
+// other objects may share them. Use the Object_Set* functions, which intern an edited copy.
 int MaterialLib_FindOrAdd(MaterialLib *lib, Material mat);
 
+// Moves every material of src into lib (src's references on textures pass to lib) and rewrites
+// materialIds[0..count) from src to lib indices. src is left empty. Returns 0 on allocation
+// failure, with nothing moved.
+int MaterialLib_Absorb(MaterialLib *lib, MaterialLib *src, int *materialIds, int count);
+
 // Remaps materialIds[0..count) so that equal materials share the lowest lib index.
 // Use after loading with a non-deduplicating path.
 void packMaterials(int *materialIds, int count, MaterialLib *lib);
 
-// Allocates a Textures block and reads ColorMap/NormalMap/MaterialMap from the
-// current file position. NormalMap is stored as RGB (3 bytes/pixel) in the binary
-// and unpacked to RGBA here. Returns NULL on allocation or read failure.
+// Maps ColorMap/NormalMap/MaterialMap at the current file position, builds the coarsest
+// level and leaves the file positioned after the maps; a background thread then streams the
+// finer levels coarsest-first, each published atomically once complete. The file stores each
+// map row-major; texels are scattered into the interleaved/tiled layout, NormalMap is stored
+// as RGB and unpacked to RGBA. The file may be closed right away. Returns NULL on failure.
 Textures *Textures_LoadFromFile(FILE *file);
 
+// Blocks until every level is resident (or streaming stopped on an allocation failure).
+void Textures_Wait(Textures *tex);
+// Stops streaming and frees every level.
 void Textures_Destroy(Textures *tex);
+// Textures_Wait on every textured entry, for runs that must not depend on load timing.
+void MaterialLib_WaitTextures(MaterialLib *lib);
+
+void MaterialTable_Init(MaterialTable *table);
+void MaterialTable_Destroy(MaterialTable *table);
+// Rebuilds the table if the lib changed since the last call. Textures stay owned by the lib.
+void MaterialTable_Sync(MaterialTable *table, const MaterialLib *lib);
+
+static inline uint16 Material_Flags(const Material *mat) {
+	return (uint16)((mat->textures ? MATERIAL_TEXTURED : 0) |
+					(mat->emission > 0.0f ? MATERIAL_EMISSIVE : 0) |
+					(mat->metallic > 0.0f ? MATERIAL_METALLIC : 0));
+}
+
+static inline const PackedMaterial *MaterialTable_Get(const MaterialTable *table, int matId) {
+	uint32 slot = (uint32)(matId + 1);
+	return &table->entries[slot < (uint32)table->count ? slot : 0];
+}
 
 static inline Material Material_Make(float3 color, float roughness, float metallic, float emission, Textures *textures) {
 	return (Material){color, roughness, metallic, emission, textures};
@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "../math/scalar.h"
 #include "../math/transform.h"
@@ -96,6 +97,7 @@ void CreateCube(Object *obj, float3 position, float3 rotation, float3 scale, flo
 	obj->scale = scale;
 	obj->hasTexture = false;
 	obj->hasEmission = emission > 0.0f ? true : false;
+	obj->materialFlags = NULL;
 	obj->_temp = ((uint8)(color.x * 255.0f) << 16) | ((uint8)(color.y * 255.0f) << 8) | (uint8)(color.z * 255.0f);
 
 	const int triCount = 12;
@@ -141,6 +143,7 @@ void CreateCube(Object *obj, float3 position, float3 rotation, float3 scale, flo
 		obj->materialIds[i] = matIdx;
 	}
 	obj->triangleCount = triCount;
+	Object_BuildMaterialFlags(obj, lib);
 	obj->BBmin = (float3){-0.5f, -0.5f, -0.5f};
 	obj->BBmax = (float3){0.5f, 0.5f, 0.5f};
 	CreateObjectBVH(obj, &obj->bvh);
@@ -148,29 +151,72 @@ void CreateCube(Object *obj, float3 position, float3 rotation, float3 scale, flo
 	CalculateFaceEmissions(obj, lib);
 }
 
+typedef void (*MaterialEdit)(Material *mat, const void *value);
+
+// Lib entries may be shared by other objects and are indexed by their fields, so they are
+// never edited in place: each material the object uses is replaced by an interned, edited
+// copy. remap[old] caches the new id (+1) so a mesh with long material runs interns each once.
+static void Object_EditMaterials(Object *obj, MaterialLib *lib, MaterialEdit edit, const void *value) {
+	if (!obj || !lib || !obj->materialIds) return;
+	int oldCount = lib->count;
+	int *remap = (int *)calloc((size_t)(oldCount ? oldCount : 1), sizeof(int));
+	if (!remap) return;
+	for (int i = 0; i < obj->triangleCount; i++) {
+		int id = obj->materialIds[i];
+		if (id < 0 || id >= oldCount) continue;
+		if (!remap[id]) {
+			Material mat = lib->entries[id];
+			edit(&mat, value);
+			remap[id] = MaterialLib_FindOrAdd(lib, mat) + 1;
+		}
+		if (remap[id] > 0) obj->materialIds[i] = remap[id] - 1;
+	}
+	free(remap);
+	Object_BuildMaterialFlags(obj, lib);
+	CalculateFaceEmissions(obj, lib);
+}
+
+static void EditColor(Material *mat, const void *value) { mat->color = *(const float3 *)value; }
+static void EditEmission(Material *mat, const void *value) { mat->emission = *(const float *)value; }
+static void EditRoughness(Material *mat, const void *value) { mat->roughness = *(const float *)value; }
+static void EditMetallic(Material *mat, const void *value) { mat->metallic = *(const float *)value; }
+
 void Object_SetMaterial(Object *obj, MaterialLib *lib, Material mat) {
+	if (!obj || !lib || !obj->materialIds) return;
+	int id = MaterialLib_FindOrAdd(lib, mat);
+	if (id < 0) return;
 	for (int i = 0; i < obj->triangleCount; i++)
-		lib->entries[obj->materialIds[i]] = mat;
+		obj->materialIds[i] = id;
+	Object_BuildMaterialFlags(obj, lib);
+	CalculateFaceEmissions(obj, lib);
 }
 
 void Object_SetColor(Object *obj, MaterialLib *lib, float3 color) {
-	for (int i = 0; i < obj->triangleCount; i++)
-		lib->entries[obj->materialIds[i]].color = color;
+	Object_EditMaterials(obj, lib, EditColor, &color);
 }
 
 void Object_SetEmission(Object *obj, MaterialLib *lib, float emission) {
-	for (int i = 0; i < obj->triangleCount; i++)
-		lib->entries[obj->materialIds[i]].emission = emission;
+	Object_EditMaterials(obj, lib, EditEmission, &emission);
 }
 
 void Object_SetRoughness(Object *obj, MaterialLib *lib, float roughness) {
-	for (int i = 0; i < obj->triangleCount; i++)
-		lib->entries[obj->materialIds[i]].roughness = roughness;
+	Object_EditMaterials(obj, lib, EditRoughness, &roughness);
 }
 
 void Object_SetMetallic(Object *obj, MaterialLib *lib, float metallic) {
-	for (int i = 0; i < obj->triangleCount; i++)
-		lib->entries[obj->materialIds[i]].metallic = metallic;
+	Object_EditMaterials(obj, lib, EditMetallic, &metallic);
+}
+
+void Object_BuildMaterialFlags(Object *obj, const MaterialLib *lib) {
+	if (!obj || obj->triangleCount <= 0) return;
+	if (!obj->materialFlags) {
+		obj->materialFlags = (uint8 *)malloc((size_t)obj->triangleCount * sizeof(uint8));
+		if (!obj->materialFlags) return;
+	}
+	for (int i = 0; i < obj->triangleCount; i++) {
+		int matId = obj->materialIds ? obj->materialIds[i] : -1;
+		obj->materialFlags[i] = (lib && matId >= 0 && matId < lib->count) ? (uint8)Material_Flags(&lib->entries[matId]) : 0;
+	}
 }
 
 void ComputePrevPostionRotationScale(ObjectList *objList) {
@@ -194,6 +240,8 @@ void Object_Destroy(Object *obj) {
 	obj->normals = NULL;
 	free(obj->materialIds);
 	obj->materialIds = NULL;
+	free(obj->materialFlags);
+	obj->materialFlags = NULL;
 	obj->triangleCount = 0;
 	free(obj->bvh.nodes);
 	obj->bvh.nodes = NULL;
@@ -728,6 +776,7 @@ void CalculateFaceEmissions(Object *obj, MaterialLib *lib) {
 	if (!obj || !lib || obj->bvh.nodeCount == 0) return;
 
 	obj->hasEmission = false;
+	obj->emissionPeak = 0.0f;
 	for (int t = 0; t < obj->triangleCount && !obj->hasEmission; t++) {
 		int matId = obj->materialIds ? obj->materialIds[t] : -1;
 		if (matId >= 0 && matId < lib->count && lib->entries[matId].emission > 0.0f)
@@ -818,6 +867,7 @@ void CalculateFaceEmissions(Object *obj, MaterialLib *lib) {
 					}
 				}
 				maps[f]->emissionMap[h][w] = em;
+				obj->emissionPeak = fmaxf(obj->emissionPeak, fmaxf(em.x, fmaxf(em.y, em.z)));
 			}
 		}
 	}
@@ -927,35 +977,157 @@ float3 SampleEmission(const Object *objs, int objCount, float3 position, float3
 	return map->emissionMap[hi][wi];
 }
 
+static inline uint8 QuantizeDensity(float d, float invScale) {
+	float q = d * invScale * 255.0f + 0.5f;
+	return q <= 0.0f ? 0 : q >= 255.0f ? 255 : (uint8)q;
+}
+
+// Texels of brick (bx, by, bz), grid edges clamped; returns the largest.
+static uint8 GatherBrick(const float *density, const int res[3], float invScale, int bx, int by, int bz, uint8 *texels) {
+	uint8 peak = 0;
+	for (int lx = 0; lx < VOLUME_BRICK_STRIDE; lx++) {
+		int x = bx * VOLUME_BRICK + lx < res[0] - 1 ? bx * VOLUME_BRICK + lx : res[0] - 1;
+		for (int ly = 0; ly < VOLUME_BRICK_STRIDE; ly++) {
+			int y = by * VOLUME_BRICK + ly < res[1] - 1 ? by * VOLUME_BRICK + ly : res[1] - 1;
+			const float *row = density + ((size_t)x * res[1] + y) * res[2];
+			uint8 *dst = texels + (lx * VOLUME_BRICK_STRIDE + ly) * VOLUME_BRICK_STRIDE;
+			for (int lz = 0; lz < VOLUME_BRICK_STRIDE; lz++) {
+				int z = bz * VOLUME_BRICK + lz < res[2] - 1 ? bz * VOLUME_BRICK + lz : res[2] - 1;
+				dst[lz] = QuantizeDensity(row[z], invScale);
+				peak = dst[lz] > peak ? dst[lz] : peak;
+			}
+		}
+	}
+	return peak;
+}
+
+int Volume_BuildBricks(Volume *vol, const float *density, int xRes, int yRes, int zRes) {
+	if (!vol || !density || xRes < 2 || yRes < 2 || zRes < 2) return 0;
+	int res[3] = {xRes, yRes, zRes};
+	size_t voxelCount = (size_t)xRes * yRes * zRes;
+	float peak = 0.0f;
+	for (size_t i = 0; i < voxelCount; i++)
+		peak = density[i] > peak ? density[i] : peak;
+	vol->densityScale = peak > 0.0f ? peak : 1.0f;
+	float invScale = 1.0f / vol->densityScale;
+
+	for (int a = 0; a < 3; a++) {
+		vol->brickDims[a] = (res[a] - 1 + VOLUME_BRICK - 1) / VOLUME_BRICK;
+		vol->superDims[a] = (vol->brickDims[a] + VOLUME_SUPER - 1) / VOLUME_SUPER;
+	}
+	int *bd = vol->brickDims, *sd = vol->superDims;
+	size_t brickCount = (size_t)bd[0] * bd[1] * bd[2];
+	vol->brickSlot = (int *)malloc(brickCount * sizeof(int));
+	vol->brickMax = (uint8 *)malloc(brickCount);
+	vol->superMax = (uint8 *)calloc((size_t)sd[0] * sd[1] * sd[2], 1);
+	if (!vol->brickSlot || !vol->brickMax || !vol->superMax) {
+		Volume_Destroy(vol);
+		return 0;
+	}
+
+	// first pass finds the occupied bricks, the second stores them
+	uint8 texels[VOLUME_BRICK_TEXELS];
+	int occupied = 0;
+	for (int bx = 0; bx < bd[0]; bx++)
+		for (int by = 0; by < bd[1]; by++)
+			for (int bz = 0; bz < bd[2]; bz++) {
+				size_t b = ((size_t)bx * bd[1] + by) * bd[2] + bz;
+				uint8 m = GatherBrick(density, res, invScale, bx, by, bz, texels);
+				vol->brickMax[b] = m;
+				vol->brickSlot[b] = m ? occupied++ : -1;
+				uint8 *super = &vol->superMax[((size_t)(bx / VOLUME_SUPER) * sd[1] + by / VOLUME_SUPER) * sd[2] + bz / VOLUME_SUPER];
+				*super = m > *super ? m : *super;
+			}
+	vol->occupiedBricks = occupied;
+	vol->brickData = (uint8 *)malloc((size_t)(occupied ? occupied : 1) * VOLUME_BRICK_TEXELS);
+	if (!vol->brickData) {
+		Volume_Destroy(vol);
+		return 0;
+	}
+	for (size_t b = 0; b < brickCount; b++) {
+		if (vol->brickSlot[b] < 0) continue;
+		int bz = (int)(b % bd[2]), by = (int)(b / bd[2] % bd[1]), bx = (int)(b / ((size_t)bd[2] * bd[1]));
+		GatherBrick(density, res, invScale, bx, by, bz, vol->brickData + (size_t)vol->brickSlot[b] * VOLUME_BRICK_TEXELS);
+	}
+	vol->xResolution = xRes;
+	vol->yResolution = yRes;
+	vol->zResolution = zRes;
+	return 1;
+}
+
+void Volume_Destroy(Volume *vol) {
+	if (!vol) return;
+	free(vol->density);
+	free(vol->brickSlot);
+	free(vol->brickMax);
+	free(vol->superMax);
+	free(vol->brickData);
+	vol->density = NULL;
+	vol->brickSlot = NULL;
+	vol->brickMax = NULL;
+	vol->superMax = NULL;
+	vol->brickData = NULL;
+	vol->occupiedBricks = 0;
+}
+
+float Volume_SampleDensity(const Volume *vol, float3 uvw) {
+	const int res[3] = {(int)vol->xResolution, (int)vol->yResolution, (int)vol->zResolution};
+	const float p[3] = {uvw.x, uvw.y, uvw.z};
+	float f[3];
+	int cell[3], b[3], l[3];
+	for (int a = 0; a < 3; a++) {
+		f[a] = p[a] * (float)(res[a] - 1);
+		cell[a] = (int)f[a];
+		cell[a] = cell[a] < 0 ? 0 : cell[a] > res[a] - 2 ? res[a] - 2 : cell[a];
+		b[a] = cell[a] / VOLUME_BRICK;
+		l[a] = cell[a] - b[a] * VOLUME_BRICK;
+	}
+	int slot = vol->brickSlot[(b[0] * vol->brickDims[1] + b[1]) * vol->brickDims[2] + b[2]];
+	if (slot < 0) return 0.0f;
+
+	const int xs = VOLUME_BRICK_STRIDE * VOLUME_BRICK_STRIDE, ys = VOLUME_BRICK_STRIDE;
+	const uint8 *t = vol->brickData + (size_t)slot * VOLUME_BRICK_TEXELS + l[0] * xs + l[1] * ys + l[2];
+	float u = f[0] - cell[0], v = f[1] - cell[1], w = f[2] - cell[2];
+	float c00 = t[0] + (t[xs] - t[0]) * u, c10 = t[ys] + (t[xs + ys] - t[ys]) * u;
+	float c01 = t[1] + (t[xs + 1] - t[1]) * u, c11 = t[ys + 1] + (t[xs + ys + 1] - t[ys + 1]) * u;
+	float c0 = c00 + (c10 - c00) * v, c1 = c01 + (c11 - c01) * v;
+	return (c0 + (c1 - c0) * w) * vol->densityScale * (1.0f / 255.0f);
+}
+
 void LoadVolume(Volume *vol, const char *filename, float3 position, float3 rotation, float3 scale, VolumeType type) {
 	if (filename == NULL || vol == NULL) {
 		fprintf(stderr, "Error: Invalid filename or object pointer.\n");
 		return;
 	}
+	memset(vol, 0, sizeof(Volume));
 	FILE *file = fopen(filename, "rb");
 	if (file == NULL) {
 		fprintf(stderr, "Error: Could not open file %s\n", filename);
 		return;
 	}
 
-	int widthResolution, heightResolution, depthResolution;
-	fread(&widthResolution, sizeof(int), 1, file);
-	fread(&heightResolution, sizeof(int), 1, file);
-	fread(&depthResolution, sizeof(int), 1, file);
-	int voxelCount = widthResolution * heightResolution * depthResolution;
-
-	vol->density = malloc(voxelCount * sizeof(float));
-	if (vol->density == NULL) {
+	int res[3];
+	if (fread(res, sizeof(int), 3, file) != 3 || res[0] < 2 || res[1] < 2 || res[2] < 2) {
+		fprintf(stderr, "Error: Invalid volume header in %s\n", filename);
+		fclose(file);
+		return;
+	}
+	size_t voxelCount = (size_t)res[0] * res[1] * res[2];
+	float *density = malloc(voxelCount * sizeof(float));
+	if (density == NULL) {
 		fprintf(stderr, "Error: Could not allocate memory for volume density.\n");
 		fclose(file);
 		return;
 	}
-	fread(vol->density, sizeof(float), voxelCount, file);
+	size_t read = fread(density, sizeof(float), voxelCount, file);
 	fclose(file);
+	int ok = read == voxelCount && Volume_BuildBricks(vol, density, res[0], res[1], res[2]);
+	free(density);
+	if (!ok) {
+		fprintf(stderr, "Error: Could not brick volume %s\n", filename);
+		return;
+	}
 
-	vol->xResolution = widthResolution;
-	vol->yResolution = heightResolution;
-	vol->zResolution = depthResolution;
 	vol->BBmin = (float3){-0.5f, -0.5f, -0.5f, 0.0f};
 	vol->BBmax = (float3){0.5f, 0.5f, 0.5f, 0.0f};
 	vol->position = position;
@@ -964,27 +1136,46 @@ void LoadVolume(Volume *vol, const char *filename, float3 position, float3 rotat
 	vol->type = type;
 }
 
+#ifndef HEADLESS
 void UploadVolumeToGpu(Volume *vol, CL_Context *ctx) {
-	if (vol == NULL || ctx == NULL || vol->density == NULL) {
+	if (vol == NULL || ctx == NULL || vol->brickSlot == NULL) {
 		fprintf(stderr, "Error: Invalid volume or OpenCL context.\n");
 		return;
 	}
 
-	float *temp = malloc(sizeof(float) * (size_t)(vol->xResolution * vol->yResolution * vol->zResolution + 3));
+	// byte offsets of each section; the kernel reads them from the header
+	size_t brickCount = (size_t)vol->brickDims[0] * vol->brickDims[1] * vol->brickDims[2];
+	size_t superCount = (size_t)vol->superDims[0] * vol->superDims[1] * vol->superDims[2];
+	size_t slotOffset = VOLUME_HEADER_WORDS * sizeof(uint32);
+	size_t maxOffset = slotOffset + brickCount * sizeof(int);
+	size_t superOffset = maxOffset + brickCount;
+	size_t dataOffset = (superOffset + superCount + 3) & ~(size_t)3;
+	size_t size = (dataOffset + (size_t)vol->occupiedBricks * VOLUME_BRICK_TEXELS + 3) & ~(size_t)3;
+
+	uint8 *temp = calloc(size, 1);
 	if (temp == NULL) {
 		fprintf(stderr, "Error: Could not allocate temporary buffer for volume upload.\n");
 		return;
 	}
-	temp[0] = (float)vol->xResolution;
-	temp[1] = (float)vol->yResolution;
-	temp[2] = (float)vol->zResolution;
-	memcpy(temp + 3, vol->density, sizeof(float) * (size_t)(vol->xResolution * vol->yResolution * vol->zResolution));
-
-	CL_Buffer buf = CL_Buffer_CreateFromData(
-		ctx,
-		sizeof(float) * (size_t)(vol->xResolution * vol->yResolution * vol->zResolution + 3), // +3 for storing dimensions in the buffer
-		temp,
-		CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR);
-	vol->gpuDensity = buf;
+	uint32 *header = (uint32 *)temp;
+	header[0] = (uint32)vol->xResolution;
+	header[1] = (uint32)vol->yResolution;
+	header[2] = (uint32)vol->zResolution;
+	for (int a = 0; a < 3; a++) {
+		header[3 + a] = (uint32)vol->brickDims[a];
+		header[6 + a] = (uint32)vol->superDims[a];
+	}
+	memcpy(&header[9], &vol->densityScale, sizeof(float));
+	header[10] = (uint32)slotOffset;
+	header[11] = (uint32)maxOffset;
+	header[12] = (uint32)superOffset;
+	header[13] = (uint32)dataOffset;
+	memcpy(temp + slotOffset, vol->brickSlot, brickCount * sizeof(int));
+	memcpy(temp + maxOffset, vol->brickMax, brickCount);
+	memcpy(temp + superOffset, vol->superMax, superCount);
+	memcpy(temp + dataOffset, vol->brickData, (size_t)vol->occupiedBricks * VOLUME_BRICK_TEXELS);
+
+	vol->gpuDensity = CL_Buffer_CreateFromData(ctx, size, temp, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR);
 	free(temp);
-}
\ No newline at end of file
+}
+#endif
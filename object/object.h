@@ -7,10 +7,16 @@
 
 #define EMISSION_RESOLUTION 32
 
+// brick layout (VOLUME_BRICK, VOLUME_SUPER, ...) is shared with render.cl
+#include "../render/gpu/kernels/cloadrendering/cloudShared.h"
+#define VOLUME_HEADER_WORDS 16 // uint32 header of the GPU buffer, see UploadVolumeToGpu
+
 #include "format.h"
 #include "../load/loadObj.h"
 #include "material/material.h"
+#ifndef HEADLESS
 #include "../render/gpu/format.h"
+#endif
 
 typedef struct {
     float tMin[4];
@@ -46,10 +52,22 @@ typedef struct Volume {
 	float yResolution;
 	float zResolution;
 
-	float *density; // for clouds: density[x + y*xRes + z*xRes*yRes]
+	float *density; // dense grid, NULL once bricked: density[(x*yRes + y)*zRes + z]
+
+	// bricked copy; every per-brick array is indexed (bx*brickDims[1] + by)*brickDims[2] + bz
+	int brickDims[3]; // bricks per axis, covering the res - 1 cells
+	int superDims[3]; // super-bricks per axis
+	int occupiedBricks;
+	float densityScale; // density of texel value 255
+	int *brickSlot;		// brick -> index into brickData, -1 when empty
+	uint8 *brickMax;	// brick -> largest texel, 0 when empty
+	uint8 *superMax;	// super-brick -> largest texel of its bricks
+	uint8 *brickData;	// occupiedBricks x VOLUME_BRICK_TEXELS, z fastest
 
+#ifndef HEADLESS
 	// GPU
-	CL_Buffer gpuDensity; // for clouds: density[x + y*xRes + z*xRes*yRes]
+	CL_Buffer gpuDensity; // header, brickSlot, brickMax, superMax and brickData in one buffer
+#endif
 } Volume;
 
 typedef struct BVHNode {
@@ -114,10 +132,12 @@ typedef struct Object {
 	UvCords *uvs;
 
 	int *materialIds;
+	uint8 *materialFlags; // per-triangle MATERIAL_* flags, mirrors materialIds
 	int triangleCount;
 
 	bool hasTexture;
 	bool hasEmission; // quick check to skip emission sampling when no faces emit
+	float emissionPeak; // brightest channel across the face maps — bounds the emitter's reach
 	EmissionMap frontFaceEmission;
 	EmissionMap backFaceEmission;
 	EmissionMap leftFaceEmission;
@@ -128,8 +148,17 @@ typedef struct Object {
 	BVH bvh;
 } Object;
 
+// Reads a dense float grid and keeps only its bricked, quantized form.
 void LoadVolume(Volume *vol, const char *filename, float3 position, float3 rotation, float3 scale, VolumeType type);
+// Bricks a dense grid (x slowest, z fastest) into vol; density is not kept. Returns 0 on failure.
+int Volume_BuildBricks(Volume *vol, const float *density, int xRes, int yRes, int zRes);
+// Frees the host-side grids; the GPU buffer lives with its OpenCL context.
+void Volume_Destroy(Volume *vol);
+// Trilinear density at uvw in [0,1]^3 from the bricks, as the cloud kernel samples it.
+float Volume_SampleDensity(const Volume *vol, float3 uvw);
+#ifndef HEADLESS
 void UploadVolumeToGpu(Volume *vol, CL_Context *ctx);
+#endif
 
 // calculate per-face emission maps with orthographic projection
 void CalculateFaceEmissions(Object *obj, MaterialLib *lib);
@@ -146,12 +175,16 @@ bool IntersectAnyBBox(const Object *objects, int objectCount, float3 rayOrigin,
 Color IntersectBBoxColor(const Object *objects, int objectCount, float3 rayOrigin, float3 rayDir);
 bool ObjectBehindCamera(const Object *obj, float3 camPos, float3 camForward);
 
-// Set material properties on every triangle of an object (updates the shared MaterialLib entries).
+// Set material properties on every triangle of an object. The object is moved to edited
+// copies of its materials (interned with MaterialLib_FindOrAdd), so other objects sharing an
+// entry keep theirs; materialFlags and the emission data of obj are rebuilt.
 void Object_SetMaterial(Object *obj, MaterialLib *lib, Material mat);
 void Object_SetColor(Object *obj, MaterialLib *lib, float3 color);
 void Object_SetEmission(Object *obj, MaterialLib *lib, float emission);
 void Object_SetRoughness(Object *obj, MaterialLib *lib, float roughness);
 void Object_SetMetallic(Object *obj, MaterialLib *lib, float metallic);
+// Recomputes materialFlags from the current lib entries; allocates the array on first call.
+void Object_BuildMaterialFlags(Object *obj, const MaterialLib *lib);
 
 void CreateObjectBVH(Object *obj, BVH *bvh);
 void DestroyObjectBVH(BVH *bvh);
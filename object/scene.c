@@ -107,6 +107,7 @@ void ObjectList_Merge(ObjectList *src, ObjectList *dst) {
 	out->v3 = malloc(totalTris * sizeof(float3));
 	out->normals = malloc(totalTris * sizeof(float3));
 	out->materialIds = malloc(totalTris * sizeof(int));
+	out->materialFlags = malloc(totalTris * sizeof(uint8));
 	out->triangleCount = totalTris;
 
 	float3 bbMin = {FLT_MAX, FLT_MAX, FLT_MAX};
@@ -125,6 +126,7 @@ void ObjectList_Merge(ObjectList *src, ObjectList *dst) {
 			out->v3[t] = c;
 			out->normals[t] = RotateXYZ(obj->normals[j], obj->rotation);
 			out->materialIds[t] = obj->materialIds ? obj->materialIds[j] : -1;
+			out->materialFlags[t] = obj->materialFlags ? obj->materialFlags[j] : 0;
 
 			// expand merged AABB
 			float3 pts[3] = {a, b, c};
@@ -67,11 +67,7 @@ int main(void) {
 	double elapsed = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9;
 	printf("Average time: %.3f ms, %.3f fps\n", elapsed * 1000.0 / iterations, iterations / elapsed);
 
-	for (int i = 0; i < 256; i++) {
-		if (alphabet.letters[i].tile.pixels) {
-			free((void *)alphabet.letters[i].tile.pixels);
-		}
-	}
+	DestroyAlphabet(&alphabet);
 	free(fb);
 	return 0;
 }
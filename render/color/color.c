@@ -24,8 +24,9 @@ void VisualizeBuffer(const Camera *camera, int mode) {
 	const int n = camera->screenWidth * camera->screenHeight;
 
 	if (mode == 1) { // VIEW_NORMALS
+		if (!camera->normalBuffer) return;
 		for (int i = 0; i < n; i++) {
-			float3 nm = camera->normalBuffer[i];
+			float3 nm = UnpackNormal(camera->normalBuffer[i]);
 			camera->framebuffer[i] = PackColorSafe(
 				nm.x * 0.5f + 0.5f,
 				nm.y * 0.5f + 0.5f,
@@ -35,8 +36,9 @@ void VisualizeBuffer(const Camera *camera, int mode) {
 	}
 
 	if (mode == 3) { // VIEW_REFLECT
+		if (!camera->reflectBuffer) return;
 		for (int i = 0; i < n; i++) {
-			float3 r = camera->reflectBuffer[i];
+			float3 r = UnpackHalf4(camera->reflectBuffer[i]);
 			camera->framebuffer[i] = PackColorSafe(
 				r.x * 0.5f + 0.5f,
 				r.y * 0.5f + 0.5f,
@@ -333,3 +335,27 @@ Color DarkenColor(Color c, float amount) {
 	col.z *= factor;
 	return PackColorF(col);
 }
+
+void PackHdr(const half4 *src, Color *dst, int count) {
+	const __m256 scale = _mm256_set1_ps(255.0f), half = _mm256_set1_ps(0.5f);
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+	int i = 0;
+	for (; i + 2 <= count; i += 2) {
+		__m256 c = _mm256_max_ps(_mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)&src[i])), _mm256_setzero_ps());
+		// overflow of the brightest channel goes to the other two, as in the CPU shading path
+		__m256 m = _mm256_max_ps(_mm256_max_ps(c, _mm256_permute_ps(c, _MM_SHUFFLE(3, 0, 2, 1))), _mm256_permute_ps(c, _MM_SHUFFLE(3, 1, 0, 2)));
+		__m256 e = _mm256_max_ps(_mm256_sub_ps(_mm256_permute_ps(m, 0), _mm256_set1_ps(1.0f)), _mm256_setzero_ps());
+		c = _mm256_min_ps(_mm256_add_ps(c, e), _mm256_set1_ps(1.0f));
+		__m256i v = _mm256_cvttps_epi32(_mm256_fmadd_ps(c, scale, half));
+		v = _mm256_shuffle_epi32(v, _MM_SHUFFLE(3, 0, 1, 2)); // rgba -> bgra, the byte order of Color
+		v = _mm256_packus_epi16(_mm256_packus_epi32(v, v), v);
+		v = _mm256_or_si256(v, alpha);
+		dst[i] = (Color)_mm_cvtsi128_si32(_mm256_castsi256_si128(v));
+		dst[i + 1] = (Color)_mm_cvtsi128_si32(_mm256_extracti128_si256(v, 1));
+	}
+	for (; i < count; i++) {
+		float3 c = UnpackHalf4(src[i]);
+		float e = fmaxf(fmaxf(c.x, fmaxf(c.y, c.z)) - 1.0f, 0.0f) + 0.5f / 255.0f;
+		dst[i] = PackColorSafe(c.x + e, c.y + e, c.z + e);
+	}
+}
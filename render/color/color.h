@@ -2,6 +2,7 @@
 #define COLOR_H
 
 #include "../../object/format.h"
+#include <immintrin.h>
 #include <math.h>
 
 Color PackColor(float r, float g, float b);
@@ -35,5 +36,52 @@ Color HueShiftColor(Color c, float shift);
 Color ApplyColorCorrection(Color c, float gamma, float exposure, float contrast, float saturation, float hueShift, float3 modulate);
 Color ScaleChannel(Color c, float rScale, float gScale, float bScale);
 void VisualizeBuffer(const Camera *camera, int mode);
+// Packs linear half-float colour without tone mapping: overflow spreads to the other
+// channels (towards white), then clamps to [0, 1].
+void PackHdr(const half4 *src, Color *dst, int count);
+
+static inline half4 PackHalf4W(float x, float y, float z, float w) {
+	half4 h;
+	_mm_storel_epi64((__m128i *)&h, _mm_cvtps_ph(_mm_setr_ps(x, y, z, w), _MM_FROUND_TO_NEAREST_INT));
+	return h;
+}
+
+static inline half4 PackHalf4(float r, float g, float b) {
+	return PackHalf4W(r, g, b, 0.0f);
+}
+
+static inline float3 UnpackHalf4(half4 h) {
+	float3 c;
+	_mm_storeu_ps(&c.x, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)&h)));
+	return c;
+}
+
+// Unit normal as two snorm16 octahedral coordinates (u in the low half), 32 bits instead
+// of a padded float3; the round trip error is below 1e-4 rad.
+static inline uint32 PackNormal(float3 n) {
+	float sum = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (sum < 1e-20f) return 0;
+	float u = n.x / sum, v = n.y / sum;
+	if (n.z < 0.0f) {
+		float fu = (1.0f - fabsf(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+		float fv = (1.0f - fabsf(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+		u = fu;
+		v = fv;
+	}
+	int16 iu = (int16)(u * 32767.0f + (u >= 0.0f ? 0.5f : -0.5f));
+	int16 iv = (int16)(v * 32767.0f + (v >= 0.0f ? 0.5f : -0.5f));
+	return (uint32)(uint16)iu | (uint32)(uint16)iv << 16;
+}
+
+static inline float3 UnpackNormal(uint32 p) {
+	float u = (int16)(p & 0xFFFF) * (1.0f / 32767.0f);
+	float v = (int16)(p >> 16) * (1.0f / 32767.0f);
+	float z = 1.0f - fabsf(u) - fabsf(v);
+	float t = fmaxf(-z, 0.0f);
+	u += u >= 0.0f ? -t : t;
+	v += v >= 0.0f ? -t : t;
+	float inv = 1.0f / sqrtf(u * u + v * v + z * z);
+	return (float3){u * inv, v * inv, z * inv, 0.0f};
+}
 
 #endif // COLOR_H
\ No newline at end of file
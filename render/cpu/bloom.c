@@ -0,0 +1,240 @@
+#include "bloom.h"
+#include <immintrin.h>
+#include <stdlib.h>
+#include <string.h>
+
+void Bloom_Init(BloomPyramid *bloom, int width, int height) {
+	if (!bloom) return;
+	memset(bloom, 0, sizeof(BloomPyramid));
+	bloom->width = width;
+	bloom->height = height;
+	bloom->levelWidth[0] = width;
+	bloom->levelHeight[0] = height;
+	size_t offset = 0;
+	for (int l = 1; l <= BLOOM_LEVELS; l++) {
+		int w = bloom->levelWidth[l - 1] / 2, h = bloom->levelHeight[l - 1] / 2;
+		if (w < 2 || h < 2) break;
+		bloom->levelWidth[l] = w;
+		bloom->levelHeight[l] = h;
+		bloom->levelOffset[l] = offset;
+		offset += (size_t)w * h;
+		bloom->levelCount = l;
+	}
+	bloom->tasks = (BloomTask *)malloc(sizeof(BloomTask) * ((height + BLOOM_ROWS_PER_TASK - 1) / BLOOM_ROWS_PER_TASK));
+	if (!bloom->tasks) bloom->levelCount = 0;
+}
+
+void Bloom_Destroy(BloomPyramid *bloom) {
+	if (!bloom) return;
+	free(bloom->tasks);
+	memset(bloom, 0, sizeof(BloomPyramid));
+}
+
+// Bilinear tap at continuous texel coordinates, edges clamped.
+static inline __m128 SampleBilinear(const float3 *level, int w, int h, float fx, float fy) {
+	if (fx < 0.0f) fx = 0.0f;
+	if (fy < 0.0f) fy = 0.0f;
+	int x0 = (int)fx, y0 = (int)fy;
+	if (x0 > w - 1) x0 = w - 1;
+	if (y0 > h - 1) y0 = h - 1;
+	int x1 = x0 + 1 < w ? x0 + 1 : x0;
+	int y1 = y0 + 1 < h ? y0 + 1 : y0;
+	__m128 tx = _mm_set1_ps(fx - x0), ty = _mm_set1_ps(fy - y0);
+	const float *r0 = (const float *)&level[y0 * w], *r1 = (const float *)&level[y1 * w];
+	__m128 a = _mm_load_ps(r0 + 4 * x0), b = _mm_load_ps(r0 + 4 * x1);
+	__m128 c = _mm_load_ps(r1 + 4 * x0), d = _mm_load_ps(r1 + 4 * x1);
+	__m128 top = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), tx));
+	__m128 bottom = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(d, c), tx));
+	return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), ty));
+}
+
+// Soft-knee threshold on the brightest channel, so glow fades in instead of popping.
+static inline __m128 Threshold(__m128 c) {
+	float v[4];
+	_mm_storeu_ps(v, c);
+	float b = v[0] > v[1] ? v[0] : v[1];
+	if (v[2] > b) b = v[2];
+	float soft = b - BLOOM_THRESHOLD + BLOOM_KNEE;
+	soft = soft < 0.0f ? 0.0f : (soft > 2.0f * BLOOM_KNEE ? 2.0f * BLOOM_KNEE : soft);
+	soft = soft * soft / (4.0f * BLOOM_KNEE + 1e-5f);
+	float hard = b - BLOOM_THRESHOLD;
+	float contrib = (soft > hard ? soft : hard) / (b > 1e-4f ? b : 1e-4f);
+	return _mm_mul_ps(c, _mm_set1_ps(contrib));
+}
+
+// 2x2 box from the level above, two destination texels per AVX2 iteration. Level 1 reads
+// bloomBuffer, masks out sky (bloomBuffer is only written on geometry) and thresholds.
+static void DownsampleRows(void *arg) {
+	BloomTask *task = arg;
+	BloomPyramid *bloom = task->bloom;
+	Camera *camera = task->camera;
+	int l = task->level;
+	int w = bloom->levelWidth[l], h = bloom->levelHeight[l];
+	int srcW = bloom->levelWidth[l - 1];
+	const float3 *src = l == 1 ? camera->bloomBuffer : camera->bloomDst + bloom->levelOffset[l - 1];
+	float3 *dst = camera->bloomDst + bloom->levelOffset[l];
+	const __m128 quarter = _mm_set1_ps(0.25f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (int y = task->row; y < task->row + task->rowCount && y < h; y++) {
+		const float *r0 = (const float *)&src[(2 * y) * srcW];
+		const float *r1 = (const float *)&src[(2 * y + 1) * srcW];
+		float *out = (float *)&dst[y * w];
+		if (l == 1) {
+			const int *id0 = &camera->objectIdBuffer[(2 * y) * srcW];
+			const int *id1 = &camera->objectIdBuffer[(2 * y + 1) * srcW];
+			for (int x = 0; x < w; x++) {
+				__m128 a = id0[2 * x] >= 0 ? _mm_load_ps(r0 + 8 * x) : zero;
+				__m128 b = id0[2 * x + 1] >= 0 ? _mm_load_ps(r0 + 8 * x + 4) : zero;
+				__m128 c = id1[2 * x] >= 0 ? _mm_load_ps(r1 + 8 * x) : zero;
+				__m128 d = id1[2 * x + 1] >= 0 ? _mm_load_ps(r1 + 8 * x + 4) : zero;
+				__m128 sum = _mm_mul_ps(_mm_add_ps(_mm_add_ps(a, b), _mm_add_ps(c, d)), quarter);
+				_mm_store_ps(out + 4 * x, Threshold(sum));
+			}
+			continue;
+		}
+		int x = 0;
+		for (; x + 2 <= w; x += 2) {
+			// texels 2x .. 2x+3 of both rows: two 256-bit loads per row
+			__m256 a0 = _mm256_loadu_ps(r0 + 8 * x), a1 = _mm256_loadu_ps(r0 + 8 * x + 8);
+			__m256 b0 = _mm256_loadu_ps(r1 + 8 * x), b1 = _mm256_loadu_ps(r1 + 8 * x + 8);
+			__m256 s0 = _mm256_add_ps(a0, b0), s1 = _mm256_add_ps(a1, b1);
+			// pair up horizontal neighbours: (s0.lo + s0.hi), (s1.lo + s1.hi)
+			__m256 lo = _mm256_permute2f128_ps(s0, s1, 0x20);
+			__m256 hi = _mm256_permute2f128_ps(s0, s1, 0x31);
+			_mm256_storeu_ps(out + 4 * x, _mm256_mul_ps(_mm256_add_ps(lo, hi), _mm256_set1_ps(0.25f)));
+		}
+		for (; x < w; x++) {
+			__m128 sum = _mm_add_ps(_mm_add_ps(_mm_load_ps(r0 + 8 * x), _mm_load_ps(r0 + 8 * x + 4)),
+									_mm_add_ps(_mm_load_ps(r1 + 8 * x), _mm_load_ps(r1 + 8 * x + 4)));
+			_mm_store_ps(out + 4 * x, _mm_mul_ps(sum, quarter));
+		}
+	}
+}
+
+// Horizontal half of the 1-4-6-4-1 blur: level -> bloomTemp.
+static void BlurRowsH(void *arg) {
+	BloomTask *task = arg;
+	BloomPyramid *bloom = task->bloom;
+	Camera *camera = task->camera;
+	int l = task->level;
+	int w = bloom->levelWidth[l], h = bloom->levelHeight[l];
+	const float3 *src = camera->bloomDst + bloom->levelOffset[l];
+	float3 *dst = camera->bloomTemp + bloom->levelOffset[l];
+	const __m128 k4 = _mm_set1_ps(4.0f), k6 = _mm_set1_ps(6.0f), norm = _mm_set1_ps(1.0f / 16.0f);
+
+	for (int y = task->row; y < task->row + task->rowCount && y < h; y++) {
+		const float *in = (const float *)&src[y * w];
+		float *out = (float *)&dst[y * w];
+		for (int x = 0; x < w; x++) {
+			int xm2 = x - 2 < 0 ? 0 : x - 2, xm1 = x - 1 < 0 ? 0 : x - 1;
+			int xp1 = x + 1 < w ? x + 1 : w - 1, xp2 = x + 2 < w ? x + 2 : w - 1;
+			__m128 outer = _mm_add_ps(_mm_load_ps(in + 4 * xm2), _mm_load_ps(in + 4 * xp2));
+			__m128 inner = _mm_add_ps(_mm_load_ps(in + 4 * xm1), _mm_load_ps(in + 4 * xp1));
+			__m128 sum = _mm_add_ps(outer, _mm_add_ps(_mm_mul_ps(inner, k4), _mm_mul_ps(_mm_load_ps(in + 4 * x), k6)));
+			_mm_store_ps(out + 4 * x, _mm_mul_ps(sum, norm));
+		}
+	}
+}
+
+// Vertical half: bloomTemp -> level, two texels per AVX2 iteration.
+static void BlurRowsV(void *arg) {
+	BloomTask *task = arg;
+	BloomPyramid *bloom = task->bloom;
+	Camera *camera = task->camera;
+	int l = task->level;
+	int w = bloom->levelWidth[l], h = bloom->levelHeight[l];
+	const float3 *src = camera->bloomTemp + bloom->levelOffset[l];
+	float3 *dst = camera->bloomDst + bloom->levelOffset[l];
+	const __m256 k4 = _mm256_set1_ps(4.0f), k6 = _mm256_set1_ps(6.0f), norm = _mm256_set1_ps(1.0f / 16.0f);
+
+	for (int y = task->row; y < task->row + task->rowCount && y < h; y++) {
+		const float *ym2 = (const float *)&src[(y - 2 < 0 ? 0 : y - 2) * w];
+		const float *ym1 = (const float *)&src[(y - 1 < 0 ? 0 : y - 1) * w];
+		const float *y0 = (const float *)&src[y * w];
+		const float *yp1 = (const float *)&src[(y + 1 < h ? y + 1 : h - 1) * w];
+		const float *yp2 = (const float *)&src[(y + 2 < h ? y + 2 : h - 1) * w];
+		float *out = (float *)&dst[y * w];
+		int i = 0, n = 4 * w;
+		for (; i + 8 <= n; i += 8) {
+			__m256 outer = _mm256_add_ps(_mm256_loadu_ps(ym2 + i), _mm256_loadu_ps(yp2 + i));
+			__m256 inner = _mm256_add_ps(_mm256_loadu_ps(ym1 + i), _mm256_loadu_ps(yp1 + i));
+			__m256 sum = _mm256_add_ps(outer, _mm256_add_ps(_mm256_mul_ps(inner, k4), _mm256_mul_ps(_mm256_loadu_ps(y0 + i), k6)));
+			_mm256_storeu_ps(out + i, _mm256_mul_ps(sum, norm));
+		}
+		for (; i < n; i += 4) {
+			__m128 outer = _mm_add_ps(_mm_load_ps(ym2 + i), _mm_load_ps(yp2 + i));
+			__m128 inner = _mm_add_ps(_mm_load_ps(ym1 + i), _mm_load_ps(yp1 + i));
+			__m128 sum = _mm_add_ps(outer, _mm_add_ps(_mm_mul_ps(inner, _mm_set1_ps(4.0f)), _mm_mul_ps(_mm_load_ps(y0 + i), _mm_set1_ps(6.0f))));
+			_mm_store_ps(out + i, _mm_mul_ps(sum, _mm_set1_ps(1.0f / 16.0f)));
+		}
+	}
+}
+
+// level += bilinear(level + 1)
+static void UpsampleRows(void *arg) {
+	BloomTask *task = arg;
+	BloomPyramid *bloom = task->bloom;
+	Camera *camera = task->camera;
+	int l = task->level;
+	int w = bloom->levelWidth[l], h = bloom->levelHeight[l];
+	int lw = bloom->levelWidth[l + 1], lh = bloom->levelHeight[l + 1];
+	const float3 *low = camera->bloomDst + bloom->levelOffset[l + 1];
+	float3 *dst = camera->bloomDst + bloom->levelOffset[l];
+
+	for (int y = task->row; y < task->row + task->rowCount && y < h; y++) {
+		float fy = (y + 0.5f) * 0.5f - 0.5f;
+		float *out = (float *)&dst[y * w];
+		for (int x = 0; x < w; x++) {
+			__m128 up = SampleBilinear(low, lw, lh, (x + 0.5f) * 0.5f - 0.5f, fy);
+			_mm_store_ps(out + 4 * x, _mm_add_ps(_mm_load_ps(out + 4 * x), up));
+		}
+	}
+}
+
+// hdrBuffer += intensity * bilinear(level 1), left unclamped for the tone map.
+static void CompositeRows(void *arg) {
+	BloomTask *task = arg;
+	BloomPyramid *bloom = task->bloom;
+	Camera *camera = task->camera;
+	int W = camera->screenWidth, H = camera->screenHeight;
+	int lw = bloom->levelWidth[1], lh = bloom->levelHeight[1];
+	const float3 *level = camera->bloomDst + bloom->levelOffset[1];
+	// every level contributes its own copy of the energy, so scale by the level count
+	const float s = BLOOM_INTENSITY / (float)bloom->levelCount;
+	const __m128 scale = _mm_setr_ps(s, s, s, 0.0f);
+
+	for (int y = task->row; y < task->row + task->rowCount && y < H; y++) {
+		float fy = (y + 0.5f) * 0.5f - 0.5f;
+		half4 *row = &camera->hdrBuffer[y * W];
+		for (int x = 0; x < W; x++) {
+			__m128 glow = SampleBilinear(level, lw, lh, (x + 0.5f) * 0.5f - 0.5f, fy);
+			__m128 base = _mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)&row[x]));
+			_mm_storel_epi64((__m128i *)&row[x], _mm_cvtps_ph(_mm_fmadd_ps(glow, scale, base), _MM_FROUND_TO_NEAREST_INT));
+		}
+	}
+}
+
+static void RunRows(BloomPyramid *bloom, Camera *camera, ThreadPool *threadPool, task_fn fn, int rows, int level) {
+	int taskCount = (rows + BLOOM_ROWS_PER_TASK - 1) / BLOOM_ROWS_PER_TASK;
+	for (int t = 0; t < taskCount; t++) {
+		bloom->tasks[t] = (BloomTask){t * BLOOM_ROWS_PER_TASK, BLOOM_ROWS_PER_TASK, level, bloom, camera};
+		poolAdd(threadPool, fn, &bloom->tasks[t]);
+	}
+	poolWait(threadPool);
+}
+
+void BloomPostProcess(BloomPyramid *bloom, Camera *camera, ThreadPool *threadPool) {
+	if (!bloom || !bloom->levelCount || !camera || !threadPool) return;
+	if (camera->screenWidth != bloom->width || camera->screenHeight != bloom->height) return;
+	if (!Camera_Require(camera, CAMERA_HDR | CAMERA_OBJECT_ID | CAMERA_BLOOM | CAMERA_BLOOM_TEMP | CAMERA_BLOOM_DST)) return;
+
+	for (int l = 1; l <= bloom->levelCount; l++) {
+		RunRows(bloom, camera, threadPool, DownsampleRows, bloom->levelHeight[l], l);
+		RunRows(bloom, camera, threadPool, BlurRowsH, bloom->levelHeight[l], l);
+		RunRows(bloom, camera, threadPool, BlurRowsV, bloom->levelHeight[l], l);
+	}
+	for (int l = bloom->levelCount - 1; l >= 1; l--)
+		RunRows(bloom, camera, threadPool, UpsampleRows, bloom->levelHeight[l], l);
+	RunRows(bloom, camera, threadPool, CompositeRows, bloom->height, 0);
+}
@@ -0,0 +1,41 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include "../../object/format.h"
+#include "../../util/threadPool.h"
+
+// Bloom over camera->bloomBuffer: soft-thresholded 2x2 downsample chain, a separable
+// 5-tap blur per level, additive bilinear upsample back to the top, then added onto
+// hdrBuffer. The pyramid lives in camera->bloomDst, blur scratch in bloomTemp.
+
+#define BLOOM_LEVELS 5			// level 1 is half resolution, each further level halves again
+#define BLOOM_THRESHOLD 0.8f	// brightest channel below this does not glow
+#define BLOOM_KNEE 0.4f			// soft ramp width above the threshold
+#define BLOOM_INTENSITY 0.35f
+#define BLOOM_ROWS_PER_TASK 8
+
+typedef struct BloomPyramid BloomPyramid;
+
+typedef struct {
+	int row;
+	int rowCount;
+	int level;
+	BloomPyramid *bloom;
+	Camera *camera;
+} BloomTask;
+
+struct BloomPyramid {
+	int width, height;
+	int levelCount; // may be below BLOOM_LEVELS for tiny targets
+	int levelWidth[BLOOM_LEVELS + 1];
+	int levelHeight[BLOOM_LEVELS + 1];
+	size_t levelOffset[BLOOM_LEVELS + 1]; // into bloomDst / bloomTemp, level 0 unused
+	BloomTask *tasks;
+};
+
+void Bloom_Init(BloomPyramid *bloom, int width, int height);
+void Bloom_Destroy(BloomPyramid *bloom);
+// Run after the composite has written bloomBuffer; adds the glow to hdrBuffer.
+void BloomPostProcess(BloomPyramid *bloom, Camera *camera, ThreadPool *threadPool);
+
+#endif // BLOOM_H
@@ -0,0 +1,480 @@
+#include "denoise.h"
+#include "../../math/vector3.h"
+#include "../color/color.h"
+#include "ray.h"
+#include <immintrin.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGN64(n) (((n) + 63) & ~(size_t)63)
+
+// plane order inside Denoiser.planes[]
+#define PLANE_EMISSION 0 // x, y, z
+#define PLANE_SHADOW 3
+#define PLANE_REFLECTION 4 // x, y, z
+#define PLANE_VARIANCE 7	 // shadow, emission, reflection
+
+static inline float Luma(float3 c) {
+	return 0.299f * c.x + 0.587f * c.y + 0.114f * c.z;
+}
+
+static inline float3 Lerp3(float3 a, float3 b, float t) {
+	return (float3){a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t};
+}
+
+static inline float3 NormalAt(const Denoiser *dn, size_t n, int idx) {
+	return (float3){dn->normal[idx], dn->normal[n + idx], dn->normal[2 * n + idx]};
+}
+
+static inline void StorePlanes(float *planes, size_t n, int idx, float3 em, float3 refl) {
+	planes[PLANE_EMISSION * n + idx] = em.x;
+	planes[(PLANE_EMISSION + 1) * n + idx] = em.y;
+	planes[(PLANE_EMISSION + 2) * n + idx] = em.z;
+	planes[PLANE_SHADOW * n + idx] = em.w;
+	planes[PLANE_REFLECTION * n + idx] = refl.x;
+	planes[(PLANE_REFLECTION + 1) * n + idx] = refl.y;
+	planes[(PLANE_REFLECTION + 2) * n + idx] = refl.z;
+}
+
+// pow(max(dot, 0), 128) by repeated squaring
+static inline float NormalWeight(float3 a, float3 b) {
+	float d = fmaxf(a.x * b.x + a.y * b.y + a.z * b.z, 0.0f);
+	for (int i = 0; i < 7; i++) d *= d;
+	return d;
+}
+
+void Denoiser_Init(Denoiser *denoiser, int width, int height) {
+	if (!denoiser) return;
+	memset(denoiser, 0, sizeof(Denoiser));
+	size_t n = (size_t)width * height;
+	denoiser->width = width;
+	denoiser->height = height;
+	denoiser->emissionHistory = (float3 *)aligned_alloc(64, ALIGN64(n * sizeof(float3)));
+	denoiser->reflectionHistory = (float3 *)aligned_alloc(64, ALIGN64(n * sizeof(float3)));
+	denoiser->moments1 = (float3 *)aligned_alloc(64, ALIGN64(n * sizeof(float3)));
+	denoiser->moments2 = (float3 *)aligned_alloc(64, ALIGN64(n * sizeof(float3)));
+	denoiser->prevDepth = (float *)aligned_alloc(64, ALIGN64(n * sizeof(float)));
+	denoiser->prevNormal = (uint32 *)aligned_alloc(64, ALIGN64(n * sizeof(uint32)));
+	denoiser->prevObjectId = (int *)aligned_alloc(64, ALIGN64(n * sizeof(int)));
+	denoiser->normal = (float *)aligned_alloc(64, ALIGN64(3 * n * sizeof(float)));
+	denoiser->planes[0] = (float *)aligned_alloc(64, ALIGN64(DENOISE_PLANES * n * sizeof(float)));
+	denoiser->planes[1] = (float *)aligned_alloc(64, ALIGN64(DENOISE_PLANES * n * sizeof(float)));
+	denoiser->variance = (float3 *)aligned_alloc(64, ALIGN64(n * sizeof(float3)));
+	denoiser->varianceTemp = (float3 *)aligned_alloc(64, ALIGN64(n * sizeof(float3)));
+	denoiser->tasks = (DenoiseTask *)malloc(sizeof(DenoiseTask) * ((height + DENOISE_ROWS_PER_TASK - 1) / DENOISE_ROWS_PER_TASK));
+	if (!denoiser->emissionHistory || !denoiser->reflectionHistory || !denoiser->moments1 || !denoiser->moments2 ||
+		!denoiser->prevDepth || !denoiser->prevNormal || !denoiser->prevObjectId || !denoiser->normal || !denoiser->planes[0] ||
+		!denoiser->planes[1] || !denoiser->variance || !denoiser->varianceTemp || !denoiser->tasks) {
+		Denoiser_Destroy(denoiser);
+		return;
+	}
+	Denoiser_Reset(denoiser);
+}
+
+void Denoiser_Destroy(Denoiser *denoiser) {
+	if (!denoiser) return;
+	free(denoiser->emissionHistory);
+	free(denoiser->reflectionHistory);
+	free(denoiser->moments1);
+	free(denoiser->moments2);
+	free(denoiser->prevDepth);
+	free(denoiser->prevNormal);
+	free(denoiser->prevObjectId);
+	free(denoiser->normal);
+	free(denoiser->planes[0]);
+	free(denoiser->planes[1]);
+	free(denoiser->variance);
+	free(denoiser->varianceTemp);
+	free(denoiser->tasks);
+	memset(denoiser, 0, sizeof(Denoiser));
+}
+
+void Denoiser_Reset(Denoiser *denoiser) {
+	if (!denoiser) return;
+	denoiser->hasHistory = 0;
+}
+
+static void DecodeNormalRows(void *arg) {
+	DenoiseTask *task = arg;
+	Denoiser *dn = task->denoiser;
+	const uint32 *src = task->camera->normalBuffer;
+	int W = dn->width;
+	size_t n = (size_t)W * dn->height;
+	for (int y = task->row; y < task->row + task->rowCount && y < dn->height; y++) {
+		for (int i = y * W; i < (y + 1) * W; i++) {
+			float3 v = UnpackNormal(src[i]);
+			dn->normal[i] = v.x;
+			dn->normal[n + i] = v.y;
+			dn->normal[2 * n + i] = v.z;
+		}
+	}
+}
+
+// Reproject last frame's history through the motion vectors (bilinear, taps rejected on
+// object / depth / normal mismatch) and blend in this frame's samples. Integrated color
+// goes back into the camera signals and into planes[0] for the a-trous passes; new moments
+// go to variance / varianceTemp, which Denoiser_Run swaps into moments1 / moments2 once every
+// row is done.
+static void TemporalRows(void *arg) {
+	DenoiseTask *task = arg;
+	Denoiser *dn = task->denoiser;
+	Camera *camera = task->camera;
+	int W = dn->width, H = dn->height;
+	size_t planeSize = (size_t)W * H;
+	int lowWidth = (W + SECONDARY_RESOLUTION - 1) / SECONDARY_RESOLUTION;
+
+	for (int y = task->row; y < task->row + task->rowCount && y < H; y++) {
+		for (int x = 0; x < W; x++) {
+			int idx = y * W + x;
+			int id = camera->objectIdBuffer[idx];
+			if (id < 0) {
+				dn->variance[idx] = (float3){0.0f, 0.0f, 0.0f, 0.0f};
+				dn->varianceTemp[idx] = (float3){0.0f, 0.0f, 0.0f, 0.0f};
+				StorePlanes(dn->planes[0], planeSize, idx, camera->emissionSignal[idx], camera->reflectionSignal[idx]);
+				continue;
+			}
+			float depth = camera->depthBuffer[idx];
+			float3 n = NormalAt(dn, planeSize, idx);
+
+			float3 histEm = {0}, histRefl = {0}, histM1 = {0}, histM2 = {0};
+			float sumW = 0.0f;
+			if (dn->hasHistory) {
+				float2 mv = camera->motionVectorBuffer[idx];
+				float px = ((x + 0.5f) / (float)W - mv.x) * W - 0.5f;
+				float py = ((y + 0.5f) / (float)H - mv.y) * H - 0.5f;
+				int x0 = (int)floorf(px), y0 = (int)floorf(py);
+				float fx = px - x0, fy = py - y0;
+				const float bw[4] = {(1.0f - fx) * (1.0f - fy), fx * (1.0f - fy), (1.0f - fx) * fy, fx * fy};
+				for (int t = 0; t < 4; t++) {
+					int tx = x0 + (t & 1), ty = y0 + (t >> 1);
+					if (tx < 0 || ty < 0 || tx >= W || ty >= H || bw[t] <= 0.0f) continue;
+					int pidx = ty * W + tx;
+					if (dn->prevObjectId[pidx] != id) continue;
+					if (fabsf(dn->prevDepth[pidx] - depth) > DENOISE_REPROJECT_DEPTH * depth) continue;
+					if (Float3_Dot(UnpackNormal(dn->prevNormal[pidx]), n) < DENOISE_REPROJECT_NORMAL) continue;
+					float w = bw[t];
+					histEm = Lerp3(histEm, dn->emissionHistory[pidx], w / (sumW + w));
+					histRefl = Lerp3(histRefl, dn->reflectionHistory[pidx], w / (sumW + w));
+					histM1 = Lerp3(histM1, dn->moments1[pidx], w / (sumW + w));
+					histM2 = Lerp3(histM2, dn->moments2[pidx], w / (sumW + w));
+					sumW += w;
+				}
+			}
+
+			// the pixel the secondary rays were traced from takes the sample itself and a larger
+			// share of it; the others only hold the upsampled estimate
+			int lidx = (y / SECONDARY_RESOLUTION) * lowWidth + x / SECONDARY_RESOLUTION;
+			int traced = camera->secondaryPixel[lidx] == idx;
+			float3 em = traced ? camera->secondaryEmission[lidx] : camera->emissionSignal[idx];
+			float3 refl = traced ? camera->secondaryReflection[lidx] : camera->reflectionSignal[idx];
+			float3 lum = {em.w, Luma(em), Luma(refl)};
+			float3 lum2 = {lum.x * lum.x, lum.y * lum.y, lum.z * lum.z};
+
+			float historyLength = sumW > 1e-3f ? fminf(histM1.w + 1.0f, DENOISE_HISTORY_MAX) : 1.0f;
+			float alpha = historyLength <= 1.0f ? 1.0f : traced ? DENOISE_TRACED_ALPHA : DENOISE_ALPHA;
+			float alphaM = fmaxf(DENOISE_MOMENTS_ALPHA, 1.0f / historyLength);
+			float3 m1 = Lerp3(histM1, lum, alphaM);
+			float3 m2 = Lerp3(histM2, lum2, alphaM);
+			m1.w = historyLength;
+
+			camera->emissionSignal[idx] = Lerp3(histEm, em, alpha);
+			camera->reflectionSignal[idx] = Lerp3(histRefl, refl, alpha);
+			StorePlanes(dn->planes[0], planeSize, idx, camera->emissionSignal[idx], camera->reflectionSignal[idx]);
+			dn->variance[idx] = m1;
+			dn->varianceTemp[idx] = m2;
+		}
+	}
+}
+
+static inline void StoreVariance(float *planes, size_t n, int idx, float3 v) {
+	planes[PLANE_VARIANCE * n + idx] = v.x;
+	planes[(PLANE_VARIANCE + 1) * n + idx] = v.y;
+	planes[(PLANE_VARIANCE + 2) * n + idx] = v.z;
+}
+
+// Variance from the temporal moments into planes[0]; pixels with little history fall back
+// to a 7x7 spatial estimate over the same object, scaled up while the history is young.
+static void VarianceRows(void *arg) {
+	DenoiseTask *task = arg;
+	Denoiser *dn = task->denoiser;
+	Camera *camera = task->camera;
+	int W = dn->width, H = dn->height;
+	size_t planeSize = (size_t)W * H;
+
+	for (int y = task->row; y < task->row + task->rowCount && y < H; y++) {
+		for (int x = 0; x < W; x++) {
+			int idx = y * W + x;
+			int id = camera->objectIdBuffer[idx];
+			if (id < 0) {
+				StoreVariance(dn->planes[0], planeSize, idx, (float3){0.0f, 0.0f, 0.0f});
+				continue;
+			}
+			float3 m1 = dn->moments1[idx];
+			float3 m2 = dn->moments2[idx];
+			float historyLength = m1.w;
+			if (historyLength >= DENOISE_MIN_HISTORY) {
+				StoreVariance(dn->planes[0], planeSize, idx, (float3){fmaxf(m2.x - m1.x * m1.x, 0.0f), fmaxf(m2.y - m1.y * m1.y, 0.0f), fmaxf(m2.z - m1.z * m1.z, 0.0f)});
+				continue;
+			}
+
+			float3 n = NormalAt(dn, planeSize, idx);
+			float3 s1 = {0}, s2 = {0};
+			float sumW = 0.0f;
+			for (int dy = -3; dy <= 3; dy++) {
+				int qy = y + dy;
+				if (qy < 0 || qy >= H) continue;
+				for (int dx = -3; dx <= 3; dx++) {
+					int qx = x + dx;
+					if (qx < 0 || qx >= W) continue;
+					int q = qy * W + qx;
+					if (camera->objectIdBuffer[q] != id) continue;
+					float w = NormalWeight(n, NormalAt(dn, planeSize, q));
+					float3 em = camera->emissionSignal[q];
+					float3 l = {em.w, Luma(em), Luma(camera->reflectionSignal[q])};
+					s1 = (float3){s1.x + l.x * w, s1.y + l.y * w, s1.z + l.z * w};
+					s2 = (float3){s2.x + l.x * l.x * w, s2.y + l.y * l.y * w, s2.z + l.z * l.z * w};
+					sumW += w;
+				}
+			}
+			float inv = sumW > 0.0f ? 1.0f / sumW : 0.0f;
+			float boost = DENOISE_MIN_HISTORY / historyLength;
+			s1 = Float3_Scale(s1, inv);
+			s2 = Float3_Scale(s2, inv);
+			StoreVariance(dn->planes[0], planeSize, idx, (float3){
+				fmaxf(s2.x - s1.x * s1.x, 0.0f) * boost,
+				fmaxf(s2.y - s1.y * s1.y, 0.0f) * boost,
+				fmaxf(s2.z - s1.z * s1.z, 0.0f) * boost,
+			});
+		}
+	}
+}
+
+// exp(x) for x <= 0: 2^t split into integer and fraction, 2^f by a degree-5 polynomial
+// (relative error ~2e-4, far below what the edge-stopping weights resolve).
+static inline __m256 ExpNeg(__m256 x) {
+	__m256 t = _mm256_mul_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.0f)), _mm256_set1_ps(1.44269504f));
+	__m256 i = _mm256_floor_ps(t);
+	__m256 f = _mm256_sub_ps(t, i);
+	__m256 p = _mm256_fmadd_ps(f, _mm256_set1_ps(1.33335581e-3f), _mm256_set1_ps(9.61812911e-3f));
+	p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(5.55041087e-2f));
+	p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(2.40226507e-1f));
+	p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(6.93147181e-1f));
+	p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.0f));
+	__m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(i), _mm256_set1_epi32(127)), 23);
+	return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+}
+
+static inline __m256 Abs8(__m256 v) {
+	return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+}
+
+static inline __m256 Luma8(__m256 r, __m256 g, __m256 b) {
+	return _mm256_fmadd_ps(r, _mm256_set1_ps(0.299f), _mm256_fmadd_ps(g, _mm256_set1_ps(0.587f), _mm256_mul_ps(b, _mm256_set1_ps(0.114f))));
+}
+
+// Lanes of x + (0..7) + offset that fall inside [0, W).
+static inline __m256i ColumnMask(__m256i lanes, int offset, int W) {
+	__m256i q = _mm256_add_epi32(lanes, _mm256_set1_epi32(offset));
+	return _mm256_and_si256(_mm256_cmpgt_epi32(q, _mm256_set1_epi32(-1)), _mm256_cmpgt_epi32(_mm256_set1_epi32(W), q));
+}
+
+// Lanes in valid whose tap belongs to the centre pixel's object.
+static inline __m256 SameObject(const int *ids, __m256i valid, __m256i id) {
+	__m256i q = _mm256_maskload_epi32(ids, valid);
+	return _mm256_castsi256_ps(_mm256_and_si256(valid, _mm256_cmpeq_epi32(q, id)));
+}
+
+// One 5x5 B3-spline a-trous iteration over planes[odd] into planes[!odd], eight pixels per
+// step. Edge stops: object id, depth relative to the local gradient, normal^128, and
+// per-signal luminance against the prefiltered variance. The depth and luminance stops share
+// one exp per signal. The first iteration's output is next frame's history; the last one is
+// written back to the camera signals.
+static void AtrousRows(void *arg) {
+	DenoiseTask *task = arg;
+	Denoiser *dn = task->denoiser;
+	Camera *camera = task->camera;
+	int W = dn->width, H = dn->height;
+	size_t n = (size_t)W * H;
+	int step = task->step;
+	int iteration = __builtin_ctz(step);
+	const float *src = dn->planes[iteration & 1];
+	float *dst = dn->planes[(iteration + 1) & 1];
+	int last = iteration == DENOISE_ATROUS_ITERATIONS - 1;
+	const int *ids = camera->objectIdBuffer;
+	const float *depth = camera->depthBuffer;
+	const float *nx = dn->normal, *ny = dn->normal + n, *nz = dn->normal + 2 * n;
+	static const float kernel[3] = {3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+	const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (int y = task->row; y < task->row + task->rowCount && y < H; y++) {
+		for (int x = 0; x < W; x += 8) {
+			int idx = y * W + x;
+			__m256i lanes = _mm256_add_epi32(laneIndex, _mm256_set1_epi32(x));
+			__m256i inRow = ColumnMask(lanes, 0, W);
+			__m256i id = _mm256_maskload_epi32(ids + idx, inRow);
+			__m256 active = _mm256_castsi256_ps(_mm256_and_si256(inRow, _mm256_cmpgt_epi32(id, _mm256_set1_epi32(-1))));
+			__m256 centre[DENOISE_PLANES];
+			for (int c = 0; c < DENOISE_PLANES; c++)
+				centre[c] = _mm256_maskload_ps(src + c * n + idx, inRow);
+			if (_mm256_testz_ps(active, active)) {
+				for (int c = 0; c < DENOISE_PLANES; c++)
+					_mm256_maskstore_ps(dst + c * n + idx, inRow, centre[c]);
+			} else {
+				// 3x3 gaussian-prefiltered variance drives the luminance edge stop
+				__m256 var[3] = {zero, zero, zero}, varW = zero;
+				for (int dy = -1; dy <= 1; dy++) {
+					if (y + dy < 0 || y + dy >= H) continue;
+					for (int dx = -1; dx <= 1; dx++) {
+						int q = idx + dy * W + dx;
+						__m256i valid = _mm256_and_si256(ColumnMask(lanes, dx, W), inRow);
+						__m256 same = SameObject(ids + q, valid, id);
+						__m256 w = _mm256_and_ps(same, _mm256_set1_ps((dx ? 0.5f : 1.0f) * (dy ? 0.5f : 1.0f)));
+						for (int c = 0; c < 3; c++)
+							var[c] = _mm256_fmadd_ps(_mm256_maskload_ps(src + (PLANE_VARIANCE + c) * n + q, valid), w, var[c]);
+						varW = _mm256_add_ps(varW, w);
+					}
+				}
+				__m256 invVarW = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_max_ps(varW, _mm256_set1_ps(1e-6f)));
+				__m256 invSigmaL[3];
+				for (int c = 0; c < 3; c++) {
+					__m256 sigma = _mm256_sqrt_ps(_mm256_mul_ps(var[c], invVarW));
+					invSigmaL[c] = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_fmadd_ps(sigma, _mm256_set1_ps(DENOISE_SIGMA_LUMINANCE), _mm256_set1_ps(1e-4f)));
+				}
+
+				__m256 zp = _mm256_maskload_ps(depth + idx, inRow);
+				__m256 grad = zero;
+				const int offsets[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+				for (int k = 0; k < 4; k++) {
+					int dx = offsets[k][0], dy = offsets[k][1];
+					if (y + dy < 0 || y + dy >= H) continue;
+					int q = idx + dy * W + dx;
+					__m256i valid = _mm256_and_si256(ColumnMask(lanes, dx, W), inRow);
+					__m256 same = SameObject(ids + q, valid, id);
+					__m256 g = Abs8(_mm256_sub_ps(_mm256_maskload_ps(depth + q, valid), zp));
+					grad = _mm256_max_ps(grad, _mm256_and_ps(same, g));
+				}
+				__m256 invSigmaZ = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_fmadd_ps(grad, _mm256_set1_ps(DENOISE_SIGMA_DEPTH * step), _mm256_set1_ps(1e-3f)));
+
+				__m256 npx = _mm256_maskload_ps(nx + idx, inRow), npy = _mm256_maskload_ps(ny + idx, inRow), npz = _mm256_maskload_ps(nz + idx, inRow);
+				__m256 lpS = centre[PLANE_SHADOW];
+				__m256 lpE = Luma8(centre[PLANE_EMISSION], centre[PLANE_EMISSION + 1], centre[PLANE_EMISSION + 2]);
+				__m256 lpR = Luma8(centre[PLANE_REFLECTION], centre[PLANE_REFLECTION + 1], centre[PLANE_REFLECTION + 2]);
+
+				__m256 sum[DENOISE_PLANES];
+				for (int c = 0; c < DENOISE_PLANES; c++)
+					sum[c] = zero;
+				__m256 wS = zero, wE = zero, wR = zero;
+				for (int dy = -2; dy <= 2; dy++) {
+					int qy = y + dy * step;
+					if (qy < 0 || qy >= H) continue;
+					for (int dx = -2; dx <= 2; dx++) {
+						int q = qy * W + x + dx * step;
+						__m256i valid = _mm256_and_si256(ColumnMask(lanes, dx * step, W), inRow);
+						__m256 same = SameObject(ids + q, valid, id);
+						if (_mm256_testz_ps(same, same)) continue;
+						int dist = abs(dx) + abs(dy);
+						float h = kernel[abs(dx)] * kernel[abs(dy)];
+
+						__m256 ez = _mm256_mul_ps(Abs8(_mm256_sub_ps(zp, _mm256_maskload_ps(depth + q, valid))),
+												  _mm256_mul_ps(invSigmaZ, _mm256_set1_ps(1.0f / (float)(dist > 0 ? dist : 1))));
+						__m256 d = _mm256_mul_ps(npx, _mm256_maskload_ps(nx + q, valid));
+						d = _mm256_fmadd_ps(npy, _mm256_maskload_ps(ny + q, valid), d);
+						d = _mm256_fmadd_ps(npz, _mm256_maskload_ps(nz + q, valid), d);
+						d = _mm256_max_ps(d, zero);
+						for (int i = 0; i < 7; i++)
+							d = _mm256_mul_ps(d, d);
+						__m256 base = _mm256_and_ps(same, _mm256_mul_ps(d, _mm256_set1_ps(h)));
+
+						__m256 tap[DENOISE_PLANES];
+						for (int c = 0; c < DENOISE_PLANES; c++)
+							tap[c] = _mm256_maskload_ps(src + c * n + q, valid);
+						__m256 lS = _mm256_mul_ps(Abs8(_mm256_sub_ps(lpS, tap[PLANE_SHADOW])), invSigmaL[0]);
+						__m256 lE = _mm256_mul_ps(Abs8(_mm256_sub_ps(lpE, Luma8(tap[PLANE_EMISSION], tap[PLANE_EMISSION + 1], tap[PLANE_EMISSION + 2]))), invSigmaL[1]);
+						__m256 lR = _mm256_mul_ps(Abs8(_mm256_sub_ps(lpR, Luma8(tap[PLANE_REFLECTION], tap[PLANE_REFLECTION + 1], tap[PLANE_REFLECTION + 2]))), invSigmaL[2]);
+						__m256 ws = _mm256_mul_ps(base, ExpNeg(_mm256_sub_ps(zero, _mm256_add_ps(ez, lS))));
+						__m256 we = _mm256_mul_ps(base, ExpNeg(_mm256_sub_ps(zero, _mm256_add_ps(ez, lE))));
+						__m256 wr = _mm256_mul_ps(base, ExpNeg(_mm256_sub_ps(zero, _mm256_add_ps(ez, lR))));
+
+						for (int c = 0; c < 3; c++) {
+							sum[PLANE_EMISSION + c] = _mm256_fmadd_ps(tap[PLANE_EMISSION + c], we, sum[PLANE_EMISSION + c]);
+							sum[PLANE_REFLECTION + c] = _mm256_fmadd_ps(tap[PLANE_REFLECTION + c], wr, sum[PLANE_REFLECTION + c]);
+						}
+						sum[PLANE_SHADOW] = _mm256_fmadd_ps(tap[PLANE_SHADOW], ws, sum[PLANE_SHADOW]);
+						sum[PLANE_VARIANCE] = _mm256_fmadd_ps(tap[PLANE_VARIANCE], _mm256_mul_ps(ws, ws), sum[PLANE_VARIANCE]);
+						sum[PLANE_VARIANCE + 1] = _mm256_fmadd_ps(tap[PLANE_VARIANCE + 1], _mm256_mul_ps(we, we), sum[PLANE_VARIANCE + 1]);
+						sum[PLANE_VARIANCE + 2] = _mm256_fmadd_ps(tap[PLANE_VARIANCE + 2], _mm256_mul_ps(wr, wr), sum[PLANE_VARIANCE + 2]);
+						wS = _mm256_add_ps(wS, ws);
+						wE = _mm256_add_ps(wE, we);
+						wR = _mm256_add_ps(wR, wr);
+					}
+				}
+				// the centre tap always contributes to active lanes; the clamp only keeps the
+				// inactive ones finite before they are replaced by the centre value
+				__m256 tiny = _mm256_set1_ps(1e-30f), one = _mm256_set1_ps(1.0f);
+				__m256 invS = _mm256_div_ps(one, _mm256_max_ps(wS, tiny));
+				__m256 invE = _mm256_div_ps(one, _mm256_max_ps(wE, tiny));
+				__m256 invR = _mm256_div_ps(one, _mm256_max_ps(wR, tiny));
+				const __m256 *scale[DENOISE_PLANES] = {&invE, &invE, &invE, &invS, &invR, &invR, &invR, &invS, &invE, &invR};
+				for (int c = 0; c < DENOISE_PLANES; c++) {
+					__m256 out = _mm256_mul_ps(sum[c], *scale[c]);
+					if (c >= PLANE_VARIANCE) out = _mm256_mul_ps(out, *scale[c]);
+					_mm256_maskstore_ps(dst + c * n + idx, inRow, _mm256_blendv_ps(centre[c], out, active));
+				}
+			}
+
+			if (step == 1 || last) {
+				// history and camera signals stay float3 per pixel
+				int count = W - x < 8 ? W - x : 8;
+				for (int i = 0; i < count; i++) {
+					int p = idx + i;
+					float3 em = {dst[PLANE_EMISSION * n + p], dst[(PLANE_EMISSION + 1) * n + p], dst[(PLANE_EMISSION + 2) * n + p], dst[PLANE_SHADOW * n + p]};
+					float3 refl = {dst[PLANE_REFLECTION * n + p], dst[(PLANE_REFLECTION + 1) * n + p], dst[(PLANE_REFLECTION + 2) * n + p]};
+					if (step == 1) {
+						dn->emissionHistory[p] = em;
+						dn->reflectionHistory[p] = refl;
+					}
+					if (last) {
+						camera->emissionSignal[p] = em;
+						camera->reflectionSignal[p] = refl;
+					}
+				}
+			}
+		}
+	}
+}
+
+static void RunRows(Denoiser *denoiser, Camera *camera, ThreadPool *threadPool, task_fn fn, int step) {
+	int taskCount = (denoiser->height + DENOISE_ROWS_PER_TASK - 1) / DENOISE_ROWS_PER_TASK;
+	for (int t = 0; t < taskCount; t++) {
+		denoiser->tasks[t] = (DenoiseTask){t * DENOISE_ROWS_PER_TASK, DENOISE_ROWS_PER_TASK, step, denoiser, camera};
+		poolAdd(threadPool, fn, &denoiser->tasks[t]);
+	}
+	poolWait(threadPool);
+}
+
+void Denoiser_Run(Denoiser *denoiser, Camera *camera, ThreadPool *threadPool) {
+	if (!denoiser || !denoiser->tasks || !camera || !threadPool) return;
+	if (camera->screenWidth != denoiser->width || camera->screenHeight != denoiser->height) return;
+	if (!Camera_Require(camera, CAMERA_DEPTH | CAMERA_NORMAL | CAMERA_MOTION | CAMERA_OBJECT_ID | CAMERA_EMISSION_SIGNAL | CAMERA_REFLECTION_SIGNAL)) return;
+	size_t n = (size_t)denoiser->width * denoiser->height;
+
+	RunRows(denoiser, camera, threadPool, DecodeNormalRows, 0);
+	RunRows(denoiser, camera, threadPool, TemporalRows, 0);
+	float3 *swap = denoiser->moments1;
+	denoiser->moments1 = denoiser->variance;
+	denoiser->variance = swap;
+	swap = denoiser->moments2;
+	denoiser->moments2 = denoiser->varianceTemp;
+	denoiser->varianceTemp = swap;
+
+	RunRows(denoiser, camera, threadPool, VarianceRows, 0);
+	for (int i = 0; i < DENOISE_ATROUS_ITERATIONS; i++)
+		RunRows(denoiser, camera, threadPool, AtrousRows, 1 << i);
+
+	memcpy(denoiser->prevDepth, camera->depthBuffer, n * sizeof(float));
+	memcpy(denoiser->prevNormal, camera->normalBuffer, n * sizeof(uint32));
+	memcpy(denoiser->prevObjectId, camera->objectIdBuffer, n * sizeof(int));
+	denoiser->hasHistory = 1;
+}
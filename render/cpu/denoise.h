@@ -0,0 +1,63 @@
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include "../../object/format.h"
+#include "../../util/threadPool.h"
+
+// Spatiotemporal denoiser for the secondary-ray signals (SVGF style):
+// temporal reprojection with moments, spatial variance for young history,
+// then variance-guided edge-aware a-trous passes, eight pixels per AVX2 iteration.
+// Filters camera->emissionSignal / reflectionSignal in place.
+
+#define DENOISE_ATROUS_ITERATIONS 4 // kernel steps 1, 2, 4, 8
+#define DENOISE_ALPHA 0.05f			// weight of an upsampled sample in the temporal blend
+#define DENOISE_TRACED_ALPHA 0.5f	// weight of a sample at the pixel it was traced from
+#define DENOISE_MOMENTS_ALPHA 0.2f
+#define DENOISE_HISTORY_MAX 32.0f	  // frames of history before the moments alpha bottoms out
+#define DENOISE_MIN_HISTORY 4.0f	  // below this, variance is estimated spatially
+#define DENOISE_REPROJECT_DEPTH 0.05f // max relative depth change for a valid history tap
+#define DENOISE_REPROJECT_NORMAL 0.9f // min normal agreement for a valid history tap
+#define DENOISE_SIGMA_DEPTH 1.0f
+#define DENOISE_SIGMA_LUMINANCE 1.0f
+#define DENOISE_ROWS_PER_TASK 8
+#define DENOISE_PLANES 10
+
+typedef struct Denoiser Denoiser;
+
+typedef struct {
+	int row;
+	int rowCount;
+	int step;
+	Denoiser *denoiser;
+	Camera *camera;
+} DenoiseTask;
+
+struct Denoiser {
+	int width, height;
+	int hasHistory;
+	// temporal state, indexed by pixel of the previous frame
+	float3 *emissionHistory;   // emission (xyz) + shadow (w)
+	float3 *reflectionHistory; // reflection (xyz)
+	float3 *moments1;		   // luminance first moments: shadow, emission, reflection, w = history length
+	float3 *moments2;		   // luminance second moments
+	float *prevDepth;
+	uint32 *prevNormal; // octahedral, as Camera.normalBuffer
+	int *prevObjectId;
+	float *normal; // this frame's camera normals, decoded once for the filter taps: x, y, z planes
+	// a-trous ping-pong, DENOISE_PLANES planes of width * height each: emission (xyz), shadow,
+	// reflection (xyz) and variance (shadow, emission, reflection), so taps load 8 pixels at once
+	float *planes[2];
+	float3 *variance;	  // scratch for the new moments, swapped with moments1 / moments2
+	float3 *varianceTemp;
+	DenoiseTask *tasks;
+};
+
+// On allocation failure every buffer is left NULL and Denoiser_Run is a no-op.
+void Denoiser_Init(Denoiser *denoiser, int width, int height);
+void Denoiser_Destroy(Denoiser *denoiser);
+// Drops the history, e.g. after a camera cut.
+void Denoiser_Reset(Denoiser *denoiser);
+// Run after RayTraceShadeSignals and before RayTraceComposite(..., 0).
+void Denoiser_Run(Denoiser *denoiser, Camera *camera, ThreadPool *threadPool);
+
+#endif // DENOISE_H
@@ -2,6 +2,8 @@
 
 #include <ctype.h>
 #include <dirent.h>
+#include <immintrin.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -38,14 +40,56 @@ static int parseLetterIndex(const char *filename) {
 	return -1;
 }
 
+typedef struct {
+	uint32 width, height;
+	uint8 *coverage;
+} LoadedGlyph;
+
+// One glyph file: width, height, then rows of 1-bit pixels, MSB first, padded to a byte.
+static int loadGlyph(const char *filePath, LoadedGlyph *glyph) {
+	FILE *file = fopen(filePath, "rb");
+	if (!file) return 0;
+
+	uint32 width = 0;
+	uint32 height = 0;
+	if (fread(&width, sizeof(uint32), 1, file) != 1 || fread(&height, sizeof(uint32), 1, file) != 1 ||
+		width == 0 || height == 0 || width > 1024 || height > 1024) {
+		fclose(file);
+		return 0;
+	}
+
+	size_t packedBytes = ((size_t)width + 7u) / 8u;
+	uint8 *coverage = (uint8 *)malloc((size_t)width * height);
+	unsigned char *rowData = (unsigned char *)malloc(packedBytes);
+	int valid = coverage && rowData;
+	for (uint32 y = 0; valid && y < height; y++) {
+		if (fread(rowData, 1, packedBytes, file) != packedBytes) {
+			valid = 0;
+			break;
+		}
+		for (uint32 x = 0; x < width; x++)
+			coverage[(size_t)y * width + x] = (rowData[x / 8u] >> (7 - (int)(x % 8u))) & 1 ? 0xFF : 0x00;
+	}
+	free(rowData);
+	fclose(file);
+
+	if (!valid) {
+		free(coverage);
+		return 0;
+	}
+	*glyph = (LoadedGlyph){width, height, coverage};
+	return 1;
+}
+
 void LoadAlphabet(struct Alphabet *alphabet, const char *dirname) {
 	if (!alphabet || !dirname) return;
 
+	memset(alphabet, 0, sizeof(struct Alphabet));
+	GlyphSet *set = &alphabet->glyphs;
+	set->scale = 1.0f;
 	for (int i = 0; i < 256; i++) {
-		alphabet->letters[i].character = (char)i;
-		alphabet->letters[i].tile.width = 0;
-		alphabet->letters[i].tile.height = 0;
-		alphabet->letters[i].tile.pixels = NULL;
+		set->letters[i].character = (char)i;
+		set->letters[i].advance = FONT_MISSING_ADVANCE;
 	}
 
 	DIR *dir = opendir(dirname);
@@ -54,6 +98,7 @@ void LoadAlphabet(struct Alphabet *alphabet, const char *dirname) {
 		return;
 	}
 
+	LoadedGlyph glyphs[256] = {0};
 	struct dirent *entry = NULL;
 	while ((entry = readdir(dir)) != NULL) {
 		if (entry->d_name[0] == '.') continue;
@@ -65,90 +110,189 @@ void LoadAlphabet(struct Alphabet *alphabet, const char *dirname) {
 		int pathLen = snprintf(filePath, sizeof(filePath), "%s/%s", dirname, entry->d_name);
 		if (pathLen < 0 || (size_t)pathLen >= sizeof(filePath)) continue;
 
-		FILE *file = fopen(filePath, "rb");
-		if (!file) continue;
+		LoadedGlyph glyph;
+		if (!loadGlyph(filePath, &glyph)) continue;
+		free(glyphs[letterIndex].coverage);
+		glyphs[letterIndex] = glyph;
+	}
+	closedir(dir);
 
-		uint32 width = 0;
-		uint32 height = 0;
-		if (fread(&width, sizeof(uint32), 1, file) != 1 || fread(&height, sizeof(uint32), 1, file) != 1) {
-			fclose(file);
-			continue;
-		}
+	int legacyLowCount = 0;
+	int legacyHighCount = 0;
+	for (int i = 0; i < 32; i++) {
+		if (glyphs[i].coverage) legacyLowCount++;
+	}
+	for (int i = 224; i < 256; i++) {
+		if (glyphs[i].coverage) legacyHighCount++;
+	}
 
-		if (width == 0 || height == 0 || width > 1024 || height > 1024) {
-			fclose(file);
-			continue;
+	if (legacyLowCount > 0 && legacyHighCount == 0) {
+		for (int i = 255; i >= 32; i--) {
+			glyphs[i] = glyphs[i - 32];
 		}
-
-		size_t pixelCount = (size_t)width * (size_t)height;
-		if (pixelCount > (size_t)1 << 24) {
-			fclose(file);
-			continue;
+		for (int i = 0; i < 32; i++) {
+			glyphs[i] = (LoadedGlyph){0};
 		}
+	}
 
-		uint32 *pixels = (uint32 *)malloc(pixelCount * sizeof(uint32));
-		if (!pixels) {
-			fclose(file);
-			continue;
+	// one row band, glyphs left to right
+	for (int i = 0; i < 256; i++) {
+		if (!glyphs[i].coverage) continue;
+		set->width += (int)glyphs[i].width;
+		if ((int)glyphs[i].height > set->height) set->height = (int)glyphs[i].height;
+	}
+	set->coverage = set->width ? (uint8 *)calloc((size_t)set->width * set->height, 1) : NULL;
+	if (set->width && !set->coverage) fprintf(stderr, "LoadAlphabet: could not allocate the glyph atlas\n");
+	uint32 atlasX = 0;
+	for (int i = 0; i < 256; i++) {
+		LoadedGlyph *glyph = &glyphs[i];
+		if (glyph->coverage && set->coverage) {
+			for (uint32 y = 0; y < glyph->height; y++)
+				memcpy(set->coverage + (size_t)y * set->width + atlasX, glyph->coverage + (size_t)y * glyph->width, glyph->width);
+			set->letters[i] = (struct letter){(char)i, (uint16)glyph->width, (uint16)glyph->height, (uint16)glyph->width, atlasX};
+			atlasX += glyph->width;
 		}
+		free(glyph->coverage);
+	}
+}
 
-		size_t packedBytes = ((size_t)width + 7u) / 8u;
-		unsigned char *rowData = (unsigned char *)malloc(packedBytes);
-		if (!rowData) {
-			free(pixels);
-			fclose(file);
-			continue;
-		}
+void DestroyAlphabet(struct Alphabet *alphabet) {
+	if (!alphabet) return;
+	free(alphabet->glyphs.coverage);
+	for (int i = 0; i < FONT_MAX_SIZES; i++)
+		free(alphabet->sizes[i].coverage);
+	for (int i = 0; i < FONT_LAYOUT_CACHE; i++)
+		free(alphabet->layouts[i].mask);
+	memset(alphabet, 0, sizeof(struct Alphabet));
+}
 
-		int valid = 1;
-		for (uint32 y = 0; y < height; y++) {
-			if (fread(rowData, 1, packedBytes, file) != packedBytes) {
-				valid = 0;
-				break;
-			}
-			for (uint32 x = 0; x < width; x++) {
-				size_t byteIndex = x / 8u;
-				int bit = 7 - (int)(x % 8u);
-				int on = (rowData[byteIndex] >> bit) & 1;
-				pixels[(size_t)y * width + x] = on ? 0xFFFFFFFFu : 0x00000000u;
+// Nearest-texel copy of every glyph at scale, sampled as drawTileColorScaled does so text
+// looks the same as when it was drawn per character.
+static int buildGlyphSet(GlyphSet *dst, const GlyphSet *src, float scale) {
+	free(dst->coverage);
+	memset(dst, 0, sizeof(GlyphSet));
+	for (int i = 0; i < 256; i++) {
+		const struct letter *l = &src->letters[i];
+		struct letter *out = &dst->letters[i];
+		out->character = (char)i;
+		out->advance = l->width ? (uint16)(int)((float)l->width * scale) : (uint16)(int)((float)FONT_MISSING_ADVANCE * scale);
+		if (!l->width) continue;
+		out->width = (uint16)(int)((float)l->width * scale);
+		out->height = (uint16)(int)((float)l->height * scale);
+		out->atlasX = (uint32)dst->width;
+		dst->width += out->width;
+		if (out->height > dst->height) dst->height = out->height;
+	}
+	dst->coverage = dst->width && dst->height ? (uint8 *)malloc((size_t)dst->width * dst->height) : NULL;
+	if (dst->width && dst->height && !dst->coverage) return 0;
+	for (int i = 0; i < 256; i++) {
+		const struct letter *l = &src->letters[i];
+		const struct letter *out = &dst->letters[i];
+		for (int row = 0; row < out->height; row++) {
+			int srcRow = (int)(row / scale);
+			srcRow = srcRow < l->height ? srcRow : l->height - 1;
+			const uint8 *s = src->coverage + (size_t)srcRow * src->width + l->atlasX;
+			uint8 *d = dst->coverage + (size_t)row * dst->width + out->atlasX;
+			for (int col = 0; col < out->width; col++) {
+				int srcCol = (int)(col / scale);
+				d[col] = s[srcCol < l->width ? srcCol : l->width - 1];
 			}
 		}
+	}
+	dst->scale = scale;
+	return 1;
+}
 
-		free(rowData);
-		fclose(file);
-
-		if (!valid) {
-			free(pixels);
-			continue;
+static const GlyphSet *glyphSetFor(struct Alphabet *alphabet, float scale) {
+	if (scale == 1.0f) return &alphabet->glyphs;
+	GlyphSet *oldest = &alphabet->sizes[0];
+	for (int i = 0; i < FONT_MAX_SIZES; i++) {
+		GlyphSet *set = &alphabet->sizes[i];
+		if (set->scale == scale) {
+			set->lastUse = alphabet->clock;
+			return set;
 		}
+		if (set->lastUse < oldest->lastUse || (oldest->scale != 0.0f && set->scale == 0.0f)) oldest = set;
+	}
+	if (!buildGlyphSet(oldest, &alphabet->glyphs, scale)) return NULL;
+	oldest->lastUse = alphabet->clock;
+	return oldest;
+}
 
-		alphabet->letters[letterIndex].character = (char)letterIndex;
-		alphabet->letters[letterIndex].tile.width = width;
-		alphabet->letters[letterIndex].tile.height = height;
-		alphabet->letters[letterIndex].tile.pixels = pixels;
+// The cached line mask for text at scale, composed again only when that string was not
+// drawn recently.
+static const TextLayout *layoutText(struct Alphabet *alphabet, const char *text, float scale) {
+	size_t length = strlen(text);
+	int cacheable = length < (size_t)FONT_LAYOUT_CHARS;
+	TextLayout *oldest = &alphabet->layouts[0];
+	for (int i = 0; i < FONT_LAYOUT_CACHE; i++) {
+		TextLayout *layout = &alphabet->layouts[i];
+		if (cacheable && layout->valid && layout->scale == scale && strcmp(layout->text, text) == 0) {
+			layout->lastUse = alphabet->clock;
+			return layout;
+		}
+		if (layout->lastUse < oldest->lastUse || (oldest->valid && !layout->valid)) oldest = layout;
 	}
 
-	int legacyLowCount = 0;
-	int legacyHighCount = 0;
-	for (int i = 0; i < 32; i++) {
-		if (alphabet->letters[i].tile.pixels) legacyLowCount++;
+	const GlyphSet *set = glyphSetFor(alphabet, scale);
+	if (!set) return NULL;
+	TextLayout *layout = oldest;
+	layout->valid = 0;
+	int width = 0, height = 0;
+	for (size_t i = 0; i < length; i++) {
+		const struct letter *l = &set->letters[(unsigned char)text[i]];
+		width += l->advance;
+		if (l->height > height) height = l->height;
 	}
-	for (int i = 224; i < 256; i++) {
-		if (alphabet->letters[i].tile.pixels) legacyHighCount++;
+	size_t bytes = (size_t)width * height;
+	if (bytes > layout->capacity) {
+		uint8 *mask = (uint8 *)realloc(layout->mask, bytes);
+		if (!mask) return NULL;
+		layout->mask = mask;
+		layout->capacity = bytes;
+	}
+	if (bytes) memset(layout->mask, 0, bytes);
+	int cursorX = 0;
+	for (size_t i = 0; i < length; i++) {
+		const struct letter *l = &set->letters[(unsigned char)text[i]];
+		for (int row = 0; row < l->height; row++)
+			memcpy(layout->mask + (size_t)row * width + cursorX, set->coverage + (size_t)row * set->width + l->atlasX, l->width);
+		cursorX += l->advance;
+	}
+	layout->width = width;
+	layout->height = height;
+	layout->scale = scale;
+	layout->lastUse = alphabet->clock;
+	if (cacheable) {
+		memcpy(layout->text, text, length + 1);
+		layout->valid = 1;
 	}
+	return layout;
+}
 
-	if (legacyLowCount > 0 && legacyHighCount == 0) {
-		for (int i = 255; i >= 32; i--) {
-			alphabet->letters[i].tile = alphabet->letters[i - 32].tile;
-		}
-		for (int i = 0; i < 32; i++) {
-			alphabet->letters[i].tile.width = 0;
-			alphabet->letters[i].tile.height = 0;
-			alphabet->letters[i].tile.pixels = NULL;
+// Writes color wherever the mask is set, eight pixels per masked store.
+static void blitMask(uint32 *dst, int dstWidth, int dstHeight, const uint8 *mask, int maskWidth, int maskHeight, int x, int y, uint32 color) {
+	int srcX = x < 0 ? -x : 0, srcY = y < 0 ? -y : 0;
+	int copyW = (x + maskWidth > dstWidth ? dstWidth - x : maskWidth) - srcX;
+	int copyH = (y + maskHeight > dstHeight ? dstHeight - y : maskHeight) - srcY;
+	if (copyW <= 0 || copyH <= 0) return;
+
+	__m256i fill = _mm256_set1_epi32((int)color);
+	for (int row = 0; row < copyH; row++) {
+		const uint8 *m = mask + (size_t)(srcY + row) * maskWidth + srcX;
+		uint32 *d = dst + (size_t)(y + srcY + row) * dstWidth + x + srcX;
+		int col = 0;
+		for (; col + 8 <= copyW; col += 8) {
+			uint64_t bits;
+			memcpy(&bits, m + col, sizeof(bits));
+			if (!bits) continue;
+			// coverage is 0 or 0xFF: sign-extending gives the all-ones lanes maskstore wants
+			__m256i lanes = _mm256_cvtepi8_epi32(_mm_cvtsi64_si128((long long)bits));
+			_mm256_maskstore_epi32((int *)(d + col), lanes, fill);
 		}
+		for (; col < copyW; col++)
+			if (m[col]) d[col] = color;
 	}
-
-	closedir(dir);
 }
 
 void RenderText(uint32 *dst, int dstWidth, int dstHeight, struct Alphabet *alphabet, const char *text, int x, int y, float scale, uint32 color) {
@@ -156,16 +300,8 @@ void RenderText(uint32 *dst, int dstWidth, int dstHeight, struct Alphabet *alpha
 
 	if (scale <= 0.0f) scale = 1.0f;
 
-	int cursorX = x;
-	for (size_t i = 0; text[i] != '\0'; i++) {
-		unsigned char code = (unsigned char)text[i];
-		Tile tile = alphabet->letters[code].tile;
-
-		if (tile.pixels && tile.width > 0 && tile.height > 0) {
-			drawTileColorScaled(dst, dstWidth, dstHeight, tile, cursorX, y, scale, scale, color);
-			cursorX += (int)((float)tile.width * scale);
-		} else {
-			cursorX += (int)(8.0f * scale);
-		}
-	}
+	alphabet->clock++;
+	const TextLayout *layout = layoutText(alphabet, text, scale);
+	if (layout && layout->width && layout->height)
+		blitMask(dst, dstWidth, dstHeight, layout->mask, layout->width, layout->height, x, y, color);
 }
@@ -1,17 +1,54 @@
 #ifndef FONT_H
 #define FONT_H
 #include "tile.h"
+#include <stddef.h>
+
+// Glyphs are packed side by side into one coverage atlas (one byte per texel, 0 or 0xFF).
+// Each scale text is drawn at gets its own pre-scaled copy of the atlas, and each string is
+// laid out once into a line mask that is kept while the string stays the same, so redrawing
+// HUD text is one AVX2 masked store per 8 pixels of that mask.
+
+#define FONT_MAX_SIZES 4		 // pre-scaled glyph sets kept, least recently used is rebuilt
+#define FONT_LAYOUT_CACHE 16	 // laid-out strings kept, least recently used is rebuilt
+#define FONT_LAYOUT_CHARS 64	 // longer strings are laid out on every call
+#define FONT_MISSING_ADVANCE 8 // advance of a character without a glyph, before scaling
 
 struct letter {
     char character;
-    Tile tile;
+    uint16 width;   // 0 when the font has no glyph for it
+    uint16 height;
+    uint16 advance; // pen movement after the glyph
+    uint32 atlasX;  // first column in the atlas
 };
 
-struct Alphabet {
+typedef struct {
+    float scale; // 0 for an unused slot
+    uint8 *coverage;
+    int width, height; // atlas size, width is the row stride
     struct letter letters[256];
+    uint32 lastUse;
+} GlyphSet;
+
+typedef struct {
+    char text[FONT_LAYOUT_CHARS];
+    float scale;
+    int valid;
+    uint8 *mask; // width x height, the whole string composed from its glyph set
+    int width, height;
+    size_t capacity;
+    uint32 lastUse;
+} TextLayout;
+
+struct Alphabet {
+    GlyphSet glyphs; // as loaded, scale 1
+    GlyphSet sizes[FONT_MAX_SIZES];
+    TextLayout layouts[FONT_LAYOUT_CACHE];
+    uint32 clock;
 };
 
 void LoadAlphabet(struct Alphabet *alphabet, const char *dirname); // index directory load binary data letter is set by filename, tile is set by binary data
+void DestroyAlphabet(struct Alphabet *alphabet);
+// Glyph tops at y. Not thread-safe: the caches live in the alphabet.
 void RenderText(uint32 *dst, int dstWidth, int dstHeight, struct Alphabet *alphabet, const char *text, int x, int y, float scale, uint32 color);
 
-#endif // FONT_H
\ No newline at end of file
+#endif // FONT_H
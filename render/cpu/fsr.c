@@ -0,0 +1,298 @@
+#include "fsr.h"
+#include <immintrin.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGN64(n) (((n) + 63) & ~(size_t)63)
+#define FSR_RCAS_LIMIT (0.25f - 1.0f / 16.0f)
+
+void Fsr_Init(FsrUpscaler *fsr, int inWidth, int inHeight, int outWidth, int outHeight) {
+	if (!fsr) return;
+	memset(fsr, 0, sizeof(FsrUpscaler));
+	fsr->inWidth = inWidth;
+	fsr->inHeight = inHeight;
+	fsr->outWidth = outWidth;
+	fsr->outHeight = outHeight;
+	fsr->scaleX = (float)inWidth / (float)outWidth;
+	fsr->scaleY = (float)inHeight / (float)outHeight;
+	fsr->sharpness = exp2f(-FSR_SHARPNESS);
+	// the AVX2 paths work on 8-pixel spans plus a 1-pixel RCAS border
+	if (outWidth < 10 || outHeight < 1 || inWidth < 1 || inHeight < 1) return;
+	fsr->easu = (Color *)aligned_alloc(64, ALIGN64((size_t)outWidth * outHeight * sizeof(Color)));
+	fsr->tasks = (FsrTask *)malloc(sizeof(FsrTask) * ((outHeight + FSR_ROWS_PER_TASK - 1) / FSR_ROWS_PER_TASK));
+	if (!fsr->easu || !fsr->tasks) Fsr_Destroy(fsr);
+}
+
+void Fsr_Destroy(FsrUpscaler *fsr) {
+	if (!fsr) return;
+	free(fsr->easu);
+	free(fsr->tasks);
+	fsr->easu = NULL;
+	fsr->tasks = NULL;
+}
+
+typedef struct {
+	__m256 r, g, b, l;
+} Texel8;
+
+static inline Texel8 Fetch8(const Color *src, __m256i index) {
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	const __m256 inv = _mm256_set1_ps(1.0f / 255.0f);
+	__m256i c = _mm256_i32gather_epi32((const int *)src, index, 4);
+	Texel8 t;
+	t.r = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(c, 16), mask)), inv);
+	t.g = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(c, 8), mask)), inv);
+	t.b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(c, mask)), inv);
+	// FSR's cheap luma: 0.5 r + g + 0.5 b
+	t.l = _mm256_add_ps(t.g, _mm256_mul_ps(_mm256_add_ps(t.r, t.b), _mm256_set1_ps(0.5f)));
+	return t;
+}
+
+static inline __m256 Abs8(__m256 v) {
+	return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+}
+
+// Gradient direction and edge length from one of the four texels around the sample (FsrEasuSetF).
+// lA above, lB left, lC centre, lD right, lE below.
+static inline void EasuSet(__m256 *dirX, __m256 *dirY, __m256 *len, __m256 w,
+						   __m256 lA, __m256 lB, __m256 lC, __m256 lD, __m256 lE) {
+	const __m256 one = _mm256_set1_ps(1.0f), tiny = _mm256_set1_ps(1e-8f);
+	__m256 dX = _mm256_sub_ps(lD, lB);
+	__m256 lenX = _mm256_max_ps(Abs8(_mm256_sub_ps(lD, lC)), Abs8(_mm256_sub_ps(lC, lB)));
+	lenX = _mm256_min_ps(_mm256_div_ps(Abs8(dX), _mm256_max_ps(lenX, tiny)), one);
+	*dirX = _mm256_fmadd_ps(dX, w, *dirX);
+	*len = _mm256_fmadd_ps(_mm256_mul_ps(lenX, lenX), w, *len);
+
+	__m256 dY = _mm256_sub_ps(lE, lA);
+	__m256 lenY = _mm256_max_ps(Abs8(_mm256_sub_ps(lE, lC)), Abs8(_mm256_sub_ps(lC, lA)));
+	lenY = _mm256_min_ps(_mm256_div_ps(Abs8(dY), _mm256_max_ps(lenY, tiny)), one);
+	*dirY = _mm256_fmadd_ps(dY, w, *dirY);
+	*len = _mm256_fmadd_ps(_mm256_mul_ps(lenY, lenY), w, *len);
+}
+
+typedef struct {
+	__m256 r, g, b, w;
+} Accum8;
+
+// One filter tap (FsrEasuTapF): offset rotated into the edge frame, anisotropically
+// scaled, then the windowed approximation of Lanczos2.
+static inline void EasuTap(Accum8 *a, __m256 offX, __m256 offY, __m256 dirX, __m256 dirY,
+						   __m256 len2X, __m256 len2Y, __m256 lob, __m256 clp, const Texel8 *t) {
+	const __m256 one = _mm256_set1_ps(1.0f);
+	__m256 vX = _mm256_mul_ps(_mm256_fmadd_ps(offX, dirX, _mm256_mul_ps(offY, dirY)), len2X);
+	__m256 vY = _mm256_mul_ps(_mm256_fmsub_ps(offY, dirX, _mm256_mul_ps(offX, dirY)), len2Y);
+	__m256 d2 = _mm256_min_ps(_mm256_fmadd_ps(vX, vX, _mm256_mul_ps(vY, vY)), clp);
+	__m256 wB = _mm256_fmsub_ps(_mm256_set1_ps(2.0f / 5.0f), d2, one);
+	__m256 wA = _mm256_fmsub_ps(lob, d2, one);
+	wB = _mm256_mul_ps(wB, wB);
+	wA = _mm256_mul_ps(wA, wA);
+	wB = _mm256_fmsub_ps(_mm256_set1_ps(25.0f / 16.0f), wB, _mm256_set1_ps(25.0f / 16.0f - 1.0f));
+	__m256 w = _mm256_mul_ps(wB, wA);
+	a->r = _mm256_fmadd_ps(t->r, w, a->r);
+	a->g = _mm256_fmadd_ps(t->g, w, a->g);
+	a->b = _mm256_fmadd_ps(t->b, w, a->b);
+	a->w = _mm256_add_ps(a->w, w);
+}
+
+static inline __m256i Pack8(__m256 r, __m256 g, __m256 b) {
+	const __m256 s = _mm256_set1_ps(255.0f), half = _mm256_set1_ps(0.5f);
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+	__m256i ir = _mm256_cvttps_epi32(_mm256_fmadd_ps(_mm256_min_ps(_mm256_max_ps(r, zero), one), s, half));
+	__m256i ig = _mm256_cvttps_epi32(_mm256_fmadd_ps(_mm256_min_ps(_mm256_max_ps(g, zero), one), s, half));
+	__m256i ib = _mm256_cvttps_epi32(_mm256_fmadd_ps(_mm256_min_ps(_mm256_max_ps(b, zero), one), s, half));
+	__m256i c = _mm256_or_si256(_mm256_slli_epi32(ir, 16), _mm256_or_si256(_mm256_slli_epi32(ig, 8), ib));
+	return _mm256_or_si256(c, _mm256_set1_epi32((int)0xFF000000u));
+}
+
+static inline __m256i ClampIndex(__m256i v, int maxIndex) {
+	return _mm256_min_epi32(_mm256_max_epi32(v, _mm256_setzero_si256()), _mm256_set1_epi32(maxIndex));
+}
+
+// 12-tap EASU for 8 consecutive output pixels of one row:
+//     b c
+//   e f g h
+//   i j k l
+//     n o
+// f is the input texel at floor(sample position).
+static void EasuSpan(const FsrUpscaler *fsr, const Color *src, Color *dst, int x, int y) {
+	int W = fsr->inWidth, H = fsr->inHeight;
+	float ppy = (y + 0.5f) * fsr->scaleY - 0.5f;
+	float fpy = floorf(ppy);
+	int iy = (int)fpy;
+	__m256 fy = _mm256_set1_ps(ppy - fpy);
+	int rowM1 = (iy - 1 < 0 ? 0 : (iy - 1 > H - 1 ? H - 1 : iy - 1)) * W;
+	int row0 = (iy < 0 ? 0 : (iy > H - 1 ? H - 1 : iy)) * W;
+	int row1 = (iy + 1 < 0 ? 0 : (iy + 1 > H - 1 ? H - 1 : iy + 1)) * W;
+	int row2 = (iy + 2 < 0 ? 0 : (iy + 2 > H - 1 ? H - 1 : iy + 2)) * W;
+
+	__m256 ppx = _mm256_fmsub_ps(_mm256_add_ps(_mm256_set1_ps(x + 0.5f), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)),
+								 _mm256_set1_ps(fsr->scaleX), _mm256_set1_ps(0.5f));
+	__m256 fpx = _mm256_floor_ps(ppx);
+	__m256 fx = _mm256_sub_ps(ppx, fpx);
+	__m256i ix = _mm256_cvttps_epi32(fpx);
+	__m256i colM1 = ClampIndex(_mm256_sub_epi32(ix, _mm256_set1_epi32(1)), W - 1);
+	__m256i col0 = ClampIndex(ix, W - 1);
+	__m256i col1 = ClampIndex(_mm256_add_epi32(ix, _mm256_set1_epi32(1)), W - 1);
+	__m256i col2 = ClampIndex(_mm256_add_epi32(ix, _mm256_set1_epi32(2)), W - 1);
+	__m256i rM1 = _mm256_set1_epi32(rowM1), r0 = _mm256_set1_epi32(row0);
+	__m256i r1 = _mm256_set1_epi32(row1), r2 = _mm256_set1_epi32(row2);
+
+	Texel8 tb = Fetch8(src, _mm256_add_epi32(rM1, col0));
+	Texel8 tc = Fetch8(src, _mm256_add_epi32(rM1, col1));
+	Texel8 te = Fetch8(src, _mm256_add_epi32(r0, colM1));
+	Texel8 tf = Fetch8(src, _mm256_add_epi32(r0, col0));
+	Texel8 tg = Fetch8(src, _mm256_add_epi32(r0, col1));
+	Texel8 th = Fetch8(src, _mm256_add_epi32(r0, col2));
+	Texel8 ti = Fetch8(src, _mm256_add_epi32(r1, colM1));
+	Texel8 tj = Fetch8(src, _mm256_add_epi32(r1, col0));
+	Texel8 tk = Fetch8(src, _mm256_add_epi32(r1, col1));
+	Texel8 tl = Fetch8(src, _mm256_add_epi32(r1, col2));
+	Texel8 tn = Fetch8(src, _mm256_add_epi32(r2, col0));
+	Texel8 to = Fetch8(src, _mm256_add_epi32(r2, col1));
+
+	// direction and length, bilinearly weighted over f g j k
+	const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+	__m256 ifx = _mm256_sub_ps(one, fx), ify = _mm256_sub_ps(one, fy);
+	__m256 dirX = zero, dirY = zero, len = zero;
+	EasuSet(&dirX, &dirY, &len, _mm256_mul_ps(ifx, ify), tb.l, te.l, tf.l, tg.l, tj.l);
+	EasuSet(&dirX, &dirY, &len, _mm256_mul_ps(fx, ify), tc.l, tf.l, tg.l, th.l, tk.l);
+	EasuSet(&dirX, &dirY, &len, _mm256_mul_ps(ifx, fy), tf.l, ti.l, tj.l, tk.l, tn.l);
+	EasuSet(&dirX, &dirY, &len, _mm256_mul_ps(fx, fy), tg.l, tj.l, tk.l, tl.l, to.l);
+
+	__m256 dir2 = _mm256_fmadd_ps(dirX, dirX, _mm256_mul_ps(dirY, dirY));
+	__m256 flat = _mm256_cmp_ps(dir2, _mm256_set1_ps(1.0f / 32768.0f), _CMP_LT_OQ);
+	__m256 dirR = _mm256_blendv_ps(_mm256_div_ps(one, _mm256_sqrt_ps(_mm256_max_ps(dir2, _mm256_set1_ps(1e-20f)))), one, flat);
+	dirX = _mm256_mul_ps(_mm256_blendv_ps(dirX, one, flat), dirR);
+	dirY = _mm256_mul_ps(dirY, dirR);
+	len = _mm256_mul_ps(len, _mm256_set1_ps(0.5f));
+	len = _mm256_mul_ps(len, len);
+	// stretch 1 on axis-aligned edges, sqrt(2) on diagonals
+	__m256 stretch = _mm256_div_ps(_mm256_fmadd_ps(dirX, dirX, _mm256_mul_ps(dirY, dirY)), _mm256_max_ps(Abs8(dirX), Abs8(dirY)));
+	__m256 len2X = _mm256_fmadd_ps(_mm256_sub_ps(stretch, one), len, one);
+	__m256 len2Y = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), len, one);
+	__m256 lob = _mm256_fmadd_ps(_mm256_set1_ps((1.0f / 4.0f - 0.04f) - 0.5f), len, _mm256_set1_ps(0.5f));
+	__m256 clp = _mm256_div_ps(one, lob);
+
+	Accum8 a = {zero, zero, zero, zero};
+	__m256 m1 = _mm256_set1_ps(-1.0f), p1 = one, p2 = _mm256_set1_ps(2.0f);
+	__m256 oxM1 = _mm256_sub_ps(m1, fx), ox0 = _mm256_sub_ps(zero, fx), ox1 = _mm256_sub_ps(p1, fx), ox2 = _mm256_sub_ps(p2, fx);
+	__m256 oyM1 = _mm256_sub_ps(m1, fy), oy0 = _mm256_sub_ps(zero, fy), oy1 = _mm256_sub_ps(p1, fy), oy2 = _mm256_sub_ps(p2, fy);
+	EasuTap(&a, ox0, oyM1, dirX, dirY, len2X, len2Y, lob, clp, &tb);
+	EasuTap(&a, ox1, oyM1, dirX, dirY, len2X, len2Y, lob, clp, &tc);
+	EasuTap(&a, oxM1, oy1, dirX, dirY, len2X, len2Y, lob, clp, &ti);
+	EasuTap(&a, ox0, oy1, dirX, dirY, len2X, len2Y, lob, clp, &tj);
+	EasuTap(&a, ox0, oy0, dirX, dirY, len2X, len2Y, lob, clp, &tf);
+	EasuTap(&a, oxM1, oy0, dirX, dirY, len2X, len2Y, lob, clp, &te);
+	EasuTap(&a, ox1, oy1, dirX, dirY, len2X, len2Y, lob, clp, &tk);
+	EasuTap(&a, ox2, oy1, dirX, dirY, len2X, len2Y, lob, clp, &tl);
+	EasuTap(&a, ox2, oy0, dirX, dirY, len2X, len2Y, lob, clp, &th);
+	EasuTap(&a, ox1, oy0, dirX, dirY, len2X, len2Y, lob, clp, &tg);
+	EasuTap(&a, ox1, oy2, dirX, dirY, len2X, len2Y, lob, clp, &to);
+	EasuTap(&a, ox0, oy2, dirX, dirY, len2X, len2Y, lob, clp, &tn);
+
+	// deringing: clamp to the range of the 2x2 around the sample
+	__m256 invW = _mm256_div_ps(one, a.w);
+	__m256 r = _mm256_mul_ps(a.r, invW), g = _mm256_mul_ps(a.g, invW), b = _mm256_mul_ps(a.b, invW);
+	r = _mm256_min_ps(_mm256_max_ps(r, _mm256_min_ps(_mm256_min_ps(tf.r, tg.r), _mm256_min_ps(tj.r, tk.r))),
+					  _mm256_max_ps(_mm256_max_ps(tf.r, tg.r), _mm256_max_ps(tj.r, tk.r)));
+	g = _mm256_min_ps(_mm256_max_ps(g, _mm256_min_ps(_mm256_min_ps(tf.g, tg.g), _mm256_min_ps(tj.g, tk.g))),
+					  _mm256_max_ps(_mm256_max_ps(tf.g, tg.g), _mm256_max_ps(tj.g, tk.g)));
+	b = _mm256_min_ps(_mm256_max_ps(b, _mm256_min_ps(_mm256_min_ps(tf.b, tg.b), _mm256_min_ps(tj.b, tk.b))),
+					  _mm256_max_ps(_mm256_max_ps(tf.b, tg.b), _mm256_max_ps(tj.b, tk.b)));
+	_mm256_storeu_si256((__m256i *)&dst[y * fsr->outWidth + x], Pack8(r, g, b));
+}
+
+static void EasuRows(void *arg) {
+	FsrTask *task = arg;
+	const FsrUpscaler *fsr = task->fsr;
+	int W = fsr->outWidth;
+	for (int y = task->row; y < task->row + task->rowCount && y < fsr->outHeight; y++) {
+		// the last span overlaps the previous one instead of running past the row
+		for (int x = 0; x < W; x += 8)
+			EasuSpan(fsr, task->src, task->dst, x + 8 <= W ? x : W - 8, y);
+	}
+}
+
+static inline void Unpack8(__m256i c, __m256 *r, __m256 *g, __m256 *b) {
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	const __m256 inv = _mm256_set1_ps(1.0f / 255.0f);
+	*r = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(c, 16), mask)), inv);
+	*g = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(c, 8), mask)), inv);
+	*b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(c, mask)), inv);
+}
+
+// Per-channel limit on the negative lobe so the sharpened pixel cannot leave [0, 1] (FsrRcasF).
+static inline __m256 RcasLobe(__m256 b, __m256 d, __m256 e, __m256 f, __m256 h) {
+	__m256 mn4 = _mm256_min_ps(_mm256_min_ps(b, d), _mm256_min_ps(f, h));
+	__m256 mx4 = _mm256_max_ps(_mm256_max_ps(b, d), _mm256_max_ps(f, h));
+	__m256 hitMin = _mm256_div_ps(_mm256_min_ps(mn4, e), _mm256_max_ps(_mm256_mul_ps(mx4, _mm256_set1_ps(4.0f)), _mm256_set1_ps(1e-5f)));
+	__m256 hitMax = _mm256_div_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_max_ps(mx4, e)),
+								  _mm256_min_ps(_mm256_fmsub_ps(mn4, _mm256_set1_ps(4.0f), _mm256_set1_ps(4.0f)), _mm256_set1_ps(-1e-5f)));
+	return _mm256_max_ps(_mm256_sub_ps(_mm256_setzero_ps(), hitMin), hitMax);
+}
+
+//   b
+// d e f
+//   h
+static inline __m256i Rcas8(__m256i cb, __m256i cd, __m256i ce, __m256i cf, __m256i ch, __m256 sharpness) {
+	__m256 bR, bG, bB, dR, dG, dB, eR, eG, eB, fR, fG, fB, hR, hG, hB;
+	Unpack8(cb, &bR, &bG, &bB);
+	Unpack8(cd, &dR, &dG, &dB);
+	Unpack8(ce, &eR, &eG, &eB);
+	Unpack8(cf, &fR, &fG, &fB);
+	Unpack8(ch, &hR, &hG, &hB);
+	__m256 lobe = _mm256_max_ps(_mm256_max_ps(RcasLobe(bR, dR, eR, fR, hR), RcasLobe(bG, dG, eG, fG, hG)), RcasLobe(bB, dB, eB, fB, hB));
+	lobe = _mm256_max_ps(_mm256_set1_ps(-FSR_RCAS_LIMIT), _mm256_min_ps(lobe, _mm256_setzero_ps()));
+	lobe = _mm256_mul_ps(lobe, sharpness);
+	__m256 rcpL = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_fmadd_ps(lobe, _mm256_set1_ps(4.0f), _mm256_set1_ps(1.0f)));
+	__m256 r = _mm256_mul_ps(_mm256_fmadd_ps(lobe, _mm256_add_ps(_mm256_add_ps(bR, dR), _mm256_add_ps(fR, hR)), eR), rcpL);
+	__m256 g = _mm256_mul_ps(_mm256_fmadd_ps(lobe, _mm256_add_ps(_mm256_add_ps(bG, dG), _mm256_add_ps(fG, hG)), eG), rcpL);
+	__m256 b = _mm256_mul_ps(_mm256_fmadd_ps(lobe, _mm256_add_ps(_mm256_add_ps(bB, dB), _mm256_add_ps(fB, hB)), eB), rcpL);
+	return Pack8(r, g, b);
+}
+
+static void RcasRows(void *arg) {
+	FsrTask *task = arg;
+	const FsrUpscaler *fsr = task->fsr;
+	int W = fsr->outWidth, H = fsr->outHeight;
+	__m256 sharpness = _mm256_set1_ps(fsr->sharpness);
+
+	for (int y = task->row; y < task->row + task->rowCount && y < H; y++) {
+		const Color *up = &task->src[(y > 0 ? y - 1 : 0) * W];
+		const Color *mid = &task->src[y * W];
+		const Color *down = &task->src[(y + 1 < H ? y + 1 : H - 1) * W];
+		Color *out = &task->dst[y * W];
+		// interior spans cover x = 1 .. W-2, the last one overlapping
+		for (int x = 1; x < W - 1; x += 8) {
+			int sx = x + 8 <= W - 1 ? x : W - 9;
+			__m256i e = _mm256_loadu_si256((const __m256i *)&mid[sx]);
+			__m256i px = Rcas8(_mm256_loadu_si256((const __m256i *)&up[sx]), _mm256_loadu_si256((const __m256i *)&mid[sx - 1]), e,
+							   _mm256_loadu_si256((const __m256i *)&mid[sx + 1]), _mm256_loadu_si256((const __m256i *)&down[sx]), sharpness);
+			_mm256_storeu_si256((__m256i *)&out[sx], px);
+		}
+		// border columns reuse the span kernel with the missing neighbour clamped
+		for (int side = 0; side < 2; side++) {
+			int x = side ? W - 1 : 0;
+			int l = x > 0 ? x - 1 : 0, r = x + 1 < W ? x + 1 : W - 1;
+			__m256i px = Rcas8(_mm256_set1_epi32((int)up[x]), _mm256_set1_epi32((int)mid[l]), _mm256_set1_epi32((int)mid[x]),
+							   _mm256_set1_epi32((int)mid[r]), _mm256_set1_epi32((int)down[x]), sharpness);
+			out[x] = (Color)_mm256_extract_epi32(px, 0);
+		}
+	}
+}
+
+static void RunRows(FsrUpscaler *fsr, ThreadPool *threadPool, task_fn fn, const Color *src, Color *dst) {
+	int taskCount = (fsr->outHeight + FSR_ROWS_PER_TASK - 1) / FSR_ROWS_PER_TASK;
+	for (int t = 0; t < taskCount; t++) {
+		fsr->tasks[t] = (FsrTask){t * FSR_ROWS_PER_TASK, FSR_ROWS_PER_TASK, src, dst, fsr};
+		poolAdd(threadPool, fn, &fsr->tasks[t]);
+	}
+	poolWait(threadPool);
+}
+
+void FsrUpscale(FsrUpscaler *fsr, const Color *src, Color *dst, ThreadPool *threadPool) {
+	if (!fsr || !fsr->tasks || !src || !dst || !threadPool) return;
+	RunRows(fsr, threadPool, EasuRows, src, fsr->easu);
+	RunRows(fsr, threadPool, RcasRows, fsr->easu, dst);
+}
@@ -0,0 +1,39 @@
+#ifndef FSR_H
+#define FSR_H
+
+#include "../../object/format.h"
+#include "../../util/threadPool.h"
+
+// CPU port of FidelityFX FSR1: EASU edge-adaptive upscale from the internal render
+// resolution to the output resolution, then RCAS contrast-adaptive sharpening.
+// Eight output pixels per AVX2 iteration, row bands across the thread pool.
+
+#define FSR_SHARPNESS 1.0f // RCAS strength in stops, 0 = maximum sharpening
+#define FSR_ROWS_PER_TASK 8
+
+typedef struct FsrUpscaler FsrUpscaler;
+
+typedef struct {
+	int row;
+	int rowCount;
+	const Color *src;
+	Color *dst;
+	FsrUpscaler *fsr;
+} FsrTask;
+
+struct FsrUpscaler {
+	int inWidth, inHeight;
+	int outWidth, outHeight;
+	float scaleX, scaleY; // input texels per output pixel
+	float sharpness;	  // linear RCAS lobe scale, exp2(-FSR_SHARPNESS)
+	Color *easu;		  // EASU output, RCAS input (output resolution)
+	FsrTask *tasks;
+};
+
+// On allocation failure every buffer is left NULL and FsrUpscale is a no-op.
+void Fsr_Init(FsrUpscaler *fsr, int inWidth, int inHeight, int outWidth, int outHeight);
+void Fsr_Destroy(FsrUpscaler *fsr);
+// src is inWidth x inHeight, dst is outWidth x outHeight.
+void FsrUpscale(FsrUpscaler *fsr, const Color *src, Color *dst, ThreadPool *threadPool);
+
+#endif // FSR_H
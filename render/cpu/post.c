@@ -0,0 +1,243 @@
+#include "post.h"
+#include <immintrin.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGN64(n) (((n) + 63) & ~(size_t)63)
+#define LUT_N POST_LUT_SIZE
+
+PostParams Post_DefaultParams(void) {
+	return (PostParams){
+		.exposure = 0.0f,
+		.whitePoint = 1.0f,
+		.gamma = 1.0f,
+		.contrast = 1.0f,
+		.saturation = 1.0f,
+		.hueShift = 0.0f,
+		.tint = {1.0f, 1.0f, 1.0f, 0.0f},
+		.ditherAmplitude = 1.0f,
+	};
+}
+
+void Post_Init(PostChain *post, int width, int height, const PostParams *params) {
+	if (!post) return;
+	memset(post, 0, sizeof(PostChain));
+	post->width = width;
+	post->height = height;
+	post->lut = (uint32 *)aligned_alloc(64, ALIGN64((size_t)LUT_N * LUT_N * LUT_N * sizeof(uint32)));
+	post->tasks = (PostTask *)malloc(sizeof(PostTask) * ((height + POST_ROWS_PER_TASK - 1) / POST_ROWS_PER_TASK));
+	if (!post->lut || !post->tasks) {
+		Post_Destroy(post);
+		return;
+	}
+	PostParams defaults = Post_DefaultParams();
+	Post_SetParams(post, params ? params : &defaults);
+}
+
+void Post_Destroy(PostChain *post) {
+	if (!post) return;
+	free(post->lut);
+	free(post->tasks);
+	memset(post, 0, sizeof(PostChain));
+}
+
+static inline float Clamp01(float v) {
+	return fminf(fmaxf(v, 0.0f), 1.0f);
+}
+
+// HSV hue rotation, the float counterpart of HueShiftColor.
+static float3 HueShift(float3 c, float shift) {
+	float r = Clamp01(c.x), g = Clamp01(c.y), b = Clamp01(c.z);
+	float mx = fmaxf(r, fmaxf(g, b)), mn = fminf(r, fminf(g, b));
+	float delta = mx - mn;
+	if (delta < 1e-5f) return c;
+
+	float hue;
+	if (mx == r)
+		hue = (g - b) / delta + (g < b ? 6.0f : 0.0f);
+	else if (mx == g)
+		hue = (b - r) / delta + 2.0f;
+	else
+		hue = (r - g) / delta + 4.0f;
+	hue = hue / 6.0f + shift;
+	hue -= floorf(hue);
+
+	int sector = (int)(hue * 6.0f);
+	float f = hue * 6.0f - sector;
+	float q = mx - f * delta, t = mn + f * delta;
+	switch (sector % 6) {
+	case 0: return (float3){mx, t, mn};
+	case 1: return (float3){q, mx, mn};
+	case 2: return (float3){mn, mx, t};
+	case 3: return (float3){mn, q, mx};
+	case 4: return (float3){t, mn, mx};
+	default: return (float3){mx, mn, q};
+	}
+}
+
+// Grade stages of ApplyColorCorrection in float, without its 8-bit round trip per stage.
+static float3 Grade(const PostParams *p, float3 c) {
+	float invGamma = 1.0f / p->gamma;
+	c = (float3){powf(c.x, invGamma), powf(c.y, invGamma), powf(c.z, invGamma)};
+	c = (float3){(c.x - 0.5f) * p->contrast + 0.5f, (c.y - 0.5f) * p->contrast + 0.5f, (c.z - 0.5f) * p->contrast + 0.5f};
+	float gray = 0.299f * c.x + 0.587f * c.y + 0.114f * c.z;
+	float s = p->saturation;
+	c = (float3){c.x * s + gray * (1.0f - s), c.y * s + gray * (1.0f - s), c.z * s + gray * (1.0f - s)};
+	if (p->hueShift != 0.0f) c = HueShift(c, p->hueShift);
+	return (float3){Clamp01(c.x * p->tint.x), Clamp01(c.y * p->tint.y), Clamp01(c.z * p->tint.z)};
+}
+
+void Post_SetParams(PostChain *post, const PostParams *params) {
+	if (!post || !post->lut || !params) return;
+	post->params = *params;
+	post->exposureScale = exp2f(params->exposure);
+	float white = params->whitePoint > 1e-3f ? params->whitePoint : 1e-3f;
+	post->invWhite2 = 1.0f / (white * white);
+
+	const float step = 1.0f / (LUT_N - 1);
+	for (int b = 0; b < LUT_N; b++) {
+		for (int g = 0; g < LUT_N; g++) {
+			for (int r = 0; r < LUT_N; r++) {
+				float3 c = Grade(params, (float3){r * step, g * step, b * step});
+				uint32 ir = (uint32)(c.x * 1023.0f + 0.5f);
+				uint32 ig = (uint32)(c.y * 1023.0f + 0.5f);
+				uint32 ib = (uint32)(c.z * 1023.0f + 0.5f);
+				post->lut[(b * LUT_N + g) * LUT_N + r] = (ir << 20) | (ig << 10) | ib;
+			}
+		}
+	}
+}
+
+typedef struct {
+	__m256 r, g, b;
+} Rgb8;
+
+static inline Rgb8 LutTexel(const uint32 *lut, __m256i index) {
+	const __m256i mask = _mm256_set1_epi32(1023);
+	__m256i e = _mm256_i32gather_epi32((const int *)lut, index, 4);
+	return (Rgb8){_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(e, 20), mask)),
+				  _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(e, 10), mask)),
+				  _mm256_cvtepi32_ps(_mm256_and_si256(e, mask))};
+}
+
+static inline Rgb8 Lerp8(Rgb8 a, Rgb8 b, __m256 t) {
+	return (Rgb8){_mm256_fmadd_ps(_mm256_sub_ps(b.r, a.r), t, a.r),
+				  _mm256_fmadd_ps(_mm256_sub_ps(b.g, a.g), t, a.g),
+				  _mm256_fmadd_ps(_mm256_sub_ps(b.b, a.b), t, a.b)};
+}
+
+// Extended Reinhard per channel: x (1 + x / w^2) / (1 + x), then clamped for the LUT.
+static inline __m256 ToneMap8(__m256 x, __m256 invWhite2) {
+	const __m256 one = _mm256_set1_ps(1.0f);
+	__m256 t = _mm256_div_ps(_mm256_mul_ps(x, _mm256_fmadd_ps(x, invWhite2, one)), _mm256_add_ps(x, one));
+	return _mm256_min_ps(_mm256_max_ps(t, _mm256_setzero_ps()), one);
+}
+
+// Eight half4 pixels to planar r, g, b; lanes stay in pixel order.
+static inline void LoadHdr8(const half4 *p, __m256 *r, __m256 *g, __m256 *b) {
+	__m128i a = _mm_loadu_si128((const __m128i *)p), c = _mm_loadu_si128((const __m128i *)(p + 2));
+	__m128i d = _mm_loadu_si128((const __m128i *)(p + 4)), e = _mm_loadu_si128((const __m128i *)(p + 6));
+	// pixel i in the low half, i + 4 in the high half
+	__m256 p0 = _mm256_cvtph_ps(_mm_unpacklo_epi64(a, d)), p1 = _mm256_cvtph_ps(_mm_unpackhi_epi64(a, d));
+	__m256 p2 = _mm256_cvtph_ps(_mm_unpacklo_epi64(c, e)), p3 = _mm256_cvtph_ps(_mm_unpackhi_epi64(c, e));
+	__m256 rg01 = _mm256_unpacklo_ps(p0, p1), ba01 = _mm256_unpackhi_ps(p0, p1);
+	__m256 rg23 = _mm256_unpacklo_ps(p2, p3), ba23 = _mm256_unpackhi_ps(p2, p3);
+	*r = _mm256_shuffle_ps(rg01, rg23, _MM_SHUFFLE(1, 0, 1, 0));
+	*g = _mm256_shuffle_ps(rg01, rg23, _MM_SHUFFLE(3, 2, 3, 2));
+	*b = _mm256_shuffle_ps(ba01, ba23, _MM_SHUFFLE(1, 0, 1, 0));
+}
+
+static void PostRows(void *arg) {
+	PostTask *task = arg;
+	const PostChain *post = task->post;
+	int W = post->width;
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	const __m256 exposure = _mm256_set1_ps(post->exposureScale);
+	const __m256 invWhite2 = _mm256_set1_ps(post->invWhite2);
+	const __m256 white = _mm256_set1_ps(1.0f / sqrtf(post->invWhite2));
+	const __m256 lutScale = _mm256_set1_ps((float)(LUT_N - 1));
+	const __m256i lutLast = _mm256_set1_epi32(LUT_N - 2);
+	const __m256 outScale = _mm256_set1_ps(255.0f / 1023.0f);
+	const float amp = post->params.ditherAmplitude;
+	const __m256 noiseScale = _mm256_set1_ps(amp / 65536.0f);
+	const __m256 noiseBias = _mm256_set1_ps(0.5f - 0.5f * amp); // +0.5 rounds, noise centred on 0
+	const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	for (int y = task->row; y < task->row + task->rowCount && y < post->height; y++) {
+		const half4 *srcRow = task->src + (size_t)y * W;
+		Color *dstRow = task->dst + (size_t)y * W;
+		__m256i rowHash = _mm256_set1_epi32((int)((uint32)y * 31337u + (uint32)task->frame * 6791u));
+		for (int x = 0; x < W; x += 8) {
+			int n = W - x < 8 ? W - x : 8;
+			half4 tailIn[8] = {0};
+			Color tailOut[8];
+			const half4 *in = srcRow + x;
+			Color *out = dstRow + x;
+			if (n < 8) {
+				memcpy(tailIn, in, n * sizeof(half4));
+				in = tailIn;
+				out = tailOut;
+			}
+
+			// exposure, overflow past white spread to the other channels, tone map
+			__m256 r, g, b;
+			LoadHdr8(in, &r, &g, &b);
+			r = _mm256_max_ps(_mm256_mul_ps(r, exposure), _mm256_setzero_ps());
+			g = _mm256_max_ps(_mm256_mul_ps(g, exposure), _mm256_setzero_ps());
+			b = _mm256_max_ps(_mm256_mul_ps(b, exposure), _mm256_setzero_ps());
+			__m256 over = _mm256_max_ps(_mm256_sub_ps(_mm256_max_ps(r, _mm256_max_ps(g, b)), white), _mm256_setzero_ps());
+			r = ToneMap8(_mm256_add_ps(r, over), invWhite2);
+			g = ToneMap8(_mm256_add_ps(g, over), invWhite2);
+			b = ToneMap8(_mm256_add_ps(b, over), invWhite2);
+
+			// grade: trilinear LUT lookup
+			r = _mm256_mul_ps(r, lutScale);
+			g = _mm256_mul_ps(g, lutScale);
+			b = _mm256_mul_ps(b, lutScale);
+			__m256i ir = _mm256_min_epi32(_mm256_cvttps_epi32(r), lutLast);
+			__m256i ig = _mm256_min_epi32(_mm256_cvttps_epi32(g), lutLast);
+			__m256i ib = _mm256_min_epi32(_mm256_cvttps_epi32(b), lutLast);
+			__m256 fr = _mm256_sub_ps(r, _mm256_cvtepi32_ps(ir));
+			__m256 fg = _mm256_sub_ps(g, _mm256_cvtepi32_ps(ig));
+			__m256 fb = _mm256_sub_ps(b, _mm256_cvtepi32_ps(ib));
+			__m256i base = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(ib, _mm256_set1_epi32(LUT_N)), ig),
+															   _mm256_set1_epi32(LUT_N)),
+											ir);
+			const __m256i dr = _mm256_set1_epi32(1), dg = _mm256_set1_epi32(LUT_N), db = _mm256_set1_epi32(LUT_N * LUT_N);
+			__m256i baseB = _mm256_add_epi32(base, db);
+			Rgb8 c00 = Lerp8(LutTexel(post->lut, base), LutTexel(post->lut, _mm256_add_epi32(base, dr)), fr);
+			Rgb8 c10 = Lerp8(LutTexel(post->lut, _mm256_add_epi32(base, dg)), LutTexel(post->lut, _mm256_add_epi32(base, _mm256_add_epi32(dg, dr))), fr);
+			Rgb8 c01 = Lerp8(LutTexel(post->lut, baseB), LutTexel(post->lut, _mm256_add_epi32(baseB, dr)), fr);
+			Rgb8 c11 = Lerp8(LutTexel(post->lut, _mm256_add_epi32(baseB, dg)), LutTexel(post->lut, _mm256_add_epi32(baseB, _mm256_add_epi32(dg, dr))), fr);
+			Rgb8 graded = Lerp8(Lerp8(c00, c10, fg), Lerp8(c01, c11, fg), fb);
+
+			// dither: per-pixel, per-frame hash (as DitherPostProcess), then pack
+			__m256i h = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(_mm256_set1_epi32(x), lane), _mm256_set1_epi32(1619)), rowHash);
+			h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+			h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0x45d9f3b));
+			h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+			__m256 noise = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_and_si256(h, _mm256_set1_epi32(0xFFFF))), noiseScale, noiseBias);
+			__m256i pr = _mm256_cvttps_epi32(_mm256_max_ps(_mm256_fmadd_ps(graded.r, outScale, noise), _mm256_setzero_ps()));
+			__m256i pg = _mm256_cvttps_epi32(_mm256_max_ps(_mm256_fmadd_ps(graded.g, outScale, noise), _mm256_setzero_ps()));
+			__m256i pb = _mm256_cvttps_epi32(_mm256_max_ps(_mm256_fmadd_ps(graded.b, outScale, noise), _mm256_setzero_ps()));
+			pr = _mm256_min_epi32(pr, mask);
+			pg = _mm256_min_epi32(pg, mask);
+			pb = _mm256_min_epi32(pb, mask);
+			__m256i packed = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(pr, 16), _mm256_slli_epi32(pg, 8)), pb);
+			packed = _mm256_or_si256(packed, _mm256_set1_epi32((int)0xFF000000u));
+			_mm256_storeu_si256((__m256i *)out, packed);
+			if (n < 8) memcpy(dstRow + x, tailOut, n * sizeof(Color));
+		}
+	}
+}
+
+void PostProcess(PostChain *post, const half4 *src, Color *dst, ThreadPool *threadPool, int frame) {
+	if (!post || !post->tasks || !src || !dst || !threadPool) return;
+	int taskCount = (post->height + POST_ROWS_PER_TASK - 1) / POST_ROWS_PER_TASK;
+	for (int t = 0; t < taskCount; t++) {
+		post->tasks[t] = (PostTask){t * POST_ROWS_PER_TASK, POST_ROWS_PER_TASK, src, dst, frame, post};
+		poolAdd(threadPool, PostRows, &post->tasks[t]);
+	}
+	poolWait(threadPool);
+}
@@ -0,0 +1,56 @@
+#ifndef POST_H
+#define POST_H
+
+#include "../../object/format.h"
+#include "../../util/threadPool.h"
+
+// Fused output pass: exposure, tone map, colour grade, dither and pack in a single
+// read of the linear hdrBuffer and write of the 8-bit framebuffer, eight pixels per AVX2
+// iteration. Everything after the tone map (gamma, contrast, saturation, hue, tint) is
+// baked into a 3D LUT. This is the only place the working colour is quantized.
+
+#define POST_LUT_SIZE 32 // texels per LUT axis
+#define POST_ROWS_PER_TASK 8
+
+typedef struct {
+	float exposure;		   // stops
+	float whitePoint;	   // extended Reinhard white, 1 = identity on [0, 1] input; overflow past it whitens
+	float gamma;		   // applied as pow(x, 1 / gamma)
+	float contrast;		   // around mid grey, 1 = unchanged
+	float saturation;	   // 1 = unchanged, 0 = grey
+	float hueShift;		   // in turns
+	float3 tint;		   // per-channel multiply
+	float ditherAmplitude; // in output LSBs, 0 disables
+} PostParams;
+
+typedef struct PostChain PostChain;
+
+typedef struct {
+	int row;
+	int rowCount;
+	const half4 *src;
+	Color *dst;
+	int frame;
+	PostChain *post;
+} PostTask;
+
+struct PostChain {
+	int width, height;
+	PostParams params;
+	float exposureScale;
+	float invWhite2;
+	uint32 *lut; // POST_LUT_SIZE^3, 10:10:10 (r at bit 20, b at bit 0), r fastest
+	PostTask *tasks;
+};
+
+// Neutral grade: output equals input apart from dithering.
+PostParams Post_DefaultParams(void);
+// On allocation failure every buffer is left NULL and PostProcess is a no-op.
+void Post_Init(PostChain *post, int width, int height, const PostParams *params);
+void Post_Destroy(PostChain *post);
+// Rebakes the LUT; call only between frames.
+void Post_SetParams(PostChain *post, const PostParams *params);
+// src and dst are width x height. frame varies the dither pattern.
+void PostProcess(PostChain *post, const half4 *src, Color *dst, ThreadPool *threadPool, int frame);
+
+#endif // POST_H
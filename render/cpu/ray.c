@@ -1,6 +1,7 @@
 #include "ray.h"
 
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -12,6 +13,13 @@
 #include "../../util/threadPool.h"
 #include "../../image/imgMethods.h"
 
+// Camera buffers written by the single-pass tracers and the deferred stages, see Camera_Require.
+#define FORWARD_BUFFERS (CAMERA_FRAMEBUFFER | CAMERA_DEPTH | CAMERA_NORMAL | CAMERA_REFLECT | CAMERA_BLOOM | CAMERA_UV | CAMERA_MOTION | CAMERA_OBJECT_ID | CAMERA_TRIANGLE_ID)
+#define VISIBILITY_BUFFERS (CAMERA_DEPTH | CAMERA_OBJECT_ID | CAMERA_TRIANGLE_ID | CAMERA_BARY)
+#define SHADE_BUFFERS (VISIBILITY_BUFFERS | CAMERA_HDR | CAMERA_NORMAL | CAMERA_REFLECT | CAMERA_BLOOM | CAMERA_UV | CAMERA_MOTION | CAMERA_EMISSION_SIGNAL | \
+					   CAMERA_REFLECTION_SIGNAL | CAMERA_SECONDARY_EMISSION | CAMERA_SECONDARY_REFLECTION | CAMERA_SECONDARY_PIXEL | CAMERA_SSR_REFLECTION)
+#define COMPOSITE_BUFFERS (CAMERA_HDR | CAMERA_REFLECT | CAMERA_BLOOM | CAMERA_OBJECT_ID | CAMERA_EMISSION_SIGNAL | CAMERA_REFLECTION_SIGNAL)
+
 static inline Color PackColorFast01(float3 color) {
 	uint8 r = (uint8)(color.x * 255.0f);
 	uint8 g = (uint8)(color.y * 255.0f);
@@ -172,6 +180,8 @@ float3 ComputeRayDirection(const Camera *camera, int pixelX, int pixelY) {
 
 void ShadowPostProcess(const Object *objects, int objectCount, Camera *camera, const int resolution, const int frameInterval) {
 	if (!objects || objectCount <= 0 || !camera) return;
+	if (!Camera_Require(camera, CAMERA_FRAMEBUFFER | CAMERA_DEPTH | CAMERA_NORMAL | CAMERA_REFLECT | CAMERA_REFLECT_CACHE |
+									CAMERA_TEMP_FRAMEBUFFER | CAMERA_TEMP_1 | CAMERA_TEMP_2 | CAMERA_SHADOW_CACHE)) return;
 	int width = camera->screenWidth;
 	int height = camera->screenHeight;
 	int size = width * height;
@@ -184,6 +194,7 @@ void ShadowPostProcess(const Object *objects, int objectCount, Camera *camera, c
 		float bias = 0.01f;
 		int step = MaxF32(1, resolution);
 		const Color skyColor = 0x007FB2FFu;
+		PixelRays rays = Camera_PixelRays(camera);
 
 		for (int i = 0; i < size; i++)
 			camera->tempBuffer_1[i] = 1.0f;
@@ -194,8 +205,8 @@ void ShadowPostProcess(const Object *objects, int objectCount, Camera *camera, c
 				int idx = y * width + x;
 				if (camera->depthBuffer[idx] >= DEPTH_FAR || camera->depthBuffer[idx] <= 0.0f) continue;
 
-				float3 worldPos = camera->positionBuffer[idx];
-				float3 normal = camera->normalBuffer[idx];
+				float3 worldPos = PixelRays_Position(&rays, x, y, camera->depthBuffer[idx]);
+				float3 normal = UnpackNormal(camera->normalBuffer[idx]);
 
 				// if (normal.y < 0.5f) continue;
 
@@ -206,7 +217,7 @@ void ShadowPostProcess(const Object *objects, int objectCount, Camera *camera, c
 						for (int dx = 0; dx < step && x + dx < width; dx++) {
 							int fillIdx = (y + dy) * width + (x + dx);
 							if (camera->depthBuffer[fillIdx] < DEPTH_FAR && camera->depthBuffer[fillIdx] > 0.0f) {
-								float3 fillNormal = camera->normalBuffer[fillIdx];
+								float3 fillNormal = UnpackNormal(camera->normalBuffer[fillIdx]);
 								if (fillNormal.y >= 0.5f)
 									camera->tempBuffer_1[fillIdx] = 0.0f;
 							}
@@ -214,7 +225,7 @@ void ShadowPostProcess(const Object *objects, int objectCount, Camera *camera, c
 					}
 				}
 
-				float3 reflDir = camera->reflectBuffer[idx];
+				float3 reflDir = UnpackHalf4(camera->reflectBuffer[idx]);
 				Color reflectionColor = IntersectBBoxColor(objects, objectCount, biasedPos, reflDir);
 				Color blendColor = reflectionColor != 0 ? reflectionColor : skyColor;
 
@@ -313,7 +324,7 @@ static void SkyBoxTaskFunc(void *arg) {
 		}
 
 		// Geometry hit — blend sky reflection weighted by Fresnel angle of incidence
-		float3 reflDir = camera->reflectBuffer[idx];
+		float3 reflDir = UnpackHalf4(camera->reflectBuffer[idx]);
 		Color skyColor = SampleSkybox(skybox, reflDir);
 		float reflStr = camera->tempBuffer_2[idx];
 		uint32 t = (uint32)(reflStr * 255.0f);
@@ -329,6 +340,7 @@ static void SkyBoxTaskFunc(void *arg) {
 // NOTE: Not used in main render loop
 void applySkybox(const Skybox *skybox, Camera *camera, ThreadPool *threadPool, SkyBoxTaskQueue *taskQueue) {
 	if (!skybox || !camera || !threadPool || !taskQueue) return;
+	if (!Camera_Require(camera, CAMERA_FRAMEBUFFER | CAMERA_DEPTH | CAMERA_REFLECT | CAMERA_TEMP_2)) return;
 	// interleave top/bottom rows so fast sky rows and slow geometry rows are spread through the queue
 	for (int i = 0; i < camera->screenHeight; i++) {
 		int row = (i % 2 == 0) ? (i / 2) : (camera->screenHeight - 1 - i / 2);
@@ -547,6 +559,17 @@ typedef struct uvCoordinates {
 	uint16 y;
 } uvCoordinates;
 
+// Texel for barycentrics (bu, bv, bw) of a triangle: interpolate stored [0..65535] UV coords,
+// then map to [0..TEXTURE_SIZE-1]
+static inline uvCoordinates TexelCoordinates(const UvCords uvCords, float bu, float bv, float bw) {
+	float u = bu * uvCords.uv1x + bv * uvCords.uv2x + bw * uvCords.uv3x;
+	float v = bu * uvCords.uv1y + bv * uvCords.uv2y + bw * uvCords.uv3y;
+	return (uvCoordinates){
+		(uint16)(u * (TEXTURE_SIZE - 1) / 65535.0f),
+		(uint16)(v * (TEXTURE_SIZE - 1) / 65535.0f),
+	};
+}
+
 // Calculate x and y for sampling a texture for given hit point and triangle
 static inline uvCoordinates calculateUvCoordinatesForTriangle(const float3 hitPos, const float3 v0, const float3 v1, const float3 v2, const UvCords uvCords) {
 	float3 edge1 = Float3_Sub(v1, v0);
@@ -565,15 +588,140 @@ static inline uvCoordinates calculateUvCoordinatesForTriangle(const float3 hitPo
 	float invDenom = 1.0f / denom;
 	float bv = (d11 * d20 - d01 * d21) * invDenom;
 	float bw = (d00 * d21 - d01 * d20) * invDenom;
-	float bu = 1.0f - bv - bw;
+	return TexelCoordinates(uvCords, 1.0f - bv - bw, bv, bw);
+}
 
-	// interpolate stored [0..65535] UV coords, then map to [0..TEXTURE_SIZE-1]
-	float u = bu * uvCords.uv1x + bv * uvCords.uv2x + bw * uvCords.uv3x;
-	float v = bu * uvCords.uv1y + bv * uvCords.uv2y + bw * uvCords.uv3y;
-	return (uvCoordinates){
-		(uint16)(u * (TEXTURE_SIZE - 1) / 65535.0f),
-		(uint16)(v * (TEXTURE_SIZE - 1) / 65535.0f),
+static inline float3 ObjectWorldToLocal(const Object *obj, float3 p) {
+	float3 t = {p.x - obj->position.x, p.y - obj->position.y, p.z - obj->position.z};
+	float3 r0 = obj->_invScale, r1 = obj->_invRotSin, r2 = obj->_invRotCos;
+	return (float3){
+		r0.x * t.x + r0.y * t.y + r0.z * t.z,
+		r1.x * t.x + r1.y * t.y + r1.z * t.z,
+		r2.x * t.x + r2.y * t.y + r2.z * t.z};
+}
+
+static inline float3 ObjectRotateDir(const Object *obj, float3 d) {
+	return (float3){
+		obj->_fwdRot0.x * d.x + obj->_fwdRot0.y * d.y + obj->_fwdRot0.z * d.z,
+		obj->_fwdRot1.x * d.x + obj->_fwdRot1.y * d.y + obj->_fwdRot1.z * d.z,
+		obj->_fwdRot2.x * d.x + obj->_fwdRot2.y * d.y + obj->_fwdRot2.z * d.z};
+}
+
+// Shading inputs at a primary hit
+typedef struct {
+	float3 color;
+	float3 normal; // world space, normal map applied
+	float roughness;
+	float metallic;
+	float emission;
+} Surface;
+
+// Resolves triangle tri of obj for shading: the material values, replaced by texel when the
+// triangle is textured (NULL otherwise), and the face normal bent by the texel's normal map.
+// The forward row and column renderers and the deferred shade pass all go through here, so
+// they only differ in how they find the hit and the material.
+static Surface ResolveSurface(const Object *obj, int tri, float3 color, float roughness, float metallic, float emission, const Texel *texel) {
+	Surface s = {
+		.color = color,
+		.normal = ObjectRotateDir(obj, obj->normals[tri]),
+		.roughness = roughness,
+		.metallic = metallic,
+		.emission = emission * 0.01f, // scale down emission to prevent it from dominating the lighting
 	};
+	float3 n = s.normal;
+	float nlen = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+	if (nlen > 1e-6f) {
+		float ni = 1.0f / nlen;
+		n.x *= ni;
+		n.y *= ni;
+		n.z *= ni;
+	}
+	s.normal = n;
+	if (!texel) return s;
+
+	// Texture maps are stored R=bits[0..7], G=bits[8..15], B=bits[16..23]
+	// UnpackColor reads R from bits[16..23], so channels would be swapped — extract directly.
+	// boost texture color a bit to make it more visible
+	s.color = (float3){
+		(texel->color & 0xFF) / 255.0f * 1.25f,
+		((texel->color >> 8) & 0xFF) / 255.0f * 1.25f,
+		((texel->color >> 16) & 0xFF) / 255.0f * 1.25f,
+	};
+	// map_Ns holds a standard roughness map (white = rough) — do not invert
+	s.roughness = (texel->material & 0xFF) / 255.0f;
+	s.metallic = ((texel->material >> 8) & 0xFF) / 255.0f;
+	if (s.metallic > 0.25f) s.metallic = 0.25f + (s.metallic - 0.25f) * 0.75f; // compress metallic range to prevent it from dominating the lighting
+
+	// decode tangent-space normal from [0,1] -> [-1,1]
+	// negate Y: Go flips V (vc = 1-v), which negates dV and thus B, inverting normal.y
+	float3 nTex = {
+		(texel->normal & 0xFF) / 255.0f * 2.0f - 1.0f,
+		-((((texel->normal >> 8) & 0xFF) / 255.0f) * 2.0f - 1.0f),
+		((texel->normal >> 16) & 0xFF) / 255.0f * 2.0f - 1.0f,
+	};
+	float nTexLen = Float3_Length(nTex);
+	if (nTexLen <= 1e-3f) return s;
+
+	UvCords uvCords = obj->uvs[tri];
+	float dU1 = ((int)uvCords.uv2x - (int)uvCords.uv1x) / 65535.0f;
+	float dV1 = ((int)uvCords.uv2y - (int)uvCords.uv1y) / 65535.0f;
+	float dU2 = ((int)uvCords.uv3x - (int)uvCords.uv1x) / 65535.0f;
+	float dV2 = ((int)uvCords.uv3y - (int)uvCords.uv1y) / 65535.0f;
+	float3 edge1 = Float3_Sub(obj->v2[tri], obj->v1[tri]);
+	float3 edge2 = Float3_Sub(obj->v3[tri], obj->v1[tri]);
+	float det = dU1 * dV2 - dU2 * dV1;
+	float3 T, B;
+	if (fabsf(det) > 1e-6f) {
+		float inv = 1.0f / det;
+		float3 tRaw = {
+			(dV2 * edge1.x - dV1 * edge2.x) * inv,
+			(dV2 * edge1.y - dV1 * edge2.y) * inv,
+			(dV2 * edge1.z - dV1 * edge2.z) * inv,
+		};
+		// rotate tangent to world space, same transform as normals, then Gram-Schmidt against n
+		float3 tWorld = ObjectRotateDir(obj, tRaw);
+		T = Float3_Normalize(Float3_Sub(tWorld, Float3_Scale(n, Float3_Dot(tWorld, n))));
+	} else {
+		// degenerate UVs — build arbitrary frame from n
+		float3 up = fabsf(n.y) < 0.9f ? (float3){0.0f, 1.0f, 0.0f} : (float3){1.0f, 0.0f, 0.0f};
+		T = Float3_Normalize(Float3_Cross(up, n));
+	}
+	B = Float3_Cross(n, T);
+	float3 nTexN = Float3_Normalize((float3){nTex.x * NORMAL_MAP_STRENGTH / nTexLen, nTex.y * NORMAL_MAP_STRENGTH / nTexLen, nTex.z / nTexLen});
+	s.normal = Float3_Normalize((float3){
+		T.x * nTexN.x + B.x * nTexN.y + n.x * nTexN.z,
+		T.y * nTexN.x + B.y * nTexN.y + n.y * nTexN.z,
+		T.z * nTexN.x + B.z * nTexN.y + n.z * nTexN.z,
+	});
+	return s;
+}
+
+// Surface from a MaterialLib entry, as the forward renderers look it up
+static Surface ResolveSurfaceLib(const Object *obj, int tri, float3 hitPos, const MaterialLib *lib) {
+	int matId = (lib && obj->materialIds) ? obj->materialIds[tri] : -1;
+	if (matId < 0 || matId >= (lib ? lib->count : 0)) return ResolveSurface(obj, tri, (float3){0.8f, 0.8f, 0.8f}, 0.8f, 0.0f, 0.0f, NULL);
+	const Material *mat = &lib->entries[matId];
+	const Texel *texel = NULL;
+	if (obj->hasTexture && obj->uvs && mat->textures) {
+		// barycentric needs local-space coords — transform world hit back to local
+		float3 localHit = InverseTransformPointTRS(hitPos, obj->position, obj->rotation, obj->scale);
+		uvCoordinates xy = calculateUvCoordinatesForTriangle(localHit, obj->v1[tri], obj->v2[tri], obj->v3[tri], obj->uvs[tri]);
+		texel = Textures_Fetch(mat->textures, xy.x, xy.y);
+	}
+	return ResolveSurface(obj, tri, mat->color, mat->roughness, mat->metallic, mat->emission, texel);
+}
+
+// Adds what emitter (dist away along toEmissive) casts onto a surface at p with normal n
+static inline void AddEmitterLight(const Object *objects, int objectCount, float3 p, float3 n, float3 toEmissive, float dist, int emitter, const MaterialLib *lib, float3 *accumulated) {
+	// NdotL: only surfaces facing the emitter receive light
+	float3 toEmissiveN = Float3_Normalize(toEmissive);
+	float NdotL = fabsf(n.x * toEmissiveN.x + n.y * toEmissiveN.y + n.z * toEmissiveN.z);
+	if (NdotL <= 0.0f) return;
+	float3 em = SampleEmission(objects, objectCount, p, toEmissive, emitter, lib);
+	float falloff = NdotL / (dist * dist + 1e-6f);
+	accumulated->x += em.x * falloff;
+	accumulated->y += em.y * falloff;
+	accumulated->z += em.z * falloff;
 }
 
 static void RayTraceRowFunc(void *arg) {
@@ -604,7 +752,10 @@ static void RayTraceRowFunc(void *arg) {
 	float prevFov = camera->prevFovScale;
 
 	// precompute per-row ray base and per-pixel right step
-	float ndcY = 1.0f - (row + 0.5f) / (float)height * 2.0f;
+	// sub-pixel jitter from the camera (TAA), applied to every primary ray of the row
+	float jitterX = camera->jitter.x;
+	float jitterY = camera->jitter.y;
+	float ndcY = 1.0f - (row + 0.5f + jitterY) / (float)height * 2.0f;
 	float yscale = ndcY * fovScale;
 	float rx = fwd.x + up_.x * yscale;
 	float ry = fwd.y + up_.y * yscale;
@@ -646,7 +797,7 @@ static void RayTraceRowFunc(void *arg) {
 	for (int x = 0; x < width; x++) {
 		int idx = row * width + x;
 
-		float ndcX = (x + 0.5f) / (float)width * 2.0f - 1.0f;
+		float ndcX = (x + 0.5f + jitterX) / (float)width * 2.0f - 1.0f;
 		float dx = rx + sx * ndcX;
 		float dy = ry + sy * ndcX;
 		float dz = rz + sz * ndcX;
@@ -711,146 +862,19 @@ static void RayTraceRowFunc(void *arg) {
 
 		const Object *obj = &objects[bestObj];
 
-		float3 v0, v1, v2;
-		v0 = obj->v1[bestTri];
-		v1 = obj->v2[bestTri];
-		v2 = obj->v3[bestTri];
+		float3 v0 = obj->v1[bestTri];
+		float3 v1 = obj->v2[bestTri];
+		float3 v2 = obj->v3[bestTri];
 
-		// check if object has textures
-		uvCoordinates xyCordsTexture = {0, 0};
-		bool hasTexture = obj->hasTexture;
-
-		if (hasTexture) {
-			// barycentric needs local-space coords — transform world hit back to local
-			float3 localHit = InverseTransformPointTRS(bestHitPos, obj->position, obj->rotation, obj->scale);
-			xyCordsTexture = calculateUvCoordinatesForTriangle(localHit, v0, v1, v2, obj->uvs[bestTri]);
-		}
-
-		float3 ln = obj->normals[bestTri];
-		float3 n = {
-			obj->_fwdRot0.x * ln.x + obj->_fwdRot0.y * ln.y + obj->_fwdRot0.z * ln.z,
-			obj->_fwdRot1.x * ln.x + obj->_fwdRot1.y * ln.y + obj->_fwdRot1.z * ln.z,
-			obj->_fwdRot2.x * ln.x + obj->_fwdRot2.y * ln.y + obj->_fwdRot2.z * ln.z};
-		float nlen = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
-		if (nlen > 1e-6f) {
-			float ni = 1.0f / nlen;
-			n.x *= ni;
-			n.y *= ni;
-			n.z *= ni;
-		}
-
-		float3 color = {0.8f, 0.8f, 0.8f};
-		float emission = 0.0f;
-		float roughness = 0.8f;
-		float metallic = 0.0f;
-
-		// texture data
-		float3 normalFromTexture_Float3 = {0.0f, 0.0f, 0.0f};
-		float3 colorFromTexture_Float3 = {0.0f, 0.0f, 0.0f};
-		float roughnessFromTexture_Float = 0.0f;
-		float metallicFromTexture_Float = 0.0f;
-
-		if (lib && obj->materialIds) {
-			int matId = obj->materialIds[bestTri];
-			if (matId >= 0 && matId < lib->count) {
-				color = lib->entries[matId].color;
-				// emission = lib->entries[matId].emission;
-				emission = lib->entries[matId].emission * 0.01f; // scale down emission to prevent it from dominating the lighting
-				metallic = lib->entries[matId].metallic;
-				roughness = lib->entries[matId].roughness;
-
-				if (hasTexture && lib->entries[matId].textures) {
-					Color colorFromTexture = lib->entries[matId].textures->colorMap[xyCordsTexture.y][xyCordsTexture.x];
-					Color normalFromTexture = lib->entries[matId].textures->normalMap[xyCordsTexture.y][xyCordsTexture.x];
-					uint16 roughnessAndMetallicFromTexture = lib->entries[matId].textures->MaterialMap[xyCordsTexture.y][xyCordsTexture.x];
-
-					// Texture maps are stored R=bits[0..7], G=bits[8..15], B=bits[16..23]
-					// UnpackColor reads R from bits[16..23], so channels would be swapped — extract directly.
-					colorFromTexture_Float3 = (float3){
-						(colorFromTexture & 0xFF) / 255.0f,
-						((colorFromTexture >> 8) & 0xFF) / 255.0f,
-						((colorFromTexture >> 16) & 0xFF) / 255.0f,
-					};
-					normalFromTexture_Float3 = (float3){
-						(normalFromTexture & 0xFF) / 255.0f,
-						((normalFromTexture >> 8) & 0xFF) / 255.0f,
-						((normalFromTexture >> 16) & 0xFF) / 255.0f,
-					};
-
-					colorFromTexture_Float3 = Float3_Scale(colorFromTexture_Float3, 1.25f); // boost texture color a bit to make it more visible
-
-					uint8 roughnessFromTexture = roughnessAndMetallicFromTexture & 0xFF;
-					uint8 metallicFromTexture = (roughnessAndMetallicFromTexture >> 8) & 0xFF;
-					// map_Ns holds a standard roughness map (white = rough) — do not invert
-					roughnessFromTexture_Float = roughnessFromTexture / 255.0f;
-					metallicFromTexture_Float = metallicFromTexture / 255.0f;
-					if (metallicFromTexture_Float > 0.25f) {
-						metallicFromTexture_Float = 0.25f + (metallicFromTexture_Float - 0.25f) * 0.75f; // compress metallic range to prevent it from dominating the lighting
-					}
-					// for testing make it rough and non-metallic when texture is present to better see the effect of the texture maps
-					// roughnessFromTexture_Float = 0.99f;
-					// metallicFromTexture_Float = 0.99f;
-				}
-			}
-		}
-
-		if (hasTexture) {
-			color = colorFromTexture_Float3;
-			roughness = roughnessFromTexture_Float;
-			metallic = metallicFromTexture_Float;
-
-			// decode tangent-space normal from [0,1] -> [-1,1]
-			// negate Y: Go flips V (vc = 1-v), which negates dV and thus B, inverting normal.y
-			float3 nTex = {
-				normalFromTexture_Float3.x * 2.0f - 1.0f,
-				-(normalFromTexture_Float3.y * 2.0f - 1.0f),
-				normalFromTexture_Float3.z * 2.0f - 1.0f,
-			};
-			float nTexLen = Float3_Length(nTex);
-			if (nTexLen > 1e-3f) {
-				UvCords uvCords = obj->uvs[bestTri];
-				float dU1 = ((int)uvCords.uv2x - (int)uvCords.uv1x) / 65535.0f;
-				float dV1 = ((int)uvCords.uv2y - (int)uvCords.uv1y) / 65535.0f;
-				float dU2 = ((int)uvCords.uv3x - (int)uvCords.uv1x) / 65535.0f;
-				float dV2 = ((int)uvCords.uv3y - (int)uvCords.uv1y) / 65535.0f;
-				float3 edge1 = Float3_Sub(v1, v0);
-				float3 edge2 = Float3_Sub(v2, v0);
-				float det = dU1 * dV2 - dU2 * dV1;
-				float3 T, B;
-				if (fabsf(det) > 1e-6f) {
-					float inv = 1.0f / det;
-					float3 tRaw = {
-						(dV2 * edge1.x - dV1 * edge2.x) * inv,
-						(dV2 * edge1.y - dV1 * edge2.y) * inv,
-						(dV2 * edge1.z - dV1 * edge2.z) * inv,
-					};
-					// rotate tangent to world space, same transform as normals
-					float3 tWorld = {
-						obj->_fwdRot0.x * tRaw.x + obj->_fwdRot0.y * tRaw.y + obj->_fwdRot0.z * tRaw.z,
-						obj->_fwdRot1.x * tRaw.x + obj->_fwdRot1.y * tRaw.y + obj->_fwdRot1.z * tRaw.z,
-						obj->_fwdRot2.x * tRaw.x + obj->_fwdRot2.y * tRaw.y + obj->_fwdRot2.z * tRaw.z,
-					};
-					// Gram-Schmidt orthogonalize against geometric normal
-					T = Float3_Normalize(Float3_Sub(tWorld, Float3_Scale(n, Float3_Dot(tWorld, n))));
-					B = Float3_Cross(n, T);
-				} else {
-					// degenerate UVs — build arbitrary frame from n
-					float3 up = fabsf(n.y) < 0.9f ? (float3){0.0f, 1.0f, 0.0f} : (float3){1.0f, 0.0f, 0.0f};
-					T = Float3_Normalize(Float3_Cross(up, n));
-					B = Float3_Cross(n, T);
-				}
-				float3 nTexN = Float3_Normalize((float3){nTex.x * NORMAL_MAP_STRENGTH / nTexLen, nTex.y * NORMAL_MAP_STRENGTH / nTexLen, nTex.z / nTexLen});
-				n = Float3_Normalize((float3){
-					T.x * nTexN.x + B.x * nTexN.y + n.x * nTexN.z,
-					T.y * nTexN.x + B.y * nTexN.y + n.y * nTexN.z,
-					T.z * nTexN.x + B.z * nTexN.y + n.z * nTexN.z,
-				});
-			}
-		}
+		Surface surface = ResolveSurfaceLib(obj, bestTri, bestHitPos, lib);
+		float3 n = surface.normal;
+		float3 color = surface.color;
+		float emission = surface.emission;
+		float roughness = surface.roughness;
+		float metallic = surface.metallic;
 
 		float3 sOrig = {bestHitPos.x + n.x * 0.01f, bestHitPos.y + n.y * 0.01f, bestHitPos.z + n.z * 0.01f};
-		camera->normalBuffer[idx] = n;
-		camera->positionBuffer[idx] = bestHitPos;
+		camera->normalBuffer[idx] = PackNormal(n);
 
 		float diffuse = n.x * lightDir.x + n.y * lightDir.y + n.z * lightDir.z;
 		if (diffuse < 0.0f) diffuse = 0.0f;
@@ -903,7 +927,7 @@ static void RayTraceRowFunc(void *arg) {
 		float3 reflDir = {dx - n.x * dot2, dy - n.y * dot2, dz - n.z * dot2};
 
 		// sky reflection blend metals tint it by albedo, dielectrics reflect white sky
-		Color skyRefl = SampleSkybox(task->skybox, reflDir);
+		Color skyRefl = SampleSkyboxRough(task->skybox, reflDir, roughness);
 		uint32 st = (uint32)(reflectStrength * 255.0f);
 		if (st > 255u) st = 255u;
 		uint32 sit = 255u - st;
@@ -924,7 +948,7 @@ static void RayTraceRowFunc(void *arg) {
 		camera->objectIdBuffer[idx] = bestObj;
 		// w = geometry reflection strength — use roughGloss^2 so it stays stronger than sky blend
 		float roughGloss = 1.0f - roughness;
-		camera->reflectBuffer[idx] = (float3){reflDir.x, reflDir.y, reflDir.z, roughGloss * roughGloss};
+		camera->reflectBuffer[idx] = PackHalf4W(reflDir.x, reflDir.y, reflDir.z, roughGloss * roughGloss);
 		camera->bloomBuffer[idx] = (float3){color.x * emission, color.y * emission, color.z * emission};
 		camera->uvBuffer[idx] = calculateUvCoordinates(bestHitPos, v0, v1, v2);
 		camera->triangleIdBuffer[idx] = bestTri;
@@ -942,8 +966,8 @@ static void RayTraceRowFunc(void *arg) {
 				float prevNdcY = prevViewY / (prevViewZ * prevFov);
 				float prevU = (prevNdcX + 1.0f) * 0.5f;
 				float prevV = (1.0f - prevNdcY) * 0.5f;
-				float currU = (x + 0.5f) / (float)width;
-				float currV = (row + 0.5f) / (float)height;
+				float currU = (x + 0.5f + jitterX) / (float)width;
+				float currV = (row + 0.5f + jitterY) / (float)height;
 				camera->motionVectorBuffer[idx] = (float2){currU - prevU, currV - prevV};
 			} else {
 				camera->motionVectorBuffer[idx] = (float2){0.0f, 0.0f};
@@ -983,17 +1007,8 @@ static void RayTraceRowFunc(void *arg) {
 			float3 accumulatedEmission = {0.0f, 0.0f, 0.0f};
 			for (int t = 0; t < TOP_EMISSIVE_OBJECTS; t++) {
 				if (topEmissiveIndices[t] < 0) break; // fewer emitters than TOP_EMISSIVE_OBJECTS
-				float3 targetPos = objects[topEmissiveIndices[t]].position;
-				float3 toEmissive = Float3_Sub(targetPos, bestHitPos);
-				// NdotL: only surfaces facing the emitter receive light
-				float3 toEmissiveN = Float3_Normalize(toEmissive);
-				float NdotL = fabsf(n.x * toEmissiveN.x + n.y * toEmissiveN.y + n.z * toEmissiveN.z);
-				if (NdotL <= 0.0f) continue;
-				float3 em = SampleEmission(objects, objectCount, bestHitPos, toEmissive, topEmissiveIndices[t], lib);
-				float falloff = NdotL / (topEmissiveDistances[t] * topEmissiveDistances[t] + 1e-6f);
-				accumulatedEmission.x += em.x * falloff;
-				accumulatedEmission.y += em.y * falloff;
-				accumulatedEmission.z += em.z * falloff;
+				float3 toEmissive = Float3_Sub(objects[topEmissiveIndices[t]].position, bestHitPos);
+				AddEmitterLight(objects, objectCount, bestHitPos, n, toEmissive, topEmissiveDistances[t], topEmissiveIndices[t], lib, &accumulatedEmission);
 			}
 
 			catchEmission = accumulatedEmission;
@@ -1006,7 +1021,7 @@ static void RayTraceRowFunc(void *arg) {
 				catchReflection.z = rHit.mat.color.z;
 				catchReflection.w = reflectStrength;
 			} else {
-				Color skyColor = SampleSkybox(task->skybox, reflDir);
+				Color skyColor = SampleSkyboxRough(task->skybox, reflDir, roughness);
 				catchReflection.x = ((skyColor >> 16) & 0xFF) / 255.0f;
 				catchReflection.y = ((skyColor >> 8) & 0xFF) / 255.0f;
 				catchReflection.z = (skyColor & 0xFF) / 255.0f;
@@ -1054,9 +1069,10 @@ static void RayTraceRowFunc(void *arg) {
 		Color baseColor = camera->framebuffer[row * width + x];
 		float3 base = UnpackColor(baseColor);
 		float shadowMod = 0.03f + 0.97f * fminf(accumulatedShadow.x, 1.0f);
-		float3 combined = hdrToLDR(base.x * shadowMod + accumulatedEmission.x + accumulatedColor.x * camera->reflectBuffer[row * width + x].w,
-								   base.y * shadowMod + accumulatedEmission.y + accumulatedColor.y * camera->reflectBuffer[row * width + x].w,
-								   base.z * shadowMod + accumulatedEmission.z + accumulatedColor.z * camera->reflectBuffer[row * width + x].w);
+		float reflW = UnpackHalf4(camera->reflectBuffer[row * width + x]).w;
+		float3 combined = hdrToLDR(base.x * shadowMod + accumulatedEmission.x + accumulatedColor.x * reflW,
+								   base.y * shadowMod + accumulatedEmission.y + accumulatedColor.y * reflW,
+								   base.z * shadowMod + accumulatedEmission.z + accumulatedColor.z * reflW);
 
 		float3 ownEmission = camera->bloomBuffer[row * width + x];
 		camera->bloomBuffer[row * width + x] = (float3){
@@ -1077,6 +1093,7 @@ static void RayTraceRowFunc(void *arg) {
 
 void RayTraceScene(const Object *objects, int objectCount, Camera *camera, const MaterialLib *lib, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool, const Skybox *skybox) {
 	if (!objects || objectCount <= 0 || !camera || !taskQueue || !threadPool) return;
+	if (!Camera_Require(camera, FORWARD_BUFFERS)) return;
 	Frustum frustum = Frustum_FromCamera(camera);
 
 	// cull once per frame — frustum is constant across all pixels
@@ -1094,6 +1111,797 @@ void RayTraceScene(const Object *objects, int objectCount, Camera *camera, const
 	poolWait(threadPool);
 }
 
+// ---------------------------------------------------------------------------
+// Visibility buffer + deferred shading
+// Phase one only resolves primary visibility (object id, triangle id, barycentrics,
+// view depth). Phase two groups each row's hits by material, resolves surfaces in that
+// order and runs the Fresnel/GGX/Smith math 8 pixels at a time with AVX2.
+// ---------------------------------------------------------------------------
+
+#define SHADE_LANES 8
+
+static void VisibilityRowFunc(void *arg) {
+	RayTraceTask *task = arg;
+	int row = task->row;
+	Camera *camera = task->camera;
+	const Object *objects = task->objects;
+	int width = camera->screenWidth;
+	int height = camera->screenHeight;
+
+	float3 orig = camera->position;
+	float3 fwd = Float3_Normalize(camera->forward);
+	float3 rgt = Float3_Normalize(camera->right);
+	float3 up_ = Float3_Normalize(camera->up);
+
+	float jitterX = camera->jitter.x;
+	float jitterY = camera->jitter.y;
+	float ndcY = 1.0f - (row + 0.5f + jitterY) / (float)height * 2.0f;
+	float yscale = ndcY * camera->fovScale;
+	float rx = fwd.x + up_.x * yscale;
+	float ry = fwd.y + up_.y * yscale;
+	float rz = fwd.z + up_.z * yscale;
+	float sx = rgt.x * camera->aspect * camera->fovScale;
+	float sy = rgt.y * camera->aspect * camera->fovScale;
+	float sz = rgt.z * camera->aspect * camera->fovScale;
+
+	const int *passIdx = task->frustumPassIndices;
+	const int passCount = task->frustumPassCount;
+
+	for (int x = 0; x < width; x++) {
+		int idx = row * width + x;
+
+		float ndcX = (x + 0.5f + jitterX) / (float)width * 2.0f - 1.0f;
+		float dx = rx + sx * ndcX;
+		float dy = ry + sy * ndcX;
+		float dz = rz + sz * ndcX;
+		float inv = 1.0f / sqrtf(dx * dx + dy * dy + dz * dz);
+		dx *= inv;
+		dy *= inv;
+		dz *= inv;
+
+		const float invDx = 1.0f / dx, invDy = 1.0f / dy, invDz = 1.0f / dz;
+		const float3 pixInvDir = {invDx, invDy, invDz};
+		const float3 pixBias = {orig.x * invDx, orig.y * invDy, orig.z * invDz};
+
+		float bestT = DEPTH_FAR;
+		int bestObj = -1, bestTri = -1;
+		float3 bestHitPos = {0};
+
+		for (int ci = 0; ci < passCount; ci++) {
+			int i = passIdx[ci];
+			float tAABB = rayAABB_inv(pixBias, pixInvDir, &objects[i].worldBBmin.x, &objects[i].worldBBmax.x);
+			if (tAABB >= bestT) continue;
+
+			int triIdx = -1;
+			float3 hitPos;
+			IntersectBVH(&objects[i], &objects[i].bvh, orig, (float3){dx, dy, dz}, &triIdx, &hitPos);
+			if (triIdx < 0) continue;
+
+			float t = (hitPos.x - orig.x) * dx + (hitPos.y - orig.y) * dy + (hitPos.z - orig.z) * dz;
+			if (t > 0.0f && t < bestT) {
+				bestT = t;
+				bestObj = i;
+				bestTri = triIdx;
+				bestHitPos = hitPos;
+			}
+		}
+
+		camera->objectIdBuffer[idx] = bestObj;
+		camera->triangleIdBuffer[idx] = bestTri;
+		if (bestObj < 0) {
+			camera->depthBuffer[idx] = DEPTH_FAR;
+			camera->baryBuffer[idx] = (float2){0.0f, 0.0f};
+			continue;
+		}
+
+		// barycentrics in object space — shading rebuilds the hit point from these
+		const Object *obj = &objects[bestObj];
+		float3 v0 = obj->v1[bestTri];
+		float3 e1 = Float3_Sub(obj->v2[bestTri], v0);
+		float3 e2 = Float3_Sub(obj->v3[bestTri], v0);
+		float3 hv = Float3_Sub(ObjectWorldToLocal(obj, bestHitPos), v0);
+		float d00 = Float3_Dot(e1, e1);
+		float d01 = Float3_Dot(e1, e2);
+		float d11 = Float3_Dot(e2, e2);
+		float d20 = Float3_Dot(hv, e1);
+		float d21 = Float3_Dot(hv, e2);
+		float denom = d00 * d11 - d01 * d01;
+		float2 bary = {0.0f, 0.0f};
+		if (fabsf(denom) >= 1e-12f) {
+			float invDenom = 1.0f / denom;
+			bary.x = (d11 * d20 - d01 * d21) * invDenom;
+			bary.y = (d00 * d21 - d01 * d20) * invDenom;
+		}
+		camera->baryBuffer[idx] = bary;
+		// View-Z depth (dot with forward) keeps SSR depth comparisons consistent
+		camera->depthBuffer[idx] = (bestHitPos.x - orig.x) * fwd.x + (bestHitPos.y - orig.y) * fwd.y + (bestHitPos.z - orig.z) * fwd.z;
+	}
+}
+
+void RayTraceVisibility(const Object *objects, int objectCount, Camera *camera, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool) {
+	if (!objects || objectCount <= 0 || !camera || !taskQueue || !threadPool) return;
+	if (!Camera_Require(camera, VISIBILITY_BUFFERS)) return;
+	Frustum frustum = Frustum_FromCamera(camera);
+
+	int frustumPassIndices[objectCount];
+	int frustumPassCount = 0;
+	for (int i = 0; i < objectCount; i++) {
+		if (Frustum_TestAABB(&frustum, objects[i].worldBBmin, objects[i].worldBBmax))
+			frustumPassIndices[frustumPassCount++] = i;
+	}
+
+	for (int row = 0; row < camera->screenHeight; row++) {
+		taskQueue->tasks[row] = (RayTraceTask){row, camera, objects, objectCount, NULL, NULL, frustum, frustumPassIndices, frustumPassCount};
+		poolAdd(threadPool, VisibilityRowFunc, &taskQueue->tasks[row]);
+	}
+	poolWait(threadPool);
+}
+
+// Per-row surface data in material order, SoA so the shading kernel loads 8 lanes at once.
+typedef struct ShadeLanes {
+	float nx[WIDTH + SHADE_LANES], ny[WIDTH + SHADE_LANES], nz[WIDTH + SHADE_LANES];
+	float dx[WIDTH + SHADE_LANES], dy[WIDTH + SHADE_LANES], dz[WIDTH + SHADE_LANES];
+	float cr[WIDTH + SHADE_LANES], cg[WIDTH + SHADE_LANES], cb[WIDTH + SHADE_LANES];
+	float roughness[WIDTH + SHADE_LANES];
+	float metallic[WIDTH + SHADE_LANES];
+	float emission[WIDTH + SHADE_LANES];
+	// outputs
+	float outR[WIDTH + SHADE_LANES], outG[WIDTH + SHADE_LANES], outB[WIDTH + SHADE_LANES];
+	float reflectStrength[WIDTH + SHADE_LANES];
+	float rdx[WIDTH + SHADE_LANES], rdy[WIDTH + SHADE_LANES], rdz[WIDTH + SHADE_LANES];
+} ShadeLanes;
+
+// Same BRDF as the scalar path in RayTraceRowFunc, 8 pixels per iteration. Unlike that path
+// it leaves the result linear and unclamped for hdrBuffer.
+static void ShadeGGX_AVX2(ShadeLanes *L, int count, float3 lightDir) {
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 eps5 = _mm256_set1_ps(1e-5f);
+	const __m256 lx = _mm256_set1_ps(lightDir.x);
+	const __m256 ly = _mm256_set1_ps(lightDir.y);
+	const __m256 lz = _mm256_set1_ps(lightDir.z);
+
+	for (int i = 0; i < count; i += SHADE_LANES) {
+		__m256 nx = _mm256_loadu_ps(L->nx + i), ny = _mm256_loadu_ps(L->ny + i), nz = _mm256_loadu_ps(L->nz + i);
+		__m256 dx = _mm256_loadu_ps(L->dx + i), dy = _mm256_loadu_ps(L->dy + i), dz = _mm256_loadu_ps(L->dz + i);
+		__m256 cr = _mm256_loadu_ps(L->cr + i), cg = _mm256_loadu_ps(L->cg + i), cb = _mm256_loadu_ps(L->cb + i);
+		__m256 rough = _mm256_loadu_ps(L->roughness + i);
+		__m256 metal = _mm256_loadu_ps(L->metallic + i);
+		__m256 emis = _mm256_loadu_ps(L->emission + i);
+
+		__m256 NdotL = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, lx), _mm256_mul_ps(ny, ly)), _mm256_mul_ps(nz, lz));
+		__m256 diffuse = _mm256_max_ps(NdotL, zero);
+		__m256 NdotD = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, dx), _mm256_mul_ps(ny, dy)), _mm256_mul_ps(nz, dz));
+		__m256 NdotV = _mm256_max_ps(_mm256_sub_ps(zero, NdotD), _mm256_set1_ps(1e-4f));
+
+		// Schlick fresnel
+		__m256 invNdotV = _mm256_sub_ps(one, NdotV);
+		__m256 inv2 = _mm256_mul_ps(invNdotV, invNdotV);
+		__m256 fresnelT = _mm256_mul_ps(_mm256_mul_ps(inv2, inv2), invNdotV);
+		__m256 f0 = _mm256_add_ps(_mm256_set1_ps(0.04f), _mm256_mul_ps(_mm256_set1_ps(0.96f), metal));
+		__m256 fresnel = _mm256_add_ps(f0, _mm256_mul_ps(_mm256_sub_ps(one, f0), fresnelT));
+
+		// GGX NDF
+		__m256 hx = _mm256_sub_ps(lx, dx), hy = _mm256_sub_ps(ly, dy), hz = _mm256_sub_ps(lz, dz);
+		__m256 hlen2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(hx, hx), _mm256_mul_ps(hy, hy)), _mm256_mul_ps(hz, hz));
+		__m256 hlen = _mm256_div_ps(one, _mm256_sqrt_ps(hlen2));
+		__m256 NdotH = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, hx), _mm256_mul_ps(ny, hy)), _mm256_mul_ps(nz, hz));
+		NdotH = _mm256_max_ps(zero, _mm256_mul_ps(NdotH, hlen));
+		__m256 alpha = _mm256_mul_ps(rough, rough);
+		__m256 alpha2 = _mm256_mul_ps(alpha, alpha);
+		__m256 dg = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(NdotH, NdotH), _mm256_sub_ps(alpha2, one)), one);
+		__m256 D = _mm256_div_ps(alpha2, _mm256_max_ps(_mm256_mul_ps(dg, dg), eps5));
+
+		// Smith G (Schlick-GGX)
+		__m256 k = _mm256_mul_ps(alpha, _mm256_set1_ps(0.5f));
+		__m256 oneMinusK = _mm256_sub_ps(one, k);
+		__m256 GV = _mm256_div_ps(NdotV, _mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(NdotV, oneMinusK), k), eps5));
+		__m256 GL = _mm256_div_ps(diffuse, _mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(diffuse, oneMinusK), k), eps5));
+		__m256 specDen = _mm256_max_ps(_mm256_mul_ps(_mm256_set1_ps(4.0f), _mm256_mul_ps(diffuse, NdotV)), eps5);
+		__m256 specBase = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(D, GV), _mm256_mul_ps(GL, fresnel)), specDen);
+		specBase = _mm256_and_ps(specBase, _mm256_cmp_ps(diffuse, zero, _CMP_GT_OQ));
+
+		// metals: albedo-tinted specular; dielectrics: white specular
+		__m256 diffuseWeight = _mm256_sub_ps(one, metal);
+		__m256 specWhite = _mm256_mul_ps(specBase, diffuseWeight);
+		__m256 specTint = _mm256_mul_ps(specBase, metal);
+		__m256 lit = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(0.02f), _mm256_mul_ps(_mm256_set1_ps(0.98f), diffuse)), diffuseWeight);
+		__m256 litE = _mm256_add_ps(lit, emis);
+		__m256 r = _mm256_add_ps(_mm256_mul_ps(cr, _mm256_add_ps(litE, specTint)), specWhite);
+		__m256 g = _mm256_add_ps(_mm256_mul_ps(cg, _mm256_add_ps(litE, specTint)), specWhite);
+		__m256 b = _mm256_add_ps(_mm256_mul_ps(cb, _mm256_add_ps(litE, specTint)), specWhite);
+
+		// linear and unclamped: the post tone map spreads overflow relative to white
+		_mm256_storeu_ps(L->outR + i, r);
+		_mm256_storeu_ps(L->outG + i, g);
+		_mm256_storeu_ps(L->outB + i, b);
+
+		// reflection strength — rough, back-lit and emissive surfaces reflect less
+		__m256 roughnessDamp = _mm256_mul_ps(_mm256_sub_ps(one, rough), _mm256_set1_ps(0.18f));
+		__m256 lightFacing = _mm256_add_ps(_mm256_set1_ps(0.15f), _mm256_mul_ps(_mm256_set1_ps(0.85f), diffuse));
+		__m256 emisDamp = _mm256_sub_ps(one, _mm256_min_ps(emis, one));
+		_mm256_storeu_ps(L->reflectStrength + i, _mm256_mul_ps(_mm256_mul_ps(fresnel, roughnessDamp), _mm256_mul_ps(lightFacing, emisDamp)));
+
+		__m256 dot2 = _mm256_add_ps(NdotD, NdotD);
+		_mm256_storeu_ps(L->rdx + i, _mm256_sub_ps(dx, _mm256_mul_ps(nx, dot2)));
+		_mm256_storeu_ps(L->rdy + i, _mm256_sub_ps(dy, _mm256_mul_ps(ny, dot2)));
+		_mm256_storeu_ps(L->rdz + i, _mm256_sub_ps(dz, _mm256_mul_ps(nz, dot2)));
+	}
+}
+
+// Orders the row's hit pixels by material key (stable LSD radix, 8 bits per pass).
+static int SortPixelsByMaterial(const uint16 *keys, const int *pixels, int count, int *out, int *tmp, uint16 maxKey) {
+	if (count == 0) return 0;
+	const int *src = pixels;
+	int passes = maxKey > 0xFF ? 2 : 1;
+	for (int pass = 0; pass < passes; pass++) {
+		int shift = pass * 8;
+		int *dst = (pass == passes - 1) ? out : tmp;
+		int offsets[256] = {0};
+		for (int i = 0; i < count; i++)
+			offsets[(keys[src[i]] >> shift) & 0xFF]++;
+		int sum = 0;
+		for (int b = 0; b < 256; b++) {
+			int c = offsets[b];
+			offsets[b] = sum;
+			sum += c;
+		}
+		for (int i = 0; i < count; i++)
+			dst[offsets[(keys[src[i]] >> shift) & 0xFF]++] = src[i];
+		src = dst;
+	}
+	return count;
+}
+
+static void ShadeRowFunc(void *arg) {
+	RayTraceTask *task = arg;
+	int row = task->row;
+	Camera *camera = task->camera;
+	const Object *objects = task->objects;
+	const MaterialTable *materials = task->materials;
+	int width = camera->screenWidth;
+	int height = camera->screenHeight; // at most WIDTH x HEIGHT, checked by RayTraceShadeSignals
+
+	float3 lightDir = Float3_Normalize(camera->lightDir);
+	float3 fwd = Float3_Normalize(camera->forward);
+	float3 rgt = Float3_Normalize(camera->right);
+	float3 up_ = Float3_Normalize(camera->up);
+
+	float3 prevPos = camera->prevPosition;
+	float3 prevFwd = Float3_Normalize(camera->prevForward);
+	float3 prevRgt = Float3_Normalize(camera->prevRight);
+	float3 prevUp = Float3_Normalize(camera->prevUp);
+	float prevAsp = camera->prevAspect;
+	float prevFov = camera->prevFovScale;
+
+	// same jittered rays as VisibilityRowFunc, so view vectors match the stored hits
+	float jitterX = camera->jitter.x;
+	float jitterY = camera->jitter.y;
+	float ndcY = 1.0f - (row + 0.5f + jitterY) / (float)height * 2.0f;
+	float yscale = ndcY * camera->fovScale;
+	float rx = fwd.x + up_.x * yscale;
+	float ry = fwd.y + up_.y * yscale;
+	float rz = fwd.z + up_.z * yscale;
+	float sx = rgt.x * camera->aspect * camera->fovScale;
+	float sy = rgt.y * camera->aspect * camera->fovScale;
+	float sz = rgt.z * camera->aspect * camera->fovScale;
+
+	const int *objIds = camera->objectIdBuffer + row * width;
+	const int *triIds = camera->triangleIdBuffer + row * width;
+
+	// 1. gather hit pixels and key them by material
+	uint16 keys[WIDTH];
+	int hits[WIDTH], order[WIDTH], sortTmp[WIDTH];
+	int hitCount = 0;
+	uint16 maxKey = 0;
+	for (int x = 0; x < width; x++) {
+		int o = objIds[x];
+		if (o < 0) continue;
+		int matId = objects[o].materialIds ? objects[o].materialIds[triIds[x]] : -1;
+		int key = (int)(MaterialTable_Get(materials, matId) - materials->entries);
+		keys[x] = (uint16)(key < 0xFFFF ? key : 0xFFFF);
+		if (keys[x] > maxKey) maxKey = keys[x];
+		hits[hitCount++] = x;
+	}
+	SortPixelsByMaterial(keys, hits, hitCount, order, sortTmp, maxKey);
+
+	// 2. resolve surfaces in material order (memory bound: vertices, uvs, texels)
+	ShadeLanes lanes;
+	for (int k = 0; k < hitCount; k++) {
+		int x = order[k];
+		int idx = row * width + x;
+		const Object *obj = &objects[objIds[x]];
+		int tri = triIds[x];
+
+		float ndcX = (x + 0.5f + jitterX) / (float)width * 2.0f - 1.0f;
+		float dx = rx + sx * ndcX;
+		float dy = ry + sy * ndcX;
+		float dz = rz + sz * ndcX;
+		float inv = 1.0f / sqrtf(dx * dx + dy * dy + dz * dz);
+		dx *= inv;
+		dy *= inv;
+		dz *= inv;
+
+		float3 v0 = obj->v1[tri];
+		float3 v1 = obj->v2[tri];
+		float3 v2 = obj->v3[tri];
+		float2 bary = camera->baryBuffer[idx];
+		float bu = 1.0f - bary.x - bary.y;
+		float3 localHit = {
+			bu * v0.x + bary.x * v1.x + bary.y * v2.x,
+			bu * v0.y + bary.x * v1.y + bary.y * v2.y,
+			bu * v0.z + bary.x * v1.z + bary.y * v2.z};
+
+		const PackedMaterial *mat = MaterialTable_Get(materials, obj->materialIds ? obj->materialIds[tri] : -1);
+		uint8 flags = obj->materialFlags ? obj->materialFlags[tri] : (uint8)mat->flags;
+		const Texel *texel = NULL;
+		if ((flags & MATERIAL_TEXTURED) && obj->uvs) {
+			uvCoordinates xy = TexelCoordinates(obj->uvs[tri], bu, bary.x, bary.y);
+			texel = Textures_Fetch(materials->textureSets[mat->textureSet], xy.x, xy.y);
+		}
+		Surface surface = ResolveSurface(obj, tri, (float3){mat->r, mat->g, mat->b}, mat->roughness, mat->metallic, mat->emission, texel);
+		float3 n = surface.normal;
+
+		lanes.nx[k] = n.x;
+		lanes.ny[k] = n.y;
+		lanes.nz[k] = n.z;
+		lanes.dx[k] = dx;
+		lanes.dy[k] = dy;
+		lanes.dz[k] = dz;
+		lanes.cr[k] = surface.color.x;
+		lanes.cg[k] = surface.color.y;
+		lanes.cb[k] = surface.color.z;
+		lanes.roughness[k] = surface.roughness;
+		lanes.metallic[k] = surface.metallic;
+		lanes.emission[k] = surface.emission;
+
+		camera->normalBuffer[idx] = PackNormal(n);
+		camera->uvBuffer[idx] = (uvMap){(uint16)(bu * 65535.0f), (uint16)(bary.x * 65535.0f)};
+
+		// Motion vector: screen-UV delta from previous frame
+		float3 prevWorldPos = TransformPointTRS(localHit, obj->prevPostion, obj->prevRotation, obj->prevScale);
+		float3 prevToPoint = Float3_Sub(prevWorldPos, prevPos);
+		float prevViewZ = Float3_Dot(prevToPoint, prevFwd);
+		if (prevViewZ > 1e-4f) {
+			float prevNdcX = Float3_Dot(prevToPoint, prevRgt) / (prevViewZ * prevAsp * prevFov);
+			float prevNdcY = Float3_Dot(prevToPoint, prevUp) / (prevViewZ * prevFov);
+			float prevU = (prevNdcX + 1.0f) * 0.5f;
+			float prevV = (1.0f - prevNdcY) * 0.5f;
+			camera->motionVectorBuffer[idx] = (float2){(x + 0.5f + jitterX) / (float)width - prevU, (row + 0.5f + jitterY) / (float)height - prevV};
+		} else {
+			camera->motionVectorBuffer[idx] = (float2){0.0f, 0.0f};
+		}
+	}
+	// zero the tail so the last 8-wide block reads defined values
+	for (int k = hitCount; k < ((hitCount + SHADE_LANES - 1) & ~(SHADE_LANES - 1)); k++) {
+		lanes.nx[k] = lanes.ny[k] = lanes.nz[k] = 0.0f;
+		lanes.dx[k] = lanes.dy[k] = lanes.dz[k] = 0.0f;
+		lanes.cr[k] = lanes.cg[k] = lanes.cb[k] = 0.0f;
+		lanes.roughness[k] = lanes.metallic[k] = lanes.emission[k] = 0.0f;
+	}
+
+	// 3. BRDF (compute bound)
+	ShadeGGX_AVX2(&lanes, hitCount, lightDir);
+
+	// 4. sky reflection + scatter back to pixel order
+	for (int k = 0; k < hitCount; k++) {
+		int x = order[k];
+		int idx = row * width + x;
+		float metallic = lanes.metallic[k];
+		float reflectStrength = lanes.reflectStrength[k];
+		float3 reflDir = {lanes.rdx[k], lanes.rdy[k], lanes.rdz[k]};
+
+		float3 sky = UnpackColor(SampleSkyboxRough(task->skybox, reflDir, lanes.roughness[k]));
+		float st = fminf(reflectStrength, 1.0f);
+		float sit = 1.0f - st;
+		float dielectric = (1.0f - metallic) * st, conductor = metallic * st;
+		camera->hdrBuffer[idx] = PackHalf4(lanes.outR[k] * sit + sky.x * (dielectric + conductor * lanes.cr[k]),
+										   lanes.outG[k] * sit + sky.y * (dielectric + conductor * lanes.cg[k]),
+										   lanes.outB[k] * sit + sky.z * (dielectric + conductor * lanes.cb[k]));
+
+		float roughGloss = 1.0f - lanes.roughness[k];
+		camera->reflectBuffer[idx] = PackHalf4W(reflDir.x, reflDir.y, reflDir.z, roughGloss * roughGloss);
+		float emission = lanes.emission[k];
+		camera->bloomBuffer[idx] = (float3){lanes.cr[k] * emission, lanes.cg[k] * emission, lanes.cb[k] * emission};
+	}
+
+	// 5. sky pixels; secondary rays run afterwards in their own low-resolution pass
+	for (int x = 0; x < width; x++) {
+		if (objIds[x] >= 0) continue;
+		int idx = row * width + x;
+		float ndcX = (x + 0.5f + jitterX) / (float)width * 2.0f - 1.0f;
+		// unnormalized: the cube lookup only needs the direction
+		float3 sky = UnpackColor(SampleSkybox(task->skybox, (float3){rx + sx * ndcX, ry + sy * ndcX, rz + sz * ndcX}));
+		camera->hdrBuffer[idx] = PackHalf4(sky.x, sky.y, sky.z);
+		camera->motionVectorBuffer[idx] = (float2){0.0f, 0.0f};
+	}
+}
+
+// One row of the secondary-ray grid: every SECONDARY_RESOLUTION x SECONDARY_RESOLUTION
+// block traces shadow, emission and reflection once, from a pixel picked by samplePhase
+// (falls back to any geometry pixel in the block). Reads only the G-buffers.
+static void SecondaryRowFunc(void *arg) {
+	RayTraceTask *task = arg;
+	int ly = task->row;
+	Camera *camera = task->camera;
+	const Object *objects = task->objects;
+	int objectCount = task->objectCount;
+	const MaterialTable *materials = task->materials;
+	const EmitterTileGrid *grid = task->emitterTiles;
+	int width = camera->screenWidth;
+	int height = camera->screenHeight;
+	int lowWidth = (width + SECONDARY_RESOLUTION - 1) / SECONDARY_RESOLUTION;
+	float3 lightDir = Float3_Normalize(camera->lightDir);
+
+	int phase = task->samplePhase % (SECONDARY_RESOLUTION * SECONDARY_RESOLUTION);
+	int jx = phase % SECONDARY_RESOLUTION;
+	int jy = phase / SECONDARY_RESOLUTION;
+	PixelRays rays = Camera_PixelRays(camera);
+
+	for (int lx = 0; lx < lowWidth; lx++) {
+		int lidx = ly * lowWidth + lx;
+		int bx = lx * SECONDARY_RESOLUTION, by = ly * SECONDARY_RESOLUTION;
+		int px = bx + jx < width ? bx + jx : width - 1;
+		int py = by + jy < height ? by + jy : height - 1;
+		int idx = py * width + px;
+		for (int k = 0; camera->objectIdBuffer[idx] < 0 && k < SECONDARY_RESOLUTION * SECONDARY_RESOLUTION; k++) {
+			int qx = bx + k % SECONDARY_RESOLUTION, qy = by + k / SECONDARY_RESOLUTION;
+			if (qx < width && qy < height) idx = qy * width + qx;
+		}
+		int bestObj = camera->objectIdBuffer[idx];
+		if (bestObj < 0) {
+			camera->secondaryPixel[lidx] = -1;
+			continue;
+		}
+		camera->secondaryPixel[lidx] = idx;
+
+		float3 n = UnpackNormal(camera->normalBuffer[idx]);
+		float3 p = PixelRays_Position(&rays, idx % width, idx / width, camera->depthBuffer[idx]);
+		float3 sOrig = {p.x + n.x * 0.01f, p.y + n.y * 0.01f, p.z + n.z * 0.01f};
+		float3 rd = UnpackHalf4(camera->reflectBuffer[idx]);
+		float3 reflDir = {rd.x, rd.y, rd.z};
+		const Object *obj = &objects[bestObj];
+		uint8 flags = obj->materialFlags ? obj->materialFlags[camera->triangleIdBuffer[idx]] : 0;
+
+		int shadowHit = -1;
+		if (!(flags & MATERIAL_EMISSIVE)) {
+			rayCollision((Object *)objects, objectCount, sOrig, lightDir, bestObj, &shadowHit, NULL, NULL);
+		}
+
+		// tile list is already ranked — take the first TOP_EMISSIVE_OBJECTS that reach this pixel
+		const EmitterTile *tile = &grid->tiles[(idx / width / EMITTER_TILE_SIZE) * grid->tilesX + (idx % width) / EMITTER_TILE_SIZE];
+		float3 accumulatedEmission = {0.0f, 0.0f, 0.0f};
+		int sampled = 0;
+		for (int t = 0; t < tile->count && sampled < TOP_EMISSIVE_OBJECTS; t++) {
+			const EmitterBounds *eb = &grid->bounds[tile->emitters[t]];
+			float3 toEmissive = Float3_Sub(objects[eb->index].position, p);
+			float dist = Float3_Length(toEmissive);
+			if (dist > eb->radius) continue;
+			sampled++;
+			AddEmitterLight(objects, objectCount, p, n, toEmissive, dist, eb->index, NULL, &accumulatedEmission);
+		}
+		accumulatedEmission.w = shadowHit >= 0 ? 0.0f : 1.0f;
+		camera->secondaryEmission[lidx] = accumulatedEmission;
+
+		// an on-screen SSR hit replaces the reflection ray, a weak one is blended with it
+		float3 ssr = camera->ssrReflection[lidx];
+		if (ssr.w >= SSR_REPLACE_CONFIDENCE) {
+			camera->secondaryReflection[lidx] = (float3){ssr.x, ssr.y, ssr.z, 0.0f};
+			continue;
+		}
+		float3 traced;
+		int reflObj, reflTri;
+		rayCollision((Object *)objects, objectCount, sOrig, reflDir, bestObj, &reflObj, &reflTri, NULL);
+		if (reflObj >= 0) {
+			const Object *ro = &objects[reflObj];
+			const PackedMaterial *rm = MaterialTable_Get(materials, ro->materialIds ? ro->materialIds[reflTri] : -1);
+			traced = (float3){rm->r, rm->g, rm->b, 0.0f};
+		} else {
+			// gloss^2 is stored in the reflect buffer
+			Color skyColor = SampleSkyboxRough(task->skybox, reflDir, 1.0f - sqrtf(fmaxf(rd.w, 0.0f)));
+			traced = (float3){
+				((skyColor >> 16) & 0xFF) / 255.0f,
+				((skyColor >> 8) & 0xFF) / 255.0f,
+				(skyColor & 0xFF) / 255.0f,
+				0.0f};
+		}
+		camera->secondaryReflection[lidx] = (float3){
+			traced.x + (ssr.x - traced.x) * ssr.w,
+			traced.y + (ssr.y - traced.y) * ssr.w,
+			traced.z + (ssr.z - traced.z) * ssr.w,
+			0.0f};
+	}
+}
+
+// Joint bilateral upsample of the secondary-ray grid to full resolution: 3x3 low-res taps
+// weighted by distance to the traced pixel, relative depth and normal agreement, and
+// restricted to the same object. No surviving tap falls back to the nearest traced sample.
+static void UpsampleRowFunc(void *arg) {
+	RayTraceTask *task = arg;
+	int row = task->row;
+	Camera *camera = task->camera;
+	int width = camera->screenWidth;
+	int height = camera->screenHeight;
+	int lowWidth = (width + SECONDARY_RESOLUTION - 1) / SECONDARY_RESOLUTION;
+	int lowHeight = (height + SECONDARY_RESOLUTION - 1) / SECONDARY_RESOLUTION;
+	const float invSpatial = 1.0f / (float)(SECONDARY_RESOLUTION * SECONDARY_RESOLUTION);
+	int ly = row / SECONDARY_RESOLUTION;
+
+	for (int x = 0; x < width; x++) {
+		int idx = row * width + x;
+		int id = camera->objectIdBuffer[idx];
+		if (id < 0) {
+			camera->emissionSignal[idx] = (float3){0.0f, 0.0f, 0.0f, 0.0f};
+			camera->reflectionSignal[idx] = (float3){0.0f, 0.0f, 0.0f, 0.0f};
+			continue;
+		}
+		float z = camera->depthBuffer[idx];
+		float3 n = UnpackNormal(camera->normalBuffer[idx]);
+		int lx = x / SECONDARY_RESOLUTION;
+
+		float3 em = {0.0f, 0.0f, 0.0f, 0.0f}, refl = {0.0f, 0.0f, 0.0f, 0.0f};
+		float sumW = 0.0f;
+		int nearest = -1, nearestSame = -1;
+		int nearestD2 = 1 << 30, nearestSameD2 = 1 << 30;
+		for (int dy = -1; dy <= 1; dy++) {
+			int qy = ly + dy;
+			if (qy < 0 || qy >= lowHeight) continue;
+			for (int dx = -1; dx <= 1; dx++) {
+				int qx = lx + dx;
+				if (qx < 0 || qx >= lowWidth) continue;
+				int lidx = qy * lowWidth + qx;
+				int src = camera->secondaryPixel[lidx];
+				if (src < 0) continue;
+				int ox = src % width - x, oy = src / width - row;
+				int d2 = ox * ox + oy * oy;
+				if (d2 < nearestD2) nearestD2 = d2, nearest = lidx;
+				if (camera->objectIdBuffer[src] != id) continue;
+				if (d2 < nearestSameD2) nearestSameD2 = d2, nearestSame = lidx;
+
+				float3 sn = UnpackNormal(camera->normalBuffer[src]);
+				float nd = fmaxf(n.x * sn.x + n.y * sn.y + n.z * sn.z, 0.0f);
+				nd *= nd;
+				nd *= nd;
+				nd *= nd; // ^8
+				float w = expf(-(float)d2 * invSpatial - fabsf(camera->depthBuffer[src] - z) / (0.02f * z + 1e-4f)) * nd;
+				if (w <= 1e-6f) continue;
+				float3 se = camera->secondaryEmission[lidx];
+				float3 sr = camera->secondaryReflection[lidx];
+				em = (float3){em.x + se.x * w, em.y + se.y * w, em.z + se.z * w, em.w + se.w * w};
+				refl = (float3){refl.x + sr.x * w, refl.y + sr.y * w, refl.z + sr.z * w, 0.0f};
+				sumW += w;
+			}
+		}
+		if (sumW > 1e-6f) {
+			float inv = 1.0f / sumW;
+			camera->emissionSignal[idx] = (float3){em.x * inv, em.y * inv, em.z * inv, em.w * inv};
+			camera->reflectionSignal[idx] = (float3){refl.x * inv, refl.y * inv, refl.z * inv, 0.0f};
+		} else {
+			int fallback = nearestSame >= 0 ? nearestSame : nearest;
+			camera->emissionSignal[idx] = fallback >= 0 ? camera->secondaryEmission[fallback] : (float3){0.0f, 0.0f, 0.0f, 1.0f};
+			camera->reflectionSignal[idx] = fallback >= 0 ? camera->secondaryReflection[fallback] : (float3){0.0f, 0.0f, 0.0f, 0.0f};
+		}
+	}
+}
+
+// Folds the shadow, emission and reflection signals into hdrBuffer. blurRadius > 0
+// box-filters them along the row first; 0 takes them as-is (already denoised).
+static void CompositeRowFunc(void *arg) {
+	RayTraceTask *task = arg;
+	int row = task->row;
+	Camera *camera = task->camera;
+	int width = camera->screenWidth;
+	int radius = task->blurRadius;
+	const float3 *emissionSignal = &camera->emissionSignal[row * width];
+	const float3 *reflectionSignal = &camera->reflectionSignal[row * width];
+	const int *objIds = &camera->objectIdBuffer[row * width];
+
+	for (int x = 0; x < width; x++) {
+		int idx = row * width + x;
+		if (objIds[x] < 0) continue;
+		float3 accumulatedColor = {0.0f, 0.0f, 0.0f};
+		float3 accumulatedEmission = {0.0f, 0.0f, 0.0f};
+		float accumulatedShadow = 0.0f;
+		int k0 = x - radius < 0 ? 0 : x - radius;
+		int k1 = x + radius >= width ? width - 1 : x + radius;
+		for (int k = k0; k <= k1; k++) {
+			accumulatedColor.x += reflectionSignal[k].x;
+			accumulatedColor.y += reflectionSignal[k].y;
+			accumulatedColor.z += reflectionSignal[k].z;
+			accumulatedEmission.x += emissionSignal[k].x;
+			accumulatedEmission.y += emissionSignal[k].y;
+			accumulatedEmission.z += emissionSignal[k].z;
+			accumulatedShadow += emissionSignal[k].w;
+		}
+		float invW = 1.0f / (float)(k1 - k0 + 1);
+		accumulatedColor = Float3_Scale(accumulatedColor, invW);
+		accumulatedEmission = Float3_Scale(accumulatedEmission, invW);
+		accumulatedShadow *= invW;
+
+		float3 base = UnpackHalf4(camera->hdrBuffer[idx]);
+		float reflW = UnpackHalf4(camera->reflectBuffer[idx]).w;
+		float shadowMod = 0.03f + 0.97f * fminf(accumulatedShadow, 1.0f);
+
+		float3 ownEmission = camera->bloomBuffer[idx];
+		camera->bloomBuffer[idx] = (float3){
+			ownEmission.x + accumulatedEmission.x,
+			ownEmission.y + accumulatedEmission.y,
+			ownEmission.z + accumulatedEmission.z,
+		};
+		camera->hdrBuffer[idx] = PackHalf4(base.x * shadowMod + accumulatedEmission.x + accumulatedColor.x * reflW,
+										   base.y * shadowMod + accumulatedEmission.y + accumulatedColor.y * reflW,
+										   base.z * shadowMod + accumulatedEmission.z + accumulatedColor.z * reflW);
+	}
+}
+
+static void PackHdrRowFunc(void *arg) {
+	RayTraceTask *task = arg;
+	Camera *camera = task->camera;
+	int offset = task->row * camera->screenWidth;
+	PackHdr(&camera->hdrBuffer[offset], &camera->framebuffer[offset], camera->screenWidth);
+}
+
+// Culls emitter spheres against one row of screen tiles, bounded by each tile's
+// depth range, and ranks the survivors by peak / distance^2 to the tile centre.
+static void EmitterTileRowFunc(void *arg) {
+	RayTraceTask *task = arg;
+	int ty = task->row;
+	Camera *camera = task->camera;
+	EmitterTileGrid *grid = task->emitterTiles;
+	int width = camera->screenWidth;
+	int height = camera->screenHeight;
+	float kx = camera->aspect * camera->fovScale;
+	float ky = camera->fovScale;
+
+	int y0 = ty * EMITTER_TILE_SIZE;
+	int y1 = y0 + EMITTER_TILE_SIZE > height ? height : y0 + EMITTER_TILE_SIZE;
+	float ndcT = 1.0f - y0 / (float)height * 2.0f;
+	float ndcB = 1.0f - y1 / (float)height * 2.0f;
+	float invLenT = 1.0f / sqrtf(1.0f + ndcT * ky * ndcT * ky);
+	float invLenB = 1.0f / sqrtf(1.0f + ndcB * ky * ndcB * ky);
+
+	for (int tx = 0; tx < grid->tilesX; tx++) {
+		EmitterTile *tile = &grid->tiles[ty * grid->tilesX + tx];
+		tile->count = 0;
+		int x0 = tx * EMITTER_TILE_SIZE;
+		int x1 = x0 + EMITTER_TILE_SIZE > width ? width : x0 + EMITTER_TILE_SIZE;
+
+		float zMin = DEPTH_FAR, zMax = 0.0f;
+		for (int y = y0; y < y1; y++) {
+			const float *depth = &camera->depthBuffer[y * width];
+			for (int x = x0; x < x1; x++) {
+				if (depth[x] >= DEPTH_FAR) continue;
+				zMin = fminf(zMin, depth[x]);
+				zMax = fmaxf(zMax, depth[x]);
+			}
+		}
+		if (zMin >= DEPTH_FAR) continue; // all sky
+
+		float ndcL = x0 / (float)width * 2.0f - 1.0f;
+		float ndcR = x1 / (float)width * 2.0f - 1.0f;
+		float invLenL = 1.0f / sqrtf(1.0f + ndcL * kx * ndcL * kx);
+		float invLenR = 1.0f / sqrtf(1.0f + ndcR * kx * ndcR * kx);
+		float zMid = 0.5f * (zMin + zMax);
+		float3 tileCenter = {0.5f * (ndcL + ndcR) * kx * zMid, 0.5f * (ndcT + ndcB) * ky * zMid, zMid};
+
+		float importance[EMITTER_TILE_CAPACITY];
+		for (int e = 0; e < grid->boundsCount; e++) {
+			const EmitterBounds *eb = &grid->bounds[e];
+			float3 c = eb->viewCenter;
+			float r = eb->radius;
+			if (c.z + r < zMin || c.z - r > zMax) continue;
+			if ((c.x - ndcL * kx * c.z) * invLenL < -r) continue;
+			if ((ndcR * kx * c.z - c.x) * invLenR < -r) continue;
+			if ((c.y - ndcB * ky * c.z) * invLenB < -r) continue;
+			if ((ndcT * ky * c.z - c.y) * invLenT < -r) continue;
+
+			float3 d = Float3_Sub(c, tileCenter);
+			float w = eb->peak / (Float3_Dot(d, d) + 1e-6f);
+			int slot = tile->count;
+			while (slot > 0 && importance[slot - 1] < w) slot--;
+			if (slot >= EMITTER_TILE_CAPACITY) continue;
+			int last = tile->count < EMITTER_TILE_CAPACITY ? tile->count : EMITTER_TILE_CAPACITY - 1;
+			for (int s = last; s > slot; s--) {
+				importance[s] = importance[s - 1];
+				tile->emitters[s] = tile->emitters[s - 1];
+			}
+			importance[slot] = w;
+			tile->emitters[slot] = e;
+			if (tile->count < EMITTER_TILE_CAPACITY) tile->count++;
+		}
+	}
+}
+
+void RayTraceShadeSignals(const Object *objects, int objectCount, Camera *camera, const MaterialTable *materials, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool, const Skybox *skybox, int samplePhase) {
+	if (!objects || objectCount <= 0 || !camera || !materials || materials->count <= 0 || !taskQueue || !threadPool) return;
+	// the emitter tile grid and the row lane arrays are sized for WIDTH x HEIGHT
+	if (camera->screenWidth > WIDTH || camera->screenHeight > HEIGHT) {
+		fprintf(stderr, "RayTraceShadeSignals: %dx%d camera exceeds the %dx%d shading buffers\n",
+				camera->screenWidth, camera->screenHeight, WIDTH, HEIGHT);
+		return;
+	}
+	if (!Camera_Require(camera, SHADE_BUFFERS)) return;
+
+	// emitter spheres in view space — radius is where peak / d^2 drops below EMITTER_CUTOFF
+	float3 orig = camera->position;
+	float3 fwd = Float3_Normalize(camera->forward);
+	float3 rgt = Float3_Normalize(camera->right);
+	float3 up_ = Float3_Normalize(camera->up);
+	EmitterBounds bounds[objectCount];
+	int boundsCount = 0;
+	for (int i = 0; i < objectCount; i++) {
+		if (!objects[i].hasEmission || objects[i].emissionPeak <= 0.0f) continue;
+		float3 rel = Float3_Sub(objects[i].position, orig);
+		float radius = sqrtf(objects[i].emissionPeak / EMITTER_CUTOFF);
+		float3 vc = {Float3_Dot(rel, rgt), Float3_Dot(rel, up_), Float3_Dot(rel, fwd)};
+		if (vc.z + radius < 0.0f) continue; // entirely behind the camera
+		bounds[boundsCount++] = (EmitterBounds){vc, radius, objects[i].emissionPeak, i};
+	}
+
+	EmitterTileGrid *grid = &taskQueue->emitterTiles;
+	grid->tilesX = (camera->screenWidth + EMITTER_TILE_SIZE - 1) / EMITTER_TILE_SIZE;
+	grid->tilesY = (camera->screenHeight + EMITTER_TILE_SIZE - 1) / EMITTER_TILE_SIZE;
+	grid->bounds = bounds;
+	grid->boundsCount = boundsCount;
+	for (int ty = 0; ty < grid->tilesY; ty++) {
+		taskQueue->tasks[ty] = (RayTraceTask){ty, camera, objects, objectCount, .emitterTiles = grid};
+		poolAdd(threadPool, EmitterTileRowFunc, &taskQueue->tasks[ty]);
+	}
+	poolWait(threadPool);
+
+	for (int row = 0; row < camera->screenHeight; row++) {
+		taskQueue->tasks[row] = (RayTraceTask){row, camera, objects, objectCount, NULL, skybox, .materials = materials, .emitterTiles = grid};
+		poolAdd(threadPool, ShadeRowFunc, &taskQueue->tasks[row]);
+	}
+	poolWait(threadPool);
+
+	int lowHeight = (camera->screenHeight + SECONDARY_RESOLUTION - 1) / SECONDARY_RESOLUTION;
+	for (int ly = 0; ly < lowHeight; ly++) {
+		taskQueue->tasks[ly] = (RayTraceTask){ly, camera, objects, objectCount, NULL, skybox, .materials = materials, .emitterTiles = grid, .samplePhase = samplePhase};
+		poolAdd(threadPool, SecondaryRowFunc, &taskQueue->tasks[ly]);
+	}
+	poolWait(threadPool);
+
+	for (int row = 0; row < camera->screenHeight; row++) {
+		taskQueue->tasks[row] = (RayTraceTask){row, camera};
+		poolAdd(threadPool, UpsampleRowFunc, &taskQueue->tasks[row]);
+	}
+	poolWait(threadPool);
+	grid->bounds = NULL; // lived on this stack frame; the tile lists stay until the next call
+}
+
+void RayTraceComposite(Camera *camera, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool, int blurRadius) {
+	if (!camera || !taskQueue || !threadPool) return;
+	if (!Camera_Require(camera, COMPOSITE_BUFFERS)) return;
+	for (int row = 0; row < camera->screenHeight; row++) {
+		taskQueue->tasks[row] = (RayTraceTask){row, camera, .blurRadius = blurRadius};
+		poolAdd(threadPool, CompositeRowFunc, &taskQueue->tasks[row]);
+	}
+	poolWait(threadPool);
+}
+
+void RayTracePackHdr(Camera *camera, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool) {
+	if (!camera || !taskQueue || !threadPool) return;
+	if (!Camera_Require(camera, CAMERA_FRAMEBUFFER | CAMERA_HDR)) return;
+	for (int row = 0; row < camera->screenHeight; row++) {
+		taskQueue->tasks[row] = (RayTraceTask){row, camera};
+		poolAdd(threadPool, PackHdrRowFunc, &taskQueue->tasks[row]);
+	}
+	poolWait(threadPool);
+}
+
+void RayTraceShade(const Object *objects, int objectCount, Camera *camera, const MaterialTable *materials, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool, const Skybox *skybox) {
+	if (!objects || objectCount <= 0 || !camera || !materials || materials->count <= 0 || !taskQueue || !threadPool) return;
+	RayTraceShadeSignals(objects, objectCount, camera, materials, taskQueue, threadPool, skybox, 0);
+	RayTraceComposite(camera, taskQueue, threadPool, BLUR_RADIUS);
+	RayTracePackHdr(camera, taskQueue, threadPool);
+}
+
+void RayTraceSceneDeferred(const Object *objects, int objectCount, Camera *camera, const MaterialTable *materials, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool, const Skybox *skybox) {
+	RayTraceVisibility(objects, objectCount, camera, taskQueue, threadPool);
+	RayTraceShade(objects, objectCount, camera, materials, taskQueue, threadPool, skybox);
+}
+
 static void RayTraceColumnFunc(void *arg) {
 	RayTraceTask *task = arg;
 	int col = task->row;
@@ -1123,7 +1931,9 @@ static void RayTraceColumnFunc(void *arg) {
 
 	// per-column constants — products and association order match the row version
 	// exactly so rays are bit-identical and frame hashes match
-	float ndcX = (col + 0.5f) / (float)width * 2.0f - 1.0f;
+	float jitterX = camera->jitter.x;
+	float jitterY = camera->jitter.y;
+	float ndcX = (col + 0.5f + jitterX) / (float)width * 2.0f - 1.0f;
 	float xstepX = rgt.x * aspect * fovScale;
 	float xstepY = rgt.y * aspect * fovScale;
 	float xstepZ = rgt.z * aspect * fovScale;
@@ -1161,7 +1971,7 @@ static void RayTraceColumnFunc(void *arg) {
 	for (int y = 0; y < height; y++) {
 		int idx = y * width + col;
 
-		float ndcY = 1.0f - (y + 0.5f) / (float)height * 2.0f;
+		float ndcY = 1.0f - (y + 0.5f + jitterY) / (float)height * 2.0f;
 		float yscale = ndcY * fovScale;
 		float dx = fwd.x + up_.x * yscale + xstepX * ndcX;
 		float dy = fwd.y + up_.y * yscale + xstepY * ndcX;
@@ -1211,143 +2021,19 @@ static void RayTraceColumnFunc(void *arg) {
 
 		const Object *obj = &objects[bestObj];
 
-		float3 v0, v1, v2;
-		v0 = obj->v1[bestTri];
-		v1 = obj->v2[bestTri];
-		v2 = obj->v3[bestTri];
-
-		// check if object has textures
-		uvCoordinates xyCordsTexture = {0, 0};
-		bool hasTexture = obj->hasTexture;
-
-		if (hasTexture) {
-			// barycentric needs local-space coords — transform world hit back to local
-			float3 localHit = InverseTransformPointTRS(bestHitPos, obj->position, obj->rotation, obj->scale);
-			xyCordsTexture = calculateUvCoordinatesForTriangle(localHit, v0, v1, v2, obj->uvs[bestTri]);
-		}
-
-		float3 ln = obj->normals[bestTri];
-		float3 n = {
-			obj->_fwdRot0.x * ln.x + obj->_fwdRot0.y * ln.y + obj->_fwdRot0.z * ln.z,
-			obj->_fwdRot1.x * ln.x + obj->_fwdRot1.y * ln.y + obj->_fwdRot1.z * ln.z,
-			obj->_fwdRot2.x * ln.x + obj->_fwdRot2.y * ln.y + obj->_fwdRot2.z * ln.z};
-		float nlen = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
-		if (nlen > 1e-6f) {
-			float ni = 1.0f / nlen;
-			n.x *= ni;
-			n.y *= ni;
-			n.z *= ni;
-		}
-
-		float3 color = {0.8f, 0.8f, 0.8f};
-		float emission = 0.0f;
-		float roughness = 0.8f;
-		float metallic = 0.0f;
-
-		// texture data
-		float3 normalFromTexture_Float3 = {0.0f, 0.0f, 0.0f};
-		float3 colorFromTexture_Float3 = {0.0f, 0.0f, 0.0f};
-		float roughnessFromTexture_Float = 0.0f;
-		float metallicFromTexture_Float = 0.0f;
-
-		if (lib && obj->materialIds) {
-			int matId = obj->materialIds[bestTri];
-			if (matId >= 0 && matId < lib->count) {
-				color = lib->entries[matId].color;
-				// emission = lib->entries[matId].emission;
-				emission = lib->entries[matId].emission * 0.01f; // scale down emission to prevent it from dominating the lighting
-				metallic = lib->entries[matId].metallic;
-				roughness = lib->entries[matId].roughness;
-
-				if (hasTexture && lib->entries[matId].textures) {
-					Color colorFromTexture = lib->entries[matId].textures->colorMap[xyCordsTexture.y][xyCordsTexture.x];
-					Color normalFromTexture = lib->entries[matId].textures->normalMap[xyCordsTexture.y][xyCordsTexture.x];
-					uint16 roughnessAndMetallicFromTexture = lib->entries[matId].textures->MaterialMap[xyCordsTexture.y][xyCordsTexture.x];
-
-					// Texture maps are stored R=bits[0..7], G=bits[8..15], B=bits[16..23]
-					// UnpackColor reads R from bits[16..23], so channels would be swapped — extract directly.
-					colorFromTexture_Float3 = (float3){
-						(colorFromTexture & 0xFF) / 255.0f,
-						((colorFromTexture >> 8) & 0xFF) / 255.0f,
-						((colorFromTexture >> 16) & 0xFF) / 255.0f,
-					};
-					normalFromTexture_Float3 = (float3){
-						(normalFromTexture & 0xFF) / 255.0f,
-						((normalFromTexture >> 8) & 0xFF) / 255.0f,
-						((normalFromTexture >> 16) & 0xFF) / 255.0f,
-					};
-
-					colorFromTexture_Float3 = Float3_Scale(colorFromTexture_Float3, 1.25f); // boost texture color a bit to make it more visible
-
-					uint8 roughnessFromTexture = roughnessAndMetallicFromTexture & 0xFF;
-					uint8 metallicFromTexture = (roughnessAndMetallicFromTexture >> 8) & 0xFF;
-					// map_Ns holds a standard roughness map (white = rough) — do not invert
-					roughnessFromTexture_Float = roughnessFromTexture / 255.0f;
-					metallicFromTexture_Float = metallicFromTexture / 255.0f;
-					if (metallicFromTexture_Float > 0.25f) {
-						metallicFromTexture_Float = 0.25f + (metallicFromTexture_Float - 0.25f) * 0.75f; // compress metallic range to prevent it from dominating the lighting
-					}
-				}
-			}
-		}
+		float3 v0 = obj->v1[bestTri];
+		float3 v1 = obj->v2[bestTri];
+		float3 v2 = obj->v3[bestTri];
 
-		if (hasTexture) {
-			color = colorFromTexture_Float3;
-			roughness = roughnessFromTexture_Float;
-			metallic = metallicFromTexture_Float;
-
-			// decode tangent-space normal from [0,1] -> [-1,1]
-			// negate Y: Go flips V (vc = 1-v), which negates dV and thus B, inverting normal.y
-			float3 nTex = {
-				normalFromTexture_Float3.x * 2.0f - 1.0f,
-				-(normalFromTexture_Float3.y * 2.0f - 1.0f),
-				normalFromTexture_Float3.z * 2.0f - 1.0f,
-			};
-			float nTexLen = Float3_Length(nTex);
-			if (nTexLen > 1e-3f) {
-				UvCords uvCords = obj->uvs[bestTri];
-				float dU1 = ((int)uvCords.uv2x - (int)uvCords.uv1x) / 65535.0f;
-				float dV1 = ((int)uvCords.uv2y - (int)uvCords.uv1y) / 65535.0f;
-				float dU2 = ((int)uvCords.uv3x - (int)uvCords.uv1x) / 65535.0f;
-				float dV2 = ((int)uvCords.uv3y - (int)uvCords.uv1y) / 65535.0f;
-				float3 edge1 = Float3_Sub(v1, v0);
-				float3 edge2 = Float3_Sub(v2, v0);
-				float det = dU1 * dV2 - dU2 * dV1;
-				float3 T, B;
-				if (fabsf(det) > 1e-6f) {
-					float inv = 1.0f / det;
-					float3 tRaw = {
-						(dV2 * edge1.x - dV1 * edge2.x) * inv,
-						(dV2 * edge1.y - dV1 * edge2.y) * inv,
-						(dV2 * edge1.z - dV1 * edge2.z) * inv,
-					};
-					// rotate tangent to world space, same transform as normals
-					float3 tWorld = {
-						obj->_fwdRot0.x * tRaw.x + obj->_fwdRot0.y * tRaw.y + obj->_fwdRot0.z * tRaw.z,
-						obj->_fwdRot1.x * tRaw.x + obj->_fwdRot1.y * tRaw.y + obj->_fwdRot1.z * tRaw.z,
-						obj->_fwdRot2.x * tRaw.x + obj->_fwdRot2.y * tRaw.y + obj->_fwdRot2.z * tRaw.z,
-					};
-					// Gram-Schmidt orthogonalize against geometric normal
-					T = Float3_Normalize(Float3_Sub(tWorld, Float3_Scale(n, Float3_Dot(tWorld, n))));
-					B = Float3_Cross(n, T);
-				} else {
-					// degenerate UVs — build arbitrary frame from n
-					float3 up = fabsf(n.y) < 0.9f ? (float3){0.0f, 1.0f, 0.0f} : (float3){1.0f, 0.0f, 0.0f};
-					T = Float3_Normalize(Float3_Cross(up, n));
-					B = Float3_Cross(n, T);
-				}
-				float3 nTexN = Float3_Normalize((float3){nTex.x * NORMAL_MAP_STRENGTH / nTexLen, nTex.y * NORMAL_MAP_STRENGTH / nTexLen, nTex.z / nTexLen});
-				n = Float3_Normalize((float3){
-					T.x * nTexN.x + B.x * nTexN.y + n.x * nTexN.z,
-					T.y * nTexN.x + B.y * nTexN.y + n.y * nTexN.z,
-					T.z * nTexN.x + B.z * nTexN.y + n.z * nTexN.z,
-				});
-			}
-		}
+		Surface surface = ResolveSurfaceLib(obj, bestTri, bestHitPos, lib);
+		float3 n = surface.normal;
+		float3 color = surface.color;
+		float emission = surface.emission;
+		float roughness = surface.roughness;
+		float metallic = surface.metallic;
 
 		float3 sOrig = {bestHitPos.x + n.x * 0.01f, bestHitPos.y + n.y * 0.01f, bestHitPos.z + n.z * 0.01f};
-		camera->normalBuffer[idx] = n;
-		camera->positionBuffer[idx] = bestHitPos;
+		camera->normalBuffer[idx] = PackNormal(n);
 
 		float diffuse = n.x * lightDir.x + n.y * lightDir.y + n.z * lightDir.z;
 		if (diffuse < 0.0f) diffuse = 0.0f;
@@ -1400,7 +2086,7 @@ static void RayTraceColumnFunc(void *arg) {
 		float3 reflDir = {dx - n.x * dot2, dy - n.y * dot2, dz - n.z * dot2};
 
 		// sky reflection blend metals tint it by albedo, dielectrics reflect white sky
-		Color skyRefl = SampleSkybox(task->skybox, reflDir);
+		Color skyRefl = SampleSkyboxRough(task->skybox, reflDir, roughness);
 		uint32 st = (uint32)(reflectStrength * 255.0f);
 		if (st > 255u) st = 255u;
 		uint32 sit = 255u - st;
@@ -1421,7 +2107,7 @@ static void RayTraceColumnFunc(void *arg) {
 		camera->objectIdBuffer[idx] = bestObj;
 		// w = geometry reflection strength — use roughGloss^2 so it stays stronger than sky blend
 		float roughGloss = 1.0f - roughness;
-		camera->reflectBuffer[idx] = (float3){reflDir.x, reflDir.y, reflDir.z, roughGloss * roughGloss};
+		camera->reflectBuffer[idx] = PackHalf4W(reflDir.x, reflDir.y, reflDir.z, roughGloss * roughGloss);
 		camera->bloomBuffer[idx] = (float3){color.x * emission, color.y * emission, color.z * emission};
 		camera->uvBuffer[idx] = calculateUvCoordinates(bestHitPos, v0, v1, v2);
 		camera->triangleIdBuffer[idx] = bestTri;
@@ -1439,8 +2125,8 @@ static void RayTraceColumnFunc(void *arg) {
 				float prevNdcY = prevViewY / (prevViewZ * prevFov);
 				float prevU = (prevNdcX + 1.0f) * 0.5f;
 				float prevV = (1.0f - prevNdcY) * 0.5f;
-				float currU = (col + 0.5f) / (float)width;
-				float currV = (y + 0.5f) / (float)height;
+				float currU = (col + 0.5f + jitterX) / (float)width;
+				float currV = (y + 0.5f + jitterY) / (float)height;
 				camera->motionVectorBuffer[idx] = (float2){currU - prevU, currV - prevV};
 			} else {
 				camera->motionVectorBuffer[idx] = (float2){0.0f, 0.0f};
@@ -1480,17 +2166,8 @@ static void RayTraceColumnFunc(void *arg) {
 			float3 accumulatedEmission = {0.0f, 0.0f, 0.0f};
 			for (int t = 0; t < TOP_EMISSIVE_OBJECTS; t++) {
 				if (topEmissiveIndices[t] < 0) break; // fewer emitters than TOP_EMISSIVE_OBJECTS
-				float3 targetPos = objects[topEmissiveIndices[t]].position;
-				float3 toEmissive = Float3_Sub(targetPos, bestHitPos);
-				// NdotL: only surfaces facing the emitter receive light
-				float3 toEmissiveN = Float3_Normalize(toEmissive);
-				float NdotL = fabsf(n.x * toEmissiveN.x + n.y * toEmissiveN.y + n.z * toEmissiveN.z);
-				if (NdotL <= 0.0f) continue;
-				float3 em = SampleEmission(objects, objectCount, bestHitPos, toEmissive, topEmissiveIndices[t], lib);
-				float falloff = NdotL / (topEmissiveDistances[t] * topEmissiveDistances[t] + 1e-6f);
-				accumulatedEmission.x += em.x * falloff;
-				accumulatedEmission.y += em.y * falloff;
-				accumulatedEmission.z += em.z * falloff;
+				float3 toEmissive = Float3_Sub(objects[topEmissiveIndices[t]].position, bestHitPos);
+				AddEmitterLight(objects, objectCount, bestHitPos, n, toEmissive, topEmissiveDistances[t], topEmissiveIndices[t], lib, &accumulatedEmission);
 			}
 
 			catchEmission = accumulatedEmission;
@@ -1503,7 +2180,7 @@ static void RayTraceColumnFunc(void *arg) {
 				catchReflection.z = rHit.mat.color.z;
 				catchReflection.w = reflectStrength;
 			} else {
-				Color skyColor = SampleSkybox(task->skybox, reflDir);
+				Color skyColor = SampleSkyboxRough(task->skybox, reflDir, roughness);
 				catchReflection.x = ((skyColor >> 16) & 0xFF) / 255.0f;
 				catchReflection.y = ((skyColor >> 8) & 0xFF) / 255.0f;
 				catchReflection.z = (skyColor & 0xFF) / 255.0f;
@@ -1551,9 +2228,10 @@ static void RayTraceColumnFunc(void *arg) {
 		Color baseColor = camera->framebuffer[y * width + col];
 		float3 base = UnpackColor(baseColor);
 		float shadowMod = 0.03f + 0.97f * fminf(accumulatedShadow.x, 1.0f);
-		float3 combined = hdrToLDR(base.x * shadowMod + accumulatedEmission.x + accumulatedColor.x * camera->reflectBuffer[y * width + col].w,
-								   base.y * shadowMod + accumulatedEmission.y + accumulatedColor.y * camera->reflectBuffer[y * width + col].w,
-								   base.z * shadowMod + accumulatedEmission.z + accumulatedColor.z * camera->reflectBuffer[y * width + col].w);
+		float reflW = UnpackHalf4(camera->reflectBuffer[y * width + col]).w;
+		float3 combined = hdrToLDR(base.x * shadowMod + accumulatedEmission.x + accumulatedColor.x * reflW,
+								   base.y * shadowMod + accumulatedEmission.y + accumulatedColor.y * reflW,
+								   base.z * shadowMod + accumulatedEmission.z + accumulatedColor.z * reflW);
 
 		float3 ownEmission = camera->bloomBuffer[y * width + col];
 		camera->bloomBuffer[y * width + col] = (float3){
@@ -1569,6 +2247,7 @@ static void RayTraceColumnFunc(void *arg) {
 // TODO: test column based ray tracing and benchmark it against row based
 void RayTraceSceneColumn(const Object *objects, int objectCount, Camera *camera, const MaterialLib *lib, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool, const Skybox *skybox) {
 	if (!objects || objectCount <= 0 || !camera || !taskQueue || !threadPool) return;
+	if (!Camera_Require(camera, FORWARD_BUFFERS)) return;
 	Frustum frustum = Frustum_FromCamera(camera);
 
 	// cull once per frame — frustum is constant across all pixels
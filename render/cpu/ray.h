@@ -9,9 +9,16 @@
 #include "../render.h"
 
 #define REFLECTION_RESOLUTION 4 // 1 = full, 2 = half, 4 = quarter, etc.
+#define SECONDARY_RESOLUTION 2	// deferred path: secondary rays per NxN block, 2 = half, 4 = quarter (>= 2, see Camera)
+#define SSR_REPLACE_CONFIDENCE 0.6f // deferred path: SSR hits this confident skip the reflection ray
 #define BLUR_RADIUS 3
 #define TOP_EMISSIVE_OBJECTS 3 // only consider the top N closest emissive objects for reflections to save ray casts
 #define NORMAL_MAP_STRENGTH 2   // tangent-space normal map intensity multiplier
+#define EMITTER_TILE_SIZE 16     // screen tile edge for per-frame emitter culling
+#define EMITTER_TILE_CAPACITY 16 // ranked emitters kept per tile, most important first
+#define EMITTER_CUTOFF 0.004f    // emission below this (after 1/d^2 falloff) is treated as zero
+#define EMITTER_TILES_X ((WIDTH + EMITTER_TILE_SIZE - 1) / EMITTER_TILE_SIZE)
+#define EMITTER_TILES_Y ((HEIGHT + EMITTER_TILE_SIZE - 1) / EMITTER_TILE_SIZE)
 
 typedef struct {
 	int row;
@@ -23,6 +30,27 @@ typedef struct {
 	SkyBoxTask tasks[HEIGHT];
 } SkyBoxTaskQueue;
 
+// Emissive object as seen by the tile pass: view-space sphere of influence
+typedef struct {
+	float3 viewCenter; // x along right, y along up, z along forward
+	float radius;	   // distance where peak emission falls below EMITTER_CUTOFF
+	float peak;
+	int index; // into the frame's object array
+} EmitterBounds;
+
+typedef struct {
+	int count;
+	int emitters[EMITTER_TILE_CAPACITY]; // indices into EmitterTileGrid.bounds
+} EmitterTile;
+
+// Per-frame screen-tile emitter lists for the deferred shading path
+typedef struct {
+	int tilesX, tilesY;
+	const EmitterBounds *bounds; // only set during RayTraceShadeSignals
+	int boundsCount;
+	EmitterTile tiles[EMITTER_TILES_X * EMITTER_TILES_Y];
+} EmitterTileGrid;
+
 typedef struct {
 	int row;
 	Camera *camera;
@@ -33,14 +61,36 @@ typedef struct {
 	Frustum frustum;
 	const int *frustumPassIndices;
 	int frustumPassCount;
+	const MaterialTable *materials; // deferred shading path only
+	EmitterTileGrid *emitterTiles;	// deferred shading path only
+	int blurRadius;					// composite pass only
+	int samplePhase;				// deferred shading path only: secondary-ray pixel within its block
 } RayTraceTask;
 
 typedef struct {
 	// WIDTH >= HEIGHT, so one queue serves both row- and column-based dispatch
 	RayTraceTask tasks[WIDTH];
+	EmitterTileGrid emitterTiles;
 } RayTraceTaskQueue;
 
 void RayTraceScene(const Object *objects, int objectCount, Camera *camera, const MaterialLib *lib, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool, const Skybox *skybox);
+// Two-phase renderer: RayTraceVisibility fills objectId/triangleId/bary/depth buffers,
+// RayTraceShade shades from them. RayTraceSceneDeferred runs both.
+// RayTraceShade = RayTraceShadeSignals (direct light into hdrBuffer, noisy shadow /
+// emission / reflection into the camera signal buffers) + RayTraceComposite with BLUR_RADIUS
+// + RayTracePackHdr, so the framebuffer holds a clamped preview of the linear result.
+// Secondary rays are traced on a SECONDARY_RESOLUTION grid and joint-bilaterally upsampled.
+// Run a denoiser between the two and composite with blurRadius 0 instead; pass the frame
+// number as samplePhase so the traced pixel rotates through each block under the temporal filter.
+// SSRTraceReflections (ssr.h) before RayTraceShadeSignals lets on-screen reflections skip their ray.
+// RayTraceShadeSignals rejects cameras larger than WIDTH x HEIGHT with an error.
+void RayTraceVisibility(const Object *objects, int objectCount, Camera *camera, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool);
+void RayTraceShadeSignals(const Object *objects, int objectCount, Camera *camera, const MaterialTable *materials, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool, const Skybox *skybox, int samplePhase);
+void RayTraceComposite(Camera *camera, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool, int blurRadius);
+// hdrBuffer -> framebuffer, clamped without tone mapping. The frame loop packs in PostProcess instead.
+void RayTracePackHdr(Camera *camera, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool);
+void RayTraceShade(const Object *objects, int objectCount, Camera *camera, const MaterialTable *materials, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool, const Skybox *skybox);
+void RayTraceSceneDeferred(const Object *objects, int objectCount, Camera *camera, const MaterialTable *materials, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool, const Skybox *skybox);
 void RayTraceSceneColumn(const Object *objects, int objectCount, Camera *camera, const MaterialLib *lib, RayTraceTaskQueue *taskQueue, ThreadPool *threadPool, const Skybox *skybox);
 
 // Persistent raytrace workers — live for program lifetime, sync via barriers each frame
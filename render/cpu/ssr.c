@@ -1,133 +1,441 @@
 #include "ssr.h"
+#include "ray.h"
 #include "../../math/vector3.h"
+#include "../color/color.h"
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
-static void SSRProcessRow(Camera *camera, int row) {
-	int W = camera->screenWidth;
-	int H = camera->screenHeight;
+#define TRACE_BUFFERS (CAMERA_DEPTH | CAMERA_NORMAL | CAMERA_REFLECT | CAMERA_MOTION | CAMERA_SSR_REFLECTION)
+#define POST_PROCESS_BUFFERS (CAMERA_FRAMEBUFFER | CAMERA_DEPTH | CAMERA_NORMAL | CAMERA_REFLECT | CAMERA_MOTION | CAMERA_TEMP_FRAMEBUFFER)
+#define ALIGN64(n) (((n) + 63) & ~(size_t)63)
+#define SSR_NEAR 0.05f
+
+void SSR_Init(SSRContext *ssr, int width, int height) {
+	if (!ssr) return;
+	memset(ssr, 0, sizeof(SSRContext));
+	ssr->width = width;
+	ssr->height = height;
+	ssr->lowWidth = (width + SECONDARY_RESOLUTION - 1) / SECONDARY_RESOLUTION;
+	ssr->lowHeight = (height + SECONDARY_RESOLUTION - 1) / SECONDARY_RESOLUTION;
+	size_t lowSize = (size_t)ssr->lowWidth * ssr->lowHeight;
+
+	int ok = 1;
+	ssr->levelWidth[0] = width;
+	ssr->levelHeight[0] = height;
+	for (int l = 1; l < SSR_HIZ_LEVELS; l++) {
+		ssr->levelWidth[l] = (ssr->levelWidth[l - 1] + 1) / 2;
+		ssr->levelHeight[l] = (ssr->levelHeight[l - 1] + 1) / 2;
+		ssr->hiZ[l] = (float *)aligned_alloc(64, ALIGN64((size_t)ssr->levelWidth[l] * ssr->levelHeight[l] * sizeof(float)));
+		if (!ssr->hiZ[l]) ok = 0;
+	}
+	ssr->hits = (float3 *)aligned_alloc(64, ALIGN64(lowSize * sizeof(float3)));
+	ssr->history = (float3 *)aligned_alloc(64, ALIGN64(lowSize * sizeof(float3)));
+	ssr->historyTemp = (float3 *)aligned_alloc(64, ALIGN64(lowSize * sizeof(float3)));
+	ssr->lowPixel = (int *)aligned_alloc(64, ALIGN64(lowSize * sizeof(int)));
+	ssr->lowDepth = (float *)aligned_alloc(64, ALIGN64(lowSize * sizeof(float)));
+	ssr->prevLowDepth = (float *)aligned_alloc(64, ALIGN64(lowSize * sizeof(float)));
+	ssr->prevFrame = (Color *)aligned_alloc(64, ALIGN64((size_t)width * height * sizeof(Color)));
+	ssr->tasks = (SSRTask *)malloc(sizeof(SSRTask) * ((height + SSR_ROWS_PER_TASK - 1) / SSR_ROWS_PER_TASK));
+	if (!ok || !ssr->hits || !ssr->history || !ssr->historyTemp || !ssr->lowPixel || !ssr->lowDepth ||
+		!ssr->prevLowDepth || !ssr->prevFrame || !ssr->tasks) {
+		SSR_Destroy(ssr);
+		return;
+	}
+	SSR_Reset(ssr);
+}
+
+void SSR_Destroy(SSRContext *ssr) {
+	if (!ssr) return;
+	for (int l = 1; l < SSR_HIZ_LEVELS; l++)
+		free(ssr->hiZ[l]);
+	free(ssr->hits);
+	free(ssr->history);
+	free(ssr->historyTemp);
+	free(ssr->lowPixel);
+	free(ssr->lowDepth);
+	free(ssr->prevLowDepth);
+	free(ssr->prevFrame);
+	free(ssr->tasks);
+	memset(ssr, 0, sizeof(SSRContext));
+}
+
+void SSR_Reset(SSRContext *ssr) {
+	if (!ssr) return;
+	ssr->hasHistory = 0;
+	ssr->hasPrevFrame = 0;
+}
+
+void SSR_StoreFrame(SSRContext *ssr, const Camera *camera) {
+	if (!ssr || !ssr->prevFrame || !camera || !camera->hdrBuffer) return;
+	if (camera->screenWidth != ssr->width || camera->screenHeight != ssr->height) return;
+	PackHdr(camera->hdrBuffer, ssr->prevFrame, ssr->width * ssr->height);
+	ssr->hasPrevFrame = 1;
+}
+
+// Each Hi-Z texel holds the nearest view depth of the 2x2 texels below it.
+static void HiZRowTask(void *arg) {
+	SSRTask *task = arg;
+	SSRContext *ssr = task->ssr;
+	int l = task->level;
+	int w = ssr->levelWidth[l], h = ssr->levelHeight[l];
+	int srcW = ssr->levelWidth[l - 1], srcH = ssr->levelHeight[l - 1];
+	const float *src = ssr->hiZ[l - 1];
+	float *dst = ssr->hiZ[l];
+
+	for (int y = task->row; y < task->row + task->rowCount && y < h; y++) {
+		const float *r0 = &src[(2 * y) * srcW];
+		const float *r1 = &src[(2 * y + 1 < srcH ? 2 * y + 1 : 2 * y) * srcW];
+		for (int x = 0; x < w; x++) {
+			int x0 = 2 * x, x1 = 2 * x + 1 < srcW ? 2 * x + 1 : 2 * x;
+			dst[y * w + x] = fminf(fminf(r0[x0], r0[x1]), fminf(r1[x0], r1[x1]));
+		}
+	}
+}
+
+static inline int ProjectToScreen(const Camera *camera, float3 fwd, float3 rgt, float3 up, float3 rel, float *sx, float *sy) {
+	float depth = rel.x * fwd.x + rel.y * fwd.y + rel.z * fwd.z;
+	if (depth < SSR_NEAR * 0.5f) return 0;
+	float invD = 1.0f / (depth * camera->fovScale);
+	float ndcX = (rel.x * rgt.x + rel.y * rgt.y + rel.z * rgt.z) * invD / camera->aspect;
+	float ndcY = (rel.x * up.x + rel.y * up.y + rel.z * up.z) * invD;
+	*sx = (ndcX + 1.0f) * 0.5f * camera->screenWidth;
+	*sy = (-ndcY + 1.0f) * 0.5f * camera->screenHeight;
+	return 1;
+}
+
+// Walks the ray through the Hi-Z pyramid in screen space. A cell whose nearest depth lies
+// behind the ray's whole span inside it is skipped and the walk climbs a level; otherwise
+// it descends, and at level 0 a surface within SSR_THICKNESS of the ray is a hit. A ray that
+// passes behind a surface ends the walk; the caller falls back to its reflection ray.
+// View depth is interpolated as 1/z, which is linear in screen space.
+static int HiZTrace(const SSRContext *ssr, const Camera *camera, float3 fwd, float3 rgt, float3 up,
+					float3 origin, float3 dir, float *hitX, float *hitY, float *hitT) {
+	int W = camera->screenWidth, H = camera->screenHeight;
+	float3 rel0 = Float3_Sub(origin, camera->position);
+	float z0 = rel0.x * fwd.x + rel0.y * fwd.y + rel0.z * fwd.z;
+	float dirZ = dir.x * fwd.x + dir.y * fwd.y + dir.z * fwd.z;
+	if (z0 < SSR_NEAR) return -1;
+	float len = SSR_MAX_DIST;
+	if (z0 + dirZ * len < SSR_NEAR) len = (SSR_NEAR - z0) / dirZ;
+	float3 rel1 = {rel0.x + dir.x * len, rel0.y + dir.y * len, rel0.z + dir.z * len};
+	float z1 = z0 + dirZ * len;
+
+	float x0, y0, x1, y1;
+	if (!ProjectToScreen(camera, fwd, rgt, up, rel0, &x0, &y0)) return -1;
+	if (!ProjectToScreen(camera, fwd, rgt, up, rel1, &x1, &y1)) return -1;
+	float dx = x1 - x0, dy = y1 - y0;
+	float pixLen = sqrtf(dx * dx + dy * dy);
+	if (pixLen < 1.0f) return -1;
+	float k0 = 1.0f / z0, dk = 1.0f / z1 - k0;
+	float eps = 0.01f / pixLen;
+
+	float t = 1.0f / pixLen; // skip the origin pixel
+	int level = 0;
+	for (int iter = 0; iter < SSR_MAX_ITERATIONS && t < 1.0f; iter++) {
+		float px = x0 + dx * t, py = y0 + dy * t;
+		if (px < 0.0f || py < 0.0f || px >= W || py >= H) return -1;
+		int cx = (int)px >> level, cy = (int)py >> level;
+		float cell = (float)(1 << level);
+		float tx = fabsf(dx) > 1e-6f ? ((dx > 0.0f ? cx + 1 : cx) * cell - x0) / dx : 2.0f;
+		float ty = fabsf(dy) > 1e-6f ? ((dy > 0.0f ? cy + 1 : cy) * cell - y0) / dy : 2.0f;
+		float tExit = fminf(fminf(tx, ty), 1.0f);
+
+		float zA = 1.0f / (k0 + dk * t), zB = 1.0f / (k0 + dk * tExit);
+		float rayNear = fminf(zA, zB), rayFar = fmaxf(zA, zB);
+		float cellMin = ssr->hiZ[level][cy * ssr->levelWidth[level] + cx];
+
+		if (rayFar < cellMin) {
+			t = tExit + eps;
+			if (level < SSR_HIZ_LEVELS - 1) level++;
+		} else if (level > 0) {
+			level--;
+		} else if (rayNear <= cellMin + SSR_THICKNESS + cellMin * 0.002f) {
+			*hitX = px;
+			*hitY = py;
+			*hitT = t;
+			return cy * W + cx;
+		} else {
+			return -1;
+		}
+	}
+	return -1;
+}
+
+static inline float3 FetchBilinear(const Color *src, int W, int H, float sx, float sy) {
+	float fx = sx - 0.5f, fy = sy - 0.5f;
+	int px = (int)floorf(fx), py = (int)floorf(fy);
+	float tx = fx - px, ty = fy - py;
+	int x0 = px < 0 ? 0 : px, y0 = py < 0 ? 0 : py;
+	int x1 = px + 1 < W ? px + 1 : W - 1, y1 = py + 1 < H ? py + 1 : H - 1;
+	if (x0 > W - 1) x0 = W - 1;
+	if (y0 > H - 1) y0 = H - 1;
+
+#define CH(c, sh) ((float)(((c) >> (sh)) & 0xFFu))
+	Color c00 = src[y0 * W + x0], c10 = src[y0 * W + x1];
+	Color c01 = src[y1 * W + x0], c11 = src[y1 * W + x1];
+	float w00 = (1.0f - tx) * (1.0f - ty), w10 = tx * (1.0f - ty), w01 = (1.0f - tx) * ty, w11 = tx * ty;
+	const float s = 1.0f / 255.0f;
+	float3 c = {
+		(CH(c00, 16) * w00 + CH(c10, 16) * w10 + CH(c01, 16) * w01 + CH(c11, 16) * w11) * s,
+		(CH(c00, 8) * w00 + CH(c10, 8) * w10 + CH(c01, 8) * w01 + CH(c11, 8) * w11) * s,
+		(CH(c00, 0) * w00 + CH(c10, 0) * w10 + CH(c01, 0) * w01 + CH(c11, 0) * w11) * s,
+		0.0f};
+#undef CH
+	return c;
+}
+
+// One ray per SECONDARY_RESOLUTION block, same pixel choice as the secondary-ray pass.
+static void TraceRowTask(void *arg) {
+	SSRTask *task = arg;
+	SSRContext *ssr = task->ssr;
+	Camera *camera = task->camera;
+	int W = camera->screenWidth, H = camera->screenHeight;
+	const int R = SECONDARY_RESOLUTION;
 
-	float3 camPos = camera->position;
 	float3 fwd = Float3_Normalize(camera->forward);
 	float3 rgt = Float3_Normalize(camera->right);
 	float3 up_ = Float3_Normalize(camera->up);
-	float fovS = camera->fovScale;
-	float aspect = camera->aspect;
-
-	for (int x = 0; x < W; x++) {
-		int idx = row * W + x;
-
-		if (camera->depthBuffer[idx] >= DEPTH_FAR) continue;
-
-		float3 worldPos = camera->positionBuffer[idx];
-		float3 n = camera->normalBuffer[idx];
-		float3 reflDir = camera->reflectBuffer[idx];
-		float reflectivity = reflDir.w; // (1-roughness) stored by the renderer
-		if (reflectivity < 0.05f) continue;
-
-		// Fresnel scaled by surface reflectivity
-		float3 toEye = Float3_Normalize(Float3_Sub(camPos, worldPos));
-		float NdotV = fmaxf(0.0f, n.x * toEye.x + n.y * toEye.y + n.z * toEye.z);
-		float inv = 1.0f - NdotV;
-		float inv2 = inv * inv;
-		float reflectStrength = reflectivity * (0.04f + 0.96f * (inv2 * inv2 * inv) + 0.5f * reflectivity);
-		if (reflectStrength > 1.0f) reflectStrength = 1.0f;
-
-		// Start march slightly above surface to avoid self-intersection
-		float cx = worldPos.x + n.x * SSR_DEPTH_BIAS;
-		float cy = worldPos.y + n.y * SSR_DEPTH_BIAS;
-		float cz = worldPos.z + n.z * SSR_DEPTH_BIAS;
-
-		for (int step = 0; step < SSR_MAX_STEPS; step++) {
-			cx += reflDir.x * SSR_STEP_SIZE;
-			cy += reflDir.y * SSR_STEP_SIZE;
-			cz += reflDir.z * SSR_STEP_SIZE;
-
-			// World to camera-relative
-			float rx = cx - camPos.x;
-			float ry = cy - camPos.y;
-			float rz = cz - camPos.z;
-
-			float depth = rx * fwd.x + ry * fwd.y + rz * fwd.z;
-			if (depth < 0.01f) continue;
-
-			float invD = 1.0f / (depth * fovS);
-			float ndcX = (rx * rgt.x + ry * rgt.y + rz * rgt.z) * invD / aspect;
-			float ndcY = (rx * up_.x + ry * up_.y + rz * up_.z) * invD;
-
-			float sx = (ndcX + 1.0f) * 0.5f * W;
-			float sy = (-ndcY + 1.0f) * 0.5f * H;
-
-			if (sx < 1.0f || sx >= W - 1.0f || sy < 1.0f || sy >= H - 1.0f) continue;
-
-			int px = (int)sx, py = (int)sy;
-			int pidx = py * W + px;
-
-			float sceneDepth = camera->depthBuffer[pidx];
-			float threshold = SSR_STEP_SIZE * 1.5f + depth * 0.001f;
-			float diff = depth - sceneDepth;
-
-			if (sceneDepth > 0.01f && diff > 0.0f && diff < threshold) {
-				// Bilinear fetch from the stable pre-pass copy in tempFramebuffer
-				int x1 = px + 1 < W ? px + 1 : px;
-				int y1 = py + 1 < H ? py + 1 : py;
-				float fx = sx - px, fy = sy - py;
-
-#define CH(c, sh) (((c) >> (sh)) & 0xFFu)
-				Color c00 = camera->tempFramebuffer[py * W + px];
-				Color c10 = camera->tempFramebuffer[py * W + x1];
-				Color c01 = camera->tempFramebuffer[y1 * W + px];
-				Color c11 = camera->tempFramebuffer[y1 * W + x1];
-#define BLERP(a, b, t) ((uint32)((a) + (int)((int)(b) - (int)(a)) * (t)))
-				uint32 sr = BLERP(BLERP(CH(c00, 16), CH(c10, 16), fx), BLERP(CH(c01, 16), CH(c11, 16), fx), fy);
-				uint32 sg = BLERP(BLERP(CH(c00, 8), CH(c10, 8), fx), BLERP(CH(c01, 8), CH(c11, 8), fx), fy);
-				uint32 sb = BLERP(BLERP(CH(c00, 0), CH(c10, 0), fx), BLERP(CH(c01, 0), CH(c11, 0), fx), fy);
-#undef CH
-#undef BLERP
+	int phase = task->samplePhase % (R * R);
+	int jx = phase % R, jy = phase / R;
+	float edgeX = 1.0f / (SSR_EDGE_FADE * W), edgeY = 1.0f / (SSR_EDGE_FADE * H);
+	PixelRays rays = Camera_PixelRays(camera);
 
-				if (sr + sg + sb <= 3u) break; // black hit — no useful data
+	for (int ly = task->row; ly < task->row + task->rowCount && ly < ssr->lowHeight; ly++) {
+		for (int lx = 0; lx < ssr->lowWidth; lx++) {
+			int lidx = ly * ssr->lowWidth + lx;
+			int bx = lx * R, by = ly * R;
+			int idx = (by + jy < H ? by + jy : H - 1) * W + (bx + jx < W ? bx + jx : W - 1);
+			for (int k = 0; camera->depthBuffer[idx] >= DEPTH_FAR && k < R * R; k++) {
+				int qx = bx + k % R, qy = by + k / R;
+				if (qx < W && qy < H) idx = qy * W + qx;
+			}
+			ssr->hits[lidx] = (float3){0.0f, 0.0f, 0.0f, 0.0f};
+			if (camera->depthBuffer[idx] >= DEPTH_FAR) {
+				ssr->lowPixel[lidx] = -1;
+				ssr->lowDepth[lidx] = -1.0f;
+				continue;
+			}
+			ssr->lowPixel[lidx] = idx;
+			ssr->lowDepth[lidx] = camera->depthBuffer[idx];
+
+			float3 reflDir = UnpackHalf4(camera->reflectBuffer[idx]);
+			if (reflDir.w < 0.05f) continue; // (1-roughness) stored by the renderer
+			reflDir.w = 0.0f;
+			float3 n = UnpackNormal(camera->normalBuffer[idx]);
+			float3 p = PixelRays_Position(&rays, idx % W, idx / W, camera->depthBuffer[idx]);
+			float3 origin = {p.x + n.x * SSR_DEPTH_BIAS, p.y + n.y * SSR_DEPTH_BIAS, p.z + n.z * SSR_DEPTH_BIAS};
 
-				uint32 st = (uint32)(reflectStrength * 255.0f);
-				if (st > 255u) st = 255u;
-				uint32 sit = 255u - st;
+			float hx, hy, ht;
+			int hit = HiZTrace(ssr, camera, fwd, rgt, up_, origin, reflDir, &hx, &hy, &ht);
+			if (hit < 0) continue;
+			float3 hn = UnpackNormal(camera->normalBuffer[hit]);
+			if (hn.x * reflDir.x + hn.y * reflDir.y + hn.z * reflDir.z > 0.0f) continue; // back face
 
-				Color base = camera->tempFramebuffer[idx];
-				uint32 nr = (((base >> 16) & 0xFF) * sit + sr * st) >> 8;
-				uint32 ng = (((base >> 8) & 0xFF) * sit + sg * st) >> 8;
-				uint32 nb = ((base & 0xFF) * sit + sb * st) >> 8;
-				camera->framebuffer[idx] = 0xFF000000u | (nr << 16) | (ng << 8) | nb;
-				break;
+			if (task->reproject) {
+				float2 mv = camera->motionVectorBuffer[hit];
+				hx -= mv.x * W;
+				hy -= mv.y * H;
+				if (hx < 0.0f || hy < 0.0f || hx >= W || hy >= H) continue;
 			}
+			float3 c = FetchBilinear(task->source, W, H, hx, hy);
+			if (c.x + c.y + c.z <= 3.0f / 255.0f) continue; // black hit — no useful data
+
+			float edge = fminf(fminf(hx * edgeX, (W - hx) * edgeX), fminf(hy * edgeY, (H - hy) * edgeY));
+			float conf = fminf(edge, 1.0f) * (1.0f - ht * ht);
+			ssr->hits[lidx] = (float3){c.x * conf, c.y * conf, c.z * conf, conf};
 		}
 	}
 }
 
-static void SSRRowTask(void *arg) {
+// Blends this frame's hits into the reprojected history, clamped to the 3x3 neighbourhood
+// of current hits so disoccluded or moving reflections do not ghost.
+static void ResolveRowTask(void *arg) {
 	SSRTask *task = arg;
-	for (int r = task->row; r < task->row + task->rowCount && r < task->camera->screenHeight; r++) {
-		SSRProcessRow(task->camera, r);
+	SSRContext *ssr = task->ssr;
+	Camera *camera = task->camera;
+	int W = camera->screenWidth, H = camera->screenHeight;
+	int LW = ssr->lowWidth, LH = ssr->lowHeight;
+	const int R = SECONDARY_RESOLUTION;
+
+	for (int ly = task->row; ly < task->row + task->rowCount && ly < LH; ly++) {
+		for (int lx = 0; lx < LW; lx++) {
+			int lidx = ly * LW + lx;
+			int idx = ssr->lowPixel[lidx];
+			float3 cur = ssr->hits[lidx];
+			float3 out = cur;
+			if (idx >= 0 && ssr->hasHistory) {
+				float2 mv = camera->motionVectorBuffer[idx];
+				float prevX = (idx % W + 0.5f) - mv.x * W;
+				float prevY = (idx / W + 0.5f) - mv.y * H;
+				int plx = (int)floorf(prevX / R), ply = (int)floorf(prevY / R);
+				if (plx >= 0 && ply >= 0 && plx < LW && ply < LH) {
+					int pl = ply * LW + plx;
+					float z = ssr->lowDepth[lidx], pz = ssr->prevLowDepth[pl];
+					if (pz > 0.0f && fabsf(pz - z) < SSR_REPROJECT_DEPTH * z) {
+						float3 mn = cur, mx = cur;
+						for (int dy = -1; dy <= 1; dy++) {
+							int qy = ly + dy;
+							if (qy < 0 || qy >= LH) continue;
+							for (int dx = -1; dx <= 1; dx++) {
+								int qx = lx + dx;
+								if (qx < 0 || qx >= LW || ssr->lowPixel[qy * LW + qx] < 0) continue;
+								float3 q = ssr->hits[qy * LW + qx];
+								mn = (float3){fminf(mn.x, q.x), fminf(mn.y, q.y), fminf(mn.z, q.z), fminf(mn.w, q.w)};
+								mx = (float3){fmaxf(mx.x, q.x), fmaxf(mx.y, q.y), fmaxf(mx.z, q.z), fmaxf(mx.w, q.w)};
+							}
+						}
+						float3 h = ssr->history[pl];
+						h = (float3){fminf(fmaxf(h.x, mn.x), mx.x), fminf(fmaxf(h.y, mn.y), mx.y),
+									 fminf(fmaxf(h.z, mn.z), mx.z), fminf(fmaxf(h.w, mn.w), mx.w)};
+						const float a = SSR_TEMPORAL_ALPHA;
+						out = (float3){h.x + (cur.x - h.x) * a, h.y + (cur.y - h.y) * a,
+									   h.z + (cur.z - h.z) * a, h.w + (cur.w - h.w) * a};
+						if (out.w < 1e-3f) out = (float3){0.0f, 0.0f, 0.0f, 0.0f}; // no denormal tails
+					}
+				}
+			}
+			ssr->historyTemp[lidx] = out;
+			if (task->reproject) {
+				float inv = out.w > 1e-4f ? 1.0f / out.w : 0.0f;
+				camera->ssrReflection[lidx] = (float3){out.x * inv, out.y * inv, out.z * inv, out.w};
+			}
+		}
 	}
 }
 
-void SSRPostProcessSingleThreaded(Camera *camera) {
-	if (!camera) return;
-	int size = camera->screenWidth * camera->screenHeight;
-	memcpy(camera->tempFramebuffer, camera->framebuffer, size * sizeof(Color));
-	for (int row = 0; row < camera->screenHeight; row++)
-		SSRProcessRow(camera, row);
+// Depth-aware bilinear upsample of the resolved hits, blended over the snapshot in tempFramebuffer.
+static void CompositeRowTask(void *arg) {
+	SSRTask *task = arg;
+	SSRContext *ssr = task->ssr;
+	Camera *camera = task->camera;
+	int W = camera->screenWidth, H = camera->screenHeight;
+	int LW = ssr->lowWidth, LH = ssr->lowHeight;
+	const float invR = 1.0f / SECONDARY_RESOLUTION;
+	float3 camPos = camera->position;
+	PixelRays rays = Camera_PixelRays(camera);
+
+	for (int row = task->row; row < task->row + task->rowCount && row < H; row++) {
+		float fy = (row + 0.5f) * invR - 0.5f;
+		int ly0 = (int)floorf(fy);
+		float ty = fy - ly0;
+		for (int x = 0; x < W; x++) {
+			int idx = row * W + x;
+			float z = camera->depthBuffer[idx];
+			if (z >= DEPTH_FAR) continue;
+			float reflectivity = UnpackHalf4(camera->reflectBuffer[idx]).w;
+			if (reflectivity < 0.05f) continue;
+
+			float fx = (x + 0.5f) * invR - 0.5f;
+			int lx0 = (int)floorf(fx);
+			float tx = fx - lx0;
+			float3 sum = {0.0f, 0.0f, 0.0f, 0.0f};
+			float sumW = 0.0f;
+			for (int k = 0; k < 4; k++) {
+				int lx = lx0 + (k & 1), ly = ly0 + (k >> 1);
+				if (lx < 0 || ly < 0 || lx >= LW || ly >= LH) continue;
+				int l = ly * LW + lx;
+				float lz = ssr->lowDepth[l];
+				if (lz < 0.0f) continue;
+				float w = ((k & 1) ? tx : 1.0f - tx) * ((k >> 1) ? ty : 1.0f - ty);
+				w *= expf(-fabsf(lz - z) / (0.02f * z + 1e-4f)) + 1e-4f;
+				float3 h = ssr->historyTemp[l];
+				sum = (float3){sum.x + h.x * w, sum.y + h.y * w, sum.z + h.z * w, sum.w + h.w * w};
+				sumW += w;
+			}
+			if (sumW <= 1e-6f || sum.w <= 1e-4f) continue;
+			float conf = sum.w / sumW;
+			float invC = 1.0f / sum.w;
+
+			// Fresnel scaled by surface reflectivity
+			float3 n = UnpackNormal(camera->normalBuffer[idx]);
+			float3 toEye = Float3_Normalize(Float3_Sub(camPos, PixelRays_Position(&rays, x, row, z)));
+			float NdotV = fmaxf(0.0f, n.x * toEye.x + n.y * toEye.y + n.z * toEye.z);
+			float inv = 1.0f - NdotV;
+			float inv2 = inv * inv;
+			float reflectStrength = reflectivity * (0.04f + 0.96f * (inv2 * inv2 * inv) + 0.5f * reflectivity);
+			if (reflectStrength > 1.0f) reflectStrength = 1.0f;
+
+			uint32 st = (uint32)(reflectStrength * conf * 255.0f);
+			if (st > 255u) st = 255u;
+			uint32 sit = 255u - st;
+			uint32 sr = (uint32)fminf(sum.x * invC * 255.0f, 255.0f);
+			uint32 sg = (uint32)fminf(sum.y * invC * 255.0f, 255.0f);
+			uint32 sb = (uint32)fminf(sum.z * invC * 255.0f, 255.0f);
+
+			Color base = camera->tempFramebuffer[idx];
+			uint32 nr = (((base >> 16) & 0xFF) * sit + sr * st) >> 8;
+			uint32 ng = (((base >> 8) & 0xFF) * sit + sg * st) >> 8;
+			uint32 nb = ((base & 0xFF) * sit + sb * st) >> 8;
+			camera->framebuffer[idx] = 0xFF000000u | (nr << 16) | (ng << 8) | nb;
+		}
+	}
 }
 
-void SSRPostProcess(Camera *camera, ThreadPool *threadPool, SSRTask *tasks, int rowsPerTask) {
-	if (!camera || !threadPool || !tasks) return;
-	int size = camera->screenWidth * camera->screenHeight;
-	int taskCount = (camera->screenHeight + rowsPerTask - 1) / rowsPerTask;
-	// Snapshot must happen before any task reads tempFramebuffer
-	memcpy(camera->tempFramebuffer, camera->framebuffer, size * sizeof(Color));
+// threadPool NULL runs the rows inline.
+static void RunRows(SSRContext *ssr, Camera *camera, ThreadPool *threadPool, task_fn fn, int rows, int level,
+					int samplePhase, const Color *source, int reproject) {
+	int taskCount = (rows + SSR_ROWS_PER_TASK - 1) / SSR_ROWS_PER_TASK;
 	for (int t = 0; t < taskCount; t++) {
-		tasks[t].row = t * rowsPerTask;
-		tasks[t].rowCount = rowsPerTask;
-		tasks[t].camera = camera;
-		poolAdd(threadPool, SSRRowTask, &tasks[t]);
+		ssr->tasks[t] = (SSRTask){t * SSR_ROWS_PER_TASK, SSR_ROWS_PER_TASK, level, samplePhase, source, reproject, ssr, camera};
+		if (threadPool)
+			poolAdd(threadPool, fn, &ssr->tasks[t]);
+		else
+			fn(&ssr->tasks[t]);
+	}
+	if (threadPool) poolWait(threadPool);
+}
+
+static void BuildHiZ(SSRContext *ssr, Camera *camera, ThreadPool *threadPool) {
+	ssr->hiZ[0] = camera->depthBuffer;
+	for (int l = 1; l < SSR_HIZ_LEVELS; l++)
+		RunRows(ssr, camera, threadPool, HiZRowTask, ssr->levelHeight[l], l, 0, NULL, 0);
+}
+
+static void EndFrame(SSRContext *ssr) {
+	float3 *swap = ssr->history;
+	ssr->history = ssr->historyTemp;
+	ssr->historyTemp = swap;
+	float *swapDepth = ssr->prevLowDepth;
+	ssr->prevLowDepth = ssr->lowDepth;
+	ssr->lowDepth = swapDepth;
+	ssr->hasHistory = 1;
+}
+
+// Also allocates the camera buffers the pass touches.
+static int SSRReady(const SSRContext *ssr, Camera *camera, uint32 buffers) {
+	return ssr && ssr->tasks && camera && camera->screenWidth == ssr->width && camera->screenHeight == ssr->height &&
+		   Camera_Require(camera, buffers);
+}
+
+static void PostProcess(SSRContext *ssr, Camera *camera, ThreadPool *threadPool, int samplePhase) {
+	// Snapshot must happen before any task reads tempFramebuffer
+	memcpy(camera->tempFramebuffer, camera->framebuffer, (size_t)ssr->width * ssr->height * sizeof(Color));
+	BuildHiZ(ssr, camera, threadPool);
+	RunRows(ssr, camera, threadPool, TraceRowTask, ssr->lowHeight, 0, samplePhase, camera->tempFramebuffer, 0);
+	RunRows(ssr, camera, threadPool, ResolveRowTask, ssr->lowHeight, 0, samplePhase, NULL, 0);
+	RunRows(ssr, camera, threadPool, CompositeRowTask, ssr->height, 0, samplePhase, NULL, 0);
+	EndFrame(ssr);
+}
+
+void SSRPostProcessSingleThreaded(SSRContext *ssr, Camera *camera, int samplePhase) {
+	if (!SSRReady(ssr, camera, POST_PROCESS_BUFFERS)) return;
+	PostProcess(ssr, camera, NULL, samplePhase);
+}
+
+void SSRPostProcess(SSRContext *ssr, Camera *camera, ThreadPool *threadPool, int samplePhase) {
+	if (!SSRReady(ssr, camera, POST_PROCESS_BUFFERS) || !threadPool) return;
+	PostProcess(ssr, camera, threadPool, samplePhase);
+}
+
+void SSRTraceReflections(SSRContext *ssr, Camera *camera, ThreadPool *threadPool, int samplePhase) {
+	if (!SSRReady(ssr, camera, TRACE_BUFFERS) || !threadPool) return;
+	if (!ssr->hasPrevFrame) {
+		memset(camera->ssrReflection, 0, (size_t)ssr->lowWidth * ssr->lowHeight * sizeof(float3));
+		return;
 	}
-	poolWait(threadPool);
+	BuildHiZ(ssr, camera, threadPool);
+	RunRows(ssr, camera, threadPool, TraceRowTask, ssr->lowHeight, 0, samplePhase, ssr->prevFrame, 1);
+	RunRows(ssr, camera, threadPool, ResolveRowTask, ssr->lowHeight, 0, samplePhase, NULL, 1);
+	EndFrame(ssr);
 }
@@ -4,22 +4,69 @@
 #include "../../object/format.h"
 #include "../../util/threadPool.h"
 
+// Screen-space reflections traced through a min-depth Hi-Z pyramid of depthBuffer.
+// One ray per SECONDARY_RESOLUTION block (half resolution by default), the traced
+// pixel rotating with samplePhase, then a clamped temporal resolve at low resolution.
+
 // Tune these for quality vs performance
-#define SSR_MAX_STEPS 96
-#define SSR_STEP_SIZE 0.22f
+#define SSR_HIZ_LEVELS 7		  // level 0 is depthBuffer itself, each level halves the previous
+#define SSR_MAX_ITERATIONS 64	  // Hi-Z cell visits per ray
 #define SSR_MAX_DIST 22.0f
 #define SSR_DEPTH_BIAS 0.02f
+#define SSR_THICKNESS 0.35f		  // surfaces are assumed this thick (plus 0.2% of view depth)
+#define SSR_EDGE_FADE 0.08f		  // fraction of the screen over which hits fade out at the border
+#define SSR_TEMPORAL_ALPHA 0.25f  // weight of the new sample in the temporal resolve
+#define SSR_REPROJECT_DEPTH 0.05f // max relative depth change for a valid history tap
+#define SSR_ROWS_PER_TASK 4
+
+typedef struct SSRContext SSRContext;
 
 typedef struct {
 	int row;
 	int rowCount;
+	int level; // Hi-Z level being built
+	int samplePhase;
+	const Color *source; // color the hits are fetched from
+	int reproject;		 // source is last frame: follow motion vectors at the hit
+	SSRContext *ssr;
 	Camera *camera;
 } SSRTask;
 
-// Post-process pass: reads framebuffer+depthBuffer+normalBuffer+positionBuffer+reflectBuffer,
+struct SSRContext {
+	int width, height;
+	int lowWidth, lowHeight;
+	int hasHistory;
+	int hasPrevFrame;
+	int levelWidth[SSR_HIZ_LEVELS];
+	int levelHeight[SSR_HIZ_LEVELS];
+	float *hiZ[SSR_HIZ_LEVELS]; // [0] aliases camera->depthBuffer while tracing
+	// low-res grid
+	float3 *hits;		  // this frame's hits: color * confidence (xyz), confidence (w)
+	float3 *history;	  // resolved hits, ping-ponged with historyTemp
+	float3 *historyTemp;
+	int *lowPixel;		  // full-res pixel traced for each block, -1 = all sky
+	float *lowDepth;	  // view depth of the traced pixel
+	float *prevLowDepth;
+	Color *prevFrame; // last composited frame for SSRTraceReflections
+	SSRTask *tasks;
+};
+
+// On allocation failure every buffer is left NULL and the passes are no-ops.
+void SSR_Init(SSRContext *ssr, int width, int height);
+void SSR_Destroy(SSRContext *ssr);
+// Drops the history, e.g. after a camera cut.
+void SSR_Reset(SSRContext *ssr);
+
+// Post-process pass: reads framebuffer+depthBuffer+normalBuffer+reflectBuffer,
 // blends SSR hits into framebuffer. Must run after the ray trace pass is fully complete.
-// tasks must point to an array of at least ceil(height/rowsPerTask) SSRTask elements.
-void SSRPostProcess(Camera *camera, ThreadPool *threadPool, SSRTask *tasks, int rowsPerTask);
-void SSRPostProcessSingleThreaded(Camera *camera);
+void SSRPostProcess(SSRContext *ssr, Camera *camera, ThreadPool *threadPool, int samplePhase);
+void SSRPostProcessSingleThreaded(SSRContext *ssr, Camera *camera, int samplePhase);
+
+// Deferred path: run after RayTraceVisibility. Traces against last frame's color (see
+// SSR_StoreFrame) and fills camera->ssrReflection so the secondary pass can skip
+// reflection rays that land on screen.
+void SSRTraceReflections(SSRContext *ssr, Camera *camera, ThreadPool *threadPool, int samplePhase);
+// Keeps the composited frame (hdrBuffer, clamped to 8 bits) for the next SSRTraceReflections.
+void SSR_StoreFrame(SSRContext *ssr, const Camera *camera);
 
 #endif // SSR_H
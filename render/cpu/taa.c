@@ -0,0 +1,162 @@
+#include "taa.h"
+#include <immintrin.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGN64(n) (((n) + 63) & ~(size_t)63)
+
+void Taa_Init(TemporalAA *taa, int width, int height) {
+	if (!taa) return;
+	memset(taa, 0, sizeof(TemporalAA));
+	taa->width = width;
+	taa->height = height;
+	size_t size = (size_t)width * height;
+	taa->history = (float3 *)aligned_alloc(64, ALIGN64(size * sizeof(float3)));
+	taa->historyTemp = (float3 *)aligned_alloc(64, ALIGN64(size * sizeof(float3)));
+	taa->tasks = (TaaTask *)malloc(sizeof(TaaTask) * ((height + TAA_ROWS_PER_TASK - 1) / TAA_ROWS_PER_TASK));
+	if (!taa->history || !taa->historyTemp || !taa->tasks) {
+		Taa_Destroy(taa);
+		return;
+	}
+	Taa_Reset(taa);
+}
+
+void Taa_Destroy(TemporalAA *taa) {
+	if (!taa) return;
+	free(taa->history);
+	free(taa->historyTemp);
+	free(taa->tasks);
+	memset(taa, 0, sizeof(TemporalAA));
+}
+
+void Taa_Reset(TemporalAA *taa) {
+	if (!taa) return;
+	taa->hasHistory = 0;
+}
+
+static float Halton(int index, int base) {
+	float f = 1.0f, r = 0.0f;
+	while (index > 0) {
+		f /= (float)base;
+		r += f * (float)(index % base);
+		index /= base;
+	}
+	return r;
+}
+
+float2 Taa_Jitter(int frame) {
+	// index from 1: Halton(0) is 0 in both axes and would repeat the centre
+	int i = (frame & 0x7FFFFFFF) % TAA_JITTER_TAPS + 1;
+	return (float2){Halton(i, 2) - 0.5f, Halton(i, 3) - 0.5f};
+}
+
+// Linear half-float colour to (Y, Co, Cg, 0), one pixel per SSE register.
+static inline __m128 ToYCoCg(const half4 *p) {
+	__m128 rgb = _mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)p));
+	__m128 r = _mm_shuffle_ps(rgb, rgb, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 g = _mm_shuffle_ps(rgb, rgb, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 b = _mm_shuffle_ps(rgb, rgb, _MM_SHUFFLE(2, 2, 2, 2));
+	__m128 out = _mm_mul_ps(r, _mm_setr_ps(0.25f, 0.5f, -0.25f, 0.0f));
+	out = _mm_fmadd_ps(g, _mm_setr_ps(0.5f, 0.0f, 0.5f, 0.0f), out);
+	return _mm_fmadd_ps(b, _mm_setr_ps(0.25f, -0.5f, -0.25f, 0.0f), out);
+}
+
+static inline void FromYCoCg(__m128 c, half4 *p) {
+	__m128 y = _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 co = _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 cg = _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2));
+	__m128 rgb = _mm_fmadd_ps(co, _mm_setr_ps(1.0f, 0.0f, -1.0f, 0.0f), _mm_and_ps(y, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0))));
+	rgb = _mm_fmadd_ps(cg, _mm_setr_ps(-1.0f, 1.0f, -1.0f, 0.0f), rgb);
+	rgb = _mm_max_ps(rgb, _mm_setzero_ps());
+	_mm_storel_epi64((__m128i *)p, _mm_cvtps_ph(rgb, _MM_FROUND_TO_NEAREST_INT));
+}
+
+// px, py in pixels (texel centres at +0.5), clamped to the edge.
+static inline __m128 SampleHistory(const float3 *history, int W, int H, float px, float py) {
+	float fx = px - 0.5f, fy = py - 0.5f;
+	int x0 = (int)floorf(fx), y0 = (int)floorf(fy);
+	__m128 tx = _mm_set1_ps(fx - x0), ty = _mm_set1_ps(fy - y0);
+	int x1 = x0 + 1, y1 = y0 + 1;
+	x0 = x0 < 0 ? 0 : x0;
+	y0 = y0 < 0 ? 0 : y0;
+	x1 = x1 > W - 1 ? W - 1 : x1;
+	y1 = y1 > H - 1 ? H - 1 : y1;
+	const float *r0 = &history[y0 * W].x, *r1 = &history[y1 * W].x;
+	__m128 a = _mm_load_ps(r0 + 4 * x0), b = _mm_load_ps(r0 + 4 * x1);
+	__m128 c = _mm_load_ps(r1 + 4 * x0), d = _mm_load_ps(r1 + 4 * x1);
+	__m128 top = _mm_fmadd_ps(_mm_sub_ps(b, a), tx, a);
+	__m128 bottom = _mm_fmadd_ps(_mm_sub_ps(d, c), tx, c);
+	return _mm_fmadd_ps(_mm_sub_ps(bottom, top), ty, top);
+}
+
+static void ResolveRowTask(void *arg) {
+	TaaTask *task = arg;
+	TemporalAA *taa = task->taa;
+	Camera *camera = task->camera;
+	int W = taa->width, H = taa->height;
+	const float alpha = 1.0f - TAA_FEEDBACK;
+
+	// three converted rows in a ring, so each pixel is converted once per task; the 3x3 box
+	// then reduces to a per-column min / max and three lookups per pixel
+	__m128 ring[3][W], colMin[W], colMax[W];
+	for (int y = task->row; y < task->row + task->rowCount && y < H; y++) {
+		int first = y == task->row;
+		for (int dy = first ? -1 : 1; dy <= 1; dy++) {
+			int sy = y + dy < 0 ? 0 : (y + dy > H - 1 ? H - 1 : y + dy);
+			const half4 *src = &camera->hdrTemp[sy * W];
+			__m128 *dst = ring[(y + dy + 3) % 3];
+			for (int x = 0; x < W; x++)
+				dst[x] = ToYCoCg(&src[x]);
+		}
+		const __m128 *above = ring[(y + 2) % 3], *cur = ring[y % 3], *below = ring[(y + 1) % 3];
+		for (int x = 0; x < W; x++) {
+			colMin[x] = _mm_min_ps(_mm_min_ps(above[x], below[x]), cur[x]);
+			colMax[x] = _mm_max_ps(_mm_max_ps(above[x], below[x]), cur[x]);
+		}
+
+		float *out = &taa->historyTemp[y * W].x;
+		for (int x = 0; x < W; x++) {
+			int idx = y * W + x;
+			__m128 c = cur[x];
+			if (taa->hasHistory) {
+				float2 mv = camera->motionVectorBuffer[idx];
+				float prevX = (x + 0.5f) - mv.x * W;
+				float prevY = (y + 0.5f) - mv.y * H;
+				if (prevX >= 0.0f && prevY >= 0.0f && prevX <= (float)W && prevY <= (float)H) {
+					int l = x > 0 ? x - 1 : 0, r = x + 1 < W ? x + 1 : W - 1;
+					__m128 mn = _mm_min_ps(_mm_min_ps(colMin[l], colMin[x]), colMin[r]);
+					__m128 mx = _mm_max_ps(_mm_max_ps(colMax[l], colMax[x]), colMax[r]);
+					__m128 h = SampleHistory(taa->history, W, H, prevX, prevY);
+					h = _mm_min_ps(_mm_max_ps(h, mn), mx);
+					// weight by inverse luma so single bright samples do not flicker
+					// (both weights scaled by (1 + Yc)(1 + Yh) to share one division)
+					float wc = alpha * (1.0f + _mm_cvtss_f32(h)), wh = (1.0f - alpha) * (1.0f + _mm_cvtss_f32(c));
+					c = _mm_mul_ps(_mm_fmadd_ps(c, _mm_set1_ps(wc), _mm_mul_ps(h, _mm_set1_ps(wh))), _mm_set1_ps(1.0f / (wc + wh)));
+					FromYCoCg(c, &camera->hdrBuffer[idx]);
+				}
+			}
+			_mm_store_ps(out + 4 * x, c);
+		}
+	}
+}
+
+void TaaResolve(TemporalAA *taa, Camera *camera, ThreadPool *threadPool) {
+	if (!taa || !taa->tasks || !camera || !threadPool) return;
+	if (camera->screenWidth != taa->width || camera->screenHeight != taa->height) return;
+	if (!Camera_Require(camera, CAMERA_HDR | CAMERA_HDR_TEMP | CAMERA_MOTION)) return;
+	// neighbourhoods read the snapshot; hdrBuffer is only rewritten where history is used
+	memcpy(camera->hdrTemp, camera->hdrBuffer, (size_t)taa->width * taa->height * sizeof(half4));
+
+	int taskCount = (taa->height + TAA_ROWS_PER_TASK - 1) / TAA_ROWS_PER_TASK;
+	for (int t = 0; t < taskCount; t++) {
+		taa->tasks[t] = (TaaTask){t * TAA_ROWS_PER_TASK, TAA_ROWS_PER_TASK, taa, camera};
+		poolAdd(threadPool, ResolveRowTask, &taa->tasks[t]);
+	}
+	poolWait(threadPool);
+
+	float3 *swap = taa->history;
+	taa->history = taa->historyTemp;
+	taa->historyTemp = swap;
+	taa->hasHistory = 1;
+}
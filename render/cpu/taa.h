@@ -0,0 +1,42 @@
+#ifndef TAA_H
+#define TAA_H
+
+#include "../../object/format.h"
+#include "../../util/threadPool.h"
+
+// Temporal anti-aliasing over camera->hdrBuffer. Primary rays are offset by
+// camera->jitter each frame; the resolve reprojects the history through
+// motionVectorBuffer, clamps it to the current 3x3 neighbourhood in YCoCg and blends.
+
+#define TAA_FEEDBACK 0.9f // history weight once the reprojection is clamped
+#define TAA_JITTER_TAPS 8 // Halton(2, 3) sequence length
+#define TAA_ROWS_PER_TASK 8
+
+typedef struct TemporalAA TemporalAA;
+
+typedef struct {
+	int row;
+	int rowCount;
+	TemporalAA *taa;
+	Camera *camera;
+} TaaTask;
+
+struct TemporalAA {
+	int width, height;
+	int hasHistory;
+	float3 *history;	 // resolved YCoCg of the previous frame
+	float3 *historyTemp; // written this frame, swapped with history at the end
+	TaaTask *tasks;
+};
+
+// On allocation failure every buffer is left NULL and TaaResolve is a no-op.
+void Taa_Init(TemporalAA *taa, int width, int height);
+void Taa_Destroy(TemporalAA *taa);
+// Drops the history, e.g. after a camera cut.
+void Taa_Reset(TemporalAA *taa);
+// Sub-pixel offset for frame, in pixels within (-0.5, 0.5); assign to camera->jitter before tracing.
+float2 Taa_Jitter(int frame);
+// Run after the composite; resolves hdrBuffer in place and keeps the result as history.
+void TaaResolve(TemporalAA *taa, Camera *camera, ThreadPool *threadPool);
+
+#endif // TAA_H
@@ -1,4 +1,6 @@
 #include "format.h"
+#include <sys/stat.h>
+#include <unistd.h>
 
 CL_Context CL_Context_Create() {
 	CL_Context ctx = {0};
@@ -26,12 +28,117 @@ void CL_Context_Destroy(CL_Context *ctx) {
 	clReleaseContext(ctx->context);
 }
 
+// FNV-1a over the bytes, chained through h.
+static uint64_t HashBytes(uint64_t h, const void *data, size_t size) {
+	const uint8 *p = data;
+	for (size_t i = 0; i < size; i++)
+		h = (h ^ p[i]) * 0x100000001b3ull;
+	return h;
+}
+
+// A binary is only valid for the exact source, options, device and driver it was built with.
+static uint64_t ProgramKey(CL_Context *ctx, const char *src, const char *options) {
+	uint64_t h = 0xcbf29ce484222325ull;
+	h = HashBytes(h, src, strlen(src) + 1);
+	h = HashBytes(h, options ? options : "", options ? strlen(options) + 1 : 1);
+	const cl_device_info info[] = {CL_DEVICE_NAME, CL_DRIVER_VERSION, CL_DEVICE_VERSION};
+	for (int i = 0; i < 3; i++) {
+		char value[256] = {0};
+		clGetDeviceInfo(ctx->device, info[i], sizeof(value) - 1, value, NULL);
+		h = HashBytes(h, value, strlen(value) + 1);
+	}
+	return h;
+}
+
+typedef struct {
+	char magic[8];
+	uint64_t key;
+	uint64_t size; // binary bytes following the header
+} CL_CacheHeader;
+
+static const char CL_CACHE_MAGIC[8] = "CLBIN1";
+
+static void CachePath(char *path, size_t size, uint64_t key) {
+	snprintf(path, size, "%s/%016llx.bin", CL_CACHE_DIR, (unsigned long long)key);
+}
+
+// Returns a built program, or NULL when there is no usable entry; a stale or corrupt
+// entry is removed so the source build that follows replaces it.
+static cl_program LoadCachedProgram(CL_Context *ctx, uint64_t key, const char *options) {
+	char path[256];
+	CachePath(path, sizeof(path), key);
+	FILE *f = fopen(path, "rb");
+	if (!f) return NULL;
+
+	CL_CacheHeader header;
+	unsigned char *binary = NULL;
+	cl_program program = NULL;
+	if (fread(&header, sizeof(header), 1, f) == 1 && memcmp(header.magic, CL_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+		header.key == key && header.size > 0 && (binary = malloc(header.size)) && fread(binary, 1, header.size, f) == header.size) {
+		size_t size = (size_t)header.size;
+		const unsigned char *bin = binary;
+		cl_int status, err;
+		program = clCreateProgramWithBinary(ctx->context, 1, &ctx->device, &size, &bin, &status, &err);
+		if (program && (err != CL_SUCCESS || status != CL_SUCCESS ||
+						clBuildProgram(program, 1, &ctx->device, options, NULL, NULL) != CL_SUCCESS)) {
+			clReleaseProgram(program);
+			program = NULL;
+		}
+	}
+	free(binary);
+	fclose(f);
+	if (!program) {
+		printf("[CL] discarding stale cache entry %s\n", path);
+		remove(path);
+	}
+	return program;
+}
+
+// Written to a temporary name and renamed, so a crash never leaves a truncated entry.
+static void SaveProgramBinary(cl_program program, uint64_t key) {
+	size_t size = 0;
+	if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size), &size, NULL) != CL_SUCCESS || size == 0) return;
+	unsigned char *binary = malloc(size);
+	if (!binary) return;
+	if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binary), &binary, NULL) != CL_SUCCESS) {
+		free(binary);
+		return;
+	}
+
+	mkdir(CL_CACHE_DIR, 0755);
+	char path[256], temp[272];
+	CachePath(path, sizeof(path), key);
+	snprintf(temp, sizeof(temp), "%s.%d.tmp", path, (int)getpid());
+	FILE *f = fopen(temp, "wb");
+	if (f) {
+		CL_CacheHeader header = {.key = key, .size = size};
+		memcpy(header.magic, CL_CACHE_MAGIC, sizeof(header.magic));
+		int ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(binary, 1, size, f) == size;
+		ok = fclose(f) == 0 && ok;
+		if (!ok || rename(temp, path) != 0) remove(temp);
+	}
+	free(binary);
+}
+
 CL_Pipeline CL_Pipeline_FromSource(CL_Context *ctx, const char *src, const char *kernel_name, const char *options) {
 	CL_Pipeline pip = {0};
 	cl_int err;
 
 	strncpy(pip.name, kernel_name, sizeof(pip.name) - 1);
 
+	uint64_t key = ProgramKey(ctx, src, options);
+	pip.program = LoadCachedProgram(ctx, key, options);
+	if (pip.program) {
+		pip.kernel = clCreateKernel(pip.program, kernel_name, &err);
+		if (err == CL_SUCCESS) {
+			printf("[CL] kernel '%s' loaded from cache\n", kernel_name);
+			return pip;
+		}
+		// the binary built but lacks the kernel: fall back to source
+		clReleaseProgram(pip.program);
+		pip.program = NULL;
+	}
+
 	pip.program = clCreateProgramWithSource(ctx->context, 1, &src, NULL, &err);
 	CL_CheckError(err, "clCreateProgramWithSource");
 
@@ -45,6 +152,7 @@ CL_Pipeline CL_Pipeline_FromSource(CL_Context *ctx, const char *src, const char
 		free(log);
 		return pip;
 	}
+	SaveProgramBinary(pip.program, key);
 
 	pip.kernel = clCreateKernel(pip.program, kernel_name, &err);
 	CL_CheckError(err, "clCreateKernel");
@@ -53,8 +161,47 @@ CL_Pipeline CL_Pipeline_FromSource(CL_Context *ctx, const char *src, const char
 	return pip;
 }
 
+// Pastes each `#include "name"` line's file, looked up next to path, into the source, so
+// shared headers need no -I option and are part of the program cache key. One level deep.
+static char *ExpandIncludes(const char *path, char *src) {
+	const char *slash = strrchr(path, '/');
+	int dirLen = slash ? (int)(slash - path + 1) : 0;
+	char *out = NULL;
+	size_t used = 0;
+	for (const char *line = src; *line;) {
+		const char *end = strchr(line, '\n');
+		size_t len = end ? (size_t)(end - line + 1) : strlen(line);
+		char name[256], file[512];
+		char *text = NULL;
+		if (sscanf(line, " #include \"%255[^\"]\"", name) == 1) {
+			snprintf(file, sizeof(file), "%.*s%s", dirLen, path, name);
+			text = CL_LoadFile(file);
+			if (!text) printf("[CL] failed to load include: %s\n", file);
+		}
+		const char *piece = text ? text : line;
+		size_t pieceLen = text ? strlen(text) : len;
+		char *grown = realloc(out, used + pieceLen + 2);
+		if (!grown) {
+			free(text);
+			free(out);
+			return src;
+		}
+		out = grown;
+		memcpy(out + used, piece, pieceLen);
+		used += pieceLen;
+		if (text) out[used++] = '\n';
+		free(text);
+		line += len;
+	}
+	if (!out) return src;
+	out[used] = '\0';
+	free(src);
+	return out;
+}
+
 CL_Pipeline CL_Pipeline_FromFile(CL_Context *ctx, const char *path, const char *kernel_name, const char *options) {
 	char *src = CL_LoadFile(path);
+	if (src) src = ExpandIncludes(path, src);
 	if (!src) {
 		printf("[CL] failed to load kernel file: %s\n", path);
 		return (CL_Pipeline){0};
@@ -7,6 +7,11 @@
 #include <string.h>
 #include "../../object/format.h"
 
+// Built programs are kept in this directory, one file per hash of source, build options,
+// device and driver, and loaded with clCreateProgramWithBinary instead of recompiling.
+// Entries that fail to load or build are deleted and rebuilt from source.
+#define CL_CACHE_DIR ".clcache"
+
 // TYPES
 typedef struct {
 	cl_platform_id platform;
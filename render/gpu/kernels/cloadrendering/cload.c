@@ -27,17 +27,51 @@ void CloudRenderer_Init(CloudRenderer *cr, int width, int height, const char *ke
 	cr->godRayPipeline = CL_Pipeline_FromFile(&cr->ctx, kernelPath, "godRays", NULL);
 	cr->compositePipeline = CL_Pipeline_FromFile(&cr->ctx, kernelPath, "compositeFrame", NULL);
 	cr->blurPipeline = CL_Pipeline_FromFile(&cr->ctx, kernelPath, "blur", NULL);
+	cr->sunBakePipeline = CL_Pipeline_FromFile(&cr->ctx, kernelPath, "bakeSunDepth", NULL);
 
 	// Pinned (page-locked) buffers — DMA-direct transfers, no driver staging copy
 	cr->outputBuf = CL_Buffer_CreatePinned(&cr->ctx, (size_t)width * height * sizeof(float4), CL_MEM_READ_WRITE);
 	cr->depthBuf = CL_Buffer_CreatePinned(&cr->ctx, (size_t)width * height * sizeof(float), CL_MEM_READ_ONLY);
 	cr->godRayBuf = CL_Buffer_CreatePinned(&cr->ctx, (size_t)width * height * sizeof(float4), CL_MEM_READ_WRITE);
-	cr->framebufferBuf = CL_Buffer_CreatePinned(&cr->ctx, (size_t)width * height * sizeof(uint32), CL_MEM_READ_WRITE);
+	cr->framebufferBuf = CL_Buffer_CreatePinned(&cr->ctx, (size_t)width * height * sizeof(half4), CL_MEM_READ_WRITE);
 	cr->outputBlurBuf = CL_Buffer_CreatePinned(&cr->ctx, (size_t)width * height * sizeof(float4), CL_MEM_READ_WRITE);
+	cr->sunDepthBuf = CL_Buffer_Create(&cr->ctx, (size_t)CLOUD_SUN_RES * CLOUD_SUN_RES * CLOUD_SUN_RES * sizeof(uint16), CL_MEM_READ_WRITE);
+	cr->sunBaked = 0;
+}
+
+// Rebakes the sun-depth grid if the light has moved in volume space (light or volume rotated),
+// the shadow distance changed or a different volume is drawn.
+static void updateSunDepth(CloudRenderer *cr, const Volume *vol, float3 lightDir, float shadowDist) {
+	float ll = sqrtf(lightDir.x * lightDir.x + lightDir.y * lightDir.y + lightDir.z * lightDir.z);
+	float3 l = {lightDir.x / ll, lightDir.y / ll, lightDir.z / ll, 0.0f};
+	float3 local = {vol->_invScale.x * l.x + vol->_invScale.y * l.y + vol->_invScale.z * l.z,
+					vol->_invRotSin.x * l.x + vol->_invRotSin.y * l.y + vol->_invRotSin.z * l.z,
+					vol->_invRotCos.x * l.x + vol->_invRotCos.y * l.y + vol->_invRotCos.z * l.z, 0.0f};
+	float len = sqrtf(local.x * local.x + local.y * local.y + local.z * local.z);
+	local = (float3){local.x / len, local.y / len, local.z / len, 0.0f};
+
+	float3 b = cr->sunBakedLight;
+	if (cr->sunBaked && cr->sunBakedVolume == vol->gpuDensity.buf && cr->sunBakedDist == shadowDist &&
+		local.x * b.x + local.y * b.y + local.z * b.z >= CLOUD_SUN_REBAKE_COS)
+		return;
+
+	cl_kernel k = cr->sunBakePipeline.kernel;
+	int sunRes = CLOUD_SUN_RES;
+	clSetKernelArg(k, 0, sizeof(cl_mem), &vol->gpuDensity.buf);
+	clSetKernelArg(k, 1, sizeof(float3), &local);
+	clSetKernelArg(k, 2, sizeof(float), &shadowDist);
+	clSetKernelArg(k, 3, sizeof(int), &sunRes);
+	clSetKernelArg(k, 4, sizeof(cl_mem), &cr->sunDepthBuf.buf);
+	CL_Dispatch3D(&cr->ctx, &cr->sunBakePipeline, CLOUD_SUN_RES, CLOUD_SUN_RES, CLOUD_SUN_RES, 4, 4, 4);
+	cr->sunBakedLight = local;
+	cr->sunBakedDist = shadowDist;
+	cr->sunBakedVolume = vol->gpuDensity.buf;
+	cr->sunBaked = 1;
 }
 
 void CloudRenderer_Render(CloudRenderer *cr, Volume *vol, const Camera *cam, CloudParams params) {
 	updateVolumeCache(vol);
+	updateSunDepth(cr, vol, cam->lightDir, params.shadowDist);
 
 	// Upload scene depth via pinned map — avoids a pageable memcpy inside the driver
 	void *depthPtr = CL_Buffer_Map(&cr->ctx, &cr->depthBuf, CL_MAP_WRITE_INVALIDATE_REGION);
@@ -56,6 +90,9 @@ void CloudRenderer_Render(CloudRenderer *cr, Volume *vol, const Camera *cam, Clo
 	clSetKernelArg(k, a++, sizeof(float3), &vol->_fwdRot1);
 	clSetKernelArg(k, a++, sizeof(float3), &vol->_fwdRot2);
 	clSetKernelArg(k, a++, sizeof(cl_mem), &vol->gpuDensity.buf);
+	int sunRes = CLOUD_SUN_RES;
+	clSetKernelArg(k, a++, sizeof(cl_mem), &cr->sunDepthBuf.buf);
+	clSetKernelArg(k, a++, sizeof(int), &sunRes);
 	clSetKernelArg(k, a++, sizeof(float3), &cam->position);
 	clSetKernelArg(k, a++, sizeof(float3), &cam->forward);
 	clSetKernelArg(k, a++, sizeof(float3), &cam->up);
@@ -68,7 +105,6 @@ void CloudRenderer_Render(CloudRenderer *cr, Volume *vol, const Camera *cam, Clo
 	clSetKernelArg(k, a++, sizeof(float3), &params.extinctionScale);
 	clSetKernelArg(k, a++, sizeof(float3), &params.shadowExtinction);
 	clSetKernelArg(k, a++, sizeof(float), &params.scatterG);
-	clSetKernelArg(k, a++, sizeof(float), &params.shadowDist);
 	clSetKernelArg(k, a++, sizeof(float3), &params.ambientLight);
 	int samplesPerPixel = 1;
 	clSetKernelArg(k, a++, sizeof(cl_mem), &cr->outputBlurBuf.buf);
@@ -121,11 +157,12 @@ void CloudRenderer_Render(CloudRenderer *cr, Volume *vol, const Camera *cam, Clo
 }
 
 void CloudRenderer_Composite(CloudRenderer *cr, Camera *cam) {
-	size_t fbBytes = (size_t)cr->width * cr->height * sizeof(uint32);
+	if (!Camera_Require(cam, CAMERA_HDR)) return;
+	size_t fbBytes = (size_t)cr->width * cr->height * sizeof(half4);
 
-	// Upload CPU framebuffer (written by ray tracer) to pinned GPU buffer
+	// Upload the linear working buffer (written by ray tracer) to pinned GPU buffer
 	void *fbPtr = CL_Buffer_Map(&cr->ctx, &cr->framebufferBuf, CL_MAP_WRITE_INVALIDATE_REGION);
-	memcpy(fbPtr, cam->framebuffer, fbBytes);
+	memcpy(fbPtr, cam->hdrBuffer, fbBytes);
 	CL_Buffer_Unmap(&cr->ctx, &cr->framebufferBuf, fbPtr);
 
 	// Dispatch GPU composite: blends cloud + god ray onto the framebuffer in parallel
@@ -138,7 +175,7 @@ void CloudRenderer_Composite(CloudRenderer *cr, Camera *cam) {
 
 	// Read blended framebuffer back via pinned map — DMA direct, no staging copy
 	fbPtr = CL_Buffer_Map(&cr->ctx, &cr->framebufferBuf, CL_MAP_READ);
-	memcpy(cam->framebuffer, fbPtr, fbBytes);
+	memcpy(cam->hdrBuffer, fbPtr, fbBytes);
 	CL_Buffer_Unmap(&cr->ctx, &cr->framebufferBuf, fbPtr);
 }
 
@@ -147,8 +184,10 @@ void CloudRenderer_Destroy(CloudRenderer *cr) {
 	CL_Buffer_Destroy(&cr->depthBuf);
 	CL_Buffer_Destroy(&cr->godRayBuf);
 	CL_Buffer_Destroy(&cr->framebufferBuf);
+	CL_Buffer_Destroy(&cr->sunDepthBuf);
 	CL_Pipeline_Destroy(&cr->pipeline);
 	CL_Pipeline_Destroy(&cr->godRayPipeline);
 	CL_Pipeline_Destroy(&cr->compositePipeline);
+	CL_Pipeline_Destroy(&cr->sunBakePipeline);
 	CL_Context_Destroy(&cr->ctx);
 }
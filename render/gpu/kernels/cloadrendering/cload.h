@@ -5,6 +5,8 @@
 #include "../../../../object/object.h"
 #include "../../../../object/format.h"
 
+#define CLOUD_SUN_REBAKE_COS 0.99985f // rebake once the light turns ~1 degree in volume space
+
 typedef struct {
 	CL_Context ctx;
 	CL_Pipeline pipeline;
@@ -13,9 +15,16 @@ typedef struct {
 	CL_Pipeline godRayPipeline;
 	CL_Buffer godRayBuf;
 	CL_Pipeline compositePipeline;
-	CL_Buffer framebufferBuf; // pinned uint32 buffer — upload framebuffer, composite on GPU, read back
+	CL_Buffer framebufferBuf; // pinned half4 buffer — upload hdrBuffer, composite on GPU, read back
 	CL_Pipeline blurPipeline;
 	CL_Buffer outputBlurBuf;
+	// optical depth toward the sun per grid node, rebaked only when the light moves
+	CL_Pipeline sunBakePipeline;
+	CL_Buffer sunDepthBuf; // CLOUD_SUN_RES^3 halfs
+	float3 sunBakedLight;  // volume-space light direction of the current bake
+	float sunBakedDist;
+	cl_mem sunBakedVolume;
+	int sunBaked;
 	int width;
 	int height;
 } CloudRenderer;
@@ -28,7 +37,7 @@ typedef struct {
 	float3 extinctionScale;	// optical density per channel (try 10-30)
 	float3 shadowExtinction; // per-channel extinction in shadow march — keep low (0.5-3)
 	float scatterG;			// Henyey-Greenstein asymmetry (-1..1, 0=isotropic)
-	float shadowDist;		// shadow march distance in local space
+	float shadowDist;		// shadow march distance in local space (changing it rebakes)
 	float3 ambientLight;		// minimum light level on shadow side, can be colored
 	// god rays — set godRays=1 to enable, sunScreenPos computed automatically from cam->lightDir
 	int godRays;
@@ -41,7 +50,7 @@ typedef struct {
 // Render clouds for one frame. vol->gpuDensity must already be uploaded via UploadVolumeToGpu.
 void CloudRenderer_Render(CloudRenderer *cr, Volume *vol, const Camera *cam, CloudParams params);
 
-// Blend cloud luminance into cam->framebuffer via GPU composite kernel (call after CloudRenderer_Render).
+// Blend cloud luminance into cam->hdrBuffer via GPU composite kernel (call after CloudRenderer_Render).
 void CloudRenderer_Composite(CloudRenderer *cr, Camera *cam);
 
 void CloudRenderer_Destroy(CloudRenderer *cr);
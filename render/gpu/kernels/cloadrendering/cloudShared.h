@@ -0,0 +1,24 @@
+#ifndef CLOUD_SHARED_H
+#define CLOUD_SHARED_H
+
+// Constants shared by render.cl and the host code (object.h, tests). #defines only:
+// CL_Pipeline_FromFile pastes this file into the kernel source in place of its #include.
+
+// Sparse cloud volumes: the grid's cells are grouped into VOLUME_BRICK^3 bricks, only bricks
+// with any density are stored, as 8-bit texels. A brick stores one extra texel per axis
+// (shared with the next brick) so trilinear filtering never leaves it. Bricks are grouped
+// into VOLUME_SUPER^3 super-bricks for a second level of empty-space skipping.
+#define VOLUME_BRICK 8
+#define VOLUME_BRICK_STRIDE (VOLUME_BRICK + 1)
+#define VOLUME_BRICK_TEXELS (VOLUME_BRICK_STRIDE * VOLUME_BRICK_STRIDE * VOLUME_BRICK_STRIDE)
+#define VOLUME_SUPER 4
+
+#define CLOUD_STEPS 64			// steps across the box where the cloud is dense
+#define CLOUD_MAX_STRIDE 8.0f	// longest step through thin cloud, in CLOUD_STEPS steps
+#define CLOUD_STEP_DEPTH 0.25f	// optical depth one step may cover before it is shortened
+#define CLOUD_MAX_ITERATIONS 256 // density samples plus skipped regions per ray
+#define SUN_BAKE_STEPS 32		// shadow march steps per baked sun-depth node
+#define CLOUD_SUN_RES 64		// sun-depth grid nodes per axis
+#define GOD_RAY_STEPS 64
+
+#endif // CLOUD_SHARED_H
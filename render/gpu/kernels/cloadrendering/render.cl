@@ -1,55 +1,132 @@
-#define CLOUD_STEPS    64
-#define SHADOW_STEPS   8
-#define GOD_RAY_STEPS  64
+// CLOUD_* march constants and the VOLUME_* brick layout, shared with the host
+#include "cloudShared.h"
+
+// Views into the buffer written by UploadVolumeToGpu.
+typedef struct {
+    int3 res;
+    int3 bricks;
+    int3 supers;
+    float scale; // density of quantized value 1
+    __global const int   *slots;
+    __global const uchar *brickMax;
+    __global const uchar *superMax;
+    __global const uchar *data;
+} BrickVolume;
+
+static BrickVolume readVolume(__global const uint *buf) {
+    __global const uchar *bytes = (__global const uchar *)buf;
+    BrickVolume vol;
+    vol.res    = (int3)((int)buf[0], (int)buf[1], (int)buf[2]);
+    vol.bricks = (int3)((int)buf[3], (int)buf[4], (int)buf[5]);
+    vol.supers = (int3)((int)buf[6], (int)buf[7], (int)buf[8]);
+    vol.scale  = as_float(buf[9]) * (1.0f / 255.0f);
+    vol.slots    = (__global const int *)(bytes + buf[10]);
+    vol.brickMax = bytes + buf[11];
+    vol.superMax = bytes + buf[12];
+    vol.data     = bytes + buf[13];
+    return vol;
+}
+
+// Lower voxel of the trilinear cell holding uvw.
+static int3 volumeCell(const BrickVolume *vol, float3 uvw) {
+    float3 f = uvw * convert_float3(vol->res - 1);
+    return clamp(convert_int3(f), (int3)(0), vol->res - 2);
+}
 
 static float sampleDensity(
-    __global const float *buf,
+    const BrickVolume *vol,
     float3 uvw)
 {
-    int xRes = (int)buf[0];
-    int yRes = (int)buf[1];
-    int zRes = (int)buf[2];
-    __global const float *data = buf + 3;
-    float fx = uvw.x * (xRes - 1);
-    float fy = uvw.y * (yRes - 1);
-    float fz = uvw.z * (zRes - 1);
-
-    int ix = clamp((int)fx, 0, xRes - 2);
-    int iy = clamp((int)fy, 0, yRes - 2);
-    int iz = clamp((int)fz, 0, zRes - 2);
-
-    float u = fx - ix, v = fy - iy, w = fz - iz;
-
-    int xStride = yRes * zRes, yStride = zRes, zStride = 1;
-    int base = ix * xStride + iy * yStride + iz * zStride;
-
-    float d000 = data[base],                           d100 = data[base + xStride];
-    float d010 = data[base + yStride],                 d110 = data[base + xStride + yStride];
-    float d001 = data[base + zStride],                 d101 = data[base + xStride + zStride];
-    float d011 = data[base + yStride + zStride],       d111 = data[base + xStride + yStride + zStride];
-
-    return mix(
+    float3 f = uvw * convert_float3(vol->res - 1);
+    int3 cell = clamp(convert_int3(f), (int3)(0), vol->res - 2);
+    int3 b = cell / VOLUME_BRICK;
+    int slot = vol->slots[(b.x * vol->bricks.y + b.y) * vol->bricks.z + b.z];
+    if (slot < 0) return 0.0f;
+
+    float u = f.x - cell.x, v = f.y - cell.y, w = f.z - cell.z;
+    int3 l = cell - b * VOLUME_BRICK;
+    const int xStride = VOLUME_BRICK_STRIDE * VOLUME_BRICK_STRIDE, yStride = VOLUME_BRICK_STRIDE, zStride = 1;
+    __global const uchar *t = vol->data + slot * VOLUME_BRICK_TEXELS + l.x * xStride + l.y * yStride + l.z;
+
+    float d000 = t[0],                      d100 = t[xStride];
+    float d010 = t[yStride],                d110 = t[xStride + yStride];
+    float d001 = t[zStride],                d101 = t[xStride + zStride];
+    float d011 = t[yStride + zStride],      d111 = t[xStride + yStride + zStride];
+
+    return vol->scale * mix(
         mix(mix(d000, d100, u), mix(d010, d110, u), v),
         mix(mix(d001, d101, u), mix(d011, d111, u), v),
         w);
 }
 
-static float3 shadowMarch(
-    __global const float *buf,
+// Ray parameter where the ray leaves the box of voxels [lo, hi] (local space is uvw - 0.5).
+static float regionExit(const BrickVolume *vol, int3 lo, int3 hi, float3 origin, float3 invDir) {
+    float3 size = convert_float3(vol->res - 1);
+    float3 a = (convert_float3(lo) / size - 0.5f - origin) * invDir;
+    float3 b = (convert_float3(min(hi, vol->res - 1)) / size - 0.5f - origin) * invDir;
+    float3 far = fmax(a, b);
+    return fmin(fmin(far.x, far.y), far.z);
+}
+
+// Optical depth (density x distance) from pos toward the light, over shadowDist or to the box.
+static float shadowDepth(
+    const BrickVolume *vol,
     float3 pos, float3 toLight,
-    float shadowDist, float3 shadowExtinction)
+    float shadowDist, int steps)
 {
     float acc = 0.0f;
-    float stepSize = shadowDist / SHADOW_STEPS;
-    for (int s = 1; s <= SHADOW_STEPS; s++) {
+    float stepSize = shadowDist / steps;
+    for (int s = 1; s <= steps; s++) {
         float3 p = pos + toLight * (s * stepSize);
         if (p.x < -0.5f || p.x > 0.5f ||
             p.y < -0.5f || p.y > 0.5f ||
             p.z < -0.5f || p.z > 0.5f) break;
         float3 uvw = p + (float3)(0.5f, 0.5f, 0.5f);
-        acc += sampleDensity(buf, uvw) * stepSize;
+        acc += sampleDensity(vol, uvw) * stepSize;
     }
-    return exp(-acc * shadowExtinction);
+    return acc;
+}
+
+// Trilinear lookup in the baked sun-depth grid, nodes at uvw = i / (sunRes - 1).
+static float sampleSunDepth(
+    __global const half *sunDepth, int sunRes,
+    float3 uvw)
+{
+    float3 f = clamp(uvw, 0.0f, 1.0f) * (float)(sunRes - 1);
+    int3 c = min(convert_int3(f), (int3)(sunRes - 2));
+    float3 w = f - convert_float3(c);
+    int xStride = sunRes * sunRes, yStride = sunRes;
+    int base = c.x * xStride + c.y * yStride + c.z;
+
+    float d000 = vload_half(base, sunDepth),                      d100 = vload_half(base + xStride, sunDepth);
+    float d010 = vload_half(base + yStride, sunDepth),            d110 = vload_half(base + xStride + yStride, sunDepth);
+    float d001 = vload_half(base + 1, sunDepth),                  d101 = vload_half(base + xStride + 1, sunDepth);
+    float d011 = vload_half(base + yStride + 1, sunDepth),        d111 = vload_half(base + xStride + yStride + 1, sunDepth);
+
+    return mix(
+        mix(mix(d000, d100, w.x), mix(d010, d110, w.x), w.y),
+        mix(mix(d001, d101, w.x), mix(d011, d111, w.x), w.y),
+        w.z);
+}
+
+// Bakes the optical depth toward the light at every node of a sunRes^3 grid over the volume.
+// Run when the light moves in volume space; renderClouds then shades with one lookup per sample.
+__kernel void bakeSunDepth(
+    __global const uint *buf,
+    float3 localLight, // toward the light, volume space, normalized
+    float shadowDist,
+    int sunRes,
+    __global half *sunDepth
+) {
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int z = get_global_id(2);
+    if (x >= sunRes || y >= sunRes || z >= sunRes) return;
+
+    BrickVolume vol = readVolume(buf);
+    float3 pos = (float3)(x, y, z) / (float)(sunRes - 1) - (float3)(0.5f, 0.5f, 0.5f);
+    float depth = shadowDepth(&vol, pos, localLight, shadowDist, SUN_BAKE_STEPS);
+    vstore_half(depth, (x * sunRes + y) * sunRes + z, sunDepth);
 }
 
 static float henyeyGreenstein(float cosTheta, float g) {
@@ -118,8 +195,11 @@ __kernel void renderClouds(
     float3 _fwdRot0,
     float3 _fwdRot1,
     float3 _fwdRot2,
-    // cloud density volume: buf[0..2] = xRes,yRes,zRes; buf[3..] = density[x + y*xRes + z*xRes*yRes]
-    __global const float *buf,
+    // cloud density volume, bricked: header and sections as written by UploadVolumeToGpu
+    __global const uint *buf,
+    // optical depth toward the light, baked by bakeSunDepth for the current light
+    __global const half *sunDepth,
+    int sunRes,
     // camera
     float3 camPos,
     float3 camForward,
@@ -135,7 +215,6 @@ __kernel void renderClouds(
     float3 extinctionScale,
     float3 shadowExtinction,
     float scatterG,
-    float shadowDist,
     float3 ambientLight,
     // output
     __global float4 *output,
@@ -163,7 +242,6 @@ __kernel void renderClouds(
     float3 localDir    = normalize((float3)(dot(_invM0, rayDir), dot(_invM1, rayDir), dot(_invM2, rayDir)));
     // lightDir points toward the light (same convention as CPU ray tracer)
     float3 toLight = normalize(lightDir);
-    float3 localLight  = normalize((float3)(dot(_invM0, toLight), dot(_invM1, toLight), dot(_invM2, toLight)));
 
     // Compute scale factor from local-space t to CPU-depth t:
     // CPU depth = dot(hitPos - camPos, unnormRay) = t_worldNorm * rawRayLen
@@ -193,30 +271,74 @@ __kernel void renderClouds(
         return;
     }
 
-    float stepSize   = (tExit - tEntry) / (float)CLOUD_STEPS;
+    // dense cloud is stepped at (tExit - tEntry) / CLOUD_STEPS as before; empty super-bricks
+    // and bricks are skipped whole and thin bricks are crossed in longer steps. A brick's exit,
+    // peak and step are found once on entering it, then the steps inside it only sample.
+    BrickVolume vol = readVolume(buf);
+    float baseStep   = (tExit - tEntry) / (float)CLOUD_STEPS;
+    float maxExtinction = fmax(extinctionScale.x, fmax(extinctionScale.y, extinctionScale.z));
     // cosTheta between view direction and toward-light: positive = forward scatter (viewer on same side as light)
     float cosTheta   = -dot(rayDir, toLight);
     float phase      = min(henyeyGreenstein(cosTheta, scatterG), 4.0f);
     float3 transmittance = (float3)(1.0f, 1.0f, 1.0f);
     float3 scattered = (float3)(0.0f, 0.0f, 0.0f);
-
-    for (int i = 0; i < CLOUD_STEPS; i++) {
-        float3 localPos = localOrigin + localDir * (tEntry + (i + 0.5f) * stepSize);
-
-        // remap localPos from [-0.5,0.5] to [0,1] for density lookup
-        float3 uvw = localPos + (float3)(0.5f, 0.5f, 0.5f);
-        float dens = sampleDensity(buf, uvw);
-        if (dens < 0.005f) continue;
-
-        float3 extinction     = dens * extinctionScale;
-        float3 sampleTransmit = exp(-extinction * stepSize);
-        float3 shadowLight    = fmax(ambientLight, shadowMarch(buf, localPos, localLight, shadowDist, shadowExtinction));
-
-        // Energy-conserving single-scatter integral
-        float3 luminance = baseColor * (shadowLight * phase);
-        scattered += luminance * transmittance * (1.0f - sampleTransmit) / extinction;
-
-        transmittance *= sampleTransmit;
+    const int superVoxels = VOLUME_BRICK * VOLUME_SUPER;
+
+    float t = tEntry;
+    int iterations = 0;
+    while (iterations < CLOUD_MAX_ITERATIONS && t < tExit) {
+        iterations++;
+        // looked up just ahead of t, which a finished brick leaves exactly on its exit
+        float3 uvw = localOrigin + localDir * (t + 0.01f * baseStep) + (float3)(0.5f, 0.5f, 0.5f);
+        int3 cell = volumeCell(&vol, uvw);
+        int3 b = cell / VOLUME_BRICK;
+        int3 sb = b / VOLUME_SUPER;
+        if (vol.superMax[(sb.x * vol.supers.y + sb.y) * vol.supers.z + sb.z] == 0) {
+            t = fmax(regionExit(&vol, sb * superVoxels, (sb + 1) * superVoxels, localOrigin, invDir), t) + 0.01f * baseStep;
+            continue;
+        }
+        int brick = (b.x * vol.bricks.y + b.y) * vol.bricks.z + b.z;
+        float peak = vol.brickMax[brick] * vol.scale;
+        float brickExit = regionExit(&vol, b * VOLUME_BRICK, (b + 1) * VOLUME_BRICK, localOrigin, invDir);
+        if (peak == 0.0f) {
+            t = fmax(brickExit, t) + 0.01f * baseStep;
+            continue;
+        }
+
+        // the step is shortened until its optical depth at the brick's peak is CLOUD_STEP_DEPTH;
+        // the brick is split into equal steps no longer than that, ending on its exit. A sliver
+        // shorter than baseStep takes one baseStep instead.
+        float stride = clamp(CLOUD_STEP_DEPTH / (peak * maxExtinction * baseStep), 1.0f, CLOUD_MAX_STRIDE);
+        float span = fmin(brickExit, tExit) - t;
+        int steps = 1;
+        float stepSize = fmin(baseStep, tExit - t);
+        if (span > baseStep) {
+            steps = (int)ceil(span / (stride * baseStep));
+            stepSize = span / (float)steps;
+        }
+        steps = min(steps, CLOUD_MAX_ITERATIONS - iterations + 1);
+        iterations += steps - 1;
+
+        for (int s = 0; s < steps; s++) {
+            float3 localPos = localOrigin + localDir * (t + 0.5f * stepSize);
+            t += stepSize;
+
+            // remap localPos from [-0.5,0.5] to [0,1] for density lookup
+            float dens = sampleDensity(&vol, localPos + (float3)(0.5f, 0.5f, 0.5f));
+            if (dens < 0.005f) continue;
+
+            float3 extinction     = dens * extinctionScale;
+            float3 sampleTransmit = exp(-extinction * stepSize);
+            float3 sunTransmit    = exp(-sampleSunDepth(sunDepth, sunRes, localPos + (float3)(0.5f, 0.5f, 0.5f)) * shadowExtinction);
+            float3 shadowLight    = fmax(ambientLight, sunTransmit);
+
+            // Energy-conserving single-scatter integral
+            float3 luminance = baseColor * (shadowLight * phase);
+            scattered += luminance * transmittance * (1.0f - sampleTransmit) / extinction;
+
+            transmittance *= sampleTransmit;
+            if (all(transmittance < (float3)(0.005f))) break;
+        }
         if (all(transmittance < (float3)(0.005f))) break;
     }
 
@@ -270,13 +392,13 @@ __kernel void godRays(
     output[idx] = (float4)(godRayColor.x * v, godRayColor.y * v, godRayColor.z * v, 0.0f);
 }
 
-// Composites cloud + god-ray results onto the uint ARGB framebuffer.
+// Composites cloud + god-ray results onto the linear half-float framebuffer.
 // Equivalent to the CPU CloudRenderer_Composite loop, but runs parallel on GPU.
-// framebuffer format: 0xFF000000 | R<<16 | G<<8 | B (same as cpu-side Color)
+// framebuffer format: RGBA half per pixel (cpu-side half4), left unclamped for the tone map
 __kernel void compositeFrame(
     __global const float4 *cloudBuf,
     __global const float4 *godRayBuf,
-    __global uint         *framebuffer,
+    __global half         *framebuffer,
     int screenWidth,
     int screenHeight
 ) {
@@ -292,24 +414,12 @@ __kernel void compositeFrame(
 
     if (transmittance > 0.998f && gr.x < 0.001f && gr.y < 0.001f && gr.z < 0.001f) return;
 
-    uint   bg  = framebuffer[idx];
-    float  br  = ((bg >> 16) & 0xFFu) * (1.0f / 255.0f);
-    float  bgi = ((bg >>  8) & 0xFFu) * (1.0f / 255.0f);
-    float  bb  = ( bg        & 0xFFu) * (1.0f / 255.0f);
-
-    float fr = br, fg = bgi, fb = bb;
+    float4 bg = vload_half4(idx, framebuffer);
+    float4 c  = bg;
     if (transmittance < 0.998f) {
-        fr = br  * transmittance + cloud.x;
-        fg = bgi * transmittance + cloud.y;
-        fb = bb  * transmittance + cloud.z;
+        c.xyz = bg.xyz * transmittance + cloud.xyz;
     }
+    c.xyz = fmax(c.xyz + gr.xyz, 0.0f);
 
-    fr = clamp(fr + gr.x, 0.0f, 1.0f);
-    fg = clamp(fg + gr.y, 0.0f, 1.0f);
-    fb = clamp(fb + gr.z, 0.0f, 1.0f);
-
-    framebuffer[idx] = 0xFF000000u
-                     | ((uint)(fr * 255.0f) << 16)
-                     | ((uint)(fg * 255.0f) <<  8)
-                     |  (uint)(fb * 255.0f);
-}
\ No newline at end of file
+    vstore_half4(c, idx, framebuffer);
+}
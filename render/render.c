@@ -300,6 +300,7 @@ static inline float FastSeed(float cameraSeed) {
 
 void RenderObject(const Object *obj, const Camera *camera, const MaterialLib *lib) {
 	if (!obj || !camera || !obj->v1) return;
+	if (!camera->framebuffer || !camera->depthBuffer || !camera->normalBuffer || !camera->reflectBuffer) return;
 
 	float seed = camera->seed;
 	float3 right = camera->right;
@@ -388,6 +389,7 @@ void RenderObject(const Object *obj, const Camera *camera, const MaterialLib *li
 		// packedColor = 0xFF000000 | (R<<16) | (G<<8) | B  — kept for lit mode, see framebuffer write below
 		uint32 packedColor = 0xFF000000 | ((uint8)(finalColor.x * 255.0f) << 16) | ((uint8)(finalColor.y * 255.0f) << 8) | (uint8)(finalColor.z * 255.0f);
 		(void)packedColor;
+		uint32 packedNormal = PackNormal(normal);
 		float invArea = 1.0f / area;
 		float w0dx = sy2 - sy1;
 		float w0dy = -(sx2 - sx1);
@@ -423,7 +425,7 @@ void RenderObject(const Object *obj, const Camera *camera, const MaterialLib *li
 						int idx = y * camera->screenWidth + (x + k);
 						if (depth < camera->depthBuffer[idx]) {
 							camera->depthBuffer[idx] = depth;
-							camera->normalBuffer[idx] = normal;
+							camera->normalBuffer[idx] = packedNormal;
 							float p0 = cw0 * invZ0;
 							float p1 = cw1 * invZ1;
 							float p2 = cw2 * invZ2;
@@ -433,7 +435,6 @@ void RenderObject(const Object *obj, const Camera *camera, const MaterialLib *li
 								(v0.x * p0 + v1.x * p1 + v2.x * p2) * invPSum,
 								(v0.y * p0 + v1.y * p1 + v2.y * p2) * invPSum,
 								(v0.z * p0 + v1.z * p1 + v2.z * p2) * invPSum};
-							camera->positionBuffer[idx] = worldPos;
 							bRay[bCount] = Float3_Sub(worldPos, camera->position);
 							bIdx[bCount] = idx;
 							bCount++;
@@ -449,7 +450,7 @@ void RenderObject(const Object *obj, const Camera *camera, const MaterialLib *li
 					float3 bRefl[4];
 					Float3_Reflect4(bRay, normal, bRefl);
 					for (int k = 0; k < bCount; k++)
-						camera->reflectBuffer[bIdx[k]] = bRefl[k];
+						camera->reflectBuffer[bIdx[k]] = PackHalf4(bRefl[k].x, bRefl[k].y, bRefl[k].z);
 				}
 
 				w0 += w0dx * 4;
@@ -468,14 +469,14 @@ void RenderObject(const Object *obj, const Camera *camera, const MaterialLib *li
 					int idx = y * camera->screenWidth + x;
 					if (depth < camera->depthBuffer[idx]) {
 						camera->depthBuffer[idx] = depth;
-						camera->normalBuffer[idx] = normal;
+						camera->normalBuffer[idx] = packedNormal;
 						float invPSum = invArea * depth;
 						float3 worldPos = {
 							(v0.x * p0 + v1.x * p1 + v2.x * p2) * invPSum,
 							(v0.y * p0 + v1.y * p1 + v2.y * p2) * invPSum,
 							(v0.z * p0 + v1.z * p1 + v2.z * p2) * invPSum};
-						camera->positionBuffer[idx] = worldPos;
-						camera->reflectBuffer[idx] = Float3_Reflect(Float3_Sub(worldPos, camera->position), normal);
+						float3 refl = Float3_Reflect(Float3_Sub(worldPos, camera->position), normal);
+						camera->reflectBuffer[idx] = PackHalf4(refl.x, refl.y, refl.z);
 						camera->framebuffer[idx] = packedColor;
 					}
 				}
@@ -505,6 +506,7 @@ void RenderSetup(const Object *objects, int objectCount, Camera *camera) {
 
 void RenderObjects(const Object *objects, int objectCount, Camera *camera, const MaterialLib *lib) {
 	if (!objects || !camera || objectCount <= 0) return;
+	if (!Camera_Require(camera, CAMERA_FRAMEBUFFER | CAMERA_DEPTH | CAMERA_NORMAL | CAMERA_REFLECT)) return;
 	RenderSetup(objects, objectCount, camera);
 	for (int i = 0; i < objectCount; i++) {
 		RenderObject(&objects[i], camera, lib);
@@ -1,11 +1,22 @@
+#include <immintrin.h>
+#include <math.h>
+#include <pthread.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <jpeglib.h>
 #include "skybox.h"
+#include "../math/vector3.h"
 
-static uint32 *loadJpeg(const char *path, int *outWidth, int *outHeight) {
+// Decodes at the largest of 1/1, 1/2, 1/4 and 1/8 scale that fits maxSize, so an oversized
+// face is shrunk inside libjpeg's IDCT instead of being decoded in full and filtered after.
+static uint32 *loadJpeg(const char *path, int maxSize, int *outWidth, int *outHeight) {
 	FILE *f = fopen(path, "rb");
 	if (!f) {
 		fprintf(stderr, "Skybox: cannot open %s\n", path);
@@ -18,29 +29,51 @@ static uint32 *loadJpeg(const char *path, int *outWidth, int *outHeight) {
 	jpeg_create_decompress(&cinfo);
 	jpeg_stdio_src(&cinfo, f);
 	jpeg_read_header(&cinfo, TRUE);
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = 1;
+	while (cinfo.scale_denom < 8 && (int)(cinfo.image_width / cinfo.scale_denom) > maxSize &&
+		   cinfo.image_width % (cinfo.scale_denom * 2) == 0 && cinfo.image_height % (cinfo.scale_denom * 2) == 0)
+		cinfo.scale_denom *= 2;
+#ifdef JCS_ALPHA_EXTENSIONS
+	// 0xFFRRGGBB in memory order, written straight into the face
+	cinfo.out_color_space = JCS_EXT_BGRA;
+#else
 	cinfo.out_color_space = JCS_RGB;
+#endif
 	jpeg_start_decompress(&cinfo);
 
 	int w = (int)cinfo.output_width;
 	int h = (int)cinfo.output_height;
 	uint32 *pixels = malloc((size_t)w * h * sizeof(uint32));
-	if (!pixels) {
+#ifdef JCS_ALPHA_EXTENSIONS
+	unsigned char *row = NULL;
+#else
+	unsigned char *row = malloc((size_t)w * 3);
+#endif
+	if (!pixels || (!row && cinfo.out_color_space == JCS_RGB)) {
+		free(pixels);
 		jpeg_destroy_decompress(&cinfo);
 		fclose(f);
 		return NULL;
 	}
 
-	unsigned char *row = malloc((size_t)w * 3);
 	while ((int)cinfo.output_scanline < h) {
+		int y = (int)cinfo.output_scanline;
+#ifdef JCS_ALPHA_EXTENSIONS
+		JSAMPROW rows[8];
+		for (int i = 0; i < 8; i++)
+			rows[i] = (JSAMPROW)&pixels[(size_t)(y + i < h ? y + i : h - 1) * w];
+		jpeg_read_scanlines(&cinfo, rows, 8);
+#else
 		JSAMPROW rowPtr = row;
 		jpeg_read_scanlines(&cinfo, &rowPtr, 1);
-		int y = (int)cinfo.output_scanline - 1;
 		for (int x = 0; x < w; x++) {
 			unsigned char r = row[x * 3 + 0];
 			unsigned char g = row[x * 3 + 1];
 			unsigned char b = row[x * 3 + 2];
-			pixels[y * w + x] = 0xFF000000u | ((uint32)r << 16) | ((uint32)g << 8) | b;
+			pixels[(size_t)y * w + x] = 0xFF000000u | ((uint32)r << 16) | ((uint32)g << 8) | b;
 		}
+#endif
 	}
 	free(row);
 	jpeg_finish_decompress(&cinfo);
@@ -52,94 +85,352 @@ static uint32 *loadJpeg(const char *path, int *outWidth, int *outHeight) {
 	return pixels;
 }
 
-static uint32 *loadFace(const char *dir, const char *name, int *w, int *h) {
-	char path[512];
-	snprintf(path, sizeof(path), "%s/%s.jpg", dir, name);
-	return loadJpeg(path, w, h);
+#define SKYBOX_CACHE_MAGIC "SKYBOX2"
+
+typedef struct {
+	char magic[8];
+	int32_t size;
+	int32_t levelCount;
+	float maxSpread;
+	int32_t reserved;
+	int64_t sourceMtime[SKYBOX_FACES];
+	int64_t sourceBytes[SKYBOX_FACES];
+} SkyboxCacheHeader;
+
+static const char *faceNames[SKYBOX_FACES] = {"right", "left", "top", "bottom", "front", "back"};
+
+// Branch-free cube face selection, same orientation as the source JPEGs.
+static inline int CubeFaceUV(float3 d, float *u, float *v) {
+	float ax = fabsf(d.x), ay = fabsf(d.y), az = fabsf(d.z);
+	int xMajor = ax >= ay && ax >= az;
+	int yMajor = !xMajor && ay >= az;
+	float major = xMajor ? ax : (yMajor ? ay : az);
+	float sc = xMajor ? (d.x > 0.0f ? -d.z : d.z) : (yMajor ? d.x : (d.z > 0.0f ? d.x : -d.x));
+	float tc = yMajor ? (d.y > 0.0f ? d.z : -d.z) : -d.y;
+	int face = xMajor ? (d.x > 0.0f ? SKYBOX_POS_X : SKYBOX_NEG_X)
+					  : (yMajor ? (d.y > 0.0f ? SKYBOX_POS_Y : SKYBOX_NEG_Y) : (d.z > 0.0f ? SKYBOX_POS_Z : SKYBOX_NEG_Z));
+	float inv = 0.5f / fmaxf(major, 1e-20f);
+	*u = sc * inv + 0.5f;
+	*v = tc * inv + 0.5f;
+	return face;
 }
 
-void LoadSkybox(Skybox *skybox, const char *directory) {
-	if (!skybox || !directory) return;
-	memset(skybox, 0, sizeof(*skybox));
+// Inverse of CubeFaceUV: unnormalized direction through (u, v) in [0, 1] on a face.
+static inline float3 CubeFaceDir(int face, float u, float v) {
+	float a = 2.0f * u - 1.0f, b = 2.0f * v - 1.0f;
+	switch (face) {
+	case SKYBOX_POS_X: return (float3){1.0f, -b, -a, 0.0f};
+	case SKYBOX_NEG_X: return (float3){-1.0f, -b, a, 0.0f};
+	case SKYBOX_POS_Y: return (float3){a, 1.0f, b, 0.0f};
+	case SKYBOX_NEG_Y: return (float3){a, -1.0f, -b, 0.0f};
+	case SKYBOX_POS_Z: return (float3){a, -b, 1.0f, 0.0f};
+	default: return (float3){-a, -b, -1.0f, 0.0f};
+	}
+}
 
-	int w, h;
-	skybox->front  = loadFace(directory, "front",  &w, &h); skybox->imageWidth = w; skybox->imageHeight = h;
-	skybox->back   = loadFace(directory, "back",   &w, &h);
-	skybox->left   = loadFace(directory, "left",   &w, &h);
-	skybox->right  = loadFace(directory, "right",  &w, &h);
-	skybox->top    = loadFace(directory, "top",    &w, &h);
-	skybox->bottom = loadFace(directory, "bottom", &w, &h);
+// (b, g, r, a) in [0, 255]
+static inline __m128 UnpackTexel(Color c) {
+	return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128((int)c)));
 }
 
-void DestroySkybox(Skybox *skybox) {
-	if (!skybox) return;
-	free(skybox->front);  skybox->front  = NULL;
-	free(skybox->back);   skybox->back   = NULL;
-	free(skybox->left);   skybox->left   = NULL;
-	free(skybox->right);  skybox->right  = NULL;
-	free(skybox->top);    skybox->top    = NULL;
-	free(skybox->bottom); skybox->bottom = NULL;
+static inline Color PackTexel(__m128 c) {
+	__m128i i = _mm_cvtps_epi32(c);
+	i = _mm_packus_epi32(i, i);
+	return (Color)_mm_cvtsi128_si32(_mm_packus_epi16(i, i));
 }
 
-static inline Color sampleFace(const uint32 *face, int w, int h, float u, float v) {
-	if (!face) return 0xFF101010u;
-	int x = (int)(u * (float)(w - 1) + 0.5f);
-	int y = (int)(v * (float)(h - 1) + 0.5f);
-	if (x < 0) x = 0; else if (x >= w) x = w - 1;
-	if (y < 0) y = 0; else if (y >= h) y = h - 1;
-	return face[y * w + x];
+// Bilinear within the face, clamped at its edges.
+static inline __m128 FetchLevel(const SkyboxLevel *level, float3 dir) {
+	float u, v;
+	int face = CubeFaceUV(dir, &u, &v);
+	int n = level->size;
+	float fx = fminf(fmaxf(u * n - 0.5f, 0.0f), n - 1.0f);
+	float fy = fminf(fmaxf(v * n - 0.5f, 0.0f), n - 1.0f);
+	int x0 = (int)fx, y0 = (int)fy;
+	int x1 = x0 + (x0 < n - 1), y1 = y0 + (y0 < n - 1);
+	__m128 tx = _mm_set1_ps(fx - x0), ty = _mm_set1_ps(fy - y0);
+	const Color *t = level->texels + (size_t)face * n * n;
+	__m128 c00 = UnpackTexel(t[y0 * n + x0]), c10 = UnpackTexel(t[y0 * n + x1]);
+	__m128 c01 = UnpackTexel(t[y1 * n + x0]), c11 = UnpackTexel(t[y1 * n + x1]);
+	__m128 top = _mm_fmadd_ps(_mm_sub_ps(c10, c00), tx, c00);
+	__m128 bottom = _mm_fmadd_ps(_mm_sub_ps(c11, c01), tx, c01);
+	return _mm_fmadd_ps(_mm_sub_ps(bottom, top), ty, top);
 }
 
-Color SampleSkybox(const Skybox *skybox, const float3 dir) {
-	if (!skybox) return 0xFF000000u;
+static size_t LevelTexels(int size) {
+	return (size_t)SKYBOX_FACES * size * size;
+}
+
+// Sets up level views, face views and the roughness table over skybox->texels.
+static void LayoutLevels(Skybox *skybox, int size, int levelCount) {
+	Color *p = skybox->texels;
+	for (int l = 0; l < levelCount; l++) {
+		skybox->levels[l] = (SkyboxLevel){p, size >> l};
+		p += LevelTexels(size >> l);
+	}
+	skybox->levelCount = levelCount;
+	skybox->imageWidth = skybox->imageHeight = size;
+	size_t face = (size_t)size * size;
+	skybox->right = skybox->texels + SKYBOX_POS_X * face;
+	skybox->left = skybox->texels + SKYBOX_NEG_X * face;
+	skybox->top = skybox->texels + SKYBOX_POS_Y * face;
+	skybox->bottom = skybox->texels + SKYBOX_NEG_Y * face;
+	skybox->front = skybox->texels + SKYBOX_POS_Z * face;
+	skybox->back = skybox->texels + SKYBOX_NEG_Z * face;
 
-	int w = skybox->imageWidth;
-	int h = skybox->imageHeight;
+	// spread(r) = SKYBOX_MAX_SPREAD * r^2; level l > 0 has spread SKYBOX_MAX_SPREAD * 2^(l - last)
+	for (int i = 0; i < SKYBOX_ROUGHNESS_STEPS; i++) {
+		float r = (float)i / (SKYBOX_ROUGHNESS_STEPS - 1);
+		float level = r > 0.0f ? (levelCount - 1) + 2.0f * log2f(r) : 0.0f;
+		int l = (int)floorf(level + 0.5f);
+		skybox->roughnessLevel[i] = (uint8)(l < 0 ? 0 : (l > levelCount - 1 ? levelCount - 1 : l));
+	}
+}
 
-	float ax = dir.x < 0 ? -dir.x : dir.x;
-	float ay = dir.y < 0 ? -dir.y : dir.y;
-	float az = dir.z < 0 ? -dir.z : dir.z;
+static int LevelCountFor(int size) {
+	int levels = 1;
+	while (levels < SKYBOX_LEVELS && (size >> levels) >= SKYBOX_MIN_LEVEL_SIZE)
+		levels++;
+	return levels;
+}
 
-	float u, v;
+// Level 0: box filter of the source faces down to the baked size.
+static void BakeBase(Skybox *skybox, uint32 *const *faces, int sourceSize) {
+	int n = skybox->levels[0].size, f = sourceSize / n;
+	float inv = 1.0f / (float)(f * f);
+	for (int face = 0; face < SKYBOX_FACES; face++) {
+		Color *dst = (Color *)skybox->levels[0].texels + (size_t)face * n * n;
+		for (int y = 0; y < n; y++) {
+			for (int x = 0; x < n; x++) {
+				__m128 sum = _mm_setzero_ps();
+				for (int sy = 0; sy < f; sy++)
+					for (int sx = 0; sx < f; sx++)
+						sum = _mm_add_ps(sum, UnpackTexel(faces[face][(size_t)(y * f + sy) * sourceSize + x * f + sx]));
+				dst[y * n + x] = PackTexel(_mm_mul_ps(sum, _mm_set1_ps(inv)));
+			}
+		}
+	}
+}
+
+typedef struct {
+	Skybox *skybox;
+	int level;
+	int face;
+} BakeTask;
 
-	if (ax >= ay && ax >= az) {
-		// ±X face
-		if (dir.x > 0) {
-			// right: u = -Z/X, v = -Y/X
-			u = 0.5f + 0.5f * (-dir.z / ax);
-			v = 0.5f + 0.5f * (-dir.y / ax);
-			return sampleFace(skybox->right, w, h, u, v);
-		} else {
-			// left: u = +Z/X, v = -Y/X
-			u = 0.5f + 0.5f * (dir.z / ax);
-			v = 0.5f + 0.5f * (-dir.y / ax);
-			return sampleFace(skybox->left, w, h, u, v);
+// Level l > 0: Gaussian lobe around each texel direction, taken from level l - 1 on a
+// 5 x 5 grid of angular offsets. Lobes compose, so each level only adds the difference.
+static void *BakeFace(void *arg) {
+	BakeTask *task = arg;
+	Skybox *skybox = task->skybox;
+	int l = task->level, face = task->face;
+	const SkyboxLevel *src = &skybox->levels[l - 1];
+	int n = skybox->levels[l].size;
+	float spread = SKYBOX_MAX_SPREAD * exp2f((float)(l - (skybox->levelCount - 1)));
+	float step = l == 1 ? spread : spread * 0.8660254f; // sqrt(spread^2 - (spread / 2)^2)
+	// per tap: weight, cos of the offset angle and the tangent-plane components scaled by its sin
+	float weight[25], cosTheta[25], tx[25], ty[25], total = 0.0f;
+	for (int k = 0; k < 25; k++) {
+		float ox = (k % 5 - 2) * step, oy = (k / 5 - 2) * step;
+		float theta = sqrtf(ox * ox + oy * oy);
+		float s = theta > 0.0f ? sinf(theta) / theta : 1.0f;
+		total += weight[k] = expf(-0.5f * (float)((k % 5 - 2) * (k % 5 - 2) + (k / 5 - 2) * (k / 5 - 2)));
+		cosTheta[k] = cosf(theta);
+		tx[k] = ox * s;
+		ty[k] = oy * s;
+	}
+
+	Color *dst = (Color *)skybox->levels[l].texels + (size_t)face * n * n;
+	for (int y = 0; y < n; y++) {
+		for (int x = 0; x < n; x++) {
+			float3 d = Float3_Normalize(CubeFaceDir(face, (x + 0.5f) / n, (y + 0.5f) / n));
+			// tangent frame around d
+			float3 t = Float3_Normalize(fabsf(d.y) < 0.99f ? Float3_Cross((float3){0.0f, 1.0f, 0.0f}, d) : Float3_Cross((float3){1.0f, 0.0f, 0.0f}, d));
+			float3 b = Float3_Cross(d, t);
+			__m128 sum = _mm_setzero_ps();
+			for (int k = 0; k < 25; k++) {
+				float3 dir = {d.x * cosTheta[k] + t.x * tx[k] + b.x * ty[k], d.y * cosTheta[k] + t.y * tx[k] + b.y * ty[k],
+							  d.z * cosTheta[k] + t.z * tx[k] + b.z * ty[k], 0.0f};
+				sum = _mm_fmadd_ps(FetchLevel(src, dir), _mm_set1_ps(weight[k]), sum);
+			}
+			dst[y * n + x] = PackTexel(_mm_mul_ps(sum, _mm_set1_ps(1.0f / total)));
 		}
-	} else if (ay >= ax && ay >= az) {
-		// ±Y face
-		if (dir.y > 0) {
-			// top: u = +X/Y, v = +Z/Y
-			u = 0.5f + 0.5f * (dir.x / ay);
-			v = 0.5f + 0.5f * (dir.z / ay);
-			return sampleFace(skybox->top, w, h, u, v);
-		} else {
-			// bottom: u = +X/Y, v = -Z/Y
-			u = 0.5f + 0.5f * (dir.x / ay);
-			v = 0.5f + 0.5f * (-dir.z / ay);
-			return sampleFace(skybox->bottom, w, h, u, v);
+	}
+	return NULL;
+}
+
+// One thread per face; a face that cannot get a thread is baked inline. Not the ThreadPool:
+// at startup LoadSkybox itself runs as a step on the pool, and poolWait waits for every
+// pending task, that step included, so a step cannot wait on faces it queued there.
+static void BakeLevel(Skybox *skybox, int l) {
+	BakeTask tasks[SKYBOX_FACES];
+	pthread_t threads[SKYBOX_FACES];
+	int started[SKYBOX_FACES];
+	for (int face = 0; face < SKYBOX_FACES; face++) {
+		tasks[face] = (BakeTask){skybox, l, face};
+		started[face] = pthread_create(&threads[face], NULL, BakeFace, &tasks[face]) == 0;
+		if (!started[face]) BakeFace(&tasks[face]);
+	}
+	for (int face = 0; face < SKYBOX_FACES; face++)
+		if (started[face]) pthread_join(threads[face], NULL);
+}
+
+static int StatSources(const char *directory, SkyboxCacheHeader *header) {
+	for (int face = 0; face < SKYBOX_FACES; face++) {
+		char path[512];
+		struct stat st;
+		snprintf(path, sizeof(path), "%s/%s.jpg", directory, faceNames[face]);
+		if (stat(path, &st) != 0) return 0;
+		header->sourceMtime[face] = (int64_t)st.st_mtime;
+		header->sourceBytes[face] = (int64_t)st.st_size;
+	}
+	return 1;
+}
+
+// Maps the cache and points the levels into it; nothing is decoded or copied.
+static int LoadCache(Skybox *skybox, const char *path, const SkyboxCacheHeader *expected) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return 0;
+	SkyboxCacheHeader header;
+	struct stat st;
+	int ok = fstat(fd, &st) == 0 && pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+			 memcmp(header.magic, expected->magic, sizeof(header.magic)) == 0 && header.maxSpread == expected->maxSpread &&
+			 header.size > 0 && header.size <= SKYBOX_SIZE && header.levelCount == LevelCountFor(header.size) &&
+			 memcmp(header.sourceMtime, expected->sourceMtime, sizeof(header.sourceMtime)) == 0 &&
+			 memcmp(header.sourceBytes, expected->sourceBytes, sizeof(header.sourceBytes)) == 0;
+	if (ok) {
+		size_t count = 0;
+		for (int l = 0; l < header.levelCount; l++)
+			count += LevelTexels(header.size >> l);
+		size_t bytes = sizeof(header) + count * sizeof(Color);
+		void *map = (size_t)st.st_size == bytes ? mmap(NULL, bytes, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0) : MAP_FAILED;
+		ok = map != MAP_FAILED;
+		if (ok) {
+			skybox->map = map;
+			skybox->mapBytes = bytes;
+			skybox->texels = (Color *)((uint8 *)map + sizeof(header));
+			LayoutLevels(skybox, header.size, header.levelCount);
 		}
-	} else {
-		// ±Z face
-		if (dir.z > 0) {
-			// front: u = +X/Z, v = -Y/Z
-			u = 0.5f + 0.5f * (dir.x / az);
-			v = 0.5f + 0.5f * (-dir.y / az);
-			return sampleFace(skybox->front, w, h, u, v);
-		} else {
-			// back: u = -X/Z, v = -Y/Z
-			u = 0.5f + 0.5f * (-dir.x / az);
-			v = 0.5f + 0.5f * (-dir.y / az);
-			return sampleFace(skybox->back, w, h, u, v);
+	}
+	close(fd);
+	return ok;
+}
+
+static void SaveCache(const Skybox *skybox, const char *path, const SkyboxCacheHeader *sources) {
+	char tmp[520];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	FILE *f = fopen(tmp, "wb");
+	if (!f) return;
+	SkyboxCacheHeader header = *sources;
+	header.size = skybox->levels[0].size;
+	header.levelCount = skybox->levelCount;
+	size_t count = 0;
+	for (int l = 0; l < skybox->levelCount; l++)
+		count += LevelTexels(skybox->levels[l].size);
+	int ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(skybox->texels, sizeof(Color), count, f) == count;
+	ok = fclose(f) == 0 && ok;
+	// rename so a reader never sees a partial cache
+	if (!ok || rename(tmp, path) != 0) remove(tmp);
+}
+
+typedef struct {
+	char path[512];
+	uint32 *pixels;
+	int width;
+	int height;
+} DecodeTask;
+
+static void *DecodeFace(void *arg) {
+	DecodeTask *task = arg;
+	task->pixels = loadJpeg(task->path, SKYBOX_SIZE, &task->width, &task->height);
+	return NULL;
+}
+
+// One thread per face, as BakeLevel; a face that cannot get a thread is decoded inline.
+static void DecodeFaces(const char *directory, DecodeTask *tasks) {
+	pthread_t threads[SKYBOX_FACES];
+	int started[SKYBOX_FACES];
+	for (int face = 0; face < SKYBOX_FACES; face++) {
+		snprintf(tasks[face].path, sizeof(tasks[face].path), "%s/%s.jpg", directory, faceNames[face]);
+		started[face] = pthread_create(&threads[face], NULL, DecodeFace, &tasks[face]) == 0;
+		if (!started[face]) DecodeFace(&tasks[face]);
+	}
+	for (int face = 0; face < SKYBOX_FACES; face++)
+		if (started[face]) pthread_join(threads[face], NULL);
+}
+
+// Decodes the JPEGs and bakes every level into skybox->texels.
+static int Bake(Skybox *skybox, const char *directory) {
+	DecodeTask tasks[SKYBOX_FACES] = {0};
+	DecodeFaces(directory, tasks);
+	uint32 *faces[SKYBOX_FACES];
+	int size = tasks[0].width, ok = 1;
+	for (int face = 0; face < SKYBOX_FACES; face++) {
+		faces[face] = tasks[face].pixels;
+		if (!faces[face] || tasks[face].width != tasks[face].height || tasks[face].width != size) ok = 0;
+	}
+	int baked = size;
+	while (ok && baked > SKYBOX_SIZE && (baked & 1) == 0)
+		baked >>= 1;
+	if (ok && baked > SKYBOX_SIZE) {
+		fprintf(stderr, "Skybox: face size %d does not halve down to %d\n", size, SKYBOX_SIZE);
+		ok = 0;
+	}
+	if (ok) {
+		int levelCount = LevelCountFor(baked);
+		size_t count = 0;
+		for (int l = 0; l < levelCount; l++)
+			count += LevelTexels(baked >> l);
+		skybox->texels = malloc(count * sizeof(Color));
+		ok = skybox->texels != NULL;
+		if (ok) {
+			LayoutLevels(skybox, baked, levelCount);
+			BakeBase(skybox, faces, size);
+			for (int l = 1; l < levelCount; l++)
+				BakeLevel(skybox, l);
 		}
 	}
+	for (int face = 0; face < SKYBOX_FACES; face++)
+		free(faces[face]);
+	return ok;
+}
+
+void LoadSkybox(Skybox *skybox, const char *directory) {
+	if (!skybox || !directory) return;
+	memset(skybox, 0, sizeof(*skybox));
+
+	char cachePath[512];
+	snprintf(cachePath, sizeof(cachePath), "%s/skybox.cache", directory);
+	SkyboxCacheHeader sources = {.magic = SKYBOX_CACHE_MAGIC, .maxSpread = SKYBOX_MAX_SPREAD};
+	int haveSources = StatSources(directory, &sources);
+	if (haveSources && LoadCache(skybox, cachePath, &sources)) return;
+	DestroySkybox(skybox);
+
+	if (!Bake(skybox, directory)) {
+		DestroySkybox(skybox);
+		return;
+	}
+	if (haveSources) SaveCache(skybox, cachePath, &sources);
+}
+
+void DestroySkybox(Skybox *skybox) {
+	if (!skybox) return;
+	if (skybox->map)
+		munmap(skybox->map, skybox->mapBytes);
+	else
+		free(skybox->texels);
+	memset(skybox, 0, sizeof(*skybox));
+}
+
+Color SampleSkybox(const Skybox *skybox, const float3 dir) {
+	if (!skybox) return 0xFF000000u;
+	if (!skybox->texels) return 0xFF101010u;
+	return PackTexel(FetchLevel(&skybox->levels[0], dir));
+}
+
+Color SampleSkyboxRough(const Skybox *skybox, const float3 dir, float roughness) {
+	if (!skybox) return 0xFF000000u;
+	if (!skybox->texels) return 0xFF101010u;
+	int step = (int)(fminf(fmaxf(roughness, 0.0f), 1.0f) * (SKYBOX_ROUGHNESS_STEPS - 1) + 0.5f);
+	return PackTexel(FetchLevel(&skybox->levels[skybox->roughnessLevel[step]], dir));
 }
@@ -2,8 +2,37 @@
 #define SKYBOX_H
 
 #include "../object/format.h"
+#include <stddef.h>
+
+// The six JPEG faces are baked once into a compact cubemap with a prefiltered chain:
+// level 0 is the sharp sky (scaled down to at most SKYBOX_SIZE), each further level
+// halves the face size and widens a Gaussian lobe so level l stands in for roughness
+// sqrt(spread / SKYBOX_MAX_SPREAD). The bake is written to <directory>/skybox.cache and,
+// as long as the JPEGs are unchanged, later launches map it instead of decoding anything.
+
+#define SKYBOX_SIZE 1024		// largest baked face size
+#define SKYBOX_LEVELS 7			// level l is (size >> l) texels per face edge
+#define SKYBOX_MIN_LEVEL_SIZE 8 // levels stop before faces get smaller than this
+#define SKYBOX_MAX_SPREAD 0.5f	// lobe sigma of the last level in radians (roughness 1)
+#define SKYBOX_ROUGHNESS_STEPS 256
+
+typedef enum {
+	SKYBOX_POS_X, // right
+	SKYBOX_NEG_X, // left
+	SKYBOX_POS_Y, // top
+	SKYBOX_NEG_Y, // bottom
+	SKYBOX_POS_Z, // front
+	SKYBOX_NEG_Z, // back
+	SKYBOX_FACES,
+} SkyboxFace;
+
+typedef struct {
+	const Color *texels; // SKYBOX_FACES faces of size x size, in SkyboxFace order
+	int size;
+} SkyboxLevel;
 
 typedef struct Skybox {
+    // views into level 0, kept for callers that address faces directly
     uint32 *front;
     uint32 *back;
     uint32 *left;
@@ -12,11 +41,23 @@ typedef struct Skybox {
     uint32 *bottom;
     int imageWidth;
     int imageHeight;
+
+    Color *texels; // every level, one allocation or a view into the mapped cache
+    void *map;     // mapped cache file, NULL when baked this run
+    size_t mapBytes;
+    SkyboxLevel levels[SKYBOX_LEVELS];
+    int levelCount;
+    uint8 roughnessLevel[SKYBOX_ROUGHNESS_STEPS]; // roughness * (steps - 1) -> level
 } Skybox;
 
 
+// On failure every face is NULL and sampling returns a flat dark colour. Safe to call from
+// a ThreadPool task: the faces are decoded and baked on threads of its own.
 void LoadSkybox(Skybox *skybox, const char *directory);
 void DestroySkybox(Skybox *skybox);
+// Sharp sky (level 0), bilinear.
 Color SampleSkybox(const Skybox *skybox, const float3 rayDir);
+// Sky as seen in a reflection of the given roughness: the matching prefiltered level, bilinear.
+Color SampleSkyboxRough(const Skybox *skybox, const float3 rayDir, float roughness);
 
-#endif // SKYBOX_H
\ No newline at end of file
+#endif // SKYBOX_H
@@ -0,0 +1,147 @@
+// testBloom.c — checks the bloom pyramid on synthetic emission (a single hot pixel must
+// spread into a symmetric glow that falls off with distance; energy under the threshold
+// must not glow), times it, and saves a deferred render before and after bloom.
+// Compile with: make test testBloom
+#include "testBloom.h"
+#include "timings.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLES 32
+#define LIGHT_COUNT 24
+#define OBJECT_COUNT 9 // plane + 8 cubes
+
+static float Seconds(struct timespec t0, struct timespec t1) {
+	return (float)(t1.tv_sec - t0.tv_sec) + (float)(t1.tv_nsec - t0.tv_nsec) * 1e-9f;
+}
+
+// red channel of hdrBuffer in 8-bit steps
+static int Red(const Camera *camera, int x, int y) {
+	return (int)(UnpackHalf4(camera->hdrBuffer[y * camera->screenWidth + x]).x * 255.0f);
+}
+
+// Black frame, every pixel on geometry, bloomBuffer = value everywhere.
+static void ResetSynthetic(Camera *camera, float value) {
+	int n = camera->screenWidth * camera->screenHeight;
+	for (int i = 0; i < n; i++) {
+		camera->hdrBuffer[i] = PackHalf4(0.0f, 0.0f, 0.0f);
+		camera->objectIdBuffer[i] = 0;
+		camera->bloomBuffer[i] = (float3){value, value, value};
+	}
+}
+
+static void BuildScene(Object *objects, MaterialLib *lib) {
+	CreateCube(&objects[0], (float3){0.0f, -0.5f, 10.0f}, (float3){0.0f, 0.0f, 0.0f},
+			   (float3){80.0f, 1.0f, 80.0f}, (float3){0.32f, 0.34f, 0.38f}, lib, 0.0f, 0.9f, 0.0f);
+	for (int i = 1; i < OBJECT_COUNT; i++) {
+		float3 color = {0.3f + 0.7f * ((i * 37) % 11) / 10.0f, 0.3f + 0.7f * ((i * 53) % 11) / 10.0f, 0.3f + 0.7f * ((i * 71) % 11) / 10.0f};
+		CreateCube(&objects[i], (float3){-12.0f + (i - 1) % 4 * 8.0f, 1.0f, 4.0f + (i - 1) / 4 * 8.0f},
+				   (float3){0.0f, 0.4f * i, 0.0f}, (float3){2.0f, 2.0f, 2.0f}, color, lib,
+				   (i % 3 == 0) ? 6.0f : 0.0f, 0.5f, 0.0f);
+	}
+	for (int i = 0; i < OBJECT_COUNT; i++) {
+		objects[i].prevPostion = objects[i].position;
+		objects[i].prevRotation = objects[i].rotation;
+		objects[i].prevScale = objects[i].scale;
+	}
+}
+
+int main(void) {
+	ThreadPool *pool = poolCreate(32, WIDTH);
+	if (!pool) {
+		fprintf(stderr, "Failed to create thread pool\n");
+		return 1;
+	}
+	BloomPyramid bloom;
+	Bloom_Init(&bloom, WIDTH, HEIGHT);
+	if (!bloom.levelCount) {
+		fprintf(stderr, "Failed to allocate bloom pyramid\n");
+		return 1;
+	}
+	Camera camera;
+	initCamera(&camera, WIDTH, HEIGHT, 90.0f, (float3){0.0f, 2.0f, -7.0f},
+			   (float3){0.0f, -0.15f, 1.0f}, (float3){6.0f, 8.0f, -6.0f});
+	Camera_Require(&camera, CAMERA_HDR | CAMERA_OBJECT_ID | CAMERA_BLOOM);
+
+	printf("=== testBloom: %dx%d, %d levels ===\n", WIDTH, HEIGHT, bloom.levelCount);
+	int failures = 0;
+
+	// single hot pixel
+	int cx = WIDTH / 2, cy = HEIGHT / 2;
+	ResetSynthetic(&camera, 0.0f);
+	for (int dy = 0; dy < 2; dy++)
+		for (int dx = 0; dx < 2; dx++)
+			camera.bloomBuffer[(cy + dy) * WIDTH + cx + dx] = (float3){40.0f, 40.0f, 40.0f};
+	BloomPostProcess(&bloom, &camera, pool);
+	int near = Red(&camera, cx + 4, cy), mid = Red(&camera, cx + 24, cy), far = Red(&camera, cx + 400, cy);
+	int left = Red(&camera, cx - 24 + 1, cy), right = Red(&camera, cx + 24, cy);
+	printf("Hot pixel glow: +4px=%d +24px=%d +400px=%d  left/right=%d/%d\n", near, mid, far, left, right);
+	if (!(near > mid && mid > 0 && far == 0)) {
+		printf("Glow does not fall off with distance.\n");
+		failures++;
+	}
+	if (abs(left - right) > 2) {
+		printf("Glow is not symmetric.\n");
+		failures++;
+	}
+
+	// below threshold
+	ResetSynthetic(&camera, BLOOM_THRESHOLD - BLOOM_KNEE - 0.05f);
+	BloomPostProcess(&bloom, &camera, pool);
+	int lit = 0;
+	for (int i = 0; i < WIDTH * HEIGHT; i++)
+		if (UnpackHalf4(camera.hdrBuffer[i]).x != 0.0f) lit++;
+	printf("Below-threshold pixels changed: %d\n", lit);
+	if (lit) failures++;
+
+	// timing on scattered lights
+	float times[SAMPLES];
+	for (int s = 0; s < SAMPLES; s++) {
+		ResetSynthetic(&camera, 0.0f);
+		for (int l = 0; l < LIGHT_COUNT; l++) {
+			int x = (l * 7919) % WIDTH, y = (l * 104729) % HEIGHT;
+			camera.bloomBuffer[y * WIDTH + x] = (float3){8.0f, 6.0f, 3.0f};
+		}
+		struct timespec t0, t1;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		BloomPostProcess(&bloom, &camera, pool);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		times[s] = Seconds(t0, t1);
+	}
+	PerformanceMetrics m = ComputePerformanceMetrics(times, SAMPLES);
+	printf("Bloom       median=%.3fms  p99=%.3fms\n", m.medianTime * 1e3f, m.p99Time * 1e3f);
+
+	// rendered scene
+	Object *objects = malloc(sizeof(Object) * OBJECT_COUNT);
+	MaterialLib matLib;
+	MaterialLib_Init(&matLib, 64);
+	BuildScene(objects, &matLib);
+	MaterialTable matTable;
+	MaterialTable_Init(&matTable);
+	MaterialTable_Sync(&matTable, &matLib);
+	Skybox skybox;
+	LoadSkybox(&skybox, "skybox");
+	RayTraceTaskQueue rayTaskQueue;
+	RenderSetup(objects, OBJECT_COUNT, &camera);
+	ComputePrevCameraPos(&camera);
+	RayTraceSceneDeferred(objects, OBJECT_COUNT, &camera, &matTable, &rayTaskQueue, pool, &skybox);
+	SaveImage("tests/img/bloom_before.bmp", &camera);
+	BloomPostProcess(&bloom, &camera, pool);
+	RayTracePackHdr(&camera, &rayTaskQueue, pool);
+	SaveImage("tests/img/bloom_after.bmp", &camera);
+
+	Bloom_Destroy(&bloom);
+	poolDestroy(pool);
+	DestroySkybox(&skybox);
+	destroyCamera(&camera);
+	Scene_Destroy(objects, OBJECT_COUNT);
+	MaterialTable_Destroy(&matTable);
+	MaterialLib_Destroy(&matLib);
+
+	if (failures) return 1;
+	printf("Correctness check passed.\n");
+	return 0;
+}
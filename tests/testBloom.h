@@ -0,0 +1,18 @@
+#ifndef TEST_BLOOM_H
+#define TEST_BLOOM_H
+
+#include "../util/threadPool.h"
+#include "../math/vector3.h"
+#include "../render/color/color.h"
+#include "../object/format.h"
+#include "../object/object.h"
+#include "../object/scene.h"
+#include "../render/render.h"
+#include "../render/cpu/ray.h"
+#include "../render/cpu/bloom.h"
+#include "../skybox/skybox.h"
+#include "saveImage.h"
+
+// Built with: make test testBloom
+
+#endif
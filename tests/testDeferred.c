@@ -0,0 +1,435 @@
+// testDeferred.c — compares the single-pass row renderer (RayTraceScene) with the
+// visibility-buffer + deferred shading path (RayTraceVisibility/RayTraceShade) on a
+// static scene. Reports per-phase timings and fails if the frames drift apart. Also checks
+// the per-tile emitter lists against a brute-force ranking on a scene with more emitters
+// than a tile keeps, and that direct lighting reaches the HDR buffer unclamped.
+// Compile with: make test testDeferred
+#include "testDeferred.h"
+#include "timings.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLES 64
+#define GRID_COLS 6
+#define GRID_ROWS 7
+#define CUBE_COUNT (GRID_COLS * GRID_ROWS)
+#define F16_COUNT 3
+#define OBJECT_COUNT (1 + CUBE_COUNT + F16_COUNT) // plane + cubes + fighter jets
+// per-channel tolerance: deferred path rebuilds hit points from barycentrics
+#define MAX_CHANNEL_DIFF 8
+// secondary rays are traced on a 2D grid in the deferred path and on row-held columns in
+// the forward one, so shadow / reflection edges may move by a block: cap how many pixels
+// may exceed MAX_CHANNEL_DIFF instead of requiring none to
+#define MAX_OUTLIER_PERCENT 3.0f
+// both paths resolve surfaces through the same helper: where they hit the same triangle the
+// shading normal must agree, up to a texel picked from the hit point instead of barycentrics
+#define MAX_NORMAL_MISMATCH_PERCENT 0.1f
+// emitter tile test: more emitters than EMITTER_TILE_CAPACITY, on a camera smaller than the grid
+#define MANY_EMITTER_COLS 8
+#define MANY_EMITTER_ROWS 5
+#define MANY_EMITTERS (MANY_EMITTER_COLS * MANY_EMITTER_ROWS)
+#define TILE_TEST_WIDTH 320
+#define TILE_TEST_HEIGHT 240
+
+static void BuildScene(Object *objects, MaterialLib *lib) {
+	int idx = 0;
+
+	CreateCube(&objects[idx++], (float3){0.0f, -0.5f, 10.0f}, (float3){0.0f, 0.0f, 0.0f},
+			   (float3){80.0f, 1.0f, 80.0f}, (float3){0.32f, 0.34f, 0.38f}, lib, 0.0f, 0.9f, 0.0f);
+
+	const float spacingX = 8.0f, spacingZ = 8.0f;
+	const float startX = -(GRID_COLS - 1) * spacingX * 0.5f;
+	const float startZ = 10.0f - (GRID_ROWS - 1) * spacingZ * 0.5f;
+	for (int row = 0; row < GRID_ROWS; row++) {
+		for (int col = 0; col < GRID_COLS; col++) {
+			float3 color = {
+				0.2f + 0.8f * ((idx * 37) % 11) / 10.0f,
+				0.2f + 0.8f * ((idx * 53) % 11) / 10.0f,
+				0.2f + 0.8f * ((idx * 71) % 11) / 10.0f,
+			};
+			// at most TOP_EMISSIVE_OBJECTS emitters: the forward path caps and sorts
+			// them per pixel, the deferred path uses tile lists, both agree below the cap
+			float emission = (idx % 14 == 0) ? 6.0f : 0.0f;
+			float roughness = 0.1f + 0.7f * ((idx * 13) % 5) / 4.0f;
+			float metallic = (idx % 3 == 0) ? 0.8f : 0.0f;
+			CreateCube(&objects[idx++], (float3){startX + col * spacingX, 1.0f, startZ + row * spacingZ},
+					   (float3){0.0f, 0.3f * col, 0.0f}, (float3){2.0f, 2.0f, 2.0f}, color, lib,
+					   emission, roughness, metallic);
+		}
+	}
+
+	for (int i = 0; i < F16_COUNT; i++) {
+		LoadObj("assets/models/f16.bin", &objects[idx], lib);
+		objects[idx].position = (float3){-15.0f + i * 6.0f, 0.8f, 38.0f + (i % 2) * 6.0f};
+		objects[idx].rotation = (float3){0.0f, (float)(i % 2 == 0 ? -0.5f : 0.5f), 0.0f};
+		objects[idx].scale = (float3){2.0f, 2.0f, 2.0f};
+		CreateObjectBVH(&objects[idx], &objects[idx].bvh);
+		Object_UpdateWorldBounds(&objects[idx]);
+		idx++;
+	}
+
+	// static scene: prev == current so motion vectors are zero
+	for (int i = 0; i < OBJECT_COUNT; i++) {
+		objects[i].prevPostion = objects[i].position;
+		objects[i].prevRotation = objects[i].rotation;
+		objects[i].prevScale = objects[i].scale;
+	}
+}
+
+static void InitTestCamera(Camera *camera) {
+	initCamera(camera, WIDTH, HEIGHT, 90.0f, (float3){0.0f, 2.0f, -7.0f},
+			   (float3){0.0f, -0.15f, 1.0f}, (float3){6.0f, 8.0f, -6.0f});
+}
+
+static float Seconds(struct timespec t0, struct timespec t1) {
+	return (float)(t1.tv_sec - t0.tv_sec) + (float)(t1.tv_nsec - t0.tv_nsec) * 1e-9f;
+}
+
+static int AllFlags(const Object *obj, int flag, int set) {
+	for (int i = 0; i < obj->triangleCount; i++)
+		if (((obj->materialFlags[i] & flag) != 0) != set) return 0;
+	return 1;
+}
+
+// Two cubes on one lib entry: editing one must leave the other's material, flags and
+// emission untouched, and undoing the edit must find the original entry again.
+static int TestSharedMaterialEdit(void) {
+	MaterialLib lib;
+	MaterialLib_Init(&lib, 4);
+	Object a = {0}, b = {0};
+	float3 zero = {0.0f, 0.0f, 0.0f}, one = {1.0f, 1.0f, 1.0f};
+	CreateCube(&a, zero, zero, one, (float3){0.5f, 0.6f, 0.7f}, &lib, 0.0f, 0.8f, 0.0f);
+	CreateCube(&b, (float3){3.0f, 0.0f, 0.0f}, zero, one, (float3){0.1f, 0.1f, 0.1f}, &lib, 0.0f, 0.5f, 0.0f);
+	int shared = a.materialIds[0];
+	Object_SetMaterial(&b, &lib, lib.entries[shared]);
+	int ok = b.materialIds[0] == shared;
+
+	Object_SetEmission(&a, &lib, 4.0f);
+	Object_SetMetallic(&a, &lib, 1.0f);
+	ok = ok && a.materialIds[0] != shared && AllFlags(&a, MATERIAL_EMISSIVE, 1) && AllFlags(&a, MATERIAL_METALLIC, 1) && a.hasEmission;
+	ok = ok && b.materialIds[0] == shared && AllFlags(&b, MATERIAL_EMISSIVE, 0) && AllFlags(&b, MATERIAL_METALLIC, 0) && !b.hasEmission;
+	ok = ok && lib.entries[shared].emission == 0.0f && lib.entries[shared].metallic == 0.0f;
+
+	Object_SetEmission(&a, &lib, 0.0f);
+	Object_SetMetallic(&a, &lib, 0.0f);
+	ok = ok && a.materialIds[0] == shared && AllFlags(&a, MATERIAL_EMISSIVE, 0) && !a.hasEmission;
+	// an equal material added later still finds the first entry
+	ok = ok && MaterialLib_FindOrAdd(&lib, lib.entries[shared]) == shared;
+	printf("Shared material edit: %s\n", ok ? "other object unaffected" : "LEAKED INTO THE OTHER OBJECT");
+
+	Object_Destroy(&a);
+	Object_Destroy(&b);
+	MaterialLib_Destroy(&lib);
+	return ok;
+}
+
+typedef struct {
+	int bound;
+	float importance;
+} RankedEmitter;
+
+static int CompareImportance(const void *a, const void *b) {
+	float ia = ((const RankedEmitter *)a)->importance, ib = ((const RankedEmitter *)b)->importance;
+	return (ia < ib) - (ia > ib);
+}
+
+static int SameImportance(float a, float b) {
+	return fabsf(a - b) <= 1e-4f * fmaxf(a, b);
+}
+
+// Brute force over every tile: an emitter reaches a tile when some pixel of it lies inside the
+// emitter's sphere of influence. Each tile's list, restricted to those emitters, must be their
+// ranking by peak / distance^2 to the tile centre; one left out must only have lost to the cap.
+static int TestEmitterTiles(ThreadPool *pool, const Skybox *skybox, RayTraceTaskQueue *queue) {
+	const int objectCount = 1 + MANY_EMITTERS;
+	Object *objects = malloc(sizeof(Object) * objectCount);
+	if (!objects) return 0;
+	MaterialLib lib;
+	MaterialLib_Init(&lib, 64);
+	float3 zero = {0.0f, 0.0f, 0.0f};
+	CreateCube(&objects[0], (float3){0.0f, -0.5f, 10.0f}, zero, (float3){80.0f, 1.0f, 80.0f},
+			   (float3){0.32f, 0.34f, 0.38f}, &lib, 0.0f, 0.9f, 0.0f);
+	for (int i = 0; i < MANY_EMITTERS; i++) {
+		int col = i % MANY_EMITTER_COLS, row = i / MANY_EMITTER_COLS;
+		CreateCube(&objects[1 + i], (float3){-14.0f + col * 4.0f, 0.5f, 2.0f + row * 4.0f}, zero,
+				   (float3){0.5f, 0.5f, 0.5f}, (float3){0.9f, 0.7f, 0.4f}, &lib, 1.0f + (i * 7) % 6, 0.5f, 0.0f);
+	}
+	for (int i = 0; i < objectCount; i++) {
+		objects[i].prevPostion = objects[i].position;
+		objects[i].prevRotation = objects[i].rotation;
+		objects[i].prevScale = objects[i].scale;
+	}
+	MaterialTable table;
+	MaterialTable_Init(&table);
+	MaterialTable_Sync(&table, &lib);
+
+	Camera camera;
+	initCamera(&camera, TILE_TEST_WIDTH, TILE_TEST_HEIGHT, 90.0f, (float3){0.0f, 4.0f, -8.0f},
+			   (float3){0.0f, -0.3f, 1.0f}, (float3){6.0f, 8.0f, -6.0f});
+	RenderSetup(objects, objectCount, &camera);
+	ComputePrevCameraPos(&camera);
+	RayTraceVisibility(objects, objectCount, &camera, queue, pool);
+	RayTraceShadeSignals(objects, objectCount, &camera, &table, queue, pool, skybox, 0);
+
+	// the emitter list RayTraceShadeSignals builds: emissive objects not entirely behind the camera
+	float3 fwd = Float3_Normalize(camera.forward), rgt = Float3_Normalize(camera.right), up = Float3_Normalize(camera.up);
+	EmitterBounds bounds[1 + MANY_EMITTERS];
+	int boundsCount = 0;
+	for (int i = 0; i < objectCount; i++) {
+		if (!objects[i].hasEmission || objects[i].emissionPeak <= 0.0f) continue;
+		float3 rel = Float3_Sub(objects[i].position, camera.position);
+		float radius = sqrtf(objects[i].emissionPeak / EMITTER_CUTOFF);
+		float3 vc = {Float3_Dot(rel, rgt), Float3_Dot(rel, up), Float3_Dot(rel, fwd)};
+		if (vc.z + radius < 0.0f) continue;
+		bounds[boundsCount++] = (EmitterBounds){vc, radius, objects[i].emissionPeak, i};
+	}
+
+	const EmitterTileGrid *grid = &queue->emitterTiles;
+	int W = TILE_TEST_WIDTH, H = TILE_TEST_HEIGHT;
+	int ok = boundsCount == MANY_EMITTERS && grid->tilesX == (W + EMITTER_TILE_SIZE - 1) / EMITTER_TILE_SIZE &&
+			 grid->tilesY == (H + EMITTER_TILE_SIZE - 1) / EMITTER_TILE_SIZE;
+	float kx = camera.aspect * camera.fovScale, ky = camera.fovScale;
+	PixelRays rays = Camera_PixelRays(&camera);
+	int fullTiles = 0, droppedByCap = 0;
+	for (int ty = 0; ok && ty < grid->tilesY; ty++) {
+		for (int tx = 0; ok && tx < grid->tilesX; tx++) {
+			const EmitterTile *tile = &grid->tiles[ty * grid->tilesX + tx];
+			int x0 = tx * EMITTER_TILE_SIZE, y0 = ty * EMITTER_TILE_SIZE;
+			int x1 = x0 + EMITTER_TILE_SIZE < W ? x0 + EMITTER_TILE_SIZE : W;
+			int y1 = y0 + EMITTER_TILE_SIZE < H ? y0 + EMITTER_TILE_SIZE : H;
+			int reaches[1 + MANY_EMITTERS] = {0};
+			float zMin = DEPTH_FAR, zMax = 0.0f;
+			for (int y = y0; y < y1; y++) {
+				for (int x = x0; x < x1; x++) {
+					float z = camera.depthBuffer[y * W + x];
+					if (z >= DEPTH_FAR) continue;
+					zMin = fminf(zMin, z);
+					zMax = fmaxf(zMax, z);
+					float3 p = PixelRays_Position(&rays, x, y, z);
+					for (int e = 0; e < boundsCount; e++) {
+						float3 d = Float3_Sub(p, objects[bounds[e].index].position);
+						if (Float3_Dot(d, d) <= bounds[e].radius * bounds[e].radius) reaches[e] = 1;
+					}
+				}
+			}
+			ok = tile->count >= 0 && tile->count <= EMITTER_TILE_CAPACITY;
+			if (zMin >= DEPTH_FAR) {
+				ok = ok && tile->count == 0;
+				continue;
+			}
+
+			float ndcL = x0 / (float)W * 2.0f - 1.0f, ndcR = x1 / (float)W * 2.0f - 1.0f;
+			float ndcT = 1.0f - y0 / (float)H * 2.0f, ndcB = 1.0f - y1 / (float)H * 2.0f;
+			float zMid = 0.5f * (zMin + zMax);
+			float3 centre = {0.5f * (ndcL + ndcR) * kx * zMid, 0.5f * (ndcT + ndcB) * ky * zMid, zMid};
+			float importance[1 + MANY_EMITTERS];
+			RankedEmitter ranked[1 + MANY_EMITTERS];
+			int rankedCount = 0;
+			for (int e = 0; e < boundsCount; e++) {
+				float3 d = Float3_Sub(bounds[e].viewCenter, centre);
+				importance[e] = bounds[e].peak / (Float3_Dot(d, d) + 1e-6f);
+				if (reaches[e]) ranked[rankedCount++] = (RankedEmitter){e, importance[e]};
+			}
+			qsort(ranked, rankedCount, sizeof(RankedEmitter), CompareImportance);
+
+			// the list walks the brute-force ranking in order; culling may keep extra emitters
+			int next = 0;
+			for (int t = 0; ok && t < tile->count; t++) {
+				int e = tile->emitters[t];
+				ok = e >= 0 && e < boundsCount;
+				if (ok && t > 0) ok = importance[e] <= importance[tile->emitters[t - 1]] * (1.0f + 1e-4f);
+				if (ok && reaches[e]) ok = SameImportance(ranked[next++].importance, importance[e]);
+			}
+			// whatever is left must have lost to the cap
+			float lowest = tile->count ? importance[tile->emitters[tile->count - 1]] : 0.0f;
+			for (int r = next; ok && r < rankedCount; r++) {
+				ok = tile->count == EMITTER_TILE_CAPACITY && ranked[r].importance <= lowest * (1.0f + 1e-4f);
+				droppedByCap++;
+			}
+			if (tile->count == EMITTER_TILE_CAPACITY) fullTiles++;
+		}
+	}
+	// the cap has to be exercised for the ranking to matter
+	ok = ok && fullTiles > 0;
+	printf("Emitter tiles: %d emitters, %d full tiles, %d reaching emitters dropped by the cap: %s\n",
+		   boundsCount, fullTiles, droppedByCap, ok ? "match brute force" : "MISMATCH");
+
+	// a camera larger than the tile grid is refused before anything is written
+	Camera oversized;
+	initCamera(&oversized, WIDTH + EMITTER_TILE_SIZE, HEIGHT, 90.0f, camera.position, camera.forward, camera.lightDir);
+	RenderSetup(objects, objectCount, &oversized);
+	RayTraceShadeSignals(objects, objectCount, &oversized, &table, queue, pool, skybox, 0);
+	int rejected = oversized.emissionSignal == NULL;
+	printf("Oversized camera: %s\n", rejected ? "rejected" : "SHADED PAST THE TILE GRID");
+
+	destroyCamera(&oversized);
+	destroyCamera(&camera);
+	Scene_Destroy(objects, objectCount);
+	MaterialTable_Destroy(&table);
+	MaterialLib_Destroy(&lib);
+	return ok && rejected;
+}
+
+// Direct lighting goes into hdrBuffer linear: an emitter brighter than white has to stay
+// above 1.0 there, before the composite adds anything, for bloom and the tone map to see it.
+static int TestHdrHeadroom(ThreadPool *pool, const Skybox *skybox, RayTraceTaskQueue *queue) {
+	Object *objects = malloc(sizeof(Object) * 2);
+	if (!objects) return 0;
+	MaterialLib lib;
+	MaterialLib_Init(&lib, 4);
+	float3 zero = {0.0f, 0.0f, 0.0f};
+	CreateCube(&objects[0], (float3){0.0f, -0.5f, 10.0f}, zero, (float3){80.0f, 1.0f, 80.0f},
+			   (float3){0.32f, 0.34f, 0.38f}, &lib, 0.0f, 0.9f, 0.0f);
+	CreateCube(&objects[1], (float3){0.0f, 1.0f, 4.0f}, zero, (float3){2.0f, 2.0f, 2.0f},
+			   (float3){0.9f, 0.7f, 0.4f}, &lib, 400.0f, 0.5f, 0.0f);
+	for (int i = 0; i < 2; i++) {
+		objects[i].prevPostion = objects[i].position;
+		objects[i].prevRotation = objects[i].rotation;
+		objects[i].prevScale = objects[i].scale;
+	}
+	MaterialTable table;
+	MaterialTable_Init(&table);
+	MaterialTable_Sync(&table, &lib);
+
+	Camera camera;
+	initCamera(&camera, TILE_TEST_WIDTH, TILE_TEST_HEIGHT, 90.0f, (float3){0.0f, 2.0f, -2.0f},
+			   (float3){0.0f, -0.1f, 1.0f}, (float3){6.0f, 8.0f, -6.0f});
+	RenderSetup(objects, 2, &camera);
+	ComputePrevCameraPos(&camera);
+	RayTraceVisibility(objects, 2, &camera, queue, pool);
+	RayTraceShadeSignals(objects, 2, &camera, &table, queue, pool, skybox, 0);
+
+	float peak = 0.0f;
+	for (int i = 0; i < TILE_TEST_WIDTH * TILE_TEST_HEIGHT; i++) {
+		if (camera.objectIdBuffer[i] != 1) continue;
+		float3 c = UnpackHalf4(camera.hdrBuffer[i]);
+		peak = fmaxf(peak, fmaxf(c.x, fmaxf(c.y, c.z)));
+	}
+	int ok = peak > 1.0f;
+	printf("Emitter direct lighting peak: %.2f (%s)\n", peak, ok ? "linear" : "CLAMPED TO WHITE");
+
+	destroyCamera(&camera);
+	Scene_Destroy(objects, 2);
+	MaterialTable_Destroy(&table);
+	MaterialLib_Destroy(&lib);
+	return ok;
+}
+
+int main(void) {
+	Object *objects = malloc(sizeof(Object) * OBJECT_COUNT);
+	if (!objects) {
+		fprintf(stderr, "Failed to allocate objects\n");
+		return 1;
+	}
+
+	MaterialLib matLib;
+	MaterialLib_Init(&matLib, 256);
+	BuildScene(objects, &matLib);
+	MaterialTable matTable;
+	MaterialTable_Init(&matTable);
+	MaterialTable_Sync(&matTable, &matLib);
+
+	Skybox skybox;
+	LoadSkybox(&skybox, "skybox");
+
+	ThreadPool *pool = poolCreate(32, WIDTH);
+	if (!pool) {
+		fprintf(stderr, "Failed to create thread pool\n");
+		return 1;
+	}
+	RayTraceTaskQueue rayTaskQueue;
+
+	Camera camForward, camDeferred;
+	InitTestCamera(&camForward);
+	InitTestCamera(&camDeferred);
+	RenderSetup(objects, OBJECT_COUNT, &camForward);
+	RenderSetup(objects, OBJECT_COUNT, &camDeferred);
+	ComputePrevCameraPos(&camForward);
+	ComputePrevCameraPos(&camDeferred);
+
+	printf("=== testDeferred: plane + %d cubes (%d tris), %dx%d, %d samples ===\n",
+		   CUBE_COUNT, Scene_CountTriangles(objects, OBJECT_COUNT), WIDTH, HEIGHT, SAMPLES);
+
+	RayTraceScene(objects, OBJECT_COUNT, &camForward, &matLib, &rayTaskQueue, pool, &skybox);
+	RayTraceSceneDeferred(objects, OBJECT_COUNT, &camDeferred, &matTable, &rayTaskQueue, pool, &skybox);
+	SaveImage("tests/img/deferred_forward.bmp", &camForward);
+	SaveImage("tests/img/deferred_deferred.bmp", &camDeferred);
+
+	int pixelCount = WIDTH * HEIGHT;
+	int differing = 0, outliers = 0, worst = 0;
+	for (int i = 0; i < pixelCount; i++) {
+		Color a = camForward.framebuffer[i], b = camDeferred.framebuffer[i];
+		int maxDiff = 0;
+		for (int shift = 0; shift < 24; shift += 8) {
+			int d = abs((int)((a >> shift) & 0xFF) - (int)((b >> shift) & 0xFF));
+			if (d > maxDiff) maxDiff = d;
+		}
+		if (maxDiff > 0) differing++;
+		if (maxDiff > MAX_CHANNEL_DIFF) outliers++;
+		if (maxDiff > worst) worst = maxDiff;
+	}
+	float outlierPercent = 100.0f * outliers / pixelCount;
+	printf("Differing pixels: %d (%.2f%%), above %d: %.2f%%, worst channel delta: %d\n",
+		   differing, 100.0f * differing / pixelCount, MAX_CHANNEL_DIFF, outlierPercent, worst);
+
+	int sameTriangle = 0, normalMismatch = 0;
+	for (int i = 0; i < pixelCount; i++) {
+		if (camForward.objectIdBuffer[i] < 0 || camForward.objectIdBuffer[i] != camDeferred.objectIdBuffer[i] ||
+			camForward.triangleIdBuffer[i] != camDeferred.triangleIdBuffer[i]) continue;
+		sameTriangle++;
+		if (Float3_Dot(UnpackNormal(camForward.normalBuffer[i]), UnpackNormal(camDeferred.normalBuffer[i])) < 0.99f) normalMismatch++;
+	}
+	float normalMismatchPercent = sameTriangle ? 100.0f * normalMismatch / sameTriangle : 100.0f;
+	printf("Surface normals: %d of %d same-triangle pixels disagree (%.3f%%)\n", normalMismatch, sameTriangle, normalMismatchPercent);
+
+	float timesForward[SAMPLES], timesVisibility[SAMPLES], timesShade[SAMPLES];
+	for (int s = 0; s < SAMPLES; s++) {
+		struct timespec t0, t1, t2;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		RayTraceScene(objects, OBJECT_COUNT, &camForward, &matLib, &rayTaskQueue, pool, &skybox);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		timesForward[s] = Seconds(t0, t1);
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		RayTraceVisibility(objects, OBJECT_COUNT, &camDeferred, &rayTaskQueue, pool);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		RayTraceShade(objects, OBJECT_COUNT, &camDeferred, &matTable, &rayTaskQueue, pool, &skybox);
+		clock_gettime(CLOCK_MONOTONIC, &t2);
+		timesVisibility[s] = Seconds(t0, t1);
+		timesShade[s] = Seconds(t1, t2);
+	}
+
+	PerformanceMetrics mForward = ComputePerformanceMetrics(timesForward, SAMPLES);
+	PerformanceMetrics mVis = ComputePerformanceMetrics(timesVisibility, SAMPLES);
+	PerformanceMetrics mShade = ComputePerformanceMetrics(timesShade, SAMPLES);
+	printf("Forward     median=%.3fms  p99=%.3fms\n", mForward.medianTime * 1e3f, mForward.p99Time * 1e3f);
+	printf("Visibility  median=%.3fms  p99=%.3fms\n", mVis.medianTime * 1e3f, mVis.p99Time * 1e3f);
+	printf("Shade       median=%.3fms  p99=%.3fms\n", mShade.medianTime * 1e3f, mShade.p99Time * 1e3f);
+
+	int failures = 0;
+	if (!TestEmitterTiles(pool, &skybox, &rayTaskQueue)) failures++;
+	if (!TestHdrHeadroom(pool, &skybox, &rayTaskQueue)) failures++;
+
+	poolDestroy(pool);
+	DestroySkybox(&skybox);
+	destroyCamera(&camForward);
+	destroyCamera(&camDeferred);
+	Scene_Destroy(objects, OBJECT_COUNT);
+	MaterialTable_Destroy(&matTable);
+	MaterialLib_Destroy(&matLib);
+
+	if (!TestSharedMaterialEdit()) failures++;
+	if (normalMismatchPercent > MAX_NORMAL_MISMATCH_PERCENT) {
+		printf("Forward and deferred resolve different surfaces.\n");
+		failures++;
+	}
+	if (outlierPercent > MAX_OUTLIER_PERCENT) {
+		printf("Deferred output drifted from forward renderer.\n");
+		failures++;
+	}
+	if (failures) return 1;
+	printf("Correctness check passed.\n");
+	return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef TEST_DEFERRED_H
+#define TEST_DEFERRED_H
+
+#include "../util/threadPool.h"
+#include "../math/scalar.h"
+#include "../math/transform.h"
+#include "../math/vector3.h"
+#include "../render/color/color.h"
+#include "../object/format.h"
+#include "../object/object.h"
+#include "../object/scene.h"
+#include "../load/loadObj.h"
+#include "../render/render.h"
+#include "../render/cpu/ray.h"
+#include "../skybox/skybox.h"
+#include "saveImage.h"
+
+// Built with: make test testDeferred
+
+#endif
@@ -0,0 +1,214 @@
+// testDenoise.c — runs the deferred renderer on a static scene, once with the row box
+// blur and once through the spatiotemporal denoiser. Reports denoiser timings and checks
+// the filtered signals are finite and closer than the raw upsampled samples to a reference
+// where every pixel has its own secondary rays (all sample phases gathered per pixel).
+// Compile with: make test testDenoise
+#include "testDenoise.h"
+#include "timings.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLES 16
+#define GRID_COLS 6
+#define GRID_ROWS 5
+#define OBJECT_COUNT (1 + GRID_COLS * GRID_ROWS) // plane + cubes
+#define PHASES (SECONDARY_RESOLUTION * SECONDARY_RESOLUTION)
+#define MAX_ERROR_RATIO 0.5 // denoised error must be at most this fraction of the raw error
+
+static void BuildScene(Object *objects, MaterialLib *lib) {
+	int idx = 0;
+	CreateCube(&objects[idx++], (float3){0.0f, -0.5f, 10.0f}, (float3){0.0f, 0.0f, 0.0f},
+			   (float3){80.0f, 1.0f, 80.0f}, (float3){0.32f, 0.34f, 0.38f}, lib, 0.0f, 0.9f, 0.0f);
+	for (int row = 0; row < GRID_ROWS; row++) {
+		for (int col = 0; col < GRID_COLS; col++) {
+			float3 color = {
+				0.2f + 0.8f * ((idx * 37) % 11) / 10.0f,
+				0.2f + 0.8f * ((idx * 53) % 11) / 10.0f,
+				0.2f + 0.8f * ((idx * 71) % 11) / 10.0f,
+			};
+			float emission = (idx % 7 == 0) ? 6.0f : 0.0f;
+			float roughness = 0.1f + 0.7f * ((idx * 13) % 5) / 4.0f;
+			float metallic = (idx % 3 == 0) ? 0.8f : 0.0f;
+			CreateCube(&objects[idx++], (float3){-20.0f + col * 8.0f, 1.0f, 2.0f + row * 8.0f},
+					   (float3){0.0f, 0.3f * col, 0.0f}, (float3){2.0f, 2.0f, 2.0f}, color, lib,
+					   emission, roughness, metallic);
+		}
+	}
+	for (int i = 0; i < OBJECT_COUNT; i++) {
+		objects[i].prevPostion = objects[i].position;
+		objects[i].prevRotation = objects[i].rotation;
+		objects[i].prevScale = objects[i].scale;
+	}
+}
+
+static float Seconds(struct timespec t0, struct timespec t1) {
+	return (float)(t1.tv_sec - t0.tv_sec) + (float)(t1.tv_nsec - t0.tv_nsec) * 1e-9f;
+}
+
+// Mean absolute step between horizontal neighbours on the same object: shadow (w) plus
+// emission and reflection luminance. Sample-and-hold along rows shows up as large steps,
+// an over-blurred signal as steps well below the reference's.
+static double RowRoughness(const Camera *camera, const float3 *emission, const float3 *reflection, int *nonFinite) {
+	int W = camera->screenWidth, H = camera->screenHeight;
+	double sum = 0.0;
+	long pairs = 0;
+	for (int y = 0; y < H; y++) {
+		for (int x = 0; x + 1 < W; x++) {
+			int i = y * W + x;
+			if (!isfinite(emission[i].x) || !isfinite(emission[i].w) || !isfinite(reflection[i].x)) (*nonFinite)++;
+			int id = camera->objectIdBuffer[i];
+			if (id < 0 || camera->objectIdBuffer[i + 1] != id) continue;
+			sum += fabsf(emission[i].w - emission[i + 1].w);
+			sum += fabsf(emission[i].x + emission[i].y + emission[i].z - emission[i + 1].x - emission[i + 1].y - emission[i + 1].z);
+			sum += fabsf(reflection[i].x + reflection[i].y + reflection[i].z - reflection[i + 1].x - reflection[i + 1].y - reflection[i + 1].z);
+			pairs++;
+		}
+	}
+	return pairs ? sum / pairs : 0.0;
+}
+
+// Gathers the traced secondary samples of one phase into the full-resolution reference.
+static void GatherReference(const Camera *camera, float3 *refEmission, float3 *refReflection, unsigned char *covered) {
+	int W = camera->screenWidth, H = camera->screenHeight;
+	int lowCount = ((W + SECONDARY_RESOLUTION - 1) / SECONDARY_RESOLUTION) * ((H + SECONDARY_RESOLUTION - 1) / SECONDARY_RESOLUTION);
+	for (int l = 0; l < lowCount; l++) {
+		int idx = camera->secondaryPixel[l];
+		if (idx < 0 || covered[idx]) continue;
+		refEmission[idx] = camera->secondaryEmission[l];
+		refReflection[idx] = camera->secondaryReflection[l];
+		covered[idx] = 1;
+	}
+}
+
+// Mean absolute error against the reference over covered object pixels: shadow (w) plus
+// emission and reflection summed over channels.
+static double SignalError(const Camera *camera, const float3 *emission, const float3 *reflection,
+						  const float3 *refEmission, const float3 *refReflection, const unsigned char *covered) {
+	int n = camera->screenWidth * camera->screenHeight;
+	double sum = 0.0;
+	long count = 0;
+	for (int i = 0; i < n; i++) {
+		if (!covered[i] || camera->objectIdBuffer[i] < 0) continue;
+		sum += fabsf(emission[i].w - refEmission[i].w);
+		sum += fabsf(emission[i].x + emission[i].y + emission[i].z - refEmission[i].x - refEmission[i].y - refEmission[i].z);
+		sum += fabsf(reflection[i].x + reflection[i].y + reflection[i].z - refReflection[i].x - refReflection[i].y - refReflection[i].z);
+		count++;
+	}
+	return count ? sum / count : 0.0;
+}
+
+int main(void) {
+	Object *objects = malloc(sizeof(Object) * OBJECT_COUNT);
+	if (!objects) {
+		fprintf(stderr, "Failed to allocate objects\n");
+		return 1;
+	}
+	MaterialLib matLib;
+	MaterialLib_Init(&matLib, 256);
+	BuildScene(objects, &matLib);
+	MaterialTable matTable;
+	MaterialTable_Init(&matTable);
+	MaterialTable_Sync(&matTable, &matLib);
+
+	Skybox skybox;
+	LoadSkybox(&skybox, "skybox");
+
+	ThreadPool *pool = poolCreate(32, WIDTH);
+	if (!pool) {
+		fprintf(stderr, "Failed to create thread pool\n");
+		return 1;
+	}
+	RayTraceTaskQueue rayTaskQueue;
+	Denoiser denoiser;
+	Denoiser_Init(&denoiser, WIDTH, HEIGHT);
+	if (!denoiser.tasks) {
+		fprintf(stderr, "Failed to allocate denoiser\n");
+		return 1;
+	}
+
+	Camera camera;
+	initCamera(&camera, WIDTH, HEIGHT, 90.0f, (float3){0.0f, 2.0f, -7.0f},
+			   (float3){0.0f, -0.15f, 1.0f}, (float3){6.0f, 8.0f, -6.0f});
+	RenderSetup(objects, OBJECT_COUNT, &camera);
+	ComputePrevCameraPos(&camera);
+
+	printf("=== testDenoise: plane + %d cubes, %dx%d, %d samples ===\n", GRID_COLS * GRID_ROWS, WIDTH, HEIGHT, SAMPLES);
+
+	size_t signalBytes = (size_t)WIDTH * HEIGHT * sizeof(float3);
+	float3 *rawEmission = malloc(signalBytes);
+	float3 *rawReflection = malloc(signalBytes);
+	float3 *refEmission = calloc(1, signalBytes);
+	float3 *refReflection = calloc(1, signalBytes);
+	unsigned char *covered = calloc((size_t)WIDTH * HEIGHT, 1);
+	if (!rawEmission || !rawReflection || !refEmission || !refReflection || !covered) {
+		fprintf(stderr, "Failed to allocate signal buffers\n");
+		return 1;
+	}
+
+	// reference: the scene is static, so the phases together trace every pixel once
+	for (int phase = 0; phase < PHASES; phase++) {
+		RayTraceVisibility(objects, OBJECT_COUNT, &camera, &rayTaskQueue, pool);
+		RayTraceShadeSignals(objects, OBJECT_COUNT, &camera, &matTable, &rayTaskQueue, pool, &skybox, phase);
+		GatherReference(&camera, refEmission, refReflection, covered);
+	}
+
+	// baseline: row box blur
+	RayTraceVisibility(objects, OBJECT_COUNT, &camera, &rayTaskQueue, pool);
+	RayTraceShadeSignals(objects, OBJECT_COUNT, &camera, &matTable, &rayTaskQueue, pool, &skybox, 0);
+	memcpy(rawEmission, camera.emissionSignal, signalBytes);
+	memcpy(rawReflection, camera.reflectionSignal, signalBytes);
+	RayTraceComposite(&camera, &rayTaskQueue, pool, BLUR_RADIUS);
+	RayTracePackHdr(&camera, &rayTaskQueue, pool);
+	SaveImage("tests/img/denoise_rowblur.bmp", &camera);
+
+	float timesDenoise[SAMPLES];
+	for (int s = 0; s < SAMPLES; s++) {
+		RayTraceVisibility(objects, OBJECT_COUNT, &camera, &rayTaskQueue, pool);
+		RayTraceShadeSignals(objects, OBJECT_COUNT, &camera, &matTable, &rayTaskQueue, pool, &skybox, s);
+		struct timespec t0, t1;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		Denoiser_Run(&denoiser, &camera, pool);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		timesDenoise[s] = Seconds(t0, t1);
+		if (s + 1 < SAMPLES) RayTraceComposite(&camera, &rayTaskQueue, pool, 0);
+	}
+
+	int nonFinite = 0;
+	double rawRough = RowRoughness(&camera, rawEmission, rawReflection, &nonFinite);
+	double denoisedRough = RowRoughness(&camera, camera.emissionSignal, camera.reflectionSignal, &nonFinite);
+	int referenceNonFinite = 0;
+	double referenceRough = RowRoughness(&camera, refEmission, refReflection, &referenceNonFinite);
+	double rawError = SignalError(&camera, rawEmission, rawReflection, refEmission, refReflection, covered);
+	double denoisedError = SignalError(&camera, camera.emissionSignal, camera.reflectionSignal, refEmission, refReflection, covered);
+	RayTraceComposite(&camera, &rayTaskQueue, pool, 0);
+	RayTracePackHdr(&camera, &rayTaskQueue, pool);
+	SaveImage("tests/img/denoise_denoised.bmp", &camera);
+
+	PerformanceMetrics m = ComputePerformanceMetrics(timesDenoise, SAMPLES);
+	printf("Denoiser    median=%.3fms  p99=%.3fms\n", m.medianTime * 1e3f, m.p99Time * 1e3f);
+	printf("Row roughness raw=%.5f denoised=%.5f reference=%.5f  non-finite=%d\n", rawRough, denoisedRough, referenceRough, nonFinite);
+	printf("Error vs reference raw=%.5f denoised=%.5f (%.1f%%)\n", rawError, denoisedError, 100.0 * denoisedError / rawError);
+
+	free(rawEmission);
+	free(rawReflection);
+	free(refEmission);
+	free(refReflection);
+	free(covered);
+	Denoiser_Destroy(&denoiser);
+	poolDestroy(pool);
+	DestroySkybox(&skybox);
+	destroyCamera(&camera);
+	Scene_Destroy(objects, OBJECT_COUNT);
+	MaterialTable_Destroy(&matTable);
+	MaterialLib_Destroy(&matLib);
+
+	if (nonFinite > 0 || denoisedError > rawError * MAX_ERROR_RATIO) {
+		printf("Denoiser did not bring the secondary-ray signals closer to the reference.\n");
+		return 1;
+	}
+	printf("Correctness check passed.\n");
+	return 0;
+}
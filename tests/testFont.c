@@ -0,0 +1,173 @@
+// testFont.c — writes a synthetic glyph directory, loads it into the atlas and checks that
+// RenderText draws exactly what the per-character drawTileColorScaled path did, at several
+// scales and clipped against the right and bottom edges; text placed partly off the top-left
+// must match the same text drawn fully inside a larger buffer. Times HUD-style redraws of an
+// unchanged and of a changing string against the per-character path.
+// Compile with: make test testFont
+#include "testFont.h"
+#include "timings.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define CHARS_DIR "tests/img/testFontChars"
+#define W 480
+#define H 160
+#define PAD 32
+#define SAMPLES 16
+#define DRAWS 200 // RenderText calls per sample
+
+static float Seconds(struct timespec t0, struct timespec t1) {
+	return (float)(t1.tv_sec - t0.tv_sec) + (float)(t1.tv_nsec - t0.tv_nsec) * 1e-9f;
+}
+
+static uint32 Hash(uint32 x, uint32 y, uint32 salt) {
+	uint32 h = x * 0x9E3779B1u ^ y * 0x85EBCA77u ^ salt;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	return h ^ (h >> 13);
+}
+
+// printable ASCII, widths 5 to 10 so glyphs straddle 8-pixel blocks; tiles for the reference
+static int WriteGlyphs(Tile *tiles) {
+	mkdir("tests/img", 0755);
+	mkdir(CHARS_DIR, 0755);
+	for (int c = 33; c < 127; c++) {
+		uint32 width = 5 + c % 6, height = 12 + c % 3;
+		char path[256];
+		snprintf(path, sizeof(path), "%s/%d.bin", CHARS_DIR, c);
+		FILE *f = fopen(path, "wb");
+		if (!f) return 0;
+		fwrite(&width, sizeof(uint32), 1, f);
+		fwrite(&height, sizeof(uint32), 1, f);
+		uint32 *pixels = calloc((size_t)width * height, sizeof(uint32));
+		for (uint32 y = 0; y < height; y++) {
+			uint8 row[2] = {0, 0};
+			for (uint32 x = 0; x < width; x++) {
+				if (Hash(x, y, c) & 1) {
+					row[x / 8] |= (uint8)(0x80 >> (x % 8));
+					pixels[y * width + x] = 0xFFFFFFFFu;
+				}
+			}
+			fwrite(row, 1, (width + 7) / 8, f);
+		}
+		fclose(f);
+		tiles[c] = (Tile){width, height, pixels};
+	}
+	return 1;
+}
+
+static void RemoveGlyphs(void) {
+	for (int c = 33; c < 127; c++) {
+		char path[256];
+		snprintf(path, sizeof(path), "%s/%d.bin", CHARS_DIR, c);
+		remove(path);
+	}
+	rmdir(CHARS_DIR);
+}
+
+// RenderText as it was: one scaled tile draw per character.
+static void ReferenceText(uint32 *dst, int dstWidth, int dstHeight, const Tile *tiles, const char *text, int x, int y, float scale, uint32 color) {
+	int cursorX = x;
+	for (size_t i = 0; text[i] != '\0'; i++) {
+		Tile tile = tiles[(unsigned char)text[i]];
+		if (tile.pixels) {
+			drawTileColorScaled(dst, dstWidth, dstHeight, tile, cursorX, y, scale, scale, color);
+			cursorX += (int)((float)tile.width * scale);
+		} else {
+			cursorX += (int)(8.0f * scale);
+		}
+	}
+}
+
+static void Clear(uint32 *fb, int count) {
+	for (int i = 0; i < count; i++)
+		fb[i] = 0xFF102030u ^ (uint32)i;
+}
+
+int main(void) {
+	static Tile tiles[256];
+	if (!WriteGlyphs(tiles)) {
+		fprintf(stderr, "Failed to write %s\n", CHARS_DIR);
+		return 1;
+	}
+	struct Alphabet alphabet;
+	LoadAlphabet(&alphabet, CHARS_DIR);
+	RemoveGlyphs();
+
+	uint32 *fb = malloc(W * H * sizeof(uint32)), *ref = malloc(W * H * sizeof(uint32));
+	uint32 *big = malloc((W + PAD) * (H + PAD) * sizeof(uint32));
+	const char *strings[] = {"FPS: 59.9", "The quick brown fox, 0123456789!", "~{[|]}~ `@#$%^&*()_+", "1000m"};
+	const float scales[] = {1.0f, 1.75f, 0.9f, 2.5f, 0.7f, 3.0f}; // more than FONT_MAX_SIZES
+	int failures = 0, wrong = 0, cases = 0;
+	for (int pass = 0; pass < 2; pass++) { // the second pass draws from the caches
+		for (int s = 0; s < (int)(sizeof(scales) / sizeof(scales[0])); s++) {
+			for (int t = 0; t < 4; t++) {
+				const int pos[3][2] = {{20, 20}, {W - 60, 40}, {100, H - 9}};
+				for (int p = 0; p < 3; p++) {
+					Clear(fb, W * H);
+					Clear(ref, W * H);
+					RenderText(fb, W, H, &alphabet, strings[t], pos[p][0], pos[p][1], scales[s], 0xFFFF8033u);
+					ReferenceText(ref, W, H, tiles, strings[t], pos[p][0], pos[p][1], scales[s], 0xFFFF8033u);
+					wrong += memcmp(fb, ref, W * H * sizeof(uint32)) != 0;
+					cases++;
+				}
+			}
+		}
+	}
+	printf("Atlas text vs per-character tiles: %d of %d cases differ\n", wrong, cases);
+	if (wrong) failures++;
+
+	// partly off the top-left: the visible part matches the same text drawn inside a padded buffer
+	int clipWrong = 0;
+	Clear(fb, W * H);
+	Clear(big, (W + PAD) * (H + PAD));
+	for (int y = 0; y < H; y++)
+		for (int x = 0; x < W; x++)
+			big[(y + PAD) * (W + PAD) + x + PAD] = fb[y * W + x];
+	RenderText(fb, W, H, &alphabet, strings[1], -13, -7, 1.75f, 0xFF00FF00u);
+	RenderText(big, W + PAD, H + PAD, &alphabet, strings[1], PAD - 13, PAD - 7, 1.75f, 0xFF00FF00u);
+	for (int y = 0; y < H; y++)
+		clipWrong += memcmp(&fb[y * W], &big[(y + PAD) * (W + PAD) + PAD], W * sizeof(uint32)) != 0;
+	printf("Clipped at the top-left: %d rows differ\n", clipWrong);
+	if (clipWrong) failures++;
+
+	float perChar[SAMPLES], cached[SAMPLES], changing[SAMPLES];
+	char text[64];
+	for (int s = 0; s < SAMPLES; s++) {
+		struct timespec t0, t1, t2, t3;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (int i = 0; i < DRAWS; i++)
+			ReferenceText(fb, W, H, tiles, "FPS: 59.9", 20, 20, 1.75f, 0xFFFF8033u);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		for (int i = 0; i < DRAWS; i++)
+			RenderText(fb, W, H, &alphabet, "FPS: 59.9", 20, 20, 1.75f, 0xFFFF8033u);
+		clock_gettime(CLOCK_MONOTONIC, &t2);
+		for (int i = 0; i < DRAWS; i++) {
+			snprintf(text, sizeof(text), "FPS: %.1f", 30.0 + (s * DRAWS + i) * 0.1);
+			RenderText(fb, W, H, &alphabet, text, 20, 20, 1.75f, 0xFFFF8033u);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t3);
+		perChar[s] = Seconds(t0, t1) / DRAWS;
+		cached[s] = Seconds(t1, t2) / DRAWS;
+		changing[s] = Seconds(t2, t3) / DRAWS;
+	}
+	PerformanceMetrics mp = ComputePerformanceMetrics(perChar, SAMPLES);
+	PerformanceMetrics mc = ComputePerformanceMetrics(cached, SAMPLES);
+	PerformanceMetrics mn = ComputePerformanceMetrics(changing, SAMPLES);
+	printf("Per-character tiles median=%.2fus  p99=%.2fus\n", mp.medianTime * 1e6f, mp.p99Time * 1e6f);
+	printf("Cached layout       median=%.2fus  p99=%.2fus\n", mc.medianTime * 1e6f, mc.p99Time * 1e6f);
+	printf("Changing string     median=%.2fus  p99=%.2fus\n", mn.medianTime * 1e6f, mn.p99Time * 1e6f);
+
+	DestroyAlphabet(&alphabet);
+	for (int c = 0; c < 256; c++)
+		free((void *)tiles[c].pixels);
+	free(fb);
+	free(ref);
+	free(big);
+	if (failures) return 1;
+	printf("Correctness check passed.\n");
+	return 0;
+}
@@ -0,0 +1,10 @@
+#ifndef TEST_FONT_H
+#define TEST_FONT_H
+
+#include "../object/format.h"
+#include "../render/cpu/tile.h"
+#include "../render/cpu/font.h"
+
+// Built with: make test testFont
+
+#endif
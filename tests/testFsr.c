@@ -0,0 +1,263 @@
+// testFsr.c — checks the FSR1 upscaler: a flat image must stay flat, and upscaling a
+// 75% version of a synthetic edge pattern or of an anti-aliased deferred render must land
+// at least as close to the native one as plain bilinear does. Times EASU + RCAS, and a 75%
+// render plus FSR against a native render, and saves native / bilinear / FSR images.
+// Compile with: make test testFsr
+#include "testFsr.h"
+#include "timings.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLES 32
+#define OBJECT_COUNT 9 // plane + 8 cubes
+#define RENDER_SCALE 0.75f
+#define FRAME_SAMPLES 8
+#define REFERENCE_GRID 4 // jittered renders per axis averaged into the anti-aliased scene images
+
+static float Seconds(struct timespec t0, struct timespec t1) {
+	return (float)(t1.tv_sec - t0.tv_sec) + (float)(t1.tv_nsec - t0.tv_nsec) * 1e-9f;
+}
+
+static void BuildScene(Object *objects, MaterialLib *lib) {
+	CreateCube(&objects[0], (float3){0.0f, -0.5f, 10.0f}, (float3){0.0f, 0.0f, 0.0f},
+			   (float3){80.0f, 1.0f, 80.0f}, (float3){0.32f, 0.34f, 0.38f}, lib, 0.0f, 0.9f, 0.0f);
+	for (int i = 1; i < OBJECT_COUNT; i++) {
+		float3 color = {0.3f + 0.7f * ((i * 37) % 11) / 10.0f, 0.3f + 0.7f * ((i * 53) % 11) / 10.0f, 0.3f + 0.7f * ((i * 71) % 11) / 10.0f};
+		CreateCube(&objects[i], (float3){-12.0f + (i - 1) % 4 * 8.0f, 1.0f, 4.0f + (i - 1) / 4 * 8.0f},
+				   (float3){0.0f, 0.4f * i, 0.0f}, (float3){2.0f, 2.0f, 2.0f}, color, lib,
+				   (i % 3 == 0) ? 6.0f : 0.0f, 0.5f, 0.0f);
+	}
+	for (int i = 0; i < OBJECT_COUNT; i++) {
+		objects[i].prevPostion = objects[i].position;
+		objects[i].prevRotation = objects[i].rotation;
+		objects[i].prevScale = objects[i].scale;
+	}
+}
+
+static void RenderScene(Object *objects, MaterialTable *matTable, Camera *camera, RayTraceTaskQueue *queue, ThreadPool *pool, Skybox *skybox) {
+	RenderSetup(objects, OBJECT_COUNT, camera);
+	ComputePrevCameraPos(camera);
+	RayTraceSceneDeferred(objects, OBJECT_COUNT, camera, matTable, queue, pool, skybox);
+}
+
+// Box-filtered render: average of a stratified grid of jittered frames. Stands in for the
+// TAA-resolved frame FSR gets in the engine, and for a converged native image to compare to.
+static void RenderAntialiased(Object *objects, MaterialTable *matTable, Camera *camera, RayTraceTaskQueue *queue, ThreadPool *pool, Skybox *skybox, Color *out) {
+	int n = camera->screenWidth * camera->screenHeight;
+	float *sum = calloc((size_t)n * 3, sizeof(float));
+	if (!sum) return;
+	for (int sy = 0; sy < REFERENCE_GRID; sy++) {
+		for (int sx = 0; sx < REFERENCE_GRID; sx++) {
+			camera->jitter = (float2){(sx + 0.5f) / REFERENCE_GRID - 0.5f, (sy + 0.5f) / REFERENCE_GRID - 0.5f};
+			RenderScene(objects, matTable, camera, queue, pool, skybox);
+			for (int i = 0; i < n; i++) {
+				Color c = camera->framebuffer[i];
+				sum[i * 3 + 0] += (float)((c >> 16) & 0xFF);
+				sum[i * 3 + 1] += (float)((c >> 8) & 0xFF);
+				sum[i * 3 + 2] += (float)(c & 0xFF);
+			}
+		}
+	}
+	camera->jitter = (float2){0.0f, 0.0f};
+	const float inv = 1.0f / (REFERENCE_GRID * REFERENCE_GRID);
+	for (int i = 0; i < n; i++) {
+		out[i] = 0xFF000000u | (Color)(sum[i * 3] * inv + 0.5f) << 16 |
+				 (Color)(sum[i * 3 + 1] * inv + 0.5f) << 8 | (Color)(sum[i * 3 + 2] * inv + 0.5f);
+	}
+	free(sum);
+}
+
+// Reference upscale with the same pixel-centre mapping as EASU.
+static void UpscaleBilinear(const Color *src, int inW, int inH, Color *dst, int outW, int outH) {
+	float sx = (float)inW / outW, sy = (float)inH / outH;
+	for (int y = 0; y < outH; y++) {
+		float py = fmaxf((y + 0.5f) * sy - 0.5f, 0.0f);
+		int y0 = (int)py, y1 = y0 + 1 < inH ? y0 + 1 : inH - 1;
+		float fy = py - y0;
+		for (int x = 0; x < outW; x++) {
+			float px = fmaxf((x + 0.5f) * sx - 0.5f, 0.0f);
+			int x0 = (int)px, x1 = x0 + 1 < inW ? x0 + 1 : inW - 1;
+			float fx = px - x0;
+			Color c00 = src[y0 * inW + x0], c10 = src[y0 * inW + x1], c01 = src[y1 * inW + x0], c11 = src[y1 * inW + x1];
+			Color out = 0xFF000000u;
+			for (int shift = 0; shift <= 16; shift += 8) {
+				float a = ((c00 >> shift) & 0xFF) * (1.0f - fx) + ((c10 >> shift) & 0xFF) * fx;
+				float b = ((c01 >> shift) & 0xFF) * (1.0f - fx) + ((c11 >> shift) & 0xFF) * fx;
+				out |= (Color)(a * (1.0f - fy) + b * fy + 0.5f) << shift;
+			}
+			dst[y * outW + x] = out;
+		}
+	}
+}
+
+// Box-filtered (4x4 supersampled) rings and a rotated square in normalised coordinates,
+// so both resolutions see the same noise-free edges.
+static void RenderPattern(Color *dst, int w, int h) {
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			float sum = 0.0f;
+			for (int s = 0; s < 16; s++) {
+				float u = (x + ((s & 3) + 0.5f) * 0.25f) / w * 2.0f - 1.0f;
+				float v = ((y + ((s >> 2) + 0.5f) * 0.25f) / h * 2.0f - 1.0f) * h / w;
+				float r = sqrtf((u + 0.45f) * (u + 0.45f) + v * v);
+				float ru = 0.766f * (u - 0.45f) - 0.643f * v, rv = 0.643f * (u - 0.45f) + 0.766f * v;
+				int ring = ((int)(r * 24.0f) & 1) && r < 0.4f;
+				int square = fabsf(ru) < 0.25f && fabsf(rv) < 0.25f;
+				sum += (ring || square) ? 1.0f : 0.0f;
+			}
+			int c = (int)(30.0f + 200.0f * sum / 16.0f + 0.5f);
+			dst[y * w + x] = 0xFF000000u | (Color)c << 16 | (Color)c << 8 | (Color)c;
+		}
+	}
+}
+
+static double Psnr(const Color *a, const Color *b, int count) {
+	double sum = 0.0;
+	for (int i = 0; i < count; i++) {
+		for (int shift = 0; shift <= 16; shift += 8) {
+			int d = (int)((a[i] >> shift) & 0xFF) - (int)((b[i] >> shift) & 0xFF);
+			sum += d * d;
+		}
+	}
+	double mse = sum / (count * 3.0);
+	return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+int main(void) {
+	int inW = (int)(WIDTH * RENDER_SCALE), inH = (int)(HEIGHT * RENDER_SCALE);
+	ThreadPool *pool = poolCreate(32, WIDTH);
+	if (!pool) {
+		fprintf(stderr, "Failed to create thread pool\n");
+		return 1;
+	}
+	FsrUpscaler fsr;
+	Fsr_Init(&fsr, inW, inH, WIDTH, HEIGHT);
+	if (!fsr.tasks) {
+		fprintf(stderr, "Failed to allocate FSR buffers\n");
+		return 1;
+	}
+	Color *input = malloc(sizeof(Color) * inW * inH);
+	Color *output = malloc(sizeof(Color) * WIDTH * HEIGHT);
+	Color *bilinear = malloc(sizeof(Color) * WIDTH * HEIGHT);
+	Color *reference = malloc(sizeof(Color) * WIDTH * HEIGHT);
+
+	printf("=== testFsr: %dx%d -> %dx%d ===\n", inW, inH, WIDTH, HEIGHT);
+	int failures = 0;
+
+	// flat input must come out flat (EASU weights are normalised, RCAS lobe is zero)
+	for (int i = 0; i < inW * inH; i++)
+		input[i] = 0xFF6080A0u;
+	FsrUpscale(&fsr, input, output, pool);
+	int off = 0;
+	for (int i = 0; i < WIDTH * HEIGHT; i++) {
+		for (int shift = 0; shift <= 16; shift += 8) {
+			if (abs((int)((output[i] >> shift) & 0xFF) - (int)((0xFF6080A0u >> shift) & 0xFF)) > 1) {
+				off++;
+				break;
+			}
+		}
+	}
+	printf("Flat input, pixels changed: %d\n", off);
+	if (off) failures++;
+
+	// noise-free edges: EASU + RCAS should track the native pattern better than bilinear
+	RenderPattern(input, inW, inH);
+	RenderPattern(reference, WIDTH, HEIGHT);
+	FsrUpscale(&fsr, input, output, pool);
+	double psnrFsr = Psnr(output, reference, WIDTH * HEIGHT);
+	UpscaleBilinear(input, inW, inH, output, WIDTH, HEIGHT);
+	double psnrBilinear = Psnr(output, reference, WIDTH * HEIGHT);
+	printf("Pattern PSNR vs native: fsr=%.2f dB  bilinear=%.2f dB\n", psnrFsr, psnrBilinear);
+	if (psnrFsr < psnrBilinear) {
+		printf("FSR is further from the native pattern than bilinear.\n");
+		failures++;
+	}
+
+	Object *objects = malloc(sizeof(Object) * OBJECT_COUNT);
+	MaterialLib matLib;
+	MaterialLib_Init(&matLib, 64);
+	BuildScene(objects, &matLib);
+	MaterialTable matTable;
+	MaterialTable_Init(&matTable);
+	MaterialTable_Sync(&matTable, &matLib);
+	Skybox skybox;
+	LoadSkybox(&skybox, "skybox");
+	RayTraceTaskQueue rayTaskQueue;
+
+	Camera native, low;
+	initCamera(&native, WIDTH, HEIGHT, 90.0f, (float3){0.0f, 2.0f, -7.0f},
+			   (float3){0.0f, -0.15f, 1.0f}, (float3){6.0f, 8.0f, -6.0f});
+	initCamera(&low, inW, inH, 90.0f, (float3){0.0f, 2.0f, -7.0f},
+			   (float3){0.0f, -0.15f, 1.0f}, (float3){6.0f, 8.0f, -6.0f});
+	Color *nativeAA = malloc(sizeof(Color) * WIDTH * HEIGHT);
+	Color *lowAA = malloc(sizeof(Color) * inW * inH);
+	RenderAntialiased(objects, &matTable, &native, &rayTaskQueue, pool, &skybox, nativeAA);
+	RenderAntialiased(objects, &matTable, &low, &rayTaskQueue, pool, &skybox, lowAA);
+
+	// frame cost: tracing at RENDER_SCALE and upscaling against tracing every output pixel
+	float timesNative[FRAME_SAMPLES], timesScaled[FRAME_SAMPLES];
+	for (int s = 0; s < FRAME_SAMPLES; s++) {
+		struct timespec t0, t1, t2;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		RenderScene(objects, &matTable, &native, &rayTaskQueue, pool, &skybox);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		RenderScene(objects, &matTable, &low, &rayTaskQueue, pool, &skybox);
+		FsrUpscale(&fsr, low.framebuffer, output, pool);
+		clock_gettime(CLOCK_MONOTONIC, &t2);
+		timesNative[s] = Seconds(t0, t1);
+		timesScaled[s] = Seconds(t1, t2);
+	}
+	float times[SAMPLES];
+	for (int s = 0; s < SAMPLES; s++) {
+		struct timespec t0, t1;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		FsrUpscale(&fsr, lowAA, output, pool);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		times[s] = Seconds(t0, t1);
+	}
+	PerformanceMetrics m = ComputePerformanceMetrics(times, SAMPLES);
+	PerformanceMetrics mNative = ComputePerformanceMetrics(timesNative, FRAME_SAMPLES);
+	PerformanceMetrics mScaled = ComputePerformanceMetrics(timesScaled, FRAME_SAMPLES);
+	printf("FSR         median=%.3fms  p99=%.3fms\n", m.medianTime * 1e3f, m.p99Time * 1e3f);
+	printf("Frame       native median=%.3fms  %.0f%% + FSR median=%.3fms (%.2fx)\n", mNative.medianTime * 1e3f,
+		   RENDER_SCALE * 100.0f, mScaled.medianTime * 1e3f, mNative.medianTime / mScaled.medianTime);
+
+	// anti-aliased on both sides, so the edges compare like the pattern's
+	UpscaleBilinear(lowAA, inW, inH, bilinear, WIDTH, HEIGHT);
+	double sceneFsr = Psnr(output, nativeAA, WIDTH * HEIGHT);
+	double sceneBilinear = Psnr(bilinear, nativeAA, WIDTH * HEIGHT);
+	printf("Scene PSNR vs native:   fsr=%.2f dB  bilinear=%.2f dB\n", sceneFsr, sceneBilinear);
+	if (sceneFsr < sceneBilinear) {
+		printf("FSR is further from the native scene than bilinear.\n");
+		failures++;
+	}
+
+	memcpy(native.framebuffer, nativeAA, sizeof(Color) * WIDTH * HEIGHT);
+	SaveImage("tests/img/fsr_native.bmp", &native);
+	memcpy(native.framebuffer, bilinear, sizeof(Color) * WIDTH * HEIGHT);
+	SaveImage("tests/img/fsr_bilinear.bmp", &native);
+	memcpy(native.framebuffer, output, sizeof(Color) * WIDTH * HEIGHT);
+	SaveImage("tests/img/fsr_upscaled.bmp", &native);
+
+	Fsr_Destroy(&fsr);
+	poolDestroy(pool);
+	free(input);
+	free(output);
+	free(bilinear);
+	free(reference);
+	free(nativeAA);
+	free(lowAA);
+	DestroySkybox(&skybox);
+	destroyCamera(&native);
+	destroyCamera(&low);
+	Scene_Destroy(objects, OBJECT_COUNT);
+	MaterialTable_Destroy(&matTable);
+	MaterialLib_Destroy(&matLib);
+
+	if (failures) return 1;
+	printf("Correctness check passed.\n");
+	return 0;
+}
@@ -0,0 +1,404 @@
+// testLoadObj.c — writes a synthetic model file in the triangle record format and checks
+// that the mapped, bulk-decoding LoadObj produces exactly what the old per-field fread
+// loader did: vertices, normals, uvs, bounds and the material of every triangle. Times both.
+// The asset loader must put a proxy in the scene at once and later swap the model into the
+// same slot with the transform it was given meanwhile. A second, textured model checks streaming: LoadObj must return with a coarse level
+// resident that samples the right source texels, every level must end up matching the file,
+// and destroying a model mid-stream must be safe. Times first visibility against full res.
+// Material interning must match on fields alone, whatever the padding bytes hold, and stay
+// linear in the number of materials.
+// Compile with: make test testLoadObj
+#include "testLoadObj.h"
+#include "timings.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRIANGLES 200000
+#define MATERIALS 24
+#define RUN_LENGTH 1500 // triangles per material run, as a converted mesh groups them
+#define SAMPLES 8
+#define MODEL_PATH "tests/img/testLoadObj.bin"
+#define TEXTURED_PATH "tests/img/testLoadObjTextured.bin"
+#define INTERN_MATERIALS 100000 // distinct per-triangle colours
+#define INTERN_LINEAR 10000		// of those, interned by the linear-scan reference
+
+static float Seconds(struct timespec t0, struct timespec t1) {
+	return (float)(t1.tv_sec - t0.tv_sec) + (float)(t1.tv_nsec - t0.tv_nsec) * 1e-9f;
+}
+
+static float Rand(uint32 *seed) {
+	*seed = *seed * 1664525u + 1013904223u;
+	return (float)(*seed >> 8) / 16777216.0f;
+}
+
+static uint32 Hash(uint32 x, uint32 y, uint32 salt) {
+	uint32 h = x * 0x9E3779B1u ^ y * 0x85EBCA77u ^ salt;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	return h ^ (h >> 13);
+}
+
+// The texel the file holds at (x, y), in loaded form.
+static Texel SourceTexel(uint32 x, uint32 y) {
+	uint32 n = Hash(x, y, 2);
+	return (Texel){Hash(x, y, 1), 0xFF000000u | (n & 0xFFFFFF), (uint16)Hash(x, y, 3), 0};
+}
+
+static int WriteTexturedModel(const char *path) {
+	FILE *f = fopen(path, "wb");
+	if (!f) return 0;
+	uint32 header[4] = {(uint32)(16 + TEXTURE_FILE_BYTES + LOADOBJ_RECORD_SIZE), LOADOBJ_RECORD_SIZE, 1, 1};
+	fwrite(header, sizeof(uint32), 4, f);
+	uint8 *row = malloc(TEXTURE_SIZE * 4);
+	for (int map = 0; map < 3; map++) {
+		int bpp = map == 0 ? 4 : map == 1 ? 3 : 2;
+		for (uint32 y = 0; y < TEXTURE_SIZE; y++) {
+			for (uint32 x = 0; x < TEXTURE_SIZE; x++) {
+				Texel t = SourceTexel(x, y);
+				uint32 v = map == 0 ? t.color : map == 1 ? t.normal : t.material;
+				memcpy(row + x * bpp, &v, bpp);
+			}
+			fwrite(row, bpp, TEXTURE_SIZE, f);
+		}
+	}
+	free(row);
+	uint8 record[LOADOBJ_RECORD_SIZE] = {0};
+	float v[12] = {0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0};
+	memcpy(record, v, sizeof(v));
+	fwrite(record, 1, sizeof(record), f);
+	return fclose(f) == 0;
+}
+
+static int SameTexel(const Texel *a, Texel b) {
+	return a->color == b.color && a->normal == b.normal && a->material == b.material;
+}
+
+// Compares level l against the file at the texel nearest each level texel's centre; every
+// texel for the full-resolution level, a strided subset otherwise.
+static int CheckLevel(const Textures *tex, int l) {
+	int shift = TEXTURE_LEVEL_SHIFT * l, size = TEXTURE_SIZE >> shift, half = (1 << shift) >> 1;
+	int stride = l == 0 ? 1 : 7, wrong = 0;
+	for (int y = 0; y < size; y += stride)
+		for (int x = 0; x < size; x += stride)
+			if (!SameTexel(&tex->levels[l][Textures_TexelIndex(x, y, size)], SourceTexel((x << shift) + half, (y << shift) + half)))
+				wrong++;
+	return wrong;
+}
+
+static int WriteModel(const char *path) {
+	FILE *f = fopen(path, "wb");
+	if (!f) return 0;
+	uint32 header[4] = {16 + TRIANGLES * LOADOBJ_RECORD_SIZE, LOADOBJ_RECORD_SIZE, TRIANGLES, 0};
+	fwrite(header, sizeof(uint32), 4, f);
+	uint32 seed = 99u;
+	for (int i = 0; i < TRIANGLES; i++) {
+		uint8 record[LOADOBJ_RECORD_SIZE] = {0};
+		float *v = (float *)record;
+		for (int k = 0; k < 16; k++)
+			v[k] = (k & 3) == 3 ? 0.0f : Rand(&seed) * 40.0f - 20.0f;
+		int m = (i / RUN_LENGTH) % MATERIALS;
+		float mat[7] = {m / (float)MATERIALS, (m & 1) ? 1.0f : 0.0f, (m % 5 == 0) ? 2.0f : 0.0f, 0.2f + m * 0.03f, 0.5f, 1.0f - m * 0.04f, 0.0f};
+		memcpy(record + 64, mat, sizeof(mat));
+		uint16 *uv = (uint16 *)(record + 92);
+		for (int k = 0; k < 6; k++)
+			uv[k] = (uint16)(Rand(&seed) * 65535.0f);
+		fwrite(record, 1, sizeof(record), f);
+	}
+	return fclose(f) == 0;
+}
+
+// The loader before mapping: one fread per field, one material search per triangle. The
+// material is built with zeroed padding so the search dedupes the way it was meant to.
+static void LoadReference(const char *filename, Object *obj, MaterialLib *lib) {
+	FILE *file = fopen(filename, "rb");
+	uint32 header[4];
+	fread(header, sizeof(uint32), 4, file);
+	uint32 n = header[2];
+	obj->v1 = malloc(n * sizeof(float3));
+	obj->v2 = malloc(n * sizeof(float3));
+	obj->v3 = malloc(n * sizeof(float3));
+	obj->normals = malloc(n * sizeof(float3));
+	obj->materialIds = malloc(n * sizeof(int));
+	obj->uvs = malloc(n * sizeof(UvCords));
+	obj->triangleCount = n;
+	float3 BBmin = {FLT_MAX, FLT_MAX, FLT_MAX};
+	float3 BBmax = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+	for (uint32 i = 0; i < n; i++) {
+		float3 v1, v2, v3, normal, color;
+		float roughness, metallic, emission;
+		uint16 uv[6];
+		uint32 pad;
+		fread(&v1, sizeof(float3), 1, file);
+		fread(&v2, sizeof(float3), 1, file);
+		fread(&v3, sizeof(float3), 1, file);
+		UpdateBoundingBox(&BBmin, &BBmax, v1);
+		UpdateBoundingBox(&BBmin, &BBmax, v2);
+		UpdateBoundingBox(&BBmin, &BBmax, v3);
+		fread(&normal, sizeof(float3), 1, file);
+		fread(&roughness, sizeof(float), 1, file);
+		fread(&metallic, sizeof(float), 1, file);
+		fread(&emission, sizeof(float), 1, file);
+		fread(&color, sizeof(float3), 1, file);
+		for (int k = 0; k < 6; k++)
+			fread(&uv[k], sizeof(uint16), 1, file);
+		fread(&pad, sizeof(uint32), 1, file);
+		obj->v1[i] = v1;
+		obj->v2[i] = v2;
+		obj->v3[i] = v3;
+		obj->normals[i] = normal;
+		obj->uvs[i] = (UvCords){uv[0], uv[1], uv[2], uv[3], uv[4], uv[5]};
+		Material mat;
+		memset(&mat, 0, sizeof(mat));
+		mat.color = color;
+		mat.roughness = roughness;
+		mat.metallic = metallic;
+		mat.emission = emission;
+		obj->materialIds[i] = MaterialLib_FindOrAdd(lib, mat);
+	}
+	obj->BBmin = BBmin;
+	obj->BBmax = BBmax;
+	fclose(file);
+}
+
+static int SameFloat3(float3 a, float3 b) {
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+static int SameMaterial(const Material *a, const Material *b) {
+	return SameFloat3(a->color, b->color) && a->roughness == b->roughness && a->metallic == b->metallic &&
+		   a->emission == b->emission && a->textures == b->textures;
+}
+
+// The scan FindOrAdd used to do, compared field by field.
+static int LinearFindOrAdd(MaterialLib *lib, Material mat) {
+	for (int i = 0; i < lib->count; i++)
+		if (SameMaterial(&lib->entries[i], &mat)) return i;
+	return MaterialLib_Add(lib, mat);
+}
+
+// mats[i] with every padding byte (color.w and the tail) set to fill.
+static Material Repadded(const Material *mat, int fill) {
+	Material out;
+	memset(&out, fill, sizeof(out));
+	out.color.x = mat->color.x;
+	out.color.y = mat->color.y;
+	out.color.z = mat->color.z;
+	out.roughness = mat->roughness;
+	out.metallic = mat->metallic;
+	out.emission = mat->emission;
+	out.textures = mat->textures;
+	return out;
+}
+
+// Every distinct material is interned twice, the second time with different padding bytes,
+// which must find the first. packMaterials must fold duplicates onto the lowest index.
+static int TestInterning(void) {
+	Material *mats = malloc(INTERN_MATERIALS * sizeof(Material));
+	int *ids = malloc(2 * INTERN_MATERIALS * sizeof(int));
+	uint32 seed = 11;
+	for (int i = 0; i < INTERN_MATERIALS; i++)
+		mats[i] = Repadded(&(Material){{(float)i / INTERN_MATERIALS, Rand(&seed), Rand(&seed)}, Rand(&seed), Rand(&seed), 0.0f, NULL}, 0);
+
+	struct timespec t0, t1, t2, t3;
+	MaterialLib lib;
+	MaterialLib_Init(&lib, 16);
+	int wrong = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (int i = 0; i < INTERN_MATERIALS; i++)
+		ids[i] = MaterialLib_FindOrAdd(&lib, mats[i]);
+	for (int i = 0; i < INTERN_MATERIALS; i++)
+		wrong += MaterialLib_FindOrAdd(&lib, Repadded(&mats[i], 0x5A)) != ids[i];
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (int i = 0; i < INTERN_MATERIALS; i++)
+		wrong += ids[i] < 0 || !SameMaterial(&lib.entries[ids[i]], &mats[i]);
+	int interned = lib.count;
+	MaterialLib_Destroy(&lib);
+
+	MaterialLib_Init(&lib, 16);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	for (int pass = 0; pass < 2; pass++)
+		for (int i = 0; i < INTERN_LINEAR; i++)
+			LinearFindOrAdd(&lib, Repadded(&mats[i], pass ? 0x5A : 0));
+	clock_gettime(CLOCK_MONOTONIC, &t3);
+	MaterialLib_Destroy(&lib);
+
+	// duplicates added without interning
+	MaterialLib_Init(&lib, 16);
+	for (int i = 0; i < 2 * INTERN_LINEAR; i++)
+		ids[i] = MaterialLib_Add(&lib, Repadded(&mats[i % INTERN_LINEAR], i < INTERN_LINEAR ? 0 : 0x5A));
+	packMaterials(ids, 2 * INTERN_LINEAR, &lib);
+	int unpacked = 0;
+	for (int i = 0; i < 2 * INTERN_LINEAR; i++)
+		unpacked += ids[i] != i % INTERN_LINEAR;
+	MaterialLib_Destroy(&lib);
+	free(mats);
+	free(ids);
+
+	printf("Interning: %d materials (expected %d), %d lookups wrong, %d ids left unpacked\n", interned, INTERN_MATERIALS, wrong, unpacked);
+	printf("Interning twice: hashed %.3fms for %d materials, linear scan %.3fms for %d\n", Seconds(t0, t1) * 1e3f, INTERN_MATERIALS,
+		   Seconds(t2, t3) * 1e3f, INTERN_LINEAR);
+	return interned == INTERN_MATERIALS && !wrong && !unpacked;
+}
+
+int main(void) {
+	printf("=== testLoadObj: %d triangles, %d materials ===\n", TRIANGLES, MATERIALS);
+	if (!WriteModel(MODEL_PATH)) {
+		fprintf(stderr, "Failed to write %s\n", MODEL_PATH);
+		return 1;
+	}
+
+	Object ref = {0}, obj = {0};
+	MaterialLib refLib, lib;
+	MaterialLib_Init(&refLib, 16);
+	MaterialLib_Init(&lib, 16);
+	LoadReference(MODEL_PATH, &ref, &refLib);
+	LoadObj(MODEL_PATH, &obj, &lib);
+	if (!obj.v1 || obj.triangleCount != TRIANGLES) {
+		fprintf(stderr, "LoadObj failed\n");
+		return 1;
+	}
+
+	int failures = 0, mismatched = 0, wrongMaterial = 0;
+	for (int i = 0; i < TRIANGLES; i++) {
+		if (memcmp(&obj.v1[i], &ref.v1[i], sizeof(float3)) || memcmp(&obj.v2[i], &ref.v2[i], sizeof(float3)) ||
+			memcmp(&obj.v3[i], &ref.v3[i], sizeof(float3)) || memcmp(&obj.normals[i], &ref.normals[i], sizeof(float3)) ||
+			memcmp(&obj.uvs[i], &ref.uvs[i], sizeof(UvCords)))
+			mismatched++;
+		const Material *a = &lib.entries[obj.materialIds[i]], *b = &refLib.entries[ref.materialIds[i]];
+		if (!SameFloat3(a->color, b->color) || a->roughness != b->roughness || a->metallic != b->metallic || a->emission != b->emission)
+			wrongMaterial++;
+	}
+	printf("Triangles differing from reference: %d, wrong material: %d, materials %d (reference %d)\n", mismatched, wrongMaterial, lib.count, refLib.count);
+	// one search per run at most
+	if (mismatched || wrongMaterial || lib.count > (TRIANGLES + RUN_LENGTH - 1) / RUN_LENGTH) failures++;
+	int boundsMatch = SameFloat3(obj.BBmin, ref.BBmin) && SameFloat3(obj.BBmax, ref.BBmax);
+	printf("Bounds (%.3f %.3f %.3f) - (%.3f %.3f %.3f) %s\n", obj.BBmin.x, obj.BBmin.y, obj.BBmin.z, obj.BBmax.x, obj.BBmax.y, obj.BBmax.z, boundsMatch ? "match" : "DIFFER");
+	if (!boundsMatch) failures++;
+	Object_Destroy(&ref);
+	Object_Destroy(&obj);
+	MaterialLib_Destroy(&refLib);
+	MaterialLib_Destroy(&lib);
+
+	float mapped[SAMPLES], freads[SAMPLES];
+	for (int s = 0; s < SAMPLES; s++) {
+		struct timespec t0, t1;
+		Object o = {0};
+		MaterialLib l;
+		MaterialLib_Init(&l, 16);
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		LoadObj(MODEL_PATH, &o, &l);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		mapped[s] = Seconds(t0, t1);
+		Object_Destroy(&o);
+		MaterialLib_Destroy(&l);
+
+		o = (Object){0};
+		MaterialLib_Init(&l, 16);
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		LoadReference(MODEL_PATH, &o, &l);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		freads[s] = Seconds(t0, t1);
+		Object_Destroy(&o);
+		MaterialLib_Destroy(&l);
+	}
+	// background loading into a scene
+	ObjectList scene;
+	ObjectList_Init(&scene, 1);
+	MaterialLib sceneLib;
+	MaterialLib_Init(&sceneLib, 16);
+	AssetLoader assets;
+	AssetLoader_Init(&assets);
+	float3 one = {1.0f, 1.0f, 1.0f}, zero = {0.0f, 0.0f, 0.0f};
+	struct timespec r0, r1, r2;
+	clock_gettime(CLOCK_MONOTONIC, &r0);
+	int slot = AssetLoader_Request(&assets, MODEL_PATH, &scene, &sceneLib, (float3){1.0f, 2.0f, 3.0f}, zero, one);
+	clock_gettime(CLOCK_MONOTONIC, &r1);
+	int proxyOk = slot >= 0 && scene.objects[slot].triangleCount == 12 && scene.objects[slot].bvh.nodeCount > 0;
+	scene.objects[slot].position = (float3){4.0f, 5.0f, 6.0f}; // moved by the network meanwhile
+	AssetLoader_Flush(&assets, &scene, &sceneLib);
+	clock_gettime(CLOCK_MONOTONIC, &r2);
+	Object *loaded = &scene.objects[slot];
+	int swapped = loaded->triangleCount == TRIANGLES && loaded->bvh.nodeCount > 0 && loaded->position.x == 4.0f && loaded->position.z == 6.0f;
+	for (int i = 0; swapped && i < TRIANGLES; i++)
+		swapped = loaded->materialIds[i] >= 0 && loaded->materialIds[i] < sceneLib.count;
+	// a second spawn of the same model gets a proxy of its real bounds
+	int second = AssetLoader_Request(&assets, MODEL_PATH, &scene, &sceneLib, zero, zero, one);
+	int sized = second >= 0 && SameFloat3(scene.objects[second].BBmin, scene.objects[slot].BBmin) && SameFloat3(scene.objects[second].BBmax, scene.objects[slot].BBmax);
+	AssetLoader_Flush(&assets, &scene, &sceneLib);
+	printf("Asset loader: proxy %s in %.3fms, model swapped in %s after %.3fms, second proxy %s\n", proxyOk ? "placed" : "MISSING",
+		   Seconds(r0, r1) * 1e3f, swapped ? "correctly" : "WRONG", Seconds(r0, r2) * 1e3f, sized ? "sized to the model" : "WRONG SIZE");
+	if (!proxyOk || !swapped || !sized) failures++;
+	AssetLoader_Destroy(&assets);
+	ObjectList_Destroy(&scene);
+	MaterialLib_Destroy(&sceneLib);
+
+	remove(MODEL_PATH);
+	PerformanceMetrics mm = ComputePerformanceMetrics(mapped, SAMPLES);
+	PerformanceMetrics mf = ComputePerformanceMetrics(freads, SAMPLES);
+	printf("Mapped loader  median=%.3fms  p99=%.3fms\n", mm.medianTime * 1e3f, mm.p99Time * 1e3f);
+	printf("Fread loader   median=%.3fms  p99=%.3fms\n", mf.medianTime * 1e3f, mf.p99Time * 1e3f);
+
+	// streamed textures
+	if (!WriteTexturedModel(TEXTURED_PATH)) {
+		fprintf(stderr, "Failed to write %s\n", TEXTURED_PATH);
+		return 1;
+	}
+	float visible[SAMPLES], complete[SAMPLES];
+	for (int s = 0; s < SAMPLES; s++) {
+		struct timespec t0, t1, t2;
+		Object o = {0};
+		MaterialLib l;
+		MaterialLib_Init(&l, 16);
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		LoadObj(TEXTURED_PATH, &o, &l);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		Textures *tex = o.triangleCount ? l.entries[o.materialIds[0]].textures : NULL;
+		if (!o.hasTexture || !tex) {
+			fprintf(stderr, "Textured model loaded without textures\n");
+			return 1;
+		}
+		int resident = atomic_load(&tex->resident);
+		if (s == 0) {
+			int wrong = CheckLevel(tex, resident);
+			printf("On return: level %d resident (%d texels), %d wrong\n", resident, TEXTURE_SIZE >> (TEXTURE_LEVEL_SHIFT * resident), wrong);
+			if (wrong) failures++;
+		}
+		MaterialLib_WaitTextures(&l);
+		clock_gettime(CLOCK_MONOTONIC, &t2);
+		visible[s] = Seconds(t0, t1);
+		complete[s] = Seconds(t0, t2);
+		if (s == 0) {
+			int wrong = 0;
+			for (int level = 0; level < TEXTURE_LEVELS; level++)
+				wrong += tex->levels[level] ? CheckLevel(tex, level) : 1;
+			resident = atomic_load(&tex->resident);
+			printf("After streaming: level %d resident, %d wrong texels over all levels\n", resident, wrong);
+			if (wrong || resident != 0) failures++;
+		}
+		Object_Destroy(&o);
+		MaterialLib_Destroy(&l);
+	}
+	// destroyed while the finer levels are still streaming
+	for (int s = 0; s < 4; s++) {
+		Object o = {0};
+		MaterialLib l;
+		MaterialLib_Init(&l, 16);
+		LoadObj(TEXTURED_PATH, &o, &l);
+		Object_Destroy(&o);
+		MaterialLib_Destroy(&l);
+	}
+	printf("Destroyed mid-stream without waiting\n");
+	remove(TEXTURED_PATH);
+	PerformanceMetrics mv = ComputePerformanceMetrics(visible, SAMPLES);
+	PerformanceMetrics mc = ComputePerformanceMetrics(complete, SAMPLES);
+	printf("Textured visible median=%.3fms  p99=%.3fms\n", mv.medianTime * 1e3f, mv.p99Time * 1e3f);
+	printf("Full resolution  median=%.3fms  p99=%.3fms\n", mc.medianTime * 1e3f, mc.p99Time * 1e3f);
+
+	if (!TestInterning()) failures++;
+
+	if (failures) return 1;
+	printf("Correctness check passed.\n");
+	return 0;
+}
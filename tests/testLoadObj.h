@@ -0,0 +1,13 @@
+#ifndef TEST_LOADOBJ_H
+#define TEST_LOADOBJ_H
+
+#include "../object/format.h"
+#include "../object/object.h"
+#include "../object/material/material.h"
+#include "../load/loadObj.h"
+#include "../load/assetLoader.h"
+#include "../util/bbox.h"
+
+// Built with: make test testLoadObj
+
+#endif
@@ -0,0 +1,159 @@
+// testPost.c — checks the fused post chain on the half-float working buffer: the neutral
+// grade must reproduce 8-bit input exactly, a full grade must match a float reference of the
+// same stages within LUT error, and the dither must preserve the mean of a value that sits
+// between two 8-bit levels. Times the fused pass against the per-stage scalar chain it replaces.
+// Compile with: make test testPost
+#include "testPost.h"
+#include "timings.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLES 16
+
+static float Seconds(struct timespec t0, struct timespec t1) {
+	return (float)(t1.tv_sec - t0.tv_sec) + (float)(t1.tv_nsec - t0.tv_nsec) * 1e-9f;
+}
+
+static float Clamp01(float v) {
+	return fminf(fmaxf(v, 0.0f), 1.0f);
+}
+
+// Scalar float version of every stage, no LUT.
+static float3 Reference(const PostParams *p, Color c) {
+	float e = exp2f(p->exposure), iw2 = 1.0f / (p->whitePoint * p->whitePoint);
+	float v[3] = {((c >> 16) & 0xFF) / 255.0f * e, ((c >> 8) & 0xFF) / 255.0f * e, (c & 0xFF) / 255.0f * e};
+	float over = fmaxf(fmaxf(v[0], fmaxf(v[1], v[2])) - p->whitePoint, 0.0f);
+	for (int i = 0; i < 3; i++) {
+		v[i] += over;
+		v[i] = Clamp01(powf(Clamp01(v[i] * (1.0f + v[i] * iw2) / (1.0f + v[i])), 1.0f / p->gamma));
+	}
+	for (int i = 0; i < 3; i++)
+		v[i] = (v[i] - 0.5f) * p->contrast + 0.5f;
+	float gray = 0.299f * v[0] + 0.587f * v[1] + 0.114f * v[2];
+	for (int i = 0; i < 3; i++)
+		v[i] = Clamp01(v[i] * p->saturation + gray * (1.0f - p->saturation));
+	// HSV hue rotation
+	float mx = fmaxf(v[0], fmaxf(v[1], v[2])), mn = fminf(v[0], fminf(v[1], v[2])), d = mx - mn;
+	if (d >= 1e-5f) {
+		float h = mx == v[0] ? (v[1] - v[2]) / d + (v[1] < v[2] ? 6.0f : 0.0f) : mx == v[1] ? (v[2] - v[0]) / d + 2.0f
+																						   : (v[0] - v[1]) / d + 4.0f;
+		h = h / 6.0f + p->hueShift;
+		h -= floorf(h);
+		int s = (int)(h * 6.0f);
+		float f = h * 6.0f - s, q = mx - f * d, t = mn + f * d;
+		float rgb[6][3] = {{mx, t, mn}, {q, mx, mn}, {mn, mx, t}, {mn, q, mx}, {t, mn, mx}, {mx, mn, q}};
+		v[0] = rgb[s % 6][0];
+		v[1] = rgb[s % 6][1];
+		v[2] = rgb[s % 6][2];
+	}
+	return (float3){Clamp01(v[0] * p->tint.x) * 255.0f, Clamp01(v[1] * p->tint.y) * 255.0f, Clamp01(v[2] * p->tint.z) * 255.0f};
+}
+
+int main(void) {
+	ThreadPool *pool = poolCreate(32, WIDTH);
+	int n = WIDTH * HEIGHT;
+	Color *src = malloc(sizeof(Color) * n);
+	Color *dst = malloc(sizeof(Color) * n);
+	half4 *hdr = malloc(sizeof(half4) * n);
+	if (!pool || !src || !dst || !hdr) {
+		fprintf(stderr, "Failed to allocate\n");
+		return 1;
+	}
+	uint32 seed = 12345u;
+	for (int i = 0; i < n; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		src[i] = 0xFF000000u | (seed >> 8);
+		float3 c = UnpackColor(src[i]);
+		hdr[i] = PackHalf4(c.x, c.y, c.z);
+	}
+
+	printf("=== testPost: %dx%d, %d^3 LUT ===\n", WIDTH, HEIGHT, POST_LUT_SIZE);
+	int failures = 0;
+	PostChain post;
+
+	// neutral grade, no dither: exact identity
+	PostParams params = Post_DefaultParams();
+	params.ditherAmplitude = 0.0f;
+	Post_Init(&post, WIDTH, HEIGHT, &params);
+	if (!post.tasks) {
+		fprintf(stderr, "Failed to allocate post chain\n");
+		return 1;
+	}
+	PostProcess(&post, hdr, dst, pool, 0);
+	int changed = 0;
+	for (int i = 0; i < n; i++)
+		if (dst[i] != src[i]) changed++;
+	printf("Neutral grade, pixels changed: %d\n", changed);
+	if (changed) failures++;
+
+	// full grade against the float reference
+	params = (PostParams){.exposure = 0.5f, .whitePoint = 2.0f, .gamma = 1.1f, .contrast = 1.1f, .saturation = 1.2f, .hueShift = 0.05f, .tint = {1.0f, 0.95f, 0.9f, 0.0f}, .ditherAmplitude = 0.0f};
+	Post_SetParams(&post, &params);
+	PostProcess(&post, hdr, dst, pool, 0);
+	double sumErr = 0.0;
+	float maxErr = 0.0f;
+	for (int i = 0; i < n; i++) {
+		float3 ref = Reference(&params, src[i]);
+		float err = fmaxf(fabsf(((dst[i] >> 16) & 0xFF) - ref.x), fmaxf(fabsf(((dst[i] >> 8) & 0xFF) - ref.y), fabsf((dst[i] & 0xFF) - ref.z)));
+		sumErr += err;
+		if (err > maxErr) maxErr = err;
+	}
+	printf("Graded vs float reference: mean %.3f LSB, max %.2f LSB\n", sumErr / n, maxErr);
+	if (sumErr / n > 1.0 || maxErr > 8.0f) failures++;
+
+	// dither keeps the mean of 128.3 instead of rounding everything to 128
+	params = Post_DefaultParams();
+	Post_SetParams(&post, &params);
+	half4 *flat = malloc(sizeof(half4) * n);
+	for (int i = 0; i < n; i++)
+		flat[i] = PackHalf4(128.3f / 255.0f, 128.3f / 255.0f, 128.3f / 255.0f);
+	double target = UnpackHalf4(flat[0]).y * 255.0; // 128.3 as stored in half precision
+	PostProcess(&post, flat, dst, pool, 7);
+	free(flat);
+	double mean = 0.0;
+	for (int i = 0; i < n; i++)
+		mean += (dst[i] >> 8) & 0xFF;
+	mean /= n;
+	printf("Dithered mean of %.3f: %.3f\n", target, mean);
+	if (fabs(mean - target) > 0.05) failures++;
+
+	// timing: fused pass vs the per-stage scalar chain
+	params = (PostParams){.exposure = 0.25f, .whitePoint = 1.5f, .gamma = 1.0f, .contrast = 1.05f, .saturation = 1.1f, .hueShift = 0.0f, .tint = {1.0f, 1.0f, 1.0f, 0.0f}, .ditherAmplitude = 1.0f};
+	Post_SetParams(&post, &params);
+	float fused[SAMPLES], chained[SAMPLES];
+	Camera camera;
+	initCamera(&camera, WIDTH, HEIGHT, 90.0f, (float3){0.0f, 0.0f, 0.0f}, (float3){0.0f, 0.0f, 1.0f}, (float3){0.0f, 1.0f, 0.0f});
+	for (int s = 0; s < SAMPLES; s++) {
+		struct timespec t0, t1;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		PostProcess(&post, hdr, dst, pool, s);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		fused[s] = Seconds(t0, t1);
+
+		memcpy(camera.framebuffer, src, sizeof(Color) * n);
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (int i = 0; i < n; i++)
+			camera.framebuffer[i] = ApplyColorCorrection(camera.framebuffer[i], 1.0f, 0.25f, 1.05f, 1.1f, 0.0f, (float3){1.0f, 1.0f, 1.0f});
+		DitherPostProcess(&camera, s);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		chained[s] = Seconds(t0, t1);
+	}
+	PerformanceMetrics mf = ComputePerformanceMetrics(fused, SAMPLES);
+	PerformanceMetrics mc = ComputePerformanceMetrics(chained, SAMPLES);
+	printf("Fused post  median=%.3fms  p99=%.3fms\n", mf.medianTime * 1e3f, mf.p99Time * 1e3f);
+	printf("Scalar chain median=%.3fms  p99=%.3fms\n", mc.medianTime * 1e3f, mc.p99Time * 1e3f);
+
+	Post_Destroy(&post);
+	destroyCamera(&camera);
+	poolDestroy(pool);
+	free(src);
+	free(dst);
+	free(hdr);
+
+	if (failures) return 1;
+	printf("Correctness check passed.\n");
+	return 0;
+}
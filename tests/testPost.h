@@ -0,0 +1,12 @@
+#ifndef TEST_POST_H
+#define TEST_POST_H
+
+#include "../util/threadPool.h"
+#include "../render/color/color.h"
+#include "../object/format.h"
+#include "../render/cpu/ray.h"
+#include "../render/cpu/post.h"
+
+// Built with: make test testPost
+
+#endif
@@ -12,7 +12,7 @@
 
 #define SKY_COLOR 0xFF5588BBu
 
-// Fills framebuffer, depthBuffer, normalBuffer, positionBuffer, reflectBuffer for one row.
+// Fills framebuffer, depthBuffer, normalBuffer, reflectBuffer for one row.
 static void RenderRow(const Object *objects, int objectCount, const MaterialLib *lib, Camera *camera, int row) {
 	int W = camera->screenWidth;
 	int H = camera->screenHeight;
@@ -69,9 +69,9 @@ static void RenderRow(const Object *objects, int objectCount, const MaterialLib
 		if (bestObj < 0) {
 			camera->framebuffer[idx] = SKY_COLOR;
 			camera->depthBuffer[idx] = DEPTH_FAR;
-			camera->normalBuffer[idx] = (float3){0};
-			camera->positionBuffer[idx] = (float3){0};
-			camera->reflectBuffer[idx] = (float3){dx, dy, dz};
+			camera->normalBuffer[idx] = 0;
+			camera->reflectBuffer[idx] = PackHalf4(dx, dy, dz);
+			camera->motionVectorBuffer[idx] = (float2){0.0f, 0.0f};
 			continue;
 		}
 
@@ -117,10 +117,10 @@ static void RenderRow(const Object *objects, int objectCount, const MaterialLib
 		camera->framebuffer[idx] = 0xFF000000u | ((uint32)r << 16) | ((uint32)g << 8) | b;
 		// Store view-Z (dot with forward) so SSR depth comparison is consistent
 		camera->depthBuffer[idx] = (bestHit.x - orig.x) * fwd.x + (bestHit.y - orig.y) * fwd.y + (bestHit.z - orig.z) * fwd.z;
-		camera->normalBuffer[idx] = n;
-		camera->positionBuffer[idx] = bestHit;
+		camera->normalBuffer[idx] = PackNormal(n);
 		// w stores (1-roughness) so SSR knows per-pixel reflectivity
-		camera->reflectBuffer[idx] = (float3){reflDir.x, reflDir.y, reflDir.z, 1.0f - roughness};
+		camera->reflectBuffer[idx] = PackHalf4W(reflDir.x, reflDir.y, reflDir.z, 1.0f - roughness);
+		camera->motionVectorBuffer[idx] = (float2){0.0f, 0.0f}; // static scene and camera
 	}
 }
 
@@ -138,6 +138,7 @@ static void RenderTaskFunc(void *arg) {
 }
 
 static void RenderSceneParallel(const Object *objects, int objectCount, const MaterialLib *lib, Camera *camera, ThreadPool *pool, RenderTask *tasks) {
+	Camera_Require(camera, CAMERA_NORMAL | CAMERA_REFLECT | CAMERA_MOTION);
 	for (int row = 0; row < camera->screenHeight; row++) {
 		tasks[row] = (RenderTask){objects, objectCount, lib, camera, row};
 		poolAdd(pool, RenderTaskFunc, &tasks[row]);
@@ -146,24 +147,20 @@ static void RenderSceneParallel(const Object *objects, int objectCount, const Ma
 }
 
 static void RunSSRMultiThreaded(const Object *objects, int objectCount, const MaterialLib *lib,
-								Camera *camera, ThreadPool *pool, RenderTask *renderTasks,
-								SSRTask *ssrTasks, int rowsPerTask) {
-	int height = camera->screenHeight;
-	int taskCount = (height + rowsPerTask - 1) / rowsPerTask;
-
+								Camera *camera, ThreadPool *pool, RenderTask *renderTasks, SSRContext *ssr) {
 	float timeTook[SAMPLES] = {0};
 	for (int i = 0; i < SAMPLES; i++) {
 		RenderSceneParallel(objects, objectCount, lib, camera, pool, renderTasks);
 		struct timespec t0, t1;
 		clock_gettime(CLOCK_MONOTONIC, &t0);
-		SSRPostProcess(camera, pool, ssrTasks, rowsPerTask);
+		SSRPostProcess(ssr, camera, pool, i);
 		clock_gettime(CLOCK_MONOTONIC, &t1);
 		timeTook[i] = (float)(t1.tv_sec - t0.tv_sec) + (float)(t1.tv_nsec - t0.tv_nsec) * 1e-9f;
 	}
 
 	PerformanceMetrics metrics = ComputePerformanceMetrics(timeTook, SAMPLES);
 	printf("========================================\n");
-	printf("SSR Multi-threaded (%d rows/task, %d tasks):\n", rowsPerTask, taskCount);
+	printf("SSR Multi-threaded (%d rows/task, Hi-Z %d levels):\n", SSR_ROWS_PER_TASK, SSR_HIZ_LEVELS);
 	printf("Average Time: %f seconds\n", metrics.averageTime);
 	printf("Median Time:  %f seconds\n", metrics.medianTime);
 	printf("Min Time:     %f seconds\n", metrics.minTime);
@@ -185,7 +182,7 @@ int main() {
 
 	// Wide flat floor — mirror-like (roughness set to 0.05 after creation)
 	CreateCube(&objects[0], (float3){0.0f, 0.0f, 12.0f, 0.0f}, (float3){0.0f}, (float3){40.0f, 0.15f, 40.0f, 0.0f}, (float3){0.30f, 0.32f, 0.36f, 0.0f}, &matLib, 0.0f, 1.0f, 0.0f);
-	matLib.entries[matLib.count - 1].roughness = 0.05f;
+	Object_SetRoughness(&objects[0], &matLib, 0.05f);
 
 	// Colored cubes above — these will appear in the floor reflection
 	CreateCube(&objects[1], (float3){-4.0f, 1.5f, 8.0f, 0.0f}, (float3){0.0f}, (float3){1.5f, 3.0f, 1.5f, 0.0f}, (float3){0.85f, 0.15f, 0.10f, 0.2f}, &matLib, 0.0f, 1.0f, 0.0f);
@@ -201,7 +198,8 @@ int main() {
 
 	ThreadPool *pool = poolCreate(32, camera.screenHeight);
 	RenderTask *renderTasks = malloc(sizeof(RenderTask) * camera.screenHeight);
-	SSRTask *ssrTasks = malloc(sizeof(SSRTask) * camera.screenHeight);
+	SSRContext ssr;
+	SSR_Init(&ssr, camera.screenWidth, camera.screenHeight);
 
 	RenderSetup(objects, objectCount, &camera);
 
@@ -215,7 +213,7 @@ int main() {
 		RenderSceneParallel(objects, objectCount, &matLib, &camera, pool, renderTasks);
 		struct timespec t0, t1;
 		clock_gettime(CLOCK_MONOTONIC, &t0);
-		SSRPostProcessSingleThreaded(&camera);
+		SSRPostProcessSingleThreaded(&ssr, &camera, i);
 		clock_gettime(CLOCK_MONOTONIC, &t1);
 		timeTook[i] = (float)(t1.tv_sec - t0.tv_sec) + (float)(t1.tv_nsec - t0.tv_nsec) * 1e-9f;
 	}
@@ -230,53 +228,55 @@ int main() {
 	printf("Variance:     %f\n", metrics.variance);
 	printf("99th Pct:     %f seconds\n", metrics.p99Time);
 
-	// Build reference (single-threaded) for correctness check
-	Camera camRef;
-	initCamera(&camRef, 800, 600, 75.0f, (float3){0.0f, 1.2f, -2.0f}, (float3){0.0f, -0.18f, 1.0f}, (float3){5.0f, 8.0f, -4.0f});
-	RenderSetup(objects, objectCount, &camRef);
-	RenderSceneParallel(objects, objectCount, &matLib, &camRef, pool, renderTasks);
-	SSRPostProcessSingleThreaded(&camRef);
-
-	// ── Multi-threaded SSR: sweep rows-per-task ───────────────────────────
+	// ── Multi-threaded SSR ────────────────────────────────────────────────
 	Camera camMT;
 	initCamera(&camMT, 800, 600, 75.0f, (float3){0.0f, 1.2f, -2.0f}, (float3){0.0f, -0.18f, 1.0f}, (float3){5.0f, 8.0f, -4.0f});
 	RenderSetup(objects, objectCount, &camMT);
-
-	static const int rowsPerTaskValues[] = {1, 2, 4, 16, 32, 64};
-	int testCount = (int)(sizeof(rowsPerTaskValues) / sizeof(rowsPerTaskValues[0]));
-	for (int t = 0; t < testCount; t++) {
-		RunSSRMultiThreaded(objects, objectCount, &matLib, &camMT, pool, renderTasks, ssrTasks, rowsPerTaskValues[t]);
-	}
+	SSR_Reset(&ssr);
+	RunSSRMultiThreaded(objects, objectCount, &matLib, &camMT, pool, renderTasks, &ssr);
 	printf("========================================\n");
 	SaveImage("tests/img/ssr_multi.bmp", &camMT);
 
-	// Correctness: final multi result (1-row tasks same as single-threaded scan order)
-	Camera camCheck;
+	// Correctness: same phases from a fresh history must match the single-threaded pass exactly,
+	// and the mirror floor must actually pick up reflections
+	Camera camRef, camCheck;
+	initCamera(&camRef, 800, 600, 75.0f, (float3){0.0f, 1.2f, -2.0f}, (float3){0.0f, -0.18f, 1.0f}, (float3){5.0f, 8.0f, -4.0f});
 	initCamera(&camCheck, 800, 600, 75.0f, (float3){0.0f, 1.2f, -2.0f}, (float3){0.0f, -0.18f, 1.0f}, (float3){5.0f, 8.0f, -4.0f});
+	RenderSetup(objects, objectCount, &camRef);
 	RenderSetup(objects, objectCount, &camCheck);
-	RenderSceneParallel(objects, objectCount, &matLib, &camCheck, pool, renderTasks);
-	SSRPostProcess(&camCheck, pool, ssrTasks, 1);
+	SSRContext ssrCheck;
+	SSR_Init(&ssrCheck, camCheck.screenWidth, camCheck.screenHeight);
+	SSR_Reset(&ssr);
+	for (int i = 0; i < 4; i++) {
+		RenderSceneParallel(objects, objectCount, &matLib, &camRef, pool, renderTasks);
+		SSRPostProcessSingleThreaded(&ssr, &camRef, i);
+		RenderSceneParallel(objects, objectCount, &matLib, &camCheck, pool, renderTasks);
+		SSRPostProcess(&ssrCheck, &camCheck, pool, i);
+	}
 
+	int status = 0;
+	int reflected = 0;
 	for (int i = 0; i < camRef.screenWidth * camRef.screenHeight; i++) {
 		if (camRef.framebuffer[i] != camCheck.framebuffer[i]) {
 			printf("Pixel %d mismatch: single = 0x%08X, multi = 0x%08X\n", i, camRef.framebuffer[i], camCheck.framebuffer[i]);
-			free(renderTasks);
-			free(ssrTasks);
-			poolDestroy(pool);
-			Scene_Destroy(objects, objectCount);
-			MaterialLib_Destroy(&matLib);
-			destroyCamera(&camera);
-			destroyCamera(&camRef);
-			destroyCamera(&camMT);
-			destroyCamera(&camCheck);
-			return 1;
+			status = 1;
+			break;
 		}
+		if (camRef.framebuffer[i] != camRef.tempFramebuffer[i]) reflected++;
+	}
+	printf("Reflected pixels: %d (%.2f%%)\n", reflected, 100.0f * reflected / (camRef.screenWidth * camRef.screenHeight));
+	if (reflected == 0) {
+		printf("No SSR hits on the mirror floor\n");
+		status = 1;
+	}
+	if (status == 0) {
+		printf("Correctness check passed.\n");
+		printf("Images saved: tests/img/ssr_base.bmp  tests/img/ssr_single.bmp  tests/img/ssr_multi.bmp\n");
 	}
-	printf("Correctness check passed.\n");
-	printf("Images saved: tests/img/ssr_base.bmp  tests/img/ssr_single.bmp  tests/img/ssr_multi.bmp\n");
 
 	free(renderTasks);
-	free(ssrTasks);
+	SSR_Destroy(&ssr);
+	SSR_Destroy(&ssrCheck);
 	poolDestroy(pool);
 	Scene_Destroy(objects, objectCount);
 	MaterialLib_Destroy(&matLib);
@@ -284,5 +284,5 @@ int main() {
 	destroyCamera(&camRef);
 	destroyCamera(&camMT);
 	destroyCamera(&camCheck);
-	return 0;
+	return status;
 }
@@ -0,0 +1,207 @@
+// testSkybox.c — checks the baked skybox: the bilinear level-0 lookup must agree with the
+// old nearest-texel face mapping, every prefiltered level must keep the average sky colour
+// while getting smoother, the roughest level must be continuous across face edges, and a
+// reload must map the cache and match the bake bit-for-bit. Times the parallel decode + bake,
+// the cached load and both lookups, and saves the front face of every level.
+// Compile with: make test testSkybox
+#include "testSkybox.h"
+#include "timings.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLES 16
+#define RAYS 65536
+
+static float Seconds(struct timespec t0, struct timespec t1) {
+	return (float)(t1.tv_sec - t0.tv_sec) + (float)(t1.tv_nsec - t0.tv_nsec) * 1e-9f;
+}
+
+// The pre-bake sampler: branchy face selection, nearest texel.
+static Color SampleNearest(const Skybox *skybox, float3 d) {
+	int w = skybox->imageWidth, h = skybox->imageHeight;
+	float ax = fabsf(d.x), ay = fabsf(d.y), az = fabsf(d.z);
+	const uint32 *face;
+	float u, v;
+	if (ax >= ay && ax >= az) {
+		face = d.x > 0 ? skybox->right : skybox->left;
+		u = 0.5f + 0.5f * (d.x > 0 ? -d.z : d.z) / ax;
+		v = 0.5f - 0.5f * d.y / ax;
+	} else if (ay >= az) {
+		face = d.y > 0 ? skybox->top : skybox->bottom;
+		u = 0.5f + 0.5f * d.x / ay;
+		v = 0.5f + 0.5f * (d.y > 0 ? d.z : -d.z) / ay;
+	} else {
+		face = d.z > 0 ? skybox->front : skybox->back;
+		u = 0.5f + 0.5f * (d.z > 0 ? d.x : -d.x) / az;
+		v = 0.5f - 0.5f * d.y / az;
+	}
+	int x = (int)(u * (float)(w - 1) + 0.5f), y = (int)(v * (float)(h - 1) + 0.5f);
+	x = x < 0 ? 0 : (x >= w ? w - 1 : x);
+	y = y < 0 ? 0 : (y >= h ? h - 1 : y);
+	return face[y * w + x];
+}
+
+static float ColorDiff(Color a, Color b) {
+	float d = 0.0f;
+	for (int shift = 0; shift <= 16; shift += 8)
+		d = fmaxf(d, fabsf((float)((a >> shift) & 0xFF) - (float)((b >> shift) & 0xFF)));
+	return d;
+}
+
+// Mean over every texel of a level.
+static float3 LevelMean(const SkyboxLevel *level) {
+	double sum[3] = {0.0, 0.0, 0.0};
+	size_t n = (size_t)SKYBOX_FACES * level->size * level->size;
+	for (size_t i = 0; i < n; i++) {
+		Color c = level->texels[i];
+		sum[0] += (c >> 16) & 0xFF;
+		sum[1] += (c >> 8) & 0xFF;
+		sum[2] += c & 0xFF;
+	}
+	return (float3){(float)(sum[0] / n), (float)(sum[1] / n), (float)(sum[2] / n), 0.0f};
+}
+
+// Mean colour change between directions a fixed small angle apart, at one roughness.
+static float AngularVariation(const Skybox *skybox, const float3 *rays, float roughness) {
+	double sum = 0.0;
+	for (int i = 0; i < RAYS; i++) {
+		float3 d = Float3_Normalize(rays[i]);
+		float3 t = Float3_Normalize(Float3_Cross((float3){0.0f, 1.0f, 0.0f}, d));
+		float3 o = Float3_Add(d, Float3_Scale(t, 0.02f));
+		sum += ColorDiff(SampleSkyboxRough(skybox, d, roughness), SampleSkyboxRough(skybox, o, roughness));
+	}
+	return (float)(sum / RAYS);
+}
+
+int main(void) {
+	int failures = 0;
+	struct timespec t0, t1;
+
+	remove("skybox/skybox.cache");
+	Skybox skybox;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	LoadSkybox(&skybox, "skybox");
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if (!skybox.texels) {
+		fprintf(stderr, "Failed to load skybox\n");
+		return 1;
+	}
+	printf("=== testSkybox: %d^2 base, %d levels ===\n", skybox.imageWidth, skybox.levelCount);
+	printf("Decode + bake: %.1f ms\n", Seconds(t0, t1) * 1e3f);
+
+	Skybox cached;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	LoadSkybox(&cached, "skybox");
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	printf("Cached load:   %.1f ms (%s)\n", Seconds(t0, t1) * 1e3f, cached.map ? "mapped" : "NOT MAPPED");
+	if (!cached.map) failures++;
+	size_t total = 0;
+	for (int l = 0; l < skybox.levelCount; l++)
+		total += (size_t)SKYBOX_FACES * skybox.levels[l].size * skybox.levels[l].size;
+	if (!cached.texels || cached.levelCount != skybox.levelCount || memcmp(cached.texels, skybox.texels, total * sizeof(Color))) {
+		printf("Cached skybox differs from the bake.\n");
+		failures++;
+	}
+	DestroySkybox(&cached);
+
+	float3 *rays = malloc(sizeof(float3) * RAYS);
+	Color *out = malloc(sizeof(Color) * RAYS);
+	uint32 seed = 12345u;
+	for (int i = 0; i < RAYS; i++) {
+		float c[3];
+		for (int k = 0; k < 3; k++) {
+			seed = seed * 1664525u + 1013904223u;
+			c[k] = (float)(seed >> 8) / (float)(1u << 24) * 2.0f - 1.0f;
+		}
+		rays[i] = (float3){c[0], c[1], c[2], 0.0f};
+	}
+
+	// level 0 against the old mapping: same faces and orientation, only the filter differs
+	double meanDiff = 0.0;
+	for (int i = 0; i < RAYS; i++)
+		meanDiff += ColorDiff(SampleSkybox(&skybox, rays[i]), SampleNearest(&skybox, rays[i]));
+	meanDiff /= RAYS;
+	printf("Bilinear vs nearest, mean max-channel diff: %.2f LSB\n", meanDiff);
+	if (meanDiff > 3.0) failures++;
+
+	// prefiltered levels keep the average colour and get smoother; roughness r_l selects level l
+	float3 mean0 = LevelMean(&skybox.levels[0]);
+	float prevVariation = AngularVariation(&skybox, rays, 0.0f);
+	printf("Level 0 (%4d^2): variation over 0.02 rad %.3f LSB\n", skybox.levels[0].size, prevVariation);
+	for (int l = 1; l < skybox.levelCount; l++) {
+		float3 mean = LevelMean(&skybox.levels[l]);
+		float drift = fmaxf(fabsf(mean.x - mean0.x), fmaxf(fabsf(mean.y - mean0.y), fabsf(mean.z - mean0.z)));
+		float r = sqrtf(exp2f((float)(l - (skybox.levelCount - 1))));
+		float variation = AngularVariation(&skybox, rays, r);
+		printf("Level %d (%4d^2, roughness %.2f): mean drift %.2f LSB, variation over 0.02 rad %.3f LSB\n",
+			   l, skybox.levels[l].size, r, drift, variation);
+		if (drift > 4.0f || variation > prevVariation) failures++;
+		prevVariation = variation;
+	}
+
+	// roughest level: directions either side of every face edge land on similar colours
+	float seam = 0.0f;
+	const float e = 1e-3f;
+	for (int i = 0; i < 256; i++) {
+		float t = i / 255.0f * 2.0f - 1.0f;
+		float3 pairs[][2] = {
+			{{1.0f, t, 1.0f + e}, {1.0f + e, t, 1.0f}},
+			{{-1.0f, t, 1.0f + e}, {-1.0f - e, t, 1.0f}},
+			{{t, 1.0f + e, 1.0f}, {t, 1.0f, 1.0f + e}},
+			{{t, -1.0f - e, -1.0f}, {t, -1.0f, -1.0f - e}},
+			{{1.0f + e, 1.0f, t}, {1.0f, 1.0f + e, t}},
+		};
+		for (int p = 0; p < 5; p++)
+			seam = fmaxf(seam, ColorDiff(SampleSkyboxRough(&skybox, pairs[p][0], 1.0f), SampleSkyboxRough(&skybox, pairs[p][1], 1.0f)));
+	}
+	printf("Roughest level, max step across face edges: %.0f LSB\n", seam);
+	if (seam > 8.0f) failures++;
+
+	// timing: old nearest lookup vs bilinear level 0 vs bilinear rough level
+	float nearest[SAMPLES], bilinear[SAMPLES], rough[SAMPLES];
+	for (int s = 0; s < SAMPLES; s++) {
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (int i = 0; i < RAYS; i++)
+			out[i] = SampleNearest(&skybox, rays[i]);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		nearest[s] = Seconds(t0, t1);
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (int i = 0; i < RAYS; i++)
+			out[i] = SampleSkybox(&skybox, rays[i]);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		bilinear[s] = Seconds(t0, t1);
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (int i = 0; i < RAYS; i++)
+			out[i] = SampleSkyboxRough(&skybox, rays[i], (i & 255) / 255.0f);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		rough[s] = Seconds(t0, t1);
+	}
+	PerformanceMetrics mn = ComputePerformanceMetrics(nearest, SAMPLES);
+	PerformanceMetrics mb = ComputePerformanceMetrics(bilinear, SAMPLES);
+	PerformanceMetrics mr = ComputePerformanceMetrics(rough, SAMPLES);
+	printf("Nearest  median=%.2fns/ray\n", mn.medianTime * 1e9f / RAYS);
+	printf("Bilinear median=%.2fns/ray\n", mb.medianTime * 1e9f / RAYS);
+	printf("Rough    median=%.2fns/ray\n", mr.medianTime * 1e9f / RAYS);
+
+	for (int l = 0; l < skybox.levelCount; l++) {
+		char path[64];
+		int n = skybox.levels[l].size;
+		snprintf(path, sizeof(path), "tests/img/skybox_level%d.bmp", l);
+		FILE *f = fopen(path, "wb");
+		if (f) {
+			WriteImageBMP(f, skybox.levels[l].texels + (size_t)SKYBOX_POS_Z * n * n, n, n);
+			fclose(f);
+		}
+	}
+
+	free(rays);
+	free(out);
+	DestroySkybox(&skybox);
+
+	if (failures) return 1;
+	printf("Correctness check passed.\n");
+	return 0;
+}
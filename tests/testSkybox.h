@@ -0,0 +1,11 @@
+#ifndef TEST_SKYBOX_H
+#define TEST_SKYBOX_H
+
+#include "../object/format.h"
+#include "../skybox/skybox.h"
+#include "../util/saveImage.h"
+#include "../math/vector3.h"
+
+// Built with: make test testSkybox
+
+#endif
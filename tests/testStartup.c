@@ -0,0 +1,109 @@
+// testStartup.c — runs a startup graph shaped like main's (a scene build and a model load
+// feeding an install step, independent font/skybox/flight-model loads, a volume load and an
+// OpenCL compile feeding an upload) with sleeps standing in for the work. Every step must run
+// exactly once and only after its dependencies; on the pool the independent steps must
+// overlap. Also checks the inline fallback and that a cycle is reported instead of hanging.
+// Compile with: make test testStartup
+#include "testStartup.h"
+#include "timings.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define SAMPLES 4
+
+typedef struct {
+	int ms;
+	int runs;
+} Work;
+
+static void Sleep(void *arg) {
+	Work *w = arg;
+	struct timespec t = {0, w->ms * 1000000L};
+	nanosleep(&t, NULL);
+	__atomic_add_fetch(&w->runs, 1, __ATOMIC_RELAXED);
+}
+
+// main's startup graph; returns the step count
+static int Build(Startup *s, Work *work) {
+	static const struct {
+		const char *name;
+		int ms;
+	} steps[] = {{"procedural scene", 40}, {"f16 model", 30}, {"f16 install", 5}, {"flight model", 5},
+				 {"font", 10}, {"skybox", 60}, {"cloud volume", 20}, {"opencl clouds", 50}, {"cloud upload", 5}};
+	int n = (int)(sizeof(steps) / sizeof(steps[0]));
+	Startup_Init(s);
+	for (int i = 0; i < n; i++) {
+		work[i] = (Work){steps[i].ms, 0};
+		Startup_Add(s, steps[i].name, Sleep, &work[i]);
+	}
+	Startup_After(s, 2, 0);
+	Startup_After(s, 2, 1);
+	Startup_After(s, 8, 6);
+	Startup_After(s, 8, 7);
+	return n;
+}
+
+static int CheckOrder(const Startup *s, const Work *work, int n) {
+	int bad = 0;
+	for (int i = 0; i < n; i++)
+		bad += work[i].runs != 1;
+	bad += s->steps[2].start < s->steps[0].end || s->steps[2].start < s->steps[1].end;
+	bad += s->steps[8].start < s->steps[6].end || s->steps[8].start < s->steps[7].end;
+	return bad;
+}
+
+int main(void) {
+	int failures = 0;
+	ThreadPool *pool = poolCreate(8, 64);
+	Startup s;
+	Work work[STARTUP_MAX_STEPS];
+
+	float pooled[SAMPLES], inline_[SAMPLES];
+	double serial = 0.0;
+	for (int r = 0; r < SAMPLES; r++) {
+		int n = Build(&s, work);
+		Startup_Run(&s, pool);
+		if (r == 0) {
+			printf("=== testStartup: %d steps on the pool ===\n", n);
+			Startup_PrintTimeline(&s, stdout);
+			for (int i = 0; i < n; i++)
+				serial += s.steps[i].end - s.steps[i].start;
+		}
+		failures += CheckOrder(&s, work, n) > 0;
+		pooled[r] = (float)s.total;
+		Startup_Destroy(&s);
+
+		n = Build(&s, work);
+		Startup_Run(&s, NULL);
+		failures += CheckOrder(&s, work, n) > 0;
+		inline_[r] = (float)s.total;
+		Startup_Destroy(&s);
+	}
+	PerformanceMetrics mp = ComputePerformanceMetrics(pooled, SAMPLES);
+	PerformanceMetrics mi = ComputePerformanceMetrics(inline_, SAMPLES);
+	printf("Pooled  median=%.1fms  p99=%.1fms\n", mp.medianTime * 1e3f, mp.p99Time * 1e3f);
+	printf("Inline  median=%.1fms  p99=%.1fms\n", mi.medianTime * 1e3f, mi.p99Time * 1e3f);
+	// the longest chain is the 60ms skybox against 225ms of steps
+	if (mp.medianTime > 0.5f * serial) {
+		printf("Independent steps did not overlap.\n");
+		failures++;
+	}
+
+	// a cycle leaves both steps unrun and Startup_Run must still return
+	Work a = {1, 0}, b = {1, 0};
+	Startup_Init(&s);
+	int sa = Startup_Add(&s, "a", Sleep, &a), sb = Startup_Add(&s, "b", Sleep, &b);
+	Startup_After(&s, sa, sb);
+	Startup_After(&s, sb, sa);
+	Startup_Run(&s, pool);
+	Startup_Destroy(&s);
+	printf("Cycle: %s\n", a.runs == 0 && b.runs == 0 ? "reported, nothing run" : "WRONG");
+	if (a.runs || b.runs) failures++;
+
+	poolDestroy(pool);
+	if (failures) return 1;
+	printf("Correctness check passed.\n");
+	return 0;
+}
@@ -0,0 +1,9 @@
+#ifndef TEST_STARTUP_H
+#define TEST_STARTUP_H
+
+#include "../util/startup.h"
+#include "../util/threadPool.h"
+
+// Built with: make test testStartup
+
+#endif
@@ -0,0 +1,228 @@
+// testTaa.c — checks temporal anti-aliasing on a deferred scene: with a static camera the
+// jittered, resolved frames must converge towards a 16x supersampled reference; with a
+// panning camera the reprojected history must track the current frame (no ghost trail)
+// better than history that ignores motion. Times the resolve and saves the images.
+// Compile with: make test testTaa
+#include "testTaa.h"
+#include "timings.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLES 32
+#define OBJECT_COUNT 9 // plane + 8 cubes
+#define TEST_WIDTH (WIDTH / 2)
+#define TEST_HEIGHT (HEIGHT / 2)
+#define REFERENCE_GRID 4 // REFERENCE_GRID^2 stratified samples per pixel
+#define CONVERGE_FRAMES 24
+#define PAN_FRAMES 16
+#define PAN_STEP 0.08f
+
+static float Seconds(struct timespec t0, struct timespec t1) {
+	return (float)(t1.tv_sec - t0.tv_sec) + (float)(t1.tv_nsec - t0.tv_nsec) * 1e-9f;
+}
+
+static void BuildScene(Object *objects, MaterialLib *lib) {
+	CreateCube(&objects[0], (float3){0.0f, -0.5f, 10.0f}, (float3){0.0f, 0.0f, 0.0f},
+			   (float3){80.0f, 1.0f, 80.0f}, (float3){0.32f, 0.34f, 0.38f}, lib, 0.0f, 0.9f, 0.0f);
+	for (int i = 1; i < OBJECT_COUNT; i++) {
+		float3 color = {0.3f + 0.7f * ((i * 37) % 11) / 10.0f, 0.3f + 0.7f * ((i * 53) % 11) / 10.0f, 0.3f + 0.7f * ((i * 71) % 11) / 10.0f};
+		CreateCube(&objects[i], (float3){-12.0f + (i - 1) % 4 * 8.0f, 1.0f, 4.0f + (i - 1) / 4 * 8.0f},
+				   (float3){0.0f, 0.4f * i, 0.0f}, (float3){2.0f, 2.0f, 2.0f}, color, lib,
+				   (i % 3 == 0) ? 6.0f : 0.0f, 0.5f, 0.0f);
+	}
+	for (int i = 0; i < OBJECT_COUNT; i++) {
+		objects[i].prevPostion = objects[i].position;
+		objects[i].prevRotation = objects[i].rotation;
+		objects[i].prevScale = objects[i].scale;
+	}
+}
+
+typedef struct {
+	Object *objects;
+	MaterialTable *matTable;
+	RayTraceTaskQueue *queue;
+	ThreadPool *pool;
+	Skybox *skybox;
+} Scene;
+
+static void RenderFrame(const Scene *scene, Camera *camera, float2 jitter) {
+	camera->jitter = jitter;
+	RenderSetup(scene->objects, OBJECT_COUNT, camera);
+	RayTraceSceneDeferred(scene->objects, OBJECT_COUNT, camera, scene->matTable, scene->queue, scene->pool, scene->skybox);
+}
+
+// Resolves hdrBuffer and packs the result into framebuffer for comparison.
+static void Resolve(const Scene *scene, Camera *camera, TemporalAA *taa) {
+	TaaResolve(taa, camera, scene->pool);
+	RayTracePackHdr(camera, scene->queue, scene->pool);
+}
+
+static double Psnr(const Color *a, const Color *b, int count) {
+	double sum = 0.0;
+	for (int i = 0; i < count; i++) {
+		for (int shift = 0; shift <= 16; shift += 8) {
+			int d = (int)((a[i] >> shift) & 0xFF) - (int)((b[i] >> shift) & 0xFF);
+			sum += d * d;
+		}
+	}
+	double mse = sum / (count * 3.0);
+	return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+// Box-filtered reference: average of a stratified grid of jittered renders.
+static void RenderReference(const Scene *scene, Camera *camera, Color *out) {
+	int n = camera->screenWidth * camera->screenHeight;
+	float *sum = calloc((size_t)n * 3, sizeof(float));
+	for (int sy = 0; sy < REFERENCE_GRID; sy++) {
+		for (int sx = 0; sx < REFERENCE_GRID; sx++) {
+			RenderFrame(scene, camera, (float2){(sx + 0.5f) / REFERENCE_GRID - 0.5f, (sy + 0.5f) / REFERENCE_GRID - 0.5f});
+			for (int i = 0; i < n; i++) {
+				Color c = camera->framebuffer[i];
+				sum[i * 3 + 0] += (float)((c >> 16) & 0xFF);
+				sum[i * 3 + 1] += (float)((c >> 8) & 0xFF);
+				sum[i * 3 + 2] += (float)(c & 0xFF);
+			}
+		}
+	}
+	const float inv = 1.0f / (REFERENCE_GRID * REFERENCE_GRID);
+	for (int i = 0; i < n; i++) {
+		out[i] = 0xFF000000u | (Color)(sum[i * 3] * inv + 0.5f) << 16 |
+				 (Color)(sum[i * 3 + 1] * inv + 0.5f) << 8 | (Color)(sum[i * 3 + 2] * inv + 0.5f);
+	}
+	free(sum);
+}
+
+// Pans right for PAN_FRAMES, resolving every frame; returns the mean PSNR of the resolved
+// frame against the raw frame over the last half of the pan.
+static double Pan(const Scene *scene, Camera *camera, TemporalAA *taa, Color *raw, int useMotion) {
+	camera->position = (float3){0.0f, 2.0f, -7.0f};
+	camera->forward = (float3){0.0f, -0.15f, 1.0f};
+	Taa_Reset(taa);
+	RenderSetup(scene->objects, OBJECT_COUNT, camera);
+	double psnr = 0.0;
+	int n = camera->screenWidth * camera->screenHeight;
+	for (int f = 0; f < PAN_FRAMES; f++) {
+		ComputePrevCameraPos(camera);
+		CameraMoveRight(camera, PAN_STEP);
+		RenderFrame(scene, camera, Taa_Jitter(f));
+		if (!useMotion) memset(camera->motionVectorBuffer, 0, sizeof(float2) * n);
+		memcpy(raw, camera->framebuffer, sizeof(Color) * n);
+		Resolve(scene, camera, taa);
+		if (f >= PAN_FRAMES / 2) psnr += Psnr(camera->framebuffer, raw, n);
+	}
+	return psnr / (PAN_FRAMES - PAN_FRAMES / 2);
+}
+
+int main(void) {
+	ThreadPool *pool = poolCreate(32, WIDTH);
+	if (!pool) {
+		fprintf(stderr, "Failed to create thread pool\n");
+		return 1;
+	}
+	TemporalAA taa;
+	Taa_Init(&taa, TEST_WIDTH, TEST_HEIGHT);
+	if (!taa.tasks) {
+		fprintf(stderr, "Failed to allocate TAA history\n");
+		return 1;
+	}
+
+	Object *objects = malloc(sizeof(Object) * OBJECT_COUNT);
+	MaterialLib matLib;
+	MaterialLib_Init(&matLib, 64);
+	BuildScene(objects, &matLib);
+	MaterialTable matTable;
+	MaterialTable_Init(&matTable);
+	MaterialTable_Sync(&matTable, &matLib);
+	Skybox skybox;
+	LoadSkybox(&skybox, "skybox");
+	RayTraceTaskQueue rayTaskQueue;
+	Scene scene = {objects, &matTable, &rayTaskQueue, pool, &skybox};
+
+	Camera camera;
+	initCamera(&camera, TEST_WIDTH, TEST_HEIGHT, 90.0f, (float3){0.0f, 2.0f, -7.0f},
+			   (float3){0.0f, -0.15f, 1.0f}, (float3){6.0f, 8.0f, -6.0f});
+	RenderSetup(objects, OBJECT_COUNT, &camera);
+	ComputePrevCameraPos(&camera);
+
+	int n = TEST_WIDTH * TEST_HEIGHT;
+	Color *reference = malloc(sizeof(Color) * n);
+	Color *aliased = malloc(sizeof(Color) * n);
+	Color *raw = malloc(sizeof(Color) * n);
+
+	printf("=== testTaa: %dx%d, %d jitter taps ===\n", TEST_WIDTH, TEST_HEIGHT, TAA_JITTER_TAPS);
+	int failures = 0;
+
+	for (int i = 0; i < TAA_JITTER_TAPS; i++) {
+		float2 j = Taa_Jitter(i);
+		if (!(fabsf(j.x) < 0.5f && fabsf(j.y) < 0.5f)) {
+			printf("Jitter tap %d (%f, %f) is outside the pixel.\n", i, j.x, j.y);
+			failures++;
+		}
+	}
+
+	// static camera: converge towards the supersampled reference
+	RenderReference(&scene, &camera, reference);
+	RenderFrame(&scene, &camera, (float2){0.0f, 0.0f});
+	memcpy(aliased, camera.framebuffer, sizeof(Color) * n);
+	for (int f = 0; f < CONVERGE_FRAMES; f++) {
+		RenderFrame(&scene, &camera, Taa_Jitter(f));
+		Resolve(&scene, &camera, &taa);
+	}
+	double psnrAliased = Psnr(aliased, reference, n);
+	double psnrTaa = Psnr(camera.framebuffer, reference, n);
+	printf("Static PSNR vs %dx reference: taa=%.2f dB  no-aa=%.2f dB\n", REFERENCE_GRID * REFERENCE_GRID, psnrTaa, psnrAliased);
+	if (psnrTaa < psnrAliased + 1.0) {
+		printf("TAA does not converge towards the reference.\n");
+		failures++;
+	}
+	SaveImage("tests/img/taa_resolved.bmp", &camera);
+	memcpy(camera.framebuffer, reference, sizeof(Color) * n);
+	SaveImage("tests/img/taa_supersampled.bmp", &camera);
+	memcpy(camera.framebuffer, aliased, sizeof(Color) * n);
+	SaveImage("tests/img/taa_off.bmp", &camera);
+
+	// timing on the converged frame (history valid, motion vectors zero)
+	float times[SAMPLES];
+	RenderFrame(&scene, &camera, Taa_Jitter(0));
+	half4 *rawHdr = malloc(sizeof(half4) * n);
+	memcpy(rawHdr, camera.hdrBuffer, sizeof(half4) * n);
+	for (int s = 0; s < SAMPLES; s++) {
+		memcpy(camera.hdrBuffer, rawHdr, sizeof(half4) * n);
+		struct timespec t0, t1;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		TaaResolve(&taa, &camera, pool);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		times[s] = Seconds(t0, t1);
+	}
+	PerformanceMetrics m = ComputePerformanceMetrics(times, SAMPLES);
+	printf("TAA resolve median=%.3fms  p99=%.3fms\n", m.medianTime * 1e3f, m.p99Time * 1e3f);
+
+	// panning camera: reprojection must keep the history on the moving image
+	double psnrStill = Pan(&scene, &camera, &taa, raw, 0);
+	double psnrMotion = Pan(&scene, &camera, &taa, raw, 1);
+	printf("Pan PSNR vs raw frame: reprojected=%.2f dB  unreprojected=%.2f dB\n", psnrMotion, psnrStill);
+	if (psnrMotion < psnrStill + 1.0) {
+		printf("Motion-vector reprojection does not reduce ghosting.\n");
+		failures++;
+	}
+	SaveImage("tests/img/taa_pan.bmp", &camera);
+
+	Taa_Destroy(&taa);
+	poolDestroy(pool);
+	free(reference);
+	free(aliased);
+	free(raw);
+	free(rawHdr);
+	DestroySkybox(&skybox);
+	destroyCamera(&camera);
+	Scene_Destroy(objects, OBJECT_COUNT);
+	MaterialTable_Destroy(&matTable);
+	MaterialLib_Destroy(&matLib);
+
+	if (failures) return 1;
+	printf("Correctness check passed.\n");
+	return 0;
+}
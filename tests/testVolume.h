@@ -0,0 +1,9 @@
+#ifndef TEST_VOLUME_H
+#define TEST_VOLUME_H
+
+#include "../object/format.h"
+#include "../object/object.h"
+
+// Built with: make test testVolume
+
+#endif
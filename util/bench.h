@@ -13,6 +13,10 @@
 #define BENCH_WARMUP 2.0
 #endif
 
+// When set, warmup is this many frames instead of BENCH_WARMUP seconds, so the hashed
+// frames are the same frames on every machine (headless runs with a scripted camera).
+// #define BENCH_WARMUP_FRAMES 30
+
 #ifndef BENCH_HASH_FRAMES
 #define BENCH_HASH_FRAMES 10
 #endif
@@ -22,6 +26,8 @@
 typedef struct {
 	double *times;
 	int count;
+	int frames;
+	double warmupEnd; // seconds from start to the first measured frame
 	struct timespec start;
 	struct timespec frameStart;
 	uint32_t frameHashes[BENCH_HASH_FRAMES];
@@ -75,9 +81,21 @@ static inline char *benchBase64Encode(const uint8_t *data, int len) {
 	return out;
 }
 
+static inline int benchWarmingUp(const Bench *b, double elapsed) {
+#ifdef BENCH_WARMUP_FRAMES
+	(void)elapsed;
+	return b->frames < BENCH_WARMUP_FRAMES;
+#else
+	(void)b;
+	return elapsed < BENCH_WARMUP;
+#endif
+}
+
 static inline void benchInit(Bench *b) {
 	b->times = malloc(sizeof(double) * BENCH_MAX_FRAMES);
 	b->count = 0;
+	b->frames = 0;
+	b->warmupEnd = 0.0;
 	b->hashCount = 0;
 	b->frameWidth = 0;
 	b->frameHeight = 0;
@@ -90,7 +108,7 @@ static inline void benchCaptureFrame(Bench *b, const uint32_t *pixels, int width
 	if (b->hashCount >= BENCH_HASH_FRAMES) return;
 	struct timespec now;
 	clock_gettime(CLOCK_MONOTONIC, &now);
-	if (benchDiff(b->start, now) < BENCH_WARMUP) return;
+	if (benchWarmingUp(b, benchDiff(b->start, now))) return;
 	int pixelCount = width * height;
 	b->frameWidth = width;
 	b->frameHeight = height;
@@ -110,9 +128,12 @@ static inline int benchFrameEnd(Bench *b) {
 	struct timespec now;
 	clock_gettime(CLOCK_MONOTONIC, &now);
 	double elapsed = benchDiff(b->start, now);
-	if (elapsed >= BENCH_WARMUP && b->count < BENCH_MAX_FRAMES)
+	int warm = !benchWarmingUp(b, elapsed);
+	b->frames++;
+	if (warm && b->count == 0) b->warmupEnd = benchDiff(b->start, b->frameStart);
+	if (warm && b->count < BENCH_MAX_FRAMES)
 		b->times[b->count++] = benchDiff(b->frameStart, now) * 1000.0;
-	return elapsed >= BENCH_WARMUP + BENCH_DURATION;
+	return warm && elapsed >= b->warmupEnd + BENCH_DURATION;
 }
 
 static inline void benchReport(Bench *b) {
@@ -5,9 +5,12 @@ void SaveImage(const char *filename, const Camera *camera) {
 
 	FILE *f = fopen(filename, "wb");
 	if (!f) return;
+	WriteImageBMP(f, camera->framebuffer, camera->screenWidth, camera->screenHeight);
+	fclose(f);
+}
 
-	int width = camera->screenWidth;
-	int height = camera->screenHeight;
+void WriteImageBMP(FILE *f, const Color *pixels, int width, int height) {
+	if (!f || !pixels) return;
 	int rowSize = (width * 3 + 3) & ~3;
 	int dataSize = rowSize * height;
 	int fileSize = 14 + 40 + dataSize;
@@ -48,7 +51,7 @@ void SaveImage(const char *filename, const Camera *camera) {
 	unsigned char row[rowSize];
 	for (int y = height - 1; y >= 0; y--) {
 		for (int x = 0; x < width; x++) {
-			unsigned int c = camera->framebuffer[y * width + x];
+			unsigned int c = pixels[y * width + x];
 			row[x * 3 + 0] = (c) & 0xFF;	   // B
 			row[x * 3 + 1] = (c >> 8) & 0xFF;  // G
 			row[x * 3 + 2] = (c >> 16) & 0xFF; // R
@@ -58,6 +61,24 @@ void SaveImage(const char *filename, const Camera *camera) {
 			row[x] = 0;
 		fwrite(row, 1, rowSize, f);
 	}
+}
 
-	fclose(f);
+void WriteImagePPM(FILE *f, const Color *pixels, int width, int height) {
+	if (!f || !pixels) return;
+	fprintf(f, "P6\n%d %d\n255\n", width, height);
+	unsigned char row[width * 3];
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			unsigned int c = pixels[y * width + x];
+			row[x * 3 + 0] = (c >> 16) & 0xFF; // R
+			row[x * 3 + 1] = (c >> 8) & 0xFF;  // G
+			row[x * 3 + 2] = (c) & 0xFF;	   // B
+		}
+		fwrite(row, 1, sizeof(row), f);
+	}
+}
+
+void WriteImageRaw(FILE *f, const Color *pixels, int width, int height) {
+	if (!f || !pixels) return;
+	fwrite(pixels, sizeof(Color), (size_t)width * height, f);
 }
@@ -5,4 +5,10 @@
 
 void SaveImage(const char *filename, const Camera *camera);
 
-#endif // SAVE_IMAGE_H
\ No newline at end of file
+// One 0xAARRGGBB image to an open stream, so files and pipes share a path. Raw is the
+// pixels as stored (BGRA bytes), top row first; PPM is binary P6.
+void WriteImageBMP(FILE *f, const Color *pixels, int width, int height);
+void WriteImagePPM(FILE *f, const Color *pixels, int width, int height);
+void WriteImageRaw(FILE *f, const Color *pixels, int width, int height);
+
+#endif // SAVE_IMAGE_H
@@ -0,0 +1,103 @@
+#include "startup.h"
+#include <string.h>
+#include <time.h>
+
+static double Elapsed(const Startup *startup) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)(now.tv_sec - startup->t0.tv_sec) + (double)(now.tv_nsec - startup->t0.tv_nsec) * 1e-9;
+}
+
+void Startup_Init(Startup *startup) {
+	if (!startup) return;
+	memset(startup, 0, sizeof(Startup));
+	pthread_mutex_init(&startup->lock, NULL);
+}
+
+void Startup_Destroy(Startup *startup) {
+	if (!startup) return;
+	pthread_mutex_destroy(&startup->lock);
+	memset(startup, 0, sizeof(Startup));
+}
+
+int Startup_Add(Startup *startup, const char *name, StartupFn fn, void *arg) {
+	if (!startup || !fn || startup->count >= STARTUP_MAX_STEPS) return -1;
+	startup->steps[startup->count] = (StartupStep){.startup = startup, .name = name, .fn = fn, .arg = arg};
+	return startup->count++;
+}
+
+int Startup_After(Startup *startup, int step, int dependency) {
+	if (!startup || step < 0 || dependency < 0 || step >= startup->count || dependency >= startup->count || step == dependency) return 0;
+	StartupStep *dep = &startup->steps[dependency];
+	if (dep->dependentCount >= STARTUP_MAX_DEPENDENTS) return 0;
+	dep->dependents[dep->dependentCount++] = step;
+	startup->steps[step].waiting++;
+	return 1;
+}
+
+// Pool task: runs the step, then queues every dependent it was the last dependency of. The
+// dependents are queued before this task returns, so poolWait cannot see the pool drain early.
+static void RunStep(void *arg) {
+	StartupStep *step = arg;
+	Startup *startup = step->startup;
+	step->start = Elapsed(startup);
+	step->fn(step->arg);
+	step->end = Elapsed(startup);
+
+	for (int i = 0; i < step->dependentCount; i++) {
+		int d = step->dependents[i];
+		pthread_mutex_lock(&startup->lock);
+		int ready = --startup->steps[d].waiting == 0;
+		pthread_mutex_unlock(&startup->lock);
+		if (ready) poolAdd(startup->pool, RunStep, &startup->steps[d]);
+	}
+}
+
+void Startup_Run(Startup *startup, ThreadPool *pool) {
+	if (!startup) return;
+	startup->pool = pool;
+	clock_gettime(CLOCK_MONOTONIC, &startup->t0);
+
+	if (pool) {
+		// collect the roots first: a root finishing early must not race this loop
+		int roots[STARTUP_MAX_STEPS], rootCount = 0;
+		for (int i = 0; i < startup->count; i++)
+			if (startup->steps[i].waiting == 0) roots[rootCount++] = i;
+		for (int i = 0; i < rootCount; i++)
+			poolAdd(pool, RunStep, &startup->steps[roots[i]]);
+		poolWait(pool);
+	} else {
+		// repeatedly run any step whose dependencies are done
+		int done[STARTUP_MAX_STEPS] = {0}, remaining = startup->count, progress = 1;
+		while (remaining > 0 && progress) {
+			progress = 0;
+			for (int i = 0; i < startup->count; i++) {
+				if (done[i] || startup->steps[i].waiting > 0) continue;
+				StartupStep *step = &startup->steps[i];
+				step->start = Elapsed(startup);
+				step->fn(step->arg);
+				step->end = Elapsed(startup);
+				for (int d = 0; d < step->dependentCount; d++)
+					startup->steps[step->dependents[d]].waiting--;
+				done[i] = progress = 1;
+				remaining--;
+			}
+		}
+	}
+	startup->total = Elapsed(startup);
+
+	for (int i = 0; i < startup->count; i++)
+		if (startup->steps[i].waiting > 0) fprintf(stderr, "Startup: %s never ran (dependency cycle)\n", startup->steps[i].name);
+}
+
+void Startup_PrintTimeline(const Startup *startup, FILE *out) {
+	if (!startup || !out) return;
+	double serial = 0.0;
+	for (int i = 0; i < startup->count; i++) {
+		const StartupStep *step = &startup->steps[i];
+		serial += step->end - step->start;
+		fprintf(out, "  %-16s %8.1f -> %8.1f ms  (%.1f ms)\n", step->name, step->start * 1e3, step->end * 1e3, (step->end - step->start) * 1e3);
+	}
+	fprintf(out, "Startup: %.1f ms wall, %.1f ms of steps (%.2fx overlap)\n", startup->total * 1e3, serial * 1e3,
+			startup->total > 0.0 ? serial / startup->total : 1.0);
+}
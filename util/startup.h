@@ -0,0 +1,54 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include "threadPool.h"
+#include <stdio.h>
+
+// Runs the loads before the first frame as a small dependency graph on the thread pool:
+// every step whose dependencies have finished is queued at once, so independent loads
+// (model, skybox, font, OpenCL compile, ...) overlap. Each step records when it ran for a
+// timeline. Steps that touch shared state (the material lib, the scene) must be ordered
+// with Startup_After or given private copies that a later step merges.
+
+#define STARTUP_MAX_STEPS 16
+#define STARTUP_MAX_DEPENDENTS 8
+
+typedef void (*StartupFn)(void *arg);
+
+struct Startup;
+
+typedef struct {
+	struct Startup *startup;
+	const char *name;
+	StartupFn fn;
+	void *arg;
+	int dependents[STARTUP_MAX_DEPENDENTS]; // steps waiting on this one
+	int dependentCount;
+	int waiting; // unfinished dependencies
+	double start, end; // seconds since Startup_Run began
+} StartupStep;
+
+typedef struct Startup {
+	StartupStep steps[STARTUP_MAX_STEPS];
+	int count;
+	ThreadPool *pool;
+	pthread_mutex_t lock; // guards waiting counts while steps finish
+	struct timespec t0;
+	double total; // wall time of Startup_Run
+} Startup;
+
+void Startup_Init(Startup *startup);
+void Startup_Destroy(Startup *startup);
+// Returns the step's index, or -1 if STARTUP_MAX_STEPS is reached.
+int Startup_Add(Startup *startup, const char *name, StartupFn fn, void *arg);
+// step starts only once dependency has finished; returns 0 if either index is invalid or
+// dependency has STARTUP_MAX_DEPENDENTS already.
+int Startup_After(Startup *startup, int step, int dependency);
+// Runs every step and returns when all have finished. The pool must be otherwise idle:
+// completion is detected with poolWait. Without a pool the steps run inline in an order
+// that respects the dependencies.
+void Startup_Run(Startup *startup, ThreadPool *pool);
+// One line per step with start, end and duration, then the wall time against the serial sum.
+void Startup_PrintTimeline(const Startup *startup, FILE *out);
+
+#endif // STARTUP_H